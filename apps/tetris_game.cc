@@ -7,6 +7,9 @@
 #include <cinder/audio/Voice.h>
 #include <cinder/gl/gl.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
 #include <strstream>
 
 using cinder::app::KeyEvent;
@@ -18,13 +21,65 @@ constexpr const static char kBackgroundMusicName[] = "Tetris_Main_Theme.mp3";
 constexpr const static char kEndingMusicName[] = "Tetris_Ending_Theme.mp3";
 const char kNormalFont[] = "Arial";
 const double kTextBoxWidth = 2.0;
+const char kSpectateFlag[] = "--spectate";
+const char kTelemetryFlag[] = "--telemetry";
+const char kScoresFlag[] = "--scores";
+const char kDefaultScoresPath[] = "scores.db";
+const char kTraceFlag[] = "--trace";
+const char kDefaultTracePath[] = "trace.json";
+const char kReplayIndexFlag[] = "--replay-index";
+const char kPiecesFlag[] = "--pieces";
+const char kOverlayFont[] = "Courier";
+const size_t kOverlayFontSize = 14;
+// the time a frame has at 60 frames a second
+const float kFrameBudgetMs = 1000.0f / 60.0f;
+// the profiler graphs go up to two frame budgets
+const float kProfilerRangeMs = 2.0f * kFrameBudgetMs;
+const float kProfilerGraphHeight = 60.0f;
+const size_t kProfilerTextInterval = 30;
+// preview and held blocks are drawn at this fraction of a board tile
+const float kPreviewScale = 0.5f;
+// part of a preview tile that is filled, leaving a gap between tiles
+const float kPreviewTileFill = 0.9f;
+// colors of the step phases in the update graph, in StepPhase order
+const cinder::ColorA kStepPhaseColors[World::kNumStepPhases] = {
+    cinder::ColorA(0.2f, 0.6f, 1.0f, 0.9f),
+    cinder::ColorA(1.0f, 0.8f, 0.2f, 0.9f),
+    cinder::ColorA(0.8f, 0.4f, 1.0f, 0.9f),
+    cinder::ColorA(0.4f, 1.0f, 0.6f, 0.9f)};
+
+/**
+ * Gets the time since a point in time
+ * @param start the point in time
+ * @return milliseconds since start
+ */
+static float GetMillisecondsSince(
+    std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<float, std::milli>(
+      std::chrono::steady_clock::now() - start).count();
+}
+
+TetrisGame::TetrisGame() : engine_(), trace_path_(kDefaultTracePath),
+    is_score_submitted_(false),
+    score_texture_value_(0), is_allocation_overlay_shown_(false),
+    frames_until_allocation_text_(0),
+    is_profiler_shown_(false), profiler_batch_(GL_TRIANGLES),
+    frames_until_profiler_text_(0), is_replay_paused_(false) {}
 
-TetrisGame::TetrisGame() : engine_() {}
+TetrisGame::~TetrisGame() {
+  if (spectator_encoder_) {
+    engine_.GetWorld().RemoveListener(spectator_encoder_.get());
+  }
+
+  if (event_log_writer_) {
+    engine_.GetWorld().RemoveListener(event_log_writer_.get());
+  }
+}
 
 void TetrisGame::DrawPolygonBlock(const Block* block) {
   // Color of the bomb changes randomly,
   // while other blocks remain the same color
-  if (block->GetTemplateId() == World::kBombId) {
+  if (block->IsBomb()) {
     float random_double = (float) random() / RAND_MAX;
     cinder::gl::color(random_double, random_double, random_double);
   } else {
@@ -44,53 +99,269 @@ void TetrisGame::DrawPolygonBlock(const Block* block) {
   }
 }
 
+void TetrisGame::DrawGhostBlock(const Block* block) {
+  float drop_distance = engine_.GetWorld().GetDropDistance();
+  if (drop_distance <= 0.0f) {
+    return;
+  }
+
+  cinder::gl::color(block->GetColor());
+  for (const b2AABB& tile : block->GetBoundingBoxList()) {
+    double tile_size = GetTileDisplaySize();
+    cinder::Rectf rectangle(
+        tile_size * (tile.lowerBound.x),
+        tile_size * (engine_.GetWorld().GetTotalNumRow()
+            - (tile.upperBound.y - drop_distance)),
+        tile_size * (tile.upperBound.x),
+        tile_size * (engine_.GetWorld().GetTotalNumRow()
+            - (tile.lowerBound.y - drop_distance)));
+    cinder::gl::drawStrokedRect(rectangle);
+  }
+}
+
 void TetrisGame::update() {
-  engine_.GetWorld().Step();
+  TraceSpan span("TetrisGame::update");
+  auto update_start = std::chrono::steady_clock::now();
+  // covers everything since the last update, so the last draw too
+  frame_allocations_.Sample();
+  if (!replay_index_) {
+    engine_.GetWorld().Step();
+  } else if (!is_replay_paused_) {
+    // stops by itself when the game ends or the index runs out
+    World& world = engine_.GetWorld();
+    replay_index_->GetReplay().Advance(&world,
+        std::min(world.GetTickCount() + 1, replay_index_->GetNumTicks()));
+  }
+
+  update_times_.Add(GetMillisecondsSince(update_start));
+
+  const std::array<float, World::kNumStepPhases>& phase_times =
+      engine_.GetWorld().GetStepPhaseTimes();
+  for (size_t phase = 0; phase < World::kNumStepPhases; phase++) {
+    step_phase_times_[phase].Add(phase_times[phase]);
+  }
 }
 
 void TetrisGame::draw() {
-  cinder::gl::clear();
+  TraceSpan span("TetrisGame::draw");
+  auto frame_start = std::chrono::steady_clock::now();
+  if (last_frame_start_ != std::chrono::steady_clock::time_point()) {
+    frame_intervals_.Add(std::chrono::duration<float, std::milli>(
+        frame_start - last_frame_start_).count());
+  }
 
-  // draw beginning options and modes
-  if (engine_.GetCurrentGameState() == World::kChooseMode) {
-    DrawStartScreen();
-    return;
+  last_frame_start_ = frame_start;
+  {
+    AllocationScope renderer_scope(AllocationTracker::kRenderer);
+    cinder::gl::clear();
+
+    if (engine_.GetCurrentGameState() == World::kChooseMode) {
+      // draw beginning options and modes
+      DrawStartScreen();
+    } else if (engine_.GetCurrentGameState() == World::kEndScreen) {
+      // draw ending options and scores
+      DrawEndingScreen();
+    } else {
+      DrawGame();
+    }
   }
 
-  // draw ending options and scores
-  if (engine_.GetCurrentGameState() == World::kEndScreen) {
-    DrawEndingScreen();
-    return;
+  // the overlays are left out so they don't count towards what they show
+  draw_times_.Add(GetMillisecondsSince(frame_start));
+  if (is_allocation_overlay_shown_) {
+    DrawAllocationOverlay();
   }
 
+  if (is_profiler_shown_) {
+    DrawProfilerOverlay();
+  }
+
+  if (replay_index_) {
+    DrawReplayPosition();
+  }
+}
+
+void TetrisGame::DrawGame() {
   // only draw blocks once a game is in progress and a block has spawned
   const Block* block = engine_.GetWorld().GetMovingBlock();
   if (block != nullptr) {
-    b2Vec2 position = block->GetBody()->GetPosition();
-    float angle = block->GetBody()->GetAngle();
-    printf("%4.2f %4.2f %4.2f\n", position.x, position.y, angle);
+    DrawGhostBlock(block);
     DrawPolygonBlock(block);
   }
 
+  DrawDebris();
   DrawFloor();
+  DrawPreviewAndHold();
   DrawCurrentScore();
 }
 
+void TetrisGame::DrawWaitingBlock(const Block& block, const cinder::vec2& loc,
+    float tile_size, float alpha) {
+  const BlockTemplate& block_template = block.GetTemplate();
+  cinder::gl::color(cinder::ColorA(block_template.red_,
+      block_template.green_, block_template.blue_, alpha));
+  for (size_t tile = 0; tile < block_template.num_tiles_; tile++) {
+    // rows count up from the bottom of the box, the screen counts down
+    const BlockTemplate::Cell& cell = block_template.cells_[0][tile];
+    float left = loc.x + cell.col_ * tile_size;
+    float top = loc.y + (BlockTemplate::kBoxSize - 1 - cell.row_) * tile_size;
+    float fill = tile_size * kPreviewTileFill;
+    cinder::gl::drawSolidRect(
+        cinder::Rectf(left, top, left + fill, top + fill));
+  }
+}
+
+void TetrisGame::DrawPreviewAndHold() {
+  const World& world = engine_.GetWorld();
+  float tile_size = static_cast<float>(GetTileDisplaySize()) * kPreviewScale;
+  float box_size = tile_size * BlockTemplate::kBoxSize;
+  float margin = tile_size;
+  cinder::gl::ScopedBlendAlpha blend;
+  for (size_t index = 0; index < world.GetNumPreviewBlocks(); index++) {
+    cinder::vec2 loc(static_cast<float>(GetCanvasWidth()) - margin - box_size,
+        margin + index * (box_size + margin));
+    // blocks further back are fainter
+    DrawWaitingBlock(world.GetPreviewBlock(index), loc, tile_size,
+        1.0f - 0.25f * index);
+  }
+
+  const Block* held_block = world.GetHeldBlock();
+  if (held_block != nullptr) {
+    // faded while it can't be swapped back
+    DrawWaitingBlock(*held_block, cinder::vec2(margin, margin), tile_size,
+        world.IsHoldUsed() ? 0.35f : 1.0f);
+  }
+}
+
 void TetrisGame::setup() {
-  // setting up background music
-  cinder::audio::SourceFileRef background_file = cinder::audio::load(
-      cinder::app::loadAsset(kBackgroundMusicName));
-  background_music_ = cinder::audio::Voice::create(background_file);
-  background_music_->start();
-  background_music_->setVolume(0.5);
-
-  cinder::audio::SourceFileRef ending_file = cinder::audio::load(
-      cinder::app::loadAsset(kEndingMusicName));
-  ending_music_ = cinder::audio::Voice::create(ending_file);
-  ending_music_->setVolume(0.5);
+  // spans are cheap enough to record all the time, so a stutter can be
+  // dumped right after it happens
+  Tracer::SetEnabled(true);
+  Tracer::SetThreadName("main");
+  TraceSpan span("TetrisGame::setup");
+
+  {
+    // setting up background music
+    TraceSpan load_span("TetrisGame::LoadMusic");
+    cinder::audio::SourceFileRef background_file = cinder::audio::load(
+        cinder::app::loadAsset(kBackgroundMusicName));
+    background_music_ = cinder::audio::Voice::create(background_file);
+    background_music_->start();
+    background_music_->setVolume(0.5);
+
+    cinder::audio::SourceFileRef ending_file = cinder::audio::load(
+        cinder::app::loadAsset(kEndingMusicName));
+    ending_music_ = cinder::audio::Voice::create(ending_file);
+    ending_music_->setVolume(0.5);
+  }
+
+  // publish the game to spectators and log its events if paths were given
+  const std::vector<std::string>& args = getCommandLineArgs();
+  std::string scores_path = kDefaultScoresPath;
+  for (size_t index = 0; index + 1 < args.size(); index++) {
+    if (args[index] == kScoresFlag) {
+      scores_path = args[index + 1];
+    }
+
+    if (args[index] == kTraceFlag) {
+      trace_path_ = args[index + 1];
+    }
+
+    if (args[index] == kPiecesFlag) {
+      std::string error;
+      if (piece_set_.Load(args[index + 1], &error)) {
+        engine_.GetWorld().SetPieceSet(&piece_set_);
+      } else {
+        printf("could not load pieces %s, %s\n", args[index + 1].c_str(),
+            error.c_str());
+      }
+    }
+
+    if (args[index] == kReplayIndexFlag) {
+      replay_index_.reset(new ReplayIndex);
+      if (replay_index_->Open(args[index + 1])
+          && replay_index_->SeekTo(&engine_.GetWorld(), 0)) {
+        // a watched game is not the player's, so its score isn't saved
+        is_score_submitted_ = true;
+      } else {
+        printf("could not open replay index %s\n", args[index + 1].c_str());
+        replay_index_.reset();
+      }
+    }
+
+    if (args[index] == kTelemetryFlag) {
+      event_log_writer_.reset(new EventLogWriter);
+      if (event_log_writer_->Open(args[index + 1])) {
+        engine_.GetWorld().AddListener(event_log_writer_.get());
+      } else {
+        event_log_writer_.reset();
+      }
+    }
+
+    if (args[index] != kSpectateFlag) {
+      continue;
+    }
+
+    spectator_publisher_.reset(new SpectatorPublisher);
+    if (spectator_publisher_->Listen(args[index + 1])) {
+      spectator_encoder_.reset(
+          new SpectatorEncoder(spectator_publisher_.get()));
+      engine_.GetWorld().AddListener(spectator_encoder_.get());
+    }
+  }
+
+  // the game still runs without saving scores if the database won't open
+  score_store_.Open(scores_path);
+}
+
+bool TetrisGame::ScrubReplay(int key_code) {
+  size_t tick = engine_.GetWorld().GetTickCount();
+  size_t interval = replay_index_->GetKeyframeInterval();
+  switch (key_code) {
+    // pauses or resumes the replay
+    case KeyEvent::KEY_SPACE: {
+      is_replay_paused_ = !is_replay_paused_;
+      return true;
+    }
+
+    // steps one tick back or forward, pausing first
+    case KeyEvent::KEY_LEFT:
+    case KeyEvent::KEY_RIGHT: {
+      is_replay_paused_ = true;
+      if (key_code == KeyEvent::KEY_RIGHT) {
+        replay_index_->SeekTo(&engine_.GetWorld(), tick + 1);
+      } else if (tick > 0) {
+        replay_index_->SeekTo(&engine_.GetWorld(), tick - 1);
+      }
+      return true;
+    }
+
+    // jumps one keyframe interval back or forward
+    case KeyEvent::KEY_DOWN:
+    case KeyEvent::KEY_UP: {
+      size_t target = key_code == KeyEvent::KEY_UP ? tick + interval
+          : tick - std::min(tick, interval);
+      replay_index_->SeekTo(&engine_.GetWorld(), target);
+      return true;
+    }
+
+    // the replay makes every move, so rotating and holding are ignored
+    case KeyEvent::KEY_z:
+    case KeyEvent::KEY_c: {
+      return true;
+    }
+
+    default: {
+      return false;
+    }
+  }
 }
 
 void TetrisGame::keyDown(KeyEvent event) {
+  if (replay_index_ && ScrubReplay(event.getCode())) {
+    return;
+  }
+
   switch (event.getCode()) {
     // Choose game mode classic
     case KeyEvent::KEY_1: {
@@ -111,8 +382,8 @@ void TetrisGame::keyDown(KeyEvent event) {
     // Choose blitz mode
     case KeyEvent::KEY_3: {
       if (engine_.GetCurrentGameState() == World::kChooseMode) {
-        engine_.SetCurrentGameState(World::kReloaded);
         engine_.GetWorld().SetIsTileDisconnectedMode(true);
+        engine_.SetCurrentGameState(World::kReloaded);
       }
       break;
     }
@@ -120,8 +391,8 @@ void TetrisGame::keyDown(KeyEvent event) {
     // Choose bomb mode
     case KeyEvent::KEY_4: {
       if (engine_.GetCurrentGameState() == World::kChooseMode) {
-        engine_.SetCurrentGameState(World::kClassic);
         engine_.GetWorld().SetIsBombMode(true);
+        engine_.SetCurrentGameState(World::kClassic);
       }
       break;
     }
@@ -150,8 +421,49 @@ void TetrisGame::keyDown(KeyEvent event) {
       break;
     }
 
+    // drops the block onto the floor at once
+    case KeyEvent::KEY_SPACE: {
+      engine_.Move(Block::kHardDrop);
+      break;
+    }
+
+    // puts the block aside, or swaps it with the one put aside
+    case KeyEvent::KEY_c: {
+      engine_.Move(Block::kHold);
+      break;
+    }
+
+    // shows or hides the heap allocation counts
+    case KeyEvent::KEY_F1: {
+      is_allocation_overlay_shown_ = !is_allocation_overlay_shown_;
+      break;
+    }
+
+    // shows or hides the frame and step timings
+    case KeyEvent::KEY_F2: {
+      is_profiler_shown_ = !is_profiler_shown_;
+      break;
+    }
+
+    // writes the last few seconds of spans for chrome://tracing
+    case KeyEvent::KEY_F3: {
+      if (Tracer::WriteChromeTrace(trace_path_)) {
+        printf("wrote trace to %s\n", trace_path_.c_str());
+      } else {
+        printf("could not write trace to %s\n", trace_path_.c_str());
+      }
+      break;
+    }
+
     // Exits and ends the game
     case KeyEvent::KEY_ESCAPE: {
+      // exit skips destructors, so finish writing scores and logs first
+      score_store_.Flush();
+      if (event_log_writer_) {
+        engine_.GetWorld().RemoveListener(event_log_writer_.get());
+        event_log_writer_.reset();
+      }
+
       exit(EXIT_SUCCESS);
     }
   }
@@ -202,10 +514,28 @@ void TetrisGame::DrawStartScreen() {
             control_size, position_score, 18);
 }
 
+void TetrisGame::SubmitScore() {
+  if (is_score_submitted_) {
+    return;
+  }
+
+  is_score_submitted_ = true;
+  const Replay& replay = engine_.GetReplay();
+  ScoreRecord record;
+  record.score_ = engine_.GetWorld().GetScore();
+  record.mode_ = replay.GetModeName();
+  record.seed_ = replay.GetSeed();
+  record.played_at_ = std::chrono::duration_cast<std::chrono::seconds>(
+      std::chrono::system_clock::now().time_since_epoch()).count();
+  record.replay_ = replay.Serialize();
+  score_store_.Submit(std::move(record));
+}
+
 void TetrisGame::DrawEndingScreen() {
   // stop regular background music and play ending theme
   background_music_->stop();
   ending_music_->start();
+  SubmitScore();
 
   double canvas_width = GetCanvasWidth();
   double canvas_height = GetCanvasHeight();
@@ -224,28 +554,37 @@ void TetrisGame::DrawEndingScreen() {
   game_over_stream << "Game Over     "
       << "Your final score: "
       << engine_.GetWorld().GetScore() << "       "
-      <<  "     -----------------      "
-      << "Press Esc to exit the game";
+      <<  "     -----------------      ";
+  // served from memory, so drawing it every frame costs no queries
+  std::vector<LeaderboardEntry> leaderboard =
+      score_store_.GetLeaderboard(engine_.GetReplay().GetModeName());
+  if (!leaderboard.empty()) {
+    game_over_stream << "High scores: ";
+    for (size_t index = 0; index < leaderboard.size(); index++) {
+      game_over_stream << (index + 1) << ". " << leaderboard[index].score_
+          << "   ";
+    }
+
+    game_over_stream << "     -----------------      ";
+  }
+
+  game_over_stream << "Press Esc to exit the game";
   PrintText(game_over_stream.str(), cinder::Color::white(),
             title_size, position_title, 40);
 }
 
 void TetrisGame::DrawFloor() {
-  std::vector<std::vector<Block::Tile>>& tile_array =
-      engine_.GetWorld().GetFloorTileArray();
-
-  for (size_t row = 0; row < tile_array.size(); row++) {
-    for (size_t col = 0; col < tile_array[row].size(); col++) {
-      Block::Tile &tile = tile_array[row][col];
+  Board& board = engine_.GetWorld().GetBoard();
 
-      // don't color null fixtures with black
-      // draw white colored tiles to simulate explosion effect
-      if ((tile.fixture_ == nullptr)
-          && (tile.color_ != cinder::Color::white())) {
+  for (size_t row = 0; row < board.GetNumRows(); row++) {
+    for (size_t col = 0; col < board.GetNumCols(); col++) {
+      // don't color empty tiles with black
+      // draw exploded tiles white to simulate explosion effect
+      if (!board.IsFilled(row, col) && !board.IsExploded(row, col)) {
         continue;
       }
 
-      cinder::gl::color(tile.color_);
+      cinder::gl::color(board.GetTileColor(row, col));
       double adjust_height = 0.95;
       double adjust_offset = 0.05;
       double adjust_tile_to_display = GetTileDisplaySize();
@@ -258,15 +597,32 @@ void TetrisGame::DrawFloor() {
           (engine_.GetWorld().GetTotalNumRow() - (row + adjust_offset)));
       cinder::gl::drawSolidRect(rectangle);
 
-      // change color back to black for the white explosion to disappear
+      // empty the exploded tile for the white explosion to disappear
       // only want white color to show for 1 frame before dissapearing
-      if (tile.color_ == cinder::Color::white()) {
-        tile.color_ = cinder::Color::black();
+      if (board.IsExploded(row, col)) {
+        board.ClearTile(row, col);
       }
     }
   }
 }
 
+void TetrisGame::DrawDebris() {
+  double tile_size = GetTileDisplaySize();
+  double num_rows = engine_.GetWorld().GetTotalNumRow();
+  for (const World::Debris& debris : engine_.GetWorld().GetDebris()) {
+    const BlockTemplate& block_template = *debris.block_template_;
+    cinder::gl::color(block_template.red_, block_template.green_,
+        block_template.blue_);
+    const b2AABB& tile = debris.body_->GetFixtureList()->GetAABB(0);
+    cinder::Rectf rectangle(
+        tile_size * tile.lowerBound.x,
+        tile_size * (num_rows - tile.upperBound.y),
+        tile_size * tile.upperBound.x,
+        tile_size * (num_rows - tile.lowerBound.y));
+    cinder::gl::drawSolidRect(rectangle);
+  }
+}
+
 void TetrisGame::DrawCurrentScore() {
   double canvas_width = GetCanvasWidth();
 
@@ -279,11 +635,225 @@ void TetrisGame::DrawCurrentScore() {
   const cinder::vec2 position_score = {rectf.getCenter().x,
                                        rectf.getCenter().y};
   const cinder::ivec2 size_value = {80, 15};
-  std::strstream strstream;
-  strstream << "Score : "
-            << std::to_string(engine_.GetWorld().GetScore());
-  PrintText(strstream.str(), cinder::Color::white(),
-            size_value, position_score, 15);
+  size_t score = engine_.GetWorld().GetScore();
+  if (!score_texture_ || score != score_texture_value_) {
+    score_texture_ = RenderText("Score : " + std::to_string(score),
+        cinder::Color::white(), size_value, 15);
+    score_texture_value_ = score;
+  }
+
+  cinder::gl::color(cinder::Color::white());
+  DrawCentered(score_texture_, position_score);
+}
+
+void TetrisGame::DrawAllocationOverlay() {
+  // the overlay's own text and texture are not charged to the renderer,
+  // so turning it on doesn't change the numbers it shows
+  AllocationScope overlay_scope(AllocationTracker::kOther);
+  // the text is rendered again every kProfilerTextInterval frames like
+  // the profiler's, so the overlay makes few allocations of its own
+  if (!allocation_texture_ || frames_until_allocation_text_ == 0) {
+    frames_until_allocation_text_ = kProfilerTextInterval;
+    const AllocationSampler& tick_allocations =
+        engine_.GetWorld().GetTickAllocations();
+    char line[96];
+    snprintf(line, sizeof(line), "%-9s %15s %15s %11s\n", "heap",
+        "last frame", "last tick", "held");
+    std::string text = line;
+    for (size_t index = 0; index < AllocationTracker::kNumSubsystems;
+         index++) {
+      AllocationTracker::Subsystem subsystem =
+          static_cast<AllocationTracker::Subsystem>(index);
+      const AllocationCounts& frame = frame_allocations_.GetDelta(subsystem);
+      const AllocationCounts& tick = tick_allocations.GetDelta(subsystem);
+      AllocationCounts total = AllocationTracker::GetCounts(subsystem);
+      snprintf(line, sizeof(line),
+          "%-9s %5llu %7llu B %5llu %7llu B %7lld KiB\n",
+          AllocationTracker::GetSubsystemName(subsystem),
+          static_cast<unsigned long long>(frame.num_allocations_),
+          static_cast<unsigned long long>(frame.bytes_allocated_),
+          static_cast<unsigned long long>(tick.num_allocations_),
+          static_cast<unsigned long long>(tick.bytes_allocated_),
+          static_cast<long long>(total.GetLiveBytes() / 1024));
+      text += line;
+    }
+
+    if (!AllocationTracker::IsTracked()) {
+      text += "Allocations are not counted in this build\n";
+    } else if (!AllocationTracker::IsBox2DTracked()) {
+      text += "Box2D's own allocations are not counted in this build\n";
+    }
+
+    auto box = cinder::TextBox()
+        .font(cinder::Font(kOverlayFont, kOverlayFontSize))
+        .size(static_cast<int>(GetCanvasWidth()), cinder::TextBox::GROW)
+        .color(cinder::Color::white())
+        .backgroundColor(cinder::ColorA(0, 0, 0, 0.75f))
+        .text(text);
+    allocation_texture_ = cinder::gl::Texture::create(box.render());
+  }
+
+  frames_until_allocation_text_--;
+  cinder::gl::color(cinder::Color::white());
+  cinder::gl::draw(allocation_texture_, cinder::vec2(0, 0));
+}
+
+void TetrisGame::DrawProfilerOverlay() {
+  AllocationScope overlay_scope(AllocationTracker::kOther);
+  float canvas_width = static_cast<float>(GetCanvasWidth());
+  float canvas_height = static_cast<float>(GetCanvasHeight());
+  float bar_width =
+      canvas_width / static_cast<float>(TimingHistory::kMaxSamples);
+  float pixels_per_ms = kProfilerGraphHeight / kProfilerRangeMs;
+  // from the bottom of the window: frame intervals, draw times, update
+  // times split into step phases
+  float interval_bottom = canvas_height;
+  float draw_bottom = interval_bottom - kProfilerGraphHeight;
+  float update_bottom = draw_bottom - kProfilerGraphHeight;
+  float graphs_top = update_bottom - kProfilerGraphHeight;
+
+  profiler_batch_.clear();
+  AddProfilerRect(cinder::Rectf(0, graphs_top, canvas_width, canvas_height),
+      cinder::ColorA(0, 0, 0, 0.75f));
+  for (float bottom : {interval_bottom, draw_bottom, update_bottom}) {
+    float budget_y = bottom - kFrameBudgetMs * pixels_per_ms;
+    AddProfilerRect(cinder::Rectf(0, budget_y, canvas_width, budget_y + 1),
+        cinder::ColorA(1, 1, 1, 0.5f));
+  }
+
+  // newest samples on the right, bars clipped to the top of their graph
+  auto bar_height = [pixels_per_ms](float time_ms) {
+    return std::min(time_ms, kProfilerRangeMs) * pixels_per_ms;
+  };
+  for (size_t age = 0; age < update_times_.GetNumSamples(); age++) {
+    float right = canvas_width - static_cast<float>(age) * bar_width;
+    float left = right - bar_width;
+
+    float phase_bottom = update_bottom;
+    float phases_ms = 0.0f;
+    for (size_t phase = 0; phase < World::kNumStepPhases; phase++) {
+      float phase_ms = step_phase_times_[phase].Get(age);
+      float phase_top = update_bottom - bar_height(phases_ms + phase_ms);
+      AddProfilerRect(cinder::Rectf(left, phase_top, right, phase_bottom),
+          kStepPhaseColors[phase]);
+      phases_ms += phase_ms;
+      phase_bottom = phase_top;
+    }
+
+    // the rest of update, outside the world step
+    AddProfilerRect(cinder::Rectf(left,
+        update_bottom - bar_height(update_times_.Get(age)), right,
+        phase_bottom), cinder::ColorA(0.6f, 0.6f, 0.6f, 0.9f));
+  }
+
+  for (size_t age = 0; age < draw_times_.GetNumSamples(); age++) {
+    float right = canvas_width - static_cast<float>(age) * bar_width;
+    AddProfilerRect(cinder::Rectf(right - bar_width,
+        draw_bottom - bar_height(draw_times_.Get(age)), right, draw_bottom),
+        cinder::ColorA(1.0f, 0.5f, 0.3f, 0.9f));
+  }
+
+  for (size_t age = 0; age < frame_intervals_.GetNumSamples(); age++) {
+    float right = canvas_width - static_cast<float>(age) * bar_width;
+    float interval_ms = frame_intervals_.Get(age);
+    // a frame that took much longer than its budget was visibly dropped
+    cinder::ColorA color = interval_ms > 1.5f * kFrameBudgetMs
+        ? cinder::ColorA(1.0f, 0.2f, 0.2f, 0.9f)
+        : cinder::ColorA(0.3f, 0.9f, 0.3f, 0.9f);
+    AddProfilerRect(cinder::Rectf(right - bar_width,
+        interval_bottom - bar_height(interval_ms), right, interval_bottom),
+        color);
+  }
+
+  {
+    cinder::gl::ScopedBlendAlpha blend;
+    profiler_batch_.draw();
+  }
+
+  // the text is rendered into a texture now and then, not every frame
+  if (!profiler_texture_ || frames_until_profiler_text_ == 0) {
+    frames_until_profiler_text_ = kProfilerTextInterval;
+    const b2World* b2_world = engine_.GetWorld().GetB2World();
+    size_t num_fixtures = 0;
+    for (const b2Body* body = b2_world->GetBodyList(); body != nullptr;
+         body = body->GetNext()) {
+      for (const b2Fixture* fixture = body->GetFixtureList();
+           fixture != nullptr; fixture = fixture->GetNext()) {
+        num_fixtures++;
+      }
+    }
+
+    char line[96];
+    std::string text;
+    snprintf(line, sizeof(line), "update %6.2f ms  max %6.2f ms\n",
+        update_times_.GetMean(), update_times_.GetMax());
+    text += line;
+    snprintf(line, sizeof(line), "draw   %6.2f ms  max %6.2f ms\n",
+        draw_times_.GetMean(), draw_times_.GetMax());
+    text += line;
+    snprintf(line, sizeof(line), "frame  %6.2f ms  jitter %5.2f ms\n",
+        frame_intervals_.GetMean(), frame_intervals_.GetStandardDeviation());
+    text += line;
+    text += "step  ";
+    for (size_t phase = 0; phase < World::kNumStepPhases; phase++) {
+      snprintf(line, sizeof(line), " %s %.2f",
+          World::GetStepPhaseName(static_cast<World::StepPhase>(phase)),
+          step_phase_times_[phase].GetMean());
+      text += line;
+    }
+
+    snprintf(line, sizeof(line), " ms\nbodies %d  fixtures %zu  contacts %d",
+        b2_world->GetBodyCount(), num_fixtures, b2_world->GetContactCount());
+    text += line;
+
+    auto box = cinder::TextBox()
+        .font(cinder::Font(kOverlayFont, kOverlayFontSize))
+        .size(static_cast<int>(canvas_width), cinder::TextBox::GROW)
+        .color(cinder::Color::white())
+        .backgroundColor(cinder::ColorA(0, 0, 0, 0.75f))
+        .text(text);
+    profiler_texture_ = cinder::gl::Texture::create(box.render());
+  }
+
+  frames_until_profiler_text_--;
+  cinder::gl::color(cinder::Color::white());
+  cinder::gl::draw(profiler_texture_, cinder::vec2(0,
+      graphs_top - static_cast<float>(profiler_texture_->getHeight())));
+}
+
+void TetrisGame::DrawReplayPosition() {
+  AllocationScope overlay_scope(AllocationTracker::kOther);
+  char text[64];
+  snprintf(text, sizeof(text), "tick %zu / %zu%s",
+      engine_.GetWorld().GetTickCount(), replay_index_->GetNumTicks(),
+      is_replay_paused_ ? "  paused" : "");
+  if (!replay_texture_ || replay_texture_text_ != text) {
+    auto box = cinder::TextBox()
+        .font(cinder::Font(kOverlayFont, kOverlayFontSize))
+        .size(static_cast<int>(GetCanvasWidth()), cinder::TextBox::GROW)
+        .color(cinder::Color::white())
+        .backgroundColor(cinder::ColorA(0, 0, 0, 0.75f))
+        .text(text);
+    replay_texture_ = cinder::gl::Texture::create(box.render());
+    replay_texture_text_ = text;
+  }
+
+  cinder::gl::color(cinder::Color::white());
+  cinder::gl::draw(replay_texture_, cinder::vec2(0,
+      GetCanvasHeight() - replay_texture_->getHeight()));
+}
+
+void TetrisGame::AddProfilerRect(const cinder::Rectf& rectangle,
+    const cinder::ColorA& color) {
+  // two triangles, so every rectangle fits in the same batch; the batch
+  // gives every vertex the last color set
+  profiler_batch_.color(color);
+  profiler_batch_.vertex(rectangle.x1, rectangle.y1);
+  profiler_batch_.vertex(rectangle.x2, rectangle.y1);
+  profiler_batch_.vertex(rectangle.x2, rectangle.y2);
+  profiler_batch_.vertex(rectangle.x1, rectangle.y1);
+  profiler_batch_.vertex(rectangle.x2, rectangle.y2);
+  profiler_batch_.vertex(rectangle.x1, rectangle.y2);
 }
 
 // Function is taken from snake
@@ -291,6 +861,12 @@ void TetrisGame::PrintText(const std::string& text, const cinder::Color& color,
     const cinder::ivec2& size, const cinder::vec2& loc,
     size_t font_size) {
   cinder::gl::color(color);
+  DrawCentered(RenderText(text, color, size, font_size), loc);
+}
+
+cinder::gl::Texture2dRef TetrisGame::RenderText(const std::string& text,
+    const cinder::Color& color, const cinder::ivec2& size,
+    size_t font_size) {
   auto box = cinder::TextBox()
       .alignment(cinder::TextBox::CENTER)
       .font(cinder::Font(kNormalFont, font_size))
@@ -298,14 +874,14 @@ void TetrisGame::PrintText(const std::string& text, const cinder::Color& color,
       .color(color)
       .backgroundColor(cinder::ColorA(0, 0, 0, 0))
       .text(text);
+  return cinder::gl::Texture::create(box.render());
+}
 
-  const auto box_size = box.getSize();
+void TetrisGame::DrawCentered(const cinder::gl::Texture2dRef& texture,
+    const cinder::vec2& loc) {
   const cinder::vec2 locp =
-      {loc.x - box_size.x / 2, loc.y - box_size.y / 2};
-  const auto surface = box.render();
-  const auto texture = cinder::gl::Texture::create(surface);
+      {loc.x - texture->getWidth() / 2, loc.y - texture->getHeight() / 2};
   cinder::gl::draw(texture, locp);
-
 }
 
 double TetrisGame::GetTileDisplaySize() const {
@@ -6,8 +6,23 @@
 #include <cinder/app/App.h>
 #include <tetris_engine.h>
 #include <cinder/audio/Voice.h>
+#include <cinder/gl/Texture.h>
+#include <cinder/gl/gl.h>
 
+#include <array>
+#include <chrono>
+#include <memory>
+
+#include "persistence/replay_index.h"
+#include "persistence/score_store.h"
+#include "physics/piece_set.h"
 #include "physics/world.h"
+#include "stream/spectator_publisher.h"
+#include "stream/spectator_stream.h"
+#include "telemetry/allocation_tracker.h"
+#include "telemetry/event_log.h"
+#include "telemetry/timing_history.h"
+#include "telemetry/trace.h"
 
 namespace tetris {
 
@@ -19,10 +34,54 @@ class TetrisGame : public cinder::app::App {
   static const int kDefaultBlockToDisplaySize = 50;
 
  private:
+  // only loaded when started with --pieces PIECES_PATH, which spawns its
+  // blocks instead of those of the mode. Declared before engine_, since
+  // the world's blocks point at its templates.
+  PieceSet piece_set_;
   TetrisEngine engine_;
   // Audio files
   cinder::audio::VoiceSamplePlayerNodeRef background_music_;
   cinder::audio::VoiceSamplePlayerNodeRef ending_music_;
+  // only created when started with --spectate SOCKET_PATH
+  std::unique_ptr<SpectatorPublisher> spectator_publisher_;
+  std::unique_ptr<SpectatorEncoder> spectator_encoder_;
+  // only created when started with --telemetry LOG_PATH
+  std::unique_ptr<EventLogWriter> event_log_writer_;
+  // trace of recent spans written with F3, to trace.json unless
+  // --trace TRACE_PATH is given
+  std::string trace_path_;
+  // scores of finished games, in scores.db unless --scores DB_PATH is given
+  ScoreStore score_store_;
+  bool is_score_submitted_;
+  // the score text, only rendered again when the score changes
+  cinder::gl::Texture2dRef score_texture_;
+  size_t score_texture_value_;
+  // heap allocations made over the last frame, toggled on screen with F1
+  AllocationSampler frame_allocations_;
+  bool is_allocation_overlay_shown_;
+  // the overlay text, rendered again every kProfilerTextInterval frames
+  cinder::gl::Texture2dRef allocation_texture_;
+  size_t frames_until_allocation_text_;
+  // frame and step timings, toggled on screen with F2
+  bool is_profiler_shown_;
+  TimingHistory update_times_;
+  TimingHistory draw_times_;
+  // time from the start of one frame's draw to the next
+  TimingHistory frame_intervals_;
+  std::array<TimingHistory, World::kNumStepPhases> step_phase_times_;
+  std::chrono::steady_clock::time_point last_frame_start_;
+  // every graph bar, refilled each frame and drawn in one call
+  cinder::gl::VertBatch profiler_batch_;
+  // the profiler text, rendered again every kProfilerTextInterval frames
+  cinder::gl::Texture2dRef profiler_texture_;
+  size_t frames_until_profiler_text_;
+  // only opened when started with --replay-index INDEX_PATH, which watches
+  // the indexed game instead of playing
+  std::unique_ptr<ReplayIndex> replay_index_;
+  bool is_replay_paused_;
+  // the tick counter, only rendered again when the text changes
+  cinder::gl::Texture2dRef replay_texture_;
+  std::string replay_texture_text_;
 
   /**
    * Convert polyshape into a 4 x 4 format and draw in UI
@@ -30,6 +89,33 @@ class TetrisGame : public cinder::app::App {
    */
   void DrawPolygonBlock(const Block* block);
 
+  /**
+   * Outlines where the block would land if it was dropped now
+   * @param block the current block
+   */
+  void DrawGhostBlock(const Block* block);
+
+  /**
+   * Draws the blocks, floor and score of a game in progress
+   */
+  void DrawGame();
+
+  /**
+   * Draws a block waiting to spawn, unturned and scaled down
+   * @param block the block
+   * @param loc top left corner of its 4 by 4 box
+   * @param tile_size size of a tile
+   * @param alpha opacity of the tiles
+   */
+  void DrawWaitingBlock(const Block& block, const cinder::vec2& loc,
+      float tile_size, float alpha);
+
+  /**
+   * Draws the upcoming blocks down the right edge and the held block in
+   * the top left corner
+   */
+  void DrawPreviewAndHold();
+
   /**
    * Draws the starting screen of the game
    */
@@ -40,6 +126,11 @@ class TetrisGame : public cinder::app::App {
    */
   void DrawFloor();
 
+  /**
+   * Draws the loose tiles of blocks that broke apart
+   */
+  void DrawDebris();
+
   /**
    * Draws the score of the player at the top of the game board
    */
@@ -50,6 +141,45 @@ class TetrisGame : public cinder::app::App {
    */
   void DrawEndingScreen();
 
+  /**
+   * Draws a table of the heap allocations every subsystem made over the
+   * last frame and the last world step, and how much each still holds
+   */
+  void DrawAllocationOverlay();
+
+  /**
+   * Draws graphs of the update, draw and frame times of the last few
+   * seconds, the time of every phase of the last step, and how many
+   * bodies, fixtures and contacts the physics world has
+   */
+  void DrawProfilerOverlay();
+
+  /**
+   * Draws the tick of the watched replay and whether it is paused
+   */
+  void DrawReplayPosition();
+
+  /**
+   * Handles the keys that pause and seek a watched replay
+   * @param key_code code of the key pressed
+   * @return true if the key was used, false to handle it as usual
+   */
+  bool ScrubReplay(int key_code);
+
+  /**
+   * Adds a filled rectangle to the profiler graphs
+   * @param rectangle where to draw
+   * @param color color of the rectangle
+   */
+  void AddProfilerRect(const cinder::Rectf& rectangle,
+      const cinder::ColorA& color);
+
+  /**
+   * Stores the final score and replay of the game the first time it is
+   * called after the game ends
+   */
+  void SubmitScore();
+
   /**
    * Function taken from snake. Prints out the inputted text
    * @param text text to print
@@ -62,6 +192,26 @@ class TetrisGame : public cinder::app::App {
       const cinder::ivec2& size, const cinder::vec2& loc,
       size_t font_size);
 
+  /**
+   * Renders text into a texture that can be drawn many times
+   * @param text text to print
+   * @param color color of text
+   * @param size size of the text box
+   * @param font_size font size
+   * @return the texture
+   */
+  cinder::gl::Texture2dRef RenderText(const std::string& text,
+      const cinder::Color& color, const cinder::ivec2& size,
+      size_t font_size);
+
+  /**
+   * Draws a texture centered on a point
+   * @param texture the texture
+   * @param loc where to draw
+   */
+  void DrawCentered(const cinder::gl::Texture2dRef& texture,
+      const cinder::vec2& loc);
+
   /**
    * Get the tile's display size
    * @return tile display size
@@ -80,6 +230,7 @@ class TetrisGame : public cinder::app::App {
 
  public:
   TetrisGame();
+  ~TetrisGame() override;
   void setup() override;
   void update() override;
   void draw() override;
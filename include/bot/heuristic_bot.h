@@ -0,0 +1,123 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#ifndef FINALPROJECT_HEURISTIC_BOT_H
+#define FINALPROJECT_HEURISTIC_BOT_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "physics/block_template.h"
+
+namespace tetris {
+
+/**
+ * Plays a block by trying every rotation and column it can be dropped
+ * straight down from, and keeping the one whose board scores best. A board
+ * is scored as a weighted sum of a few features of its surface, so better
+ * weights make a better player without changing the search.
+ *
+ * Boards are given as rows of bits, the bottom row first, bit c set when
+ * column c is filled, the same way PerfectClearSolver takes them.
+ */
+class HeuristicBot {
+ public:
+  enum Feature {
+    // empty tiles with a filled tile somewhere above them
+    kHoles,
+    // sum of the column heights
+    kAggregateHeight,
+    // sum of the height differences of neighboring columns
+    kBumpiness,
+    // sum of how far each column sits below both of its neighbors, where a
+    // wall counts as a neighbor that is never lower
+    kWells,
+    // rows the block cleared
+    kLinesCleared,
+    kNumFeatures
+  };
+
+  using Weights = std::array<double, kNumFeatures>;
+
+  // a reasonable player for both board sizes, and where tuning starts
+  static const Weights kDefaultWeights;
+
+  struct Placement {
+    // false when the block doesn't fit anywhere on the board
+    bool is_found_;
+    // rotation state of the block's template
+    size_t rotation_;
+    // bottom left corner of the rotation's bounding box
+    int col_;
+    int row_;
+    size_t num_cleared_;
+    double score_;
+  };
+
+ private:
+  Weights weights_;
+
+ public:
+  /**
+   * Makes a bot that scores boards with the given weights
+   * @param weights weight of each feature, higher scores are better
+   */
+  explicit HeuristicBot(const Weights& weights = kDefaultWeights);
+
+  const Weights& GetWeights() const {
+    return weights_;
+  }
+
+  /**
+   * Picks where a block goes. Ties go to the lowest rotation, then the
+   * leftmost column, so the choice only depends on the board.
+   * @param rows filled tiles of each row, one entry for every row of the
+   * board
+   * @param num_cols width of the board, at most 32
+   * @param block_template template of the block
+   * @return the best placement
+   */
+  Placement Choose(const std::vector<uint32_t>& rows, size_t num_cols,
+      const BlockTemplate& block_template) const;
+
+  /**
+   * Scores a board the way Choose does
+   * @param rows filled tiles of each row
+   * @param num_cols width of the board
+   * @param num_cleared rows cleared to reach the board
+   * @return weighted sum of the board's features
+   */
+  double Score(const std::vector<uint32_t>& rows, size_t num_cols,
+      size_t num_cleared) const;
+
+  /**
+   * Measures every feature of a board
+   * @param rows filled tiles of each row
+   * @param num_cols width of the board
+   * @param num_cleared rows cleared to reach the board
+   * @return value of each feature
+   */
+  static std::array<double, kNumFeatures> GetFeatures(
+      const std::vector<uint32_t>& rows, size_t num_cols,
+      size_t num_cleared);
+
+  /**
+   * Drops a block into its placement and clears full rows, keeping the
+   * number of rows the same
+   * @param placement where the block goes, from Choose
+   * @param block_template template of the block
+   * @param num_cols width of the board
+   * @param rows filled tiles of each row, updated
+   * @return number of rows cleared
+   */
+  static size_t Place(const Placement& placement,
+      const BlockTemplate& block_template, size_t num_cols,
+      std::vector<uint32_t>* rows);
+
+  static const char* GetFeatureName(Feature feature);
+};
+
+} // namespace tetris
+
+#endif  // FINALPROJECT_HEURISTIC_BOT_H
@@ -0,0 +1,156 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#ifndef FINALPROJECT_WEIGHT_TUNER_H
+#define FINALPROJECT_WEIGHT_TUNER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bot/heuristic_bot.h"
+#include "physics/world.h"
+
+namespace tetris {
+
+class WorkStealingPool;
+
+/**
+ * Tunes the weights of a HeuristicBot by having it play headless games.
+ * Each generation samples weights around a mean, scores every sample by
+ * the rows it clears over the same seeded games in each mode, and moves
+ * the mean toward the best samples with an evolution strategy. Weights
+ * are kept at unit length, since scaling them doesn't change any choice.
+ *
+ * Every game of a generation is its own task on a work stealing pool, so
+ * short games of bad samples don't leave threads idle while long games of
+ * good samples finish.
+ */
+class WeightTuner {
+ public:
+  enum Backend {
+    // drops blocks on rows of bits, many times faster than the world
+    kGridBackend,
+    // moves and drops blocks in a World, exactly as a player would
+    kWorldBackend
+  };
+
+  struct Options {
+    // samples tried each generation
+    size_t population_;
+    // best samples the next mean is made of
+    size_t num_parents_;
+    // seeded games every sample plays in each mode
+    size_t games_per_mode_;
+    // a game ends after this many blocks if it isn't lost first
+    size_t max_pieces_;
+    // kClassic or kReloaded
+    std::vector<World::GameState> modes_;
+    Backend backend_;
+    uint32_t seed_;
+    // spread of the first generation's samples around the mean
+    double initial_step_;
+  };
+
+  struct GameResult {
+    size_t num_pieces_;
+    size_t num_lines_;
+  };
+
+  /**
+   * What a generation found and how well it kept the threads busy
+   */
+  struct Report {
+    size_t generation_;
+    double best_fitness_;
+    double mean_fitness_;
+    double step_;
+    HeuristicBot::Weights best_weights_;
+    size_t num_games_;
+    size_t num_pieces_;
+    double seconds_;
+    // time spent in games over the time every thread had
+    double utilization_;
+  };
+
+ private:
+  Options options_;
+  WorkStealingPool* pool_;
+  size_t generation_;
+  HeuristicBot::Weights mean_;
+  double step_;
+  // mean fitness of the last generation's parents, 0 before the first
+  double parent_fitness_;
+  HeuristicBot::Weights best_weights_;
+  double best_fitness_;
+  std::mt19937 random_;
+
+ public:
+  /**
+   * Starts tuning from the bot's default weights
+   * @param options how to sample and score weights
+   * @param pool threads to play games on
+   */
+  WeightTuner(const Options& options, WorkStealingPool* pool);
+
+  /**
+   * Samples, scores and recombines one generation of weights
+   * @return what the generation found
+   */
+  Report RunGeneration();
+
+  /**
+   * Plays a game until it is lost or reaches a number of blocks
+   * @param bot the player
+   * @param mode kClassic or kReloaded
+   * @param seed seed of the block order
+   * @param max_pieces most blocks to play
+   * @param backend what to play on
+   * @return how far the game got
+   */
+  static GameResult PlayGame(const HeuristicBot& bot, World::GameState mode,
+      uint32_t seed, size_t max_pieces, Backend backend);
+
+  /**
+   * Writes the state of the search, replacing the file only once it is
+   * complete so a crash mid-write keeps the last checkpoint
+   * @param path file to write
+   * @param error set to the reason when the file can't be written
+   * @return true if the checkpoint was written
+   */
+  bool SaveCheckpoint(const std::string& path, std::string* error) const;
+
+  /**
+   * Continues a search from a checkpoint
+   * @param path file written by SaveCheckpoint
+   * @param error set to the reason when the file can't be read
+   * @return true if the checkpoint was loaded, false leaves the tuner as
+   * it was
+   */
+  bool LoadCheckpoint(const std::string& path, std::string* error);
+
+  size_t GetGeneration() const {
+    return generation_;
+  }
+
+  const HeuristicBot::Weights& GetMean() const {
+    return mean_;
+  }
+
+  double GetStep() const {
+    return step_;
+  }
+
+  const HeuristicBot::Weights& GetBestWeights() const {
+    return best_weights_;
+  }
+
+  double GetBestFitness() const {
+    return best_fitness_;
+  }
+};
+
+} // namespace tetris
+
+#endif  // FINALPROJECT_WEIGHT_TUNER_H
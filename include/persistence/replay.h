@@ -0,0 +1,112 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#ifndef FINALPROJECT_REPLAY_H
+#define FINALPROJECT_REPLAY_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "physics/block.h"
+#include "physics/world.h"
+
+namespace tetris {
+
+/**
+ * The seed, mode and player inputs of a game. Since every random choice a
+ * world makes comes from its seed, stepping a new world with the same
+ * inputs at the same ticks plays the same game again.
+ */
+class Replay {
+ public:
+  struct Input {
+    uint32_t tick_;
+    Block::Move move_;
+  };
+
+ private:
+  uint32_t seed_;
+  World::GameState game_state_;
+  bool is_bomb_mode_;
+  bool is_tile_disconnected_mode_;
+  std::vector<Input> inputs_;
+
+ public:
+  Replay();
+
+  /**
+   * Starts recording a game, keeping the world's seed and mode
+   * @param world a world whose game has just started
+   */
+  void Start(const World& world);
+
+  /**
+   * Records a move made before the given tick was stepped
+   * @param tick tick count of the world when the move was made
+   * @param move the move
+   */
+  void AddInput(size_t tick, Block::Move move);
+
+  /**
+   * Packs the replay into a portable blob
+   * @return bytes of the replay
+   */
+  std::vector<uint8_t> Serialize() const;
+
+  /**
+   * Unpacks a blob made by Serialize
+   * @param blob bytes of a replay
+   * @return false if the blob is not a replay, leaving this unchanged
+   */
+  bool Deserialize(const std::vector<uint8_t>& blob);
+
+  /**
+   * Plays the recorded game on a world that has not started a game yet
+   * @param world the world
+   * @param max_ticks steps to take at most, in case the game never ends
+   * @param is_stopped checked after every step, playing stops once it
+   *     returns true. Plays to the end if empty.
+   * @return false if is_stopped cut the game short
+   */
+  bool Play(World* world, size_t max_ticks,
+      const std::function<bool(const World&)>& is_stopped = nullptr) const;
+
+  /**
+   * Starts the recorded game on a world that has not started a game yet,
+   * without stepping it
+   * @param world the world
+   */
+  void Begin(World* world) const;
+
+  /**
+   * Steps a world playing the recorded game, from wherever it is, making
+   * the recorded moves on the way. The world may have been started with
+   * Begin or restored from a snapshot of this game.
+   * @param world the world
+   * @param end_tick tick to stop at, if the game hasn't ended before
+   * @param is_stopped checked after every step, playing stops once it
+   *     returns true. Plays on to end_tick if empty.
+   * @return false if is_stopped cut the game short
+   */
+  bool Advance(World* world, size_t end_tick,
+      const std::function<bool(const World&)>& is_stopped = nullptr) const;
+
+  /**
+   * Names the mode the game was played in
+   * @return classic, reloaded, blitz or bomb
+   */
+  std::string GetModeName() const;
+
+  uint32_t GetSeed() const {
+    return seed_;
+  }
+
+  const std::vector<Input>& GetInputs() const {
+    return inputs_;
+  }
+};
+
+} // namespace tetris
+
+#endif  // FINALPROJECT_REPLAY_H
@@ -0,0 +1,148 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#ifndef FINALPROJECT_REPLAY_INDEX_H
+#define FINALPROJECT_REPLAY_INDEX_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "persistence/replay.h"
+#include "physics/world.h"
+
+namespace tetris {
+
+/**
+ * A replay together with a snapshot of the whole game every few ticks and
+ * a hash of the game after every tick, kept in a file that is memory
+ * mapped when opened. Going to any tick restores the keyframe at or before
+ * it and steps at most one interval forward, however long the game is.
+ *
+ * The file is little endian: a header of six 32 bit numbers (magic,
+ * version, keyframe interval, number of ticks, number of keyframes, replay
+ * size), the replay as Replay::Serialize writes it, a 64 bit state hash for
+ * every tick from 0 to the last, a table of 64 bit offset and 32 bit size
+ * for every keyframe, and then the keyframes as World::SaveSnapshot writes
+ * them. Keyframe k is the game at tick k times the interval.
+ */
+class ReplayIndex {
+ public:
+  static const size_t kDefaultKeyframeInterval = 300;
+  // returned by searches that find nothing
+  static const size_t kNoTick = static_cast<size_t>(-1);
+
+ private:
+  // the whole file, mapped read only
+  const uint8_t* data_;
+  size_t size_;
+  // where mapping isn't available the file is read in here instead
+  std::vector<uint8_t> contents_;
+  bool is_mapped_;
+  Replay replay_;
+  size_t keyframe_interval_;
+  size_t num_ticks_;
+  size_t num_keyframes_;
+  const uint8_t* hashes_;
+  const uint8_t* keyframe_table_;
+
+  /**
+   * Unmaps the file, if one is open
+   */
+  void Close();
+
+  /**
+   * Restores a keyframe into a world
+   * @param keyframe index of the keyframe
+   * @param world the world
+   * @return false if the keyframe is damaged
+   */
+  bool RestoreKeyframe(size_t keyframe, World* world) const;
+
+  /**
+   * Finds the keyframe to start from to reach a tick
+   * @param tick the tick
+   * @return index of the last keyframe at or before the tick
+   */
+  size_t GetKeyframeBefore(size_t tick) const;
+
+ public:
+  ReplayIndex();
+  ~ReplayIndex();
+
+  ReplayIndex(const ReplayIndex&) = delete;
+  ReplayIndex& operator=(const ReplayIndex&) = delete;
+
+  /**
+   * Plays a replay and writes its index
+   * @param replay the replay
+   * @param keyframe_interval ticks between keyframes
+   * @param max_ticks steps to take at most, in case the game never ends
+   * @param path file to write
+   * @return false if the file could not be written
+   */
+  static bool Build(const Replay& replay, size_t keyframe_interval,
+      size_t max_ticks, const std::string& path);
+
+  /**
+   * Maps an index file, closing any open one
+   * @param path file written by Build
+   * @return false if the file could not be read or is not an index
+   */
+  bool Open(const std::string& path);
+
+  /**
+   * Puts a world at a tick of the game, restoring the nearest keyframe
+   * and stepping forward from it
+   * @param world the world, whose game is replaced
+   * @param tick the tick, past the last tick goes to the last
+   * @return false if the tick could not be reached
+   */
+  bool SeekTo(World* world, size_t tick) const;
+
+  /**
+   * Replays the interval after a keyframe, comparing every tick with the
+   * recorded hashes. Intervals don't depend on each other, so they can be
+   * checked in any order or in parallel.
+   * @param keyframe index of the keyframe
+   * @return first tick that doesn't match, or kNoTick
+   */
+  size_t FindDesync(size_t keyframe) const;
+
+  /**
+   * Finds the first tick where a condition holds, for a condition that
+   * stays true once it becomes true. Keyframes are searched by bisection
+   * and only the interval where it turns true is stepped through.
+   * @param predicate the condition
+   * @return first tick where the condition holds, or kNoTick
+   */
+  size_t Bisect(const std::function<bool(const World&)>& predicate) const;
+
+  /**
+   * Gets the recorded hash of the game after a tick
+   * @param tick the tick, at most GetNumTicks
+   * @return the hash World::GetStateHash gave
+   */
+  uint64_t GetTickHash(size_t tick) const;
+
+  const Replay& GetReplay() const {
+    return replay_;
+  }
+
+  size_t GetKeyframeInterval() const {
+    return keyframe_interval_;
+  }
+
+  // the tick the game ended at, or the last tick recorded
+  size_t GetNumTicks() const {
+    return num_ticks_;
+  }
+
+  size_t GetNumKeyframes() const {
+    return num_keyframes_;
+  }
+};
+
+} // namespace tetris
+
+#endif  // FINALPROJECT_REPLAY_INDEX_H
@@ -0,0 +1,144 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#ifndef FINALPROJECT_SCORE_STORE_H
+#define FINALPROJECT_SCORE_STORE_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct sqlite3;
+struct sqlite3_stmt;
+
+namespace tetris {
+
+/**
+ * A finished game as stored in the database
+ */
+struct ScoreRecord {
+  size_t score_;
+  // mode name as given by Replay::GetModeName
+  std::string mode_;
+  uint32_t seed_;
+  // seconds since the epoch
+  int64_t played_at_;
+  // Replay::Serialize of the game, may be empty
+  std::vector<uint8_t> replay_;
+};
+
+/**
+ * A row of the leaderboard, kept without the replay
+ */
+struct LeaderboardEntry {
+  size_t score_;
+  uint32_t seed_;
+  int64_t played_at_;
+};
+
+/**
+ * Keeps scores and replays in an SQLite database. Submitting only queues
+ * the record; a background thread inserts everything queued in a single
+ * transaction with a prepared statement. The best scores of every mode are
+ * also kept in memory so the leaderboard never waits on a query.
+ */
+class ScoreStore {
+ public:
+  static const size_t kDefaultLeaderboardSize = 10;
+
+ private:
+  sqlite3* database_;
+  sqlite3_stmt* insert_statement_;
+  size_t leaderboard_size_;
+  // best scores first, by mode name
+  std::map<std::string, std::vector<LeaderboardEntry>> leaderboards_;
+
+  std::thread writer_thread_;
+  // guards every member below and the leaderboards
+  mutable std::mutex mutex_;
+  std::condition_variable has_pending_;
+  std::condition_variable is_flushed_;
+  std::vector<ScoreRecord> pending_records_;
+  size_t num_in_flight_;
+  size_t num_stored_;
+  bool is_stopping_;
+
+  /**
+   * Loads the best scores of every mode from the database
+   * @return false on a database error
+   */
+  bool LoadLeaderboards();
+
+  /**
+   * Adds a score to the in-memory leaderboard of its mode
+   * @param record the score
+   */
+  void AddToLeaderboard(const ScoreRecord& record);
+
+  /**
+   * Inserts queued records until the store stops
+   */
+  void WriterLoop();
+
+  /**
+   * Inserts records in a single transaction
+   * @param records the records, left with only those that were committed
+   */
+  void InsertBatch(std::vector<ScoreRecord>* records);
+
+ public:
+  ScoreStore();
+
+  /**
+   * Writes every queued record and closes the database
+   */
+  ~ScoreStore();
+
+  ScoreStore(const ScoreStore&) = delete;
+  ScoreStore& operator=(const ScoreStore&) = delete;
+
+  /**
+   * Opens or creates the database and starts the writer thread
+   * @param path path of the database file
+   * @param leaderboard_size scores to keep per mode in the leaderboard
+   * @return false if the database could not be opened
+   */
+  bool Open(const std::string& path,
+      size_t leaderboard_size = kDefaultLeaderboardSize);
+
+  /**
+   * Queues a record to be stored. The record joins the leaderboard once
+   * the writer thread has committed it, see Flush.
+   * @param record the record
+   */
+  void Submit(ScoreRecord record);
+
+  /**
+   * Waits until every record submitted so far is in the database
+   */
+  void Flush();
+
+  /**
+   * Gets the best scores of a mode, without touching the database
+   * @param mode mode name
+   * @return best scores first
+   */
+  std::vector<LeaderboardEntry> GetLeaderboard(const std::string& mode) const;
+
+  /**
+   * Counts records inserted since the store was opened
+   * @return number of records
+   */
+  size_t GetNumStored() const;
+
+  bool IsOpen() const {
+    return database_ != nullptr;
+  }
+};
+
+} // namespace tetris
+
+#endif  // FINALPROJECT_SCORE_STORE_H
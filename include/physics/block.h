@@ -11,11 +11,77 @@
 #include <Box2D/Dynamics/b2Fixture.h>
 #include <cinder/Color.h>
 
+#include <cstring>
+#include <iterator>
 #include <vector>
+
+#include "block_template.h"
+
 namespace tetris {
 // defined as a class type object
 class World;
 
+/**
+ * Iterates over the bounding boxes of a body's fixtures without copying
+ * them into a container
+ */
+class FixtureBoxRange {
+ public:
+  class Iterator {
+   private:
+    const b2Fixture* fixture_;
+
+   public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef b2AABB value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const b2AABB* pointer;
+    typedef const b2AABB& reference;
+
+    explicit Iterator(const b2Fixture* fixture) : fixture_(fixture) {}
+
+    const b2AABB& operator*() const {
+      return fixture_->GetAABB(0);
+    }
+
+    Iterator& operator++() {
+      fixture_ = fixture_->GetNext();
+      return *this;
+    }
+
+    bool operator==(const Iterator& other) const {
+      return fixture_ == other.fixture_;
+    }
+
+    bool operator!=(const Iterator& other) const {
+      return fixture_ != other.fixture_;
+    }
+  };
+
+ private:
+  const b2Fixture* fixture_list_;
+
+ public:
+  explicit FixtureBoxRange(const b2Fixture* fixture_list)
+      : fixture_list_(fixture_list) {}
+
+  Iterator begin() const {
+    return Iterator(fixture_list_);
+  }
+
+  Iterator end() const {
+    return Iterator(nullptr);
+  }
+
+  /**
+   * Counts the boxes by walking the fixture list
+   * @return number of boxes
+   */
+  size_t size() const {
+    return std::distance(begin(), end());
+  }
+};
+
 /**
  * Holds the physics engine fixtures and the color of a single block in game
  */
@@ -26,7 +92,11 @@ class Block {
     kMoveLeft,
     kMoveRight,
     kMoveDown,
-    kRotate
+    kRotate,
+    // drops the block straight onto the floor and locks it
+    kHardDrop,
+    // puts the block aside, bringing back the one put aside before
+    kHold
   };
 
   /**
@@ -39,41 +109,28 @@ class Block {
     Transform(b2Transform transform, size_t times_rotated) :
         b2Transform(transform), times_rotated_(times_rotated) {}
 
-    explicit Transform(Block block) :
+    explicit Transform(const Block& block) :
         b2Transform(block.GetBody()->GetTransform()),
         times_rotated_(block.GetTimesRotated()) {}
   };
 
-  /**
-   * Holds the fixture for the physics engine of a single tile
-   * on the game board and the color of the tile.
-   */
-  struct Tile {
-    b2Fixture* fixture_;
-    cinder::Color color_;
-
-    // constructor for regular tile
-    Tile(b2Fixture* set_fixture, const cinder::Color& set_color)
-        : fixture_(set_fixture), color_(set_color) {};
-
-    // constructor for empty tile
-    Tile() : fixture_(nullptr), color_(cinder::Color::black()) {};
-  };
-
  private:
-  std::vector<b2Vec2> tile_list_;
-  cinder::Color color_;
+  // points into the compile time tables, never owned
+  const BlockTemplate* block_template_;
   b2Body* body_;
-  size_t template_id_;
   size_t times_rotated_;
+  // block box of the body at cached_transform_, recomputed once it moves
+  mutable b2AABB cached_box_;
+  mutable b2Transform cached_transform_;
+  mutable bool is_box_cached_;
 
  public:
   /**
-   * Get the bounds of a body
+   * Get the bounds of a body, cached until the body moves
    * @param world the world
    * @return bounding box
    */
-  b2AABB GetBlockBox(World *world);
+  b2AABB GetBlockBox(const World* world) const;
 
   /**
    * sets the tile at x and y
@@ -84,42 +141,58 @@ class Block {
   static void SetTileShapeAtColRow(b2PolygonShape* shape,
       double col, double row);
 
-  Block() : body_(nullptr), template_id_(-1), times_rotated_(0) {};
+  /**
+   * Gets the center of a tile from its fixture and the body's transform,
+   * which unlike the fixture's box is exact right after the body moves
+   * @param fixture fixture of a single tile
+   * @return center of the tile
+   */
+  static b2Vec2 GetTileCenter(const b2Fixture* fixture) {
+    const b2PolygonShape* shape =
+        static_cast<const b2PolygonShape*>(fixture->GetShape());
+    return b2Mul(fixture->GetBody()->GetTransform(), shape->m_centroid);
+  }
 
-  Block(std::vector<b2Vec2>& tile_list,
-      const cinder::Color& color, size_t template_id)
-      : tile_list_(tile_list),
-      color_(color), body_(nullptr), template_id_(template_id),
-      times_rotated_(0) {}
+  Block() : block_template_(nullptr), body_(nullptr), times_rotated_(0),
+      is_box_cached_(false) {};
 
-  Block(const Block& block, b2Body* body)
-      : tile_list_(block.tile_list_),
-      color_(block.color_), body_(body), template_id_(block.template_id_),
-      times_rotated_(0) {}
+  Block(const BlockTemplate& block_template, b2Body* body)
+      : block_template_(&block_template), body_(body), times_rotated_(0),
+      is_box_cached_(false) {}
 
-  const std::vector<b2Vec2>& GetTileList() const {
-    return tile_list_;
+  const BlockTemplate& GetTemplate() const {
+    return *block_template_;
   }
 
   /**
-   * Get a list of tiles that form the bounding box
-   * @return list of tiles
+   * Get the bounding boxes of the block's tiles
+   * @return boxes of the tiles, valid until the body changes
    */
-  const std::vector<b2AABB> GetBoundingBoxList() const;
+  FixtureBoxRange GetBoundingBoxList() const {
+    return FixtureBoxRange(body_->GetFixtureList());
+  }
 
   cinder::Color GetColor() const {
-    return color_;
+    return cinder::Color(block_template_->red_, block_template_->green_,
+        block_template_->blue_);
   }
 
   b2Body* GetBody() const {
     return body_;
   }
 
-  const size_t& GetTemplateId() const {
-    return template_id_;
+  size_t GetTemplateId() const {
+    return block_template_->template_id_;
+  }
+
+  // the bomb is the last classic template, so templates of a loaded piece
+  // set never count as one
+  bool IsBomb() const {
+    return block_template_
+        == &kClassicBlockTemplates[kNumClassicBlockTemplates];
   }
 
-  size_t GetTimesRotated() {
+  size_t GetTimesRotated() const {
     return times_rotated_;
   }
 
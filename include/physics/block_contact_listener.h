@@ -15,9 +15,10 @@ namespace tetris {
  * allowing ability to manual snap blocks into place.
  */
 class BlockContactListener : public b2ContactListener {
-  void BeginContact(b2Contact* contact);
+ public:
+  void BeginContact(b2Contact* contact) override;
 
-  void EndContact(b2Contact* contact);
+  void EndContact(b2Contact* contact) override;
 };
 
 } // namespace tetris
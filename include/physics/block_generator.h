@@ -9,44 +9,133 @@
 #include <Box2D/Common/b2Math.h>
 #include <Box2D/Dynamics/b2Body.h>
 
+#include <cstdint>
+#include <memory>
+#include <random>
 #include <vector>
 
 #include "block.h"
+#include "block_template.h"
+#include "piece_set.h"
 
 namespace tetris {
 
 class World;
 
 /**
- * Holds lists that generate specific types of blocks for each mode
+ * Creates blocks from the template tables of each mode
  */
 class BlockGenerator {
  private:
-  std::vector<Block> classic_block_template_list_;
-  std::vector<Block> reloaded_block_template_list_;
-  Block bomb_;
+  // classic templates in use, which include the bomb in bomb mode
+  size_t num_classic_templates_;
+  // blocks loaded from a file, used in every mode when set
+  const PieceSet* piece_set_;
+  // picks the next block, seeded so games can be replayed
+  std::mt19937 random_;
+
+  /**
+   * Gets a template of the mode the world is in
+   * @param world the world
+   * @param index_id template id for the block
+   * @return the template
+   */
+  const BlockTemplate& GetTemplate(const World& world, size_t index_id) const;
 
  public:
-  BlockGenerator(bool is_bomb_mode);
+  /**
+   * Picks the templates of each mode
+   * @param is_bomb_mode true to add the bomb to the classic blocks
+   * @param seed seed of the block order, random unless given
+   */
+  explicit BlockGenerator(bool is_bomb_mode,
+      uint32_t seed = std::random_device()());
 
+  /**
+   * Restarts the block order from a seed
+   * @param seed the seed
+   */
+  void SetSeed(uint32_t seed) {
+    random_.seed(seed);
+  }
+
+  /**
+   * Spawns blocks of a loaded piece set instead of those of the mode
+   * @param piece_set the set, which must outlive the generator, or nullptr
+   * to go back to the blocks of the mode
+   */
+  void SetPieceSet(const PieceSet* piece_set) {
+    piece_set_ = piece_set;
+  }
+
+  const PieceSet* GetPieceSet() const {
+    return piece_set_;
+  }
+
+  /**
+   * Gets the generator that picks the next block, to save its state
+   * @return the generator
+   */
+  const std::mt19937& GetRandom() const {
+    return random_;
+  }
+
+  /**
+   * Continues the block order from a saved state
+   * @param random generator state from GetRandom
+   */
+  void SetRandom(const std::mt19937& random) {
+    random_ = random;
+  }
+
+  /**
+   * Chooses the template of the next block without creating it, so a game
+   * can be played on a grid without a world
+   * @param is_reloaded true to pick from the reloaded templates
+   * @return template id, an index into GetBlockTemplateList
+   */
+  size_t PickTemplateId(bool is_reloaded);
 
   /**
    * Chooses and creates a random tetris block
    * @param world the world
-   * @return a tetris block
+   * @param is_active false for a block waiting to spawn, whose body
+   * doesn't collide or move until it is made active
+   * @return a tetris block, whose body belongs to the world
    */
-  Block* CreateRandomBlock(World* world);
+  std::unique_ptr<Block> CreateRandomBlock(World* world,
+      bool is_active = true);
 
   /**
    * Chooses and returns selected id tetris block
    * @param world the world
    * @param index_id template id for the block
-   * @return tetris block
+   * @param is_active false for a block waiting to spawn
+   * @return tetris block, whose body belongs to the world
+   */
+  std::unique_ptr<Block> CreateBlockByTemplate(World* world, size_t index_id,
+      bool is_active = true);
+
+  BlockTemplateList GetBlockTemplateList() const {
+    return GetBlockTemplateList(false);
+  }
+
+  /**
+   * Gets the templates PickTemplateId picks from
+   * @param is_reloaded true for the reloaded templates
+   * @return the templates
    */
-  Block* CreateBlockByTemplate(World* world, size_t index_id);
+  BlockTemplateList GetBlockTemplateList(bool is_reloaded) const {
+    if (piece_set_ != nullptr) {
+      return piece_set_->GetTemplates();
+    }
+
+    if (is_reloaded) {
+      return BlockTemplateList(kReloadedBlockTemplates,
+          kNumReloadedBlockTemplates);
+    }
 
-  const std::vector<Block>& GetBlockTemplateList() const {
-    return classic_block_template_list_;
+    return BlockTemplateList(kClassicBlockTemplates, num_classic_templates_);
   }
 };
 
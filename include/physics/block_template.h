@@ -0,0 +1,243 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#ifndef FINALPROJECT_BLOCK_TEMPLATE_H
+#define FINALPROJECT_BLOCK_TEMPLATE_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace tetris {
+
+/**
+ * Shape and color of a kind of block. Tiles sit in a 4 by 4 box, and every
+ * rotation state is the previous one turned a quarter clockwise inside that
+ * box, matching how World rotates a block's body. Templates are built at
+ * compile time, so nothing is allocated to spawn a block.
+ */
+struct BlockTemplate {
+  static const size_t kMaxTiles = 8;
+  static const size_t kNumRotations = 4;
+  static const int kBoxSize = 4;
+
+  struct Cell {
+    int8_t col_;
+    int8_t row_;
+  };
+
+  // smallest box holding every tile, bounds included
+  struct Box {
+    int8_t min_col_;
+    int8_t min_row_;
+    int8_t max_col_;
+    int8_t max_row_;
+  };
+
+  uint8_t template_id_;
+  uint8_t num_tiles_;
+  float red_;
+  float green_;
+  float blue_;
+  // tiles of each rotation state, only the first num_tiles_ are used
+  Cell cells_[kNumRotations][kMaxTiles];
+  Box boxes_[kNumRotations];
+  // tiles of each rotation state as bits of the 4 by 4 box, see GetMaskBit
+  uint16_t masks_[kNumRotations];
+
+  /**
+   * Gets the bit of a tile in an occupancy mask
+   * @param col column in the 4 by 4 box
+   * @param row row in the 4 by 4 box
+   * @return bit index, row major from the bottom left
+   */
+  static constexpr int GetMaskBit(int col, int row) {
+    return row * kBoxSize + col;
+  }
+};
+
+/**
+ * Turns a tile a quarter clockwise inside the 4 by 4 box
+ * @param cell the tile
+ * @return the turned tile
+ */
+constexpr BlockTemplate::Cell RotateCell(BlockTemplate::Cell cell) {
+  return BlockTemplate::Cell{
+      cell.row_, static_cast<int8_t>(BlockTemplate::kBoxSize - 1 - cell.col_)};
+}
+
+/**
+ * Builds a template from a list of tiles, deriving its rotation states,
+ * bounding boxes and occupancy masks. Tiles must lie in the 4 by 4 box and
+ * there may be at most kMaxTiles of them.
+ * @param template_id id of the template
+ * @param cells tiles of the unrotated block
+ * @param num_tiles number of tiles
+ * @param red red part of the color
+ * @param green green part of the color
+ * @param blue blue part of the color
+ * @return the template
+ */
+constexpr BlockTemplate BuildBlockTemplate(uint8_t template_id,
+    const BlockTemplate::Cell* cells, size_t num_tiles,
+    float red, float green, float blue) {
+  BlockTemplate block_template = {};
+  block_template.template_id_ = template_id;
+  block_template.num_tiles_ = static_cast<uint8_t>(num_tiles);
+  block_template.red_ = red;
+  block_template.green_ = green;
+  block_template.blue_ = blue;
+
+  for (size_t tile = 0; tile < num_tiles; tile++) {
+    block_template.cells_[0][tile] = cells[tile];
+  }
+
+  for (size_t rotation = 0; rotation < BlockTemplate::kNumRotations;
+       rotation++) {
+    if (rotation > 0) {
+      for (size_t tile = 0; tile < num_tiles; tile++) {
+        block_template.cells_[rotation][tile] =
+            RotateCell(block_template.cells_[rotation - 1][tile]);
+      }
+    }
+
+    BlockTemplate::Box box = {BlockTemplate::kBoxSize,
+                              BlockTemplate::kBoxSize, -1, -1};
+    uint16_t mask = 0;
+    for (size_t tile = 0; tile < num_tiles; tile++) {
+      const BlockTemplate::Cell& cell = block_template.cells_[rotation][tile];
+      box.min_col_ = cell.col_ < box.min_col_ ? cell.col_ : box.min_col_;
+      box.min_row_ = cell.row_ < box.min_row_ ? cell.row_ : box.min_row_;
+      box.max_col_ = cell.col_ > box.max_col_ ? cell.col_ : box.max_col_;
+      box.max_row_ = cell.row_ > box.max_row_ ? cell.row_ : box.max_row_;
+      mask = static_cast<uint16_t>(mask | 1u << BlockTemplate::GetMaskBit(
+          cell.col_, cell.row_));
+    }
+
+    block_template.boxes_[rotation] = box;
+    block_template.masks_[rotation] = mask;
+  }
+
+  return block_template;
+}
+
+/**
+ * Builds a template from a fixed list of tiles at compile time
+ * @tparam kNumTiles number of tiles
+ * @param template_id id of the template
+ * @param cells tiles of the unrotated block
+ * @param red red part of the color
+ * @param green green part of the color
+ * @param blue blue part of the color
+ * @return the template
+ */
+template <size_t kNumTiles>
+constexpr BlockTemplate MakeBlockTemplate(uint8_t template_id,
+    const BlockTemplate::Cell (&cells)[kNumTiles],
+    float red, float green, float blue) {
+  static_assert(kNumTiles <= BlockTemplate::kMaxTiles, "too many tiles");
+  return BuildBlockTemplate(template_id, cells, kNumTiles, red, green, blue);
+}
+
+/**
+ * A read-only view of a table of templates
+ */
+class BlockTemplateList {
+ private:
+  const BlockTemplate* templates_;
+  size_t size_;
+
+ public:
+  constexpr BlockTemplateList(const BlockTemplate* templates, size_t size)
+      : templates_(templates), size_(size) {}
+
+  constexpr size_t size() const {
+    return size_;
+  }
+
+  constexpr const BlockTemplate& operator[](size_t index) const {
+    return templates_[index];
+  }
+
+  constexpr const BlockTemplate* begin() const {
+    return templates_;
+  }
+
+  constexpr const BlockTemplate* end() const {
+    return templates_ + size_;
+  }
+};
+
+// https://puzzling.stackexchange.com/questions/5100/mosaic-with-tetris-blocks
+// Shapes for classic mode defined in link above.
+constexpr BlockTemplate::Cell kLineCells[] = {{0, 1}, {1, 1}, {2, 1}, {3, 1}};
+constexpr BlockTemplate::Cell kBackwardsLCells[] =
+    {{1, 1}, {2, 1}, {3, 1}, {1, 2}};
+constexpr BlockTemplate::Cell kLCells[] = {{0, 1}, {1, 1}, {2, 1}, {2, 2}};
+constexpr BlockTemplate::Cell kSquareCells[] = {{1, 1}, {2, 1}, {2, 2}, {1, 2}};
+constexpr BlockTemplate::Cell kBackwardsZCells[] =
+    {{1, 1}, {2, 1}, {2, 2}, {3, 2}};
+constexpr BlockTemplate::Cell kTCells[] = {{1, 1}, {2, 1}, {3, 1}, {2, 2}};
+constexpr BlockTemplate::Cell kZCells[] = {{1, 1}, {2, 1}, {2, 0}, {3, 0}};
+// only used in bomb mode
+constexpr BlockTemplate::Cell kBombCells[] = {{2, 2}};
+
+// Shapes for reloaded mode, made of half size tiles
+constexpr BlockTemplate::Cell kHalfBlockCells[] = {{1, 2}, {2, 2}};
+constexpr BlockTemplate::Cell kHookCells[] =
+    {{0, 2}, {1, 2}, {2, 2}, {2, 1}, {3, 2}, {3, 1}};
+constexpr BlockTemplate::Cell kStairCells[] =
+    {{0, 0}, {1, 0}, {2, 0}, {3, 0}, {2, 1}, {3, 1}, {3, 2}, {3, 3}};
+constexpr BlockTemplate::Cell kCornerCells[] =
+    {{0, 0}, {1, 0}, {2, 0}, {2, 1}, {2, 2}, {3, 0}, {3, 1}, {3, 2}};
+
+/**
+ * Holds the template tables. A constexpr array at namespace scope would get
+ * its own copy in every translation unit, so a block's template pointer
+ * would depend on which unit created the block. The tables are static
+ * members instead, defined once in block_template.cc.
+ */
+struct BlockTemplateTables {
+  // the bomb comes last so bomb mode can use the whole table
+  // and the other modes all but the last template
+  static constexpr BlockTemplate kClassic[] = {
+      MakeBlockTemplate(0, kLineCells, 0.0f, 1.0f, 1.0f),
+      MakeBlockTemplate(1, kBackwardsLCells, 0.0f, 0.0f, 1.0f),
+      MakeBlockTemplate(2, kLCells, 1.0f, 0.7f, 1.0f),
+      MakeBlockTemplate(3, kSquareCells, 1.0f, 1.0f, 0.0f),
+      MakeBlockTemplate(4, kBackwardsZCells, 0.0f, 1.0f, 0.0f),
+      MakeBlockTemplate(5, kTCells, 0.5f, 0.0f, 0.5f),
+      MakeBlockTemplate(6, kZCells, 1.0f, 0.0f, 0.0f),
+      // grey, drawn in random shades while in play
+      MakeBlockTemplate(7, kBombCells, 0.8f, 0.8f, 0.8f)};
+
+  static constexpr BlockTemplate kReloaded[] = {
+      MakeBlockTemplate(0, kHalfBlockCells, 1.0f, 0.0f, 0.0f),
+      MakeBlockTemplate(1, kHookCells, 0.0f, 1.0f, 0.0f),
+      MakeBlockTemplate(2, kStairCells, 0.0f, 0.0f, 1.0f),
+      MakeBlockTemplate(3, kCornerCells, 1.0f, 0.0f, 1.0f)};
+};
+
+// every translation unit refers to the same tables through these, a
+// reference has no storage of its own so it is kept local to each one
+static constexpr const auto& kClassicBlockTemplates =
+    BlockTemplateTables::kClassic;
+static constexpr const auto& kReloadedBlockTemplates =
+    BlockTemplateTables::kReloaded;
+
+constexpr size_t kNumClassicBlockTemplates =
+    sizeof(kClassicBlockTemplates) / sizeof(BlockTemplate) - 1;
+constexpr size_t kNumReloadedBlockTemplates =
+    sizeof(kReloadedBlockTemplates) / sizeof(BlockTemplate);
+
+static_assert(kClassicBlockTemplates[0].boxes_[1].min_col_ == 1
+    && kClassicBlockTemplates[0].boxes_[1].max_row_ == 3,
+    "a quarter turn stands the line upright");
+static_assert(kClassicBlockTemplates[3].boxes_[2].min_col_ == 1
+    && kClassicBlockTemplates[3].boxes_[2].max_row_ == 2,
+    "the square fills the same cells in every rotation");
+static_assert(kClassicBlockTemplates[3].masks_[0] == 0x0660
+    && kClassicBlockTemplates[3].masks_[3] == 0x0660,
+    "the square's mask is the middle of the box in every rotation");
+
+} // namespace tetris
+
+#endif  // FINALPROJECT_BLOCK_TEMPLATE_H
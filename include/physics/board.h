@@ -0,0 +1,198 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#ifndef FINALPROJECT_BOARD_H
+#define FINALPROJECT_BOARD_H
+
+#include <Box2D/Dynamics/b2Fixture.h>
+#include <cinder/Color.h>
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace tetris {
+
+/**
+ * The tiles that have landed on the floor. Every tile is a single byte
+ * indexing a color palette, stored row after row in one array, so a whole
+ * board fits in a few cache lines and can be copied or compared with
+ * memcpy and memcmp. Physics fixtures are kept in a separate table that
+ * only has entries for filled tiles. The height of every column and the
+ * number of filled tiles in every row are kept up to date as tiles change,
+ * so landing spots and full or empty rows are found without a scan.
+ */
+class Board {
+ public:
+  // palette index of an empty tile, drawn black
+  static const uint8_t kEmptyColor = 0;
+  // palette index of an empty tile flashing white after an explosion
+  static const uint8_t kExplosionColor = 1;
+  static const size_t kMaxPaletteSize = 256;
+
+ private:
+  size_t num_rows_;
+  size_t num_cols_;
+  // palette index of every tile, the bottom row first
+  std::vector<uint8_t> cells_;
+  std::vector<cinder::Color> palette_;
+  // fixtures of filled tiles by tile index, sorted by tile index
+  std::vector<std::pair<size_t, b2Fixture*>> fixtures_;
+  // one more than the row of the highest filled tile of every column
+  std::vector<uint16_t> column_heights_;
+  // number of filled tiles in every row
+  std::vector<uint16_t> row_counts_;
+
+  size_t GetIndex(size_t row, size_t col) const {
+    return row * num_cols_ + col;
+  }
+
+  /**
+   * Finds the height of a column by looking down from a row
+   * @param col the column
+   * @param below_row the row to start under
+   * @return one more than the highest filled row under below_row, or 0
+   */
+  uint16_t FindColumnHeight(size_t col, size_t below_row) const;
+
+ public:
+  Board();
+
+  /**
+   * Changes the size of the board and empties it
+   * @param num_rows number of rows
+   * @param num_cols number of columns
+   */
+  void Reset(size_t num_rows, size_t num_cols);
+
+  /**
+   * Replaces the board with saved tiles and palette, as read back from
+   * GetCells and GetPalette, leaving it without fixtures
+   * @param num_rows number of rows
+   * @param num_cols number of columns
+   * @param cells palette index of every tile, the bottom row first
+   * @param palette the palette the cells index
+   * @return false if the tiles don't fit the size or palette, leaving the
+   * board unchanged
+   */
+  bool Restore(size_t num_rows, size_t num_cols,
+      const std::vector<uint8_t>& cells,
+      const std::vector<cinder::Color>& palette);
+
+  /**
+   * Finds a color in the palette, adding it if there is room
+   * @param color the color
+   * @return palette index of the color, or of the closest color if full
+   */
+  uint8_t GetColorIndex(const cinder::Color& color);
+
+  /**
+   * Fills a tile
+   * @param row the row of tile
+   * @param col the col of tile
+   * @param color color of the tile
+   */
+  void FillTile(size_t row, size_t col, const cinder::Color& color);
+
+  /**
+   * Empties a tile
+   * @param row the row of tile
+   * @param col the col of tile
+   * @param is_exploded true to flash the tile white
+   */
+  void ClearTile(size_t row, size_t col, bool is_exploded = false);
+
+  bool IsFilled(size_t row, size_t col) const {
+    return cells_[GetIndex(row, col)] > kExplosionColor;
+  }
+
+  bool IsExploded(size_t row, size_t col) const {
+    return cells_[GetIndex(row, col)] == kExplosionColor;
+  }
+
+  uint8_t GetTileColorIndex(size_t row, size_t col) const {
+    return cells_[GetIndex(row, col)];
+  }
+
+  const cinder::Color& GetTileColor(size_t row, size_t col) const {
+    return palette_[cells_[GetIndex(row, col)]];
+  }
+
+  bool IsRowFull(size_t row) const {
+    return row_counts_[row] == num_cols_;
+  }
+
+  bool IsRowEmpty(size_t row) const {
+    return row_counts_[row] == 0;
+  }
+
+  /**
+   * Gets how high the filled tiles of a column reach
+   * @param col the column
+   * @return one more than the row of the highest filled tile, 0 if empty
+   */
+  size_t GetColumnHeight(size_t col) const {
+    return column_heights_[col];
+  }
+
+  /**
+   * Removes a row, moving every row above it down and adding an empty row
+   * at the top
+   * @param row the row
+   */
+  void RemoveRow(size_t row);
+
+  /**
+   * Adds an empty row at the bottom, moving every row up and dropping the
+   * top row
+   */
+  void InsertBottomRow();
+
+  /**
+   * Forgets every fixture, used when the floor body is rebuilt
+   */
+  void ClearFixtures() {
+    fixtures_.clear();
+  }
+
+  /**
+   * Records the fixture of a filled tile
+   * @param row the row of tile
+   * @param col the col of tile
+   * @param fixture the tile's fixture on the floor body
+   */
+  void SetFixture(size_t row, size_t col, b2Fixture* fixture);
+
+  /**
+   * Finds the fixture of a tile
+   * @param row the row of tile
+   * @param col the col of tile
+   * @return the fixture, or nullptr if the tile has none
+   */
+  b2Fixture* GetFixture(size_t row, size_t col) const;
+
+  /**
+   * Counts the heap memory held by the board
+   * @return size in bytes
+   */
+  size_t GetMemoryFootprint() const;
+
+  size_t GetNumRows() const {
+    return num_rows_;
+  }
+
+  size_t GetNumCols() const {
+    return num_cols_;
+  }
+
+  const std::vector<uint8_t>& GetCells() const {
+    return cells_;
+  }
+
+  const std::vector<cinder::Color>& GetPalette() const {
+    return palette_;
+  }
+};
+
+} // namespace tetris
+
+#endif  // FINALPROJECT_BOARD_H
@@ -0,0 +1,48 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#ifndef FINALPROJECT_GAME_MODE_H
+#define FINALPROJECT_GAME_MODE_H
+
+#include "world.h"
+
+namespace tetris {
+
+/**
+ * Game modes as compile time policies. World specializes its step, move
+ * and landing code for each one, so the mode checks inside them are
+ * resolved by the compiler. The window picks the policy at runtime through
+ * World::Step, while batch runs can step a single mode directly with
+ * World::StepMode.
+ */
+
+// four-tile blocks on a 10 by 24 board
+struct ClassicMode {
+  static const World::GameState kGameState = World::kClassic;
+  static const bool kIsTileDisconnected = false;
+  static const bool kHasBomb = false;
+};
+
+// larger blocks of half size tiles on a 20 by 48 board
+struct ReloadedMode {
+  static const World::GameState kGameState = World::kReloaded;
+  static const bool kIsTileDisconnected = false;
+  static const bool kHasBomb = false;
+};
+
+// reloaded blocks whose tiles may break apart on landing, the blitz mode
+struct DisjointedMode {
+  static const World::GameState kGameState = World::kReloaded;
+  static const bool kIsTileDisconnected = true;
+  static const bool kHasBomb = false;
+};
+
+// classic blocks plus a bomb that clears the 3 by 3 area it lands on
+struct BombMode {
+  static const World::GameState kGameState = World::kClassic;
+  static const bool kIsTileDisconnected = false;
+  static const bool kHasBomb = true;
+};
+
+} // namespace tetris
+
+#endif  // FINALPROJECT_GAME_MODE_H
@@ -0,0 +1,226 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#ifndef FINALPROJECT_PERFECT_CLEAR_SOLVER_H
+#define FINALPROJECT_PERFECT_CLEAR_SOLVER_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
+#include "block_template.h"
+
+namespace tetris {
+
+class Board;
+class WorkStealingPool;
+
+/**
+ * Finds placements for a known sequence of blocks that leave the board
+ * completely empty. The rows the blocks must fill, up to the clear height,
+ * are kept as one 64 bit bitboard, so placing a block, finding full rows
+ * and checking for an empty board are a few shifts and masks.
+ *
+ * Blocks are placed the way the game moves them: turned and moved across
+ * above the stack, then dropped straight down. The first few moves of the
+ * search are split into tasks on a work stealing pool, and positions every
+ * thread has already seen fail are kept in a shared transposition table.
+ */
+class PerfectClearSolver {
+ public:
+  // the board and clear height must fit in one bitboard
+  static const size_t kMaxBoardBits = 64;
+  // moves of the search run as their own tasks up to this depth
+  static const size_t kSplitDepth = 2;
+
+  /**
+   * Where a block of the sequence went, on the board as it was when the
+   * block was placed, after the rows cleared before it
+   */
+  struct Placement {
+    // index of the block in the sequence
+    size_t piece_;
+    // rotation state of the block's template
+    size_t rotation_;
+    // bottom left corner of the rotation's bounding box
+    int col_;
+    int row_;
+  };
+
+  struct Result {
+    bool is_found_;
+    // rows filled and cleared, the bottom rows of the board
+    size_t height_;
+    std::vector<Placement> placements_;
+    // positions searched, over every height tried
+    size_t num_nodes_;
+  };
+
+ private:
+  /**
+   * A rotation state of a block as bits of the bitboard, its bounding box
+   * moved to the bottom left corner
+   */
+  struct Shape {
+    uint64_t bits_;
+    int width_;
+    int height_;
+    // false when an earlier rotation has the same shape
+    bool is_distinct_;
+  };
+
+  /**
+   * A place a block can drop to and the board it leaves
+   */
+  struct Move {
+    Placement placement_;
+    // after full rows are cleared
+    uint64_t board_;
+    int height_;
+  };
+
+  /**
+   * A position that was searched to the end without a clear
+   */
+  struct FailedPosition {
+    uint64_t board_;
+    size_t depth_;
+
+    bool operator==(const FailedPosition& other) const {
+      return board_ == other.board_ && depth_ == other.depth_;
+    }
+  };
+
+  struct FailedPositionHash {
+    size_t operator()(const FailedPosition& position) const;
+  };
+
+  /**
+   * A share of the transposition table with its own lock, picked by hash
+   * so threads seldom wait on each other
+   */
+  struct TableShard {
+    std::mutex mutex_;
+    std::unordered_set<FailedPosition, FailedPositionHash> positions_;
+  };
+
+  static const size_t kNumTableShards = 64;
+
+  size_t num_cols_;
+  WorkStealingPool* pool_;
+  // per query, set up by Solve
+  std::vector<std::array<Shape, BlockTemplate::kNumRotations>> shapes_;
+  // greatest common divisor of the tile counts of the blocks from each
+  // index of the sequence to the last block used
+  std::vector<size_t> tile_gcds_;
+  // blocks that exactly fill the rows up to the clear height being tried
+  size_t num_used_;
+  std::array<std::unique_ptr<TableShard>, kNumTableShards> table_;
+  std::atomic<bool> is_found_;
+  std::atomic<size_t> num_nodes_;
+  std::mutex result_mutex_;
+  std::vector<Placement> solution_;
+
+  /**
+   * Checks if a position may still clear. A column filled to the clear
+   * height can't be crossed, even after rows clear, so the empty cells on
+   * either side of it must be filled by whole blocks.
+   * @param board the bitboard
+   * @param height rows still to clear
+   * @param depth blocks placed so far
+   * @return false if the position can never clear
+   */
+  bool CanStillClear(uint64_t board, int height, size_t depth) const;
+
+  /**
+   * Searches a position depth first on the calling thread
+   * @param board the bitboard
+   * @param height rows still to clear
+   * @param depth blocks placed so far
+   * @param path placements that led here, extended with the solution
+   * @param num_nodes counts the positions searched
+   * @return true if the position clears
+   */
+  bool Search(uint64_t board, int height, size_t depth,
+      std::vector<Placement>* path, size_t* num_nodes);
+
+  /**
+   * Searches a position, giving each move its own task while the search
+   * is shallow
+   * @param board the bitboard
+   * @param height rows still to clear
+   * @param depth blocks placed so far
+   * @param path placements that led here
+   */
+  void SearchTask(uint64_t board, int height, size_t depth,
+      const std::vector<Placement>& path);
+
+  /**
+   * Finds every place a block can drop to
+   * @param board the bitboard
+   * @param height rows still to clear
+   * @param piece index of the block in the sequence
+   * @param moves set to every move, with moves that leave the same board
+   * left out
+   */
+  void FindMoves(uint64_t board, int height, size_t piece,
+      std::vector<Move>* moves) const;
+
+  /**
+   * Notes a clear, keeping the first one found
+   * @param path placements of the clear
+   */
+  void ReportSolution(const std::vector<Placement>& path);
+
+  bool IsFailed(const FailedPosition& position);
+
+  void MarkFailed(const FailedPosition& position);
+
+ public:
+  /**
+   * Makes a solver for boards of a width
+   * @param num_cols width of the board, at most 32
+   * @param pool threads to search on
+   */
+  PerfectClearSolver(size_t num_cols, WorkStealingPool* pool);
+
+  /**
+   * Searches for a perfect clear within a number of blocks, trying each
+   * clear height that the blocks could exactly fill, lowest first
+   * @param rows filled tiles of each row, the bottom row first, bit c set
+   * when column c is filled
+   * @param pieces templates of the upcoming blocks, in order
+   * @param max_pieces most blocks to place
+   * @return whether and how the board clears
+   */
+  Result Solve(const std::vector<uint32_t>& rows,
+      const std::vector<const BlockTemplate*>& pieces, size_t max_pieces);
+
+  /**
+   * Gets the rows of a game's board for Solve
+   * @param board the board, at most 32 columns wide
+   * @return filled tiles of each row, the bottom row first
+   */
+  static std::vector<uint32_t> GetRows(const Board& board);
+
+  /**
+   * Places a block on rows given to Solve and clears full rows, to follow
+   * a solution
+   * @param placement where the block goes
+   * @param block_template template of the block
+   * @param num_cols width of the board
+   * @param rows filled tiles of each row, updated
+   * @return number of rows cleared
+   */
+  static size_t Place(const Placement& placement,
+      const BlockTemplate& block_template, size_t num_cols,
+      std::vector<uint32_t>* rows);
+};
+
+} // namespace tetris
+
+#endif  // FINALPROJECT_PERFECT_CLEAR_SOLVER_H
@@ -0,0 +1,140 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#ifndef FINALPROJECT_PIECE_SET_H
+#define FINALPROJECT_PIECE_SET_H
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "block_template.h"
+
+namespace tetris {
+
+/**
+ * Blocks loaded from a text file instead of the compiled in tables, so a
+ * mode can get new blocks without rebuilding the game. The file lists
+ * pieces, one keyword per line, with # starting a comment:
+ *
+ *   piece line
+ *   color 0 1 1
+ *   weight 2
+ *   cells 0,1 1,1 2,1 3,1
+ *
+ * Cells are column,row in the 4 by 4 box the block turns in, rows counting
+ * up from the bottom, and must touch each other. A piece spawns with a
+ * chance of its weight over the sum of all weights, 1 when left out.
+ *
+ * The first load checks the file and compiles it into a cache next to it,
+ * holding the finished templates with every rotation, bounding box and
+ * occupancy mask. Later loads map the cache and use the templates in
+ * place, as long as the text it was made from hasn't changed.
+ */
+class PieceSet {
+ public:
+  static const size_t kMaxPieces = 64;
+  static const uint32_t kMaxWeight = 1000;
+
+ private:
+  // the cache file, mapped read only
+  const uint8_t* data_;
+  size_t size_;
+  bool is_mapped_;
+  // where mapping isn't available the cache is read in here instead
+  std::vector<uint8_t> contents_;
+  // templates compiled on this load, when there was no usable cache
+  std::vector<BlockTemplate> compiled_templates_;
+  std::vector<uint32_t> compiled_weights_;
+  // point into the cache or the compiled vectors
+  const BlockTemplate* templates_;
+  const uint32_t* weights_;
+  size_t num_pieces_;
+  uint32_t total_weight_;
+  bool is_from_cache_;
+
+  /**
+   * Unmaps the cache and forgets the pieces
+   */
+  void Close();
+
+  /**
+   * Maps a cache and checks it was made from the same text
+   * @param cache_path the cache
+   * @param source_hash hash of the text
+   * @return false if the cache is missing, stale or damaged
+   */
+  bool OpenCache(const std::string& cache_path, uint64_t source_hash);
+
+  /**
+   * Writes the compiled set to a cache, replacing any older one in one go
+   * @param cache_path the cache
+   * @param source_hash hash of the text the set was compiled from
+   */
+  void WriteCache(const std::string& cache_path, uint64_t source_hash) const;
+
+ public:
+  PieceSet();
+  ~PieceSet();
+
+  PieceSet(const PieceSet&) = delete;
+  PieceSet& operator=(const PieceSet&) = delete;
+
+  /**
+   * Loads a piece set, from its cache if the cache is up to date and
+   * otherwise by compiling the text and writing the cache
+   * @param path the text file
+   * @param error set to what is wrong with the file, with its line number
+   * @return false if the file could not be read or has a mistake
+   */
+  bool Load(const std::string& path, std::string* error);
+
+  /**
+   * Checks and compiles the text of a piece set
+   * @param text the text
+   * @param templates set to a template for each piece, ids in file order
+   * @param weights set to the weight of each piece
+   * @param error set to the first mistake, with its line number
+   * @return false if the text has a mistake
+   */
+  static bool Compile(const std::string& text,
+      std::vector<BlockTemplate>* templates, std::vector<uint32_t>* weights,
+      std::string* error);
+
+  /**
+   * Gets where the cache of a piece set is kept
+   * @param path the text file
+   * @return path of the cache
+   */
+  static std::string GetCachePath(const std::string& path) {
+    return path + ".cache";
+  }
+
+  /**
+   * Picks a piece with the chance its weight gives
+   * @param random the generator to draw from
+   * @return template id of the piece
+   */
+  size_t PickPiece(std::mt19937* random) const;
+
+  BlockTemplateList GetTemplates() const {
+    return BlockTemplateList(templates_, num_pieces_);
+  }
+
+  uint32_t GetWeight(size_t template_id) const {
+    return weights_[template_id];
+  }
+
+  size_t GetNumPieces() const {
+    return num_pieces_;
+  }
+
+  // true if the last load used the cache rather than compiling the text
+  bool IsFromCache() const {
+    return is_from_cache_;
+  }
+};
+
+} // namespace tetris
+
+#endif  // FINALPROJECT_PIECE_SET_H
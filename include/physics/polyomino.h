@@ -0,0 +1,130 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#ifndef FINALPROJECT_POLYOMINO_H
+#define FINALPROJECT_POLYOMINO_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "block_template.h"
+
+namespace tetris {
+
+class WorkStealingPool;
+
+/**
+ * A shape of square tiles joined by their sides, kept in its canonical
+ * orientation: of its four rotations and their mirror images, the one whose
+ * rows compare smallest. Two shapes that can be turned or flipped into each
+ * other are therefore equal, and hash the same.
+ */
+class Polyomino {
+ public:
+  static const size_t kMaxCells = 16;
+
+ private:
+  // rows from the bottom, bit c set when column c is filled, with the
+  // shape touching row 0 and column 0
+  std::array<uint16_t, kMaxCells> rows_;
+  uint8_t num_cells_;
+
+ public:
+  Polyomino() : rows_(), num_cells_(0) {}
+
+  /**
+   * Makes the canonical shape of some tiles
+   * @param cells tiles, which must be joined and fewer than kMaxCells
+   * across in either direction
+   * @return the shape
+   */
+  static Polyomino FromCells(const std::vector<BlockTemplate::Cell>& cells);
+
+  /**
+   * Gets the tiles of the shape in its canonical orientation
+   * @return column and row of each tile, row by row from the bottom
+   */
+  std::vector<BlockTemplate::Cell> GetCells() const;
+
+  /**
+   * Adds every shape one tile bigger than this one
+   * @param children where to put the shapes, some of which may repeat
+   */
+  void Grow(std::vector<Polyomino>* children) const;
+
+  /**
+   * Checks if the shape fits in a square box, turned if need be
+   * @param box_size side of the box
+   * @return true if it fits
+   */
+  bool FitsBox(int box_size) const;
+
+  /**
+   * Checks if the shape can be turned so its bottom row is filled from
+   * edge to edge, letting it lie flat and fill part of a row without
+   * leaving a gap under itself
+   * @return true if such a turn exists
+   */
+  bool CanLieFlat() const;
+
+  size_t GetNumCells() const {
+    return num_cells_;
+  }
+
+  int GetWidth() const;
+
+  int GetHeight() const;
+
+  uint64_t GetHash() const;
+
+  bool operator==(const Polyomino& other) const {
+    return rows_ == other.rows_;
+  }
+
+  bool operator<(const Polyomino& other) const {
+    return rows_ < other.rows_;
+  }
+};
+
+/**
+ * Hashes a shape for unordered containers
+ */
+struct PolyominoHash {
+  size_t operator()(const Polyomino& polyomino) const {
+    return static_cast<size_t>(polyomino.GetHash());
+  }
+};
+
+/**
+ * Finds every free polyomino, shapes counted once however they are turned
+ * or flipped, and turns them into piece sets
+ */
+class PolyominoEnumerator {
+ public:
+  /**
+   * Enumerates the polyominoes of every size up to a limit. Each size is
+   * grown from the one before, with the shapes split between the pool's
+   * threads and the new shapes merged by hash, so no lock is taken.
+   * @param max_cells largest size, at most Polyomino::kMaxCells
+   * @param pool threads to grow the shapes on
+   * @return the shapes of each size, sorted, with index 0 holding those of
+   * size 1
+   */
+  static std::vector<std::vector<Polyomino>> Enumerate(size_t max_cells,
+      WorkStealingPool* pool);
+
+  /**
+   * Writes shapes as a piece set that PieceSet can load, each centered in
+   * the 4 by 4 box blocks turn in and given its own color
+   * @param pieces the shapes, which must fit the box and have at most
+   * BlockTemplate::kMaxTiles tiles
+   * @return text of the piece set
+   */
+  static std::string WritePieceSet(const std::vector<Polyomino>& pieces);
+};
+
+} // namespace tetris
+
+#endif  // FINALPROJECT_POLYOMINO_H
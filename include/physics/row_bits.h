@@ -0,0 +1,38 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#ifndef FINALPROJECT_ROW_BITS_H
+#define FINALPROJECT_ROW_BITS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "block_template.h"
+
+namespace tetris {
+
+/**
+ * Gets the bits of a full row, for boards kept as one uint32_t of filled
+ * tiles per row with the bottom row first
+ * @param num_cols width of the board, at most 32
+ * @return mask of the columns
+ */
+uint32_t GetFullRowBits(size_t num_cols);
+
+/**
+ * Adds a block's tiles to rows of bits and removes the rows it fills
+ * @param block_template template of the block
+ * @param rotation rotation state of the template
+ * @param col left column of the rotation's bounding box
+ * @param row bottom row of the rotation's bounding box
+ * @param num_cols width of the board
+ * @param rows filled tiles of each row, grown to fit the block and
+ * left without the full rows
+ * @return number of rows cleared
+ */
+size_t PlaceOnRows(const BlockTemplate& block_template, size_t rotation,
+    int col, int row, size_t num_cols, std::vector<uint32_t>* rows);
+
+} // namespace tetris
+
+#endif  // FINALPROJECT_ROW_BITS_H
@@ -8,9 +8,21 @@
 #include <Box2D/Dynamics/b2World.h>
 #include <cinder/audio/Voice.h>
 
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <random>
 #include <vector>
 
+#include "block_contact_listener.h"
 #include "block_generator.h"
+#include "board.h"
+#include "telemetry/allocation_tracker.h"
+#include "telemetry/trace.h"
+#include "world_listener.h"
 
 namespace tetris {
 
@@ -26,9 +38,15 @@ class World {
   constexpr static const int kBombId = 7;
   static const int kGroundFloorInitialHeight = 10;
   static const int kRotatesForFullCircle = 4;
+  // the level goes up after this many rows are cleared
+  static const size_t kRowsPerLevel = 10;
+  static const size_t kMaxLevel = 20;
+  // speed of the top level over the starting speed, about 20 rows a step
+  constexpr static const double kMaxGravity = 200.0;
+  // upcoming blocks shown to the player and to bots
+  static const size_t kNumPreviewBlocks = 3;
 
   enum MoveStatus {
-    kValidateLegalMove,
     kDetectIllegal,
     kHitGround,
     kMoveOk
@@ -41,24 +59,73 @@ class World {
     kEndScreen
   };
 
+  // the parts of a step, timed separately
+  enum StepPhase {
+    // Box2D stepping, sub-steps included
+    kPhysicsPhase,
+    // spawning, reverting illegal moves, locking and clearing rows
+    kLandingPhase,
+    // settling loose tiles in disconnected mode
+    kDebrisPhase,
+    // telling listeners the step finished
+    kListenerPhase,
+    kNumStepPhases
+  };
+
+  /**
+   * A loose tile of a block that broke apart in disconnected mode, falling
+   * on its own until it settles into the floor
+   */
+  struct Debris {
+    b2Body* body_;
+    const BlockTemplate* block_template_;
+  };
+
  private:
   const float kTimeStep = 1.0f/60.0f;
   const int32 kVelocityIterations = 6;
   const int32 kPositionIterations = 2;
   const int32 kDisconnectVelocityIter = 2;
   const int32 kDisconnectPositionIter = 6;
+  // a fast block is checked for tiles in its way this far apart, well
+  // under the 0.8 tile size so it cannot pass through a floor tile, and
+  // the physics step moves it at most this far
+  const float kMaxTravelPerPiece = 0.5f;
+  const int kMaxTravelPieces = 256;
+  // only debris falls with gravity, blocks fall at a set speed
+  const float kDebrisGravity = -30.0f;
+  // debris further than this outside the board has fallen out of it
+  const float kDebrisCullMargin = 2.0f;
+  // how far a tile may reach into a neighbouring tile and still fit
+  const float kOverlapTolerance = 0.1f;
 
   // Audio files
   cinder::audio::VoiceSamplePlayerNodeRef row_complete_sound_;
   cinder::audio::VoiceSamplePlayerNodeRef block_collide_sound_;
   cinder::audio::VoiceSamplePlayerNodeRef bomb_explode_sound_;
-  b2World* b2_world_;
-  Block* moving_block_;
-  BlockGenerator* block_generator_;
+  // reverts illegal moves, declared before b2_world_ so it outlives it
+  BlockContactListener contact_listener_;
+  std::unique_ptr<b2World> b2_world_;
+  std::unique_ptr<Block> moving_block_;
+  std::unique_ptr<BlockGenerator> block_generator_;
+  // blocks that spawn next, in order, whose bodies are made ahead of time
+  // but kept inactive so a spawn only switches one on. One more than the
+  // preview is kept, so the lock tick doesn't have to make a body.
+  std::deque<std::unique_ptr<Block>> preview_blocks_;
+  // block put aside with Block::kHold, inactive like the preview blocks
+  std::unique_ptr<Block> held_block_;
+  // the moving block was swapped in from the hold, so it can't be held
+  // again until it locks
+  bool is_hold_used_;
+  // bodies below belong to b2_world_
   b2Body* ground_floor_body_;
-  // if not filled in, color_ is black
-  std::vector<std::vector<Block::Tile>> floor_tile_array_;
-  // variables used for determining legal moves
+  b2Body* left_wall_body_;
+  b2Body* right_wall_body_;
+  // tiles that have landed on the floor
+  Board board_;
+  // loose tiles still falling or settling in disconnected mode
+  std::vector<Debris> debris_;
+  // set when the falling block runs into something during a step
   MoveStatus move_status_;
   Block::Transform previous_legal_transform_;
   size_t current_score_;
@@ -67,6 +134,8 @@ class World {
   size_t total_num_col_;
   size_t total_num_row_;
   double expected_block_speed_;
+  // sets expected_block_speed_, raised as rows are cleared
+  size_t level_;
   // used for disconnected mode to detect block stuck on floor
   size_t num_illegal_move_;
   // physical engine rarely checks for iteration if true,
@@ -75,6 +144,25 @@ class World {
   bool is_tile_disconnected_mode_;
   // bomb now added to created blocks
   bool is_bomb_mode_;
+  // not owned, blocks spawned instead of the mode's when set
+  const PieceSet* piece_set_;
+  // rows cleared since the last call to TakeClearedRowCount
+  size_t num_cleared_rows_;
+  // seeds every random choice, so a game can be replayed from its inputs
+  uint32_t seed_;
+  // picks the open column of incoming garbage rows
+  std::mt19937 garbage_random_;
+  // steps taken while a game was in progress
+  size_t current_tick_;
+  // heap allocations made during the last step of a game in progress
+  AllocationSampler tick_allocations_;
+  // milliseconds each phase took in the last step of a game in progress
+  std::array<float, kNumStepPhases> step_phase_times_;
+  // not owned, told about game events in the order they were added
+  std::vector<WorldListener*> listeners_;
+  // StepMode and MoveMode specialized for the current mode
+  void (World::*step_function_)();
+  bool (World::*move_function_)(Block::Move);
 
   /**
    * Rebuilds the ground floor with floor tile array and floor
@@ -105,27 +193,187 @@ class World {
 
    /**
     * Checks and adds blocks dropping on the floor
+    * @tparam Mode game mode policy from game_mode.h
     */
+   template <typename Mode>
    void HandleBlockDroppingOnFloor();
 
+   /**
+    * Adds the moving block's tiles to the floor and spawns the next block
+    * @tparam Mode game mode policy from game_mode.h
+    */
+   template <typename Mode>
+   void LockMovingBlock();
+
+   /**
+    * Makes the next block's body ahead of time and adds it to the preview
+    */
+   void PrepareNextBlock();
+
+   /**
+    * Makes a block waiting to spawn the moving block, at the spawn point,
+    * unturned and at the current speed
+    * @param block a block with an inactive body
+    */
+   void ActivateBlock(std::unique_ptr<Block> block);
+
+   /**
+    * Destroys the bodies of the preview and held blocks
+    */
+   void ClearWaitingBlocks();
+
+   /**
+    * Replaces the moving block with a piece of debris for every tile and
+    * spawns the next block
+    */
+   void BreakMovingBlockApart();
+
+   /**
+    * Snaps debris that has gone to sleep into the floor, and drops debris
+    * that has left the board
+    */
+   void SettleDebris();
+
+   /**
+    * Checks if the floor reaches the top two rows
+    * @return true if the game should end
+    */
+   bool IsToppedOut() const;
+
+   /**
+    * Checks if the moving block would only cover empty tiles at a
+    * transform, tiles above the board count as empty
+    * @param transform transform of the block's body
+    * @return true if every tile would be empty and between the walls
+    */
+   bool IsBlockClear(const b2Transform& transform) const;
+
+   /**
+    * Moves/rotates the block based on the input
+    * @tparam Mode game mode policy from game_mode.h
+    * @param direction direction to move/rotate
+    * @return true if the block moved, false if the move was illegal
+    */
+   template <typename Mode>
+   bool MoveMode(Block::Move direction);
+
+   /**
+    * Points the step and move functions at the current mode's versions
+    */
+   void SelectModeFunctions();
+
+   /**
+    * Adds a single tile to the ground floor body
+    * @param row the row of tile
+    * @param col the col of tile
+    * @return the fixture of the created tile
+    */
+   b2Fixture* CreateFloorTileFixture(size_t row, size_t col);
+
+   /**
+    * Moves a block falling faster than one physics step can carry along
+    * its path, up to kMaxTravelPerPiece short of where it would go or of
+    * the first tile or debris in its way, and slows it to cover the rest
+    * @param velocity set to the speed the block had
+    * @return true if the block was moved, and must get its speed back
+    */
+   bool CarryFastBlock(b2Vec2* velocity);
+
+   /**
+    * Checks if the moving block would overlap any debris
+    * @param transform the transform to check the block at
+    * @return true if a piece of debris is in the way
+    */
+   bool IsTouchingDebris(const b2Transform& transform) const;
+
+   /**
+    * Shortens a drop so the moving block stops above the first debris in
+    * its way, to within kMaxTravelPerPiece
+    * @param drop_distance distance in rows the block falls onto the board
+    * @return distance in rows the block falls without touching debris
+    */
+   float GetDropDistanceAboveDebris(float drop_distance) const;
+
+   /**
+    * Finds how far the moving block falls before it lands on the floor,
+    * using the column heights and ignoring debris
+    * @return distance in rows
+    */
+   float GetBoardDropDistance() const;
+
+   /**
+    * Stores how long a phase of the step took
+    * @param phase the phase that just finished
+    * @param start when the phase started
+    * @return now, when the next phase starts
+    */
+   std::chrono::steady_clock::time_point FinishStepPhase(StepPhase phase,
+       std::chrono::steady_clock::time_point start);
+
+   /**
+    * Plays a sound effect if sound is enabled
+    * @param sound the sound to play
+    */
+   static void PlaySound(const cinder::audio::VoiceSamplePlayerNodeRef& sound);
+
+   /**
+    * Moves the game to the end screen and tells the listeners
+    */
+   void EndGame();
+
  public:
-  World();
+  /**
+   * Creates an empty world
+   * @param is_sound_enabled false to skip loading and playing sound effects,
+   * used when many worlds are hosted without a window
+   */
+  explicit World(bool is_sound_enabled = true);
 
   /**
    * Executes a single step.
    */
-  void Step();
+  void Step() {
+    (this->*step_function_)();
+  }
+
+  /**
+   * Executes a single step of a known mode, skipping the runtime dispatch
+   * @tparam Mode game mode policy from game_mode.h matching this world
+   */
+  template <typename Mode>
+  void StepMode();
 
   /**
-   * Spawns a new block at the top of the screen
+   * Spawns the first block of the preview at the top of the screen,
+   * making blocks first if the preview ran short
    */
   void SpawnNewRandomBlock();
 
   /**
-   * Moves/rotates the block based on the input
+   * Gets where blocks spawn
+   * @return position of a new block's body
+   */
+  b2Vec2 GetSpawnPosition() const {
+    return b2Vec2(total_num_col_ / 2.0f, static_cast<float>(total_num_row_));
+  }
+
+  /**
+   * Moves/rotates the block based on the input. The move is checked
+   * against the walls and floor tiles first, and an illegal move leaves the
+   * block where it is.
    * @param direction direction to move/rotate
+   * @return true if the block moved, false if the move was illegal
    */
-  void Move(Block::Move direction);
+  bool Move(Block::Move direction) {
+    return (this->*move_function_)(direction);
+  }
+
+  /**
+   * Finds how far the moving block falls before it lands on the floor or
+   * on debris, as the debris lies right now
+   * @return distance in rows, 0 if there is no moving block
+   */
+  float GetDropDistance() const;
 
   /**
    * Deals with illegal movements
@@ -133,23 +381,142 @@ class World {
    */
   void IllegalMoveCallBack(b2Body* other_body);
 
+  /**
+   * Adds a piece of debris
+   * @param block_template the block the tile came from
+   * @param position bottom left corner of the tile
+   * @param velocity starting velocity
+   */
+  void AddDebris(const BlockTemplate& block_template, const b2Vec2& position,
+      const b2Vec2& velocity);
+
+  /**
+   * Pushes the floor up by garbage rows that share a single open column
+   * @param num_rows number of garbage rows to add
+   */
+  void AddGarbageRows(size_t num_rows);
+
+  /**
+   * Gets the rows cleared since the last call and resets the count
+   * @return number of rows cleared
+   */
+  size_t TakeClearedRowCount();
+
+  /**
+   * Estimates the heap and physics engine memory held by this world
+   * @return approximate size in bytes
+   */
+  size_t GetMemoryFootprint() const;
+
+  /**
+   * Saves everything a game in progress depends on, from the floor and
+   * score to the moving block's body and the state of every random
+   * generator, so it can be picked up again with RestoreSnapshot.
+   * Box2D's contact caches are rebuilt rather than saved, so in
+   * disconnected mode debris resting in a pile can settle slightly
+   * differently after a restore.
+   * @return bytes of the snapshot
+   */
+  std::vector<uint8_t> SaveSnapshot() const;
+
+  /**
+   * Replaces the game with one saved by SaveSnapshot, keeping listeners
+   * @param data bytes of the snapshot
+   * @param size number of bytes
+   * @return false if the bytes are not a snapshot of a game in progress,
+   * leaving the world unchanged
+   */
+  bool RestoreSnapshot(const uint8_t* data, size_t size);
+
+  /**
+   * Hashes the parts of the game a player can see: the mode, tick, score,
+   * floor, and where the moving block and debris are to within a small
+   * fraction of a tile. Two runs of a replay match at a tick when their
+   * hashes do, which is cheap enough to check after every step.
+   * @return the hash
+   */
+  uint64_t GetStateHash() const;
+
+  /**
+   * Registers a listener to be told about game events
+   * @param listener listener that must outlive its registration
+   */
+  void AddListener(WorldListener* listener);
+
+  /**
+   * Stops telling a listener about game events
+   * @param listener a registered listener
+   */
+  void RemoveListener(WorldListener* listener);
+
+  /**
+   * Sets the seed of every random choice, call before the game starts
+   * @param seed the seed
+   */
+  void SetSeed(uint32_t seed);
+
+  uint32_t GetSeed() const {
+    return seed_;
+  }
+
+  size_t GetTickCount() const {
+    return current_tick_;
+  }
+
   const Block* GetMovingBlock() const {
-    return moving_block_;
+    return moving_block_.get();
+  }
+
+  // blocks in the preview, none before the first block spawns
+  size_t GetNumPreviewBlocks() const {
+    return std::min(preview_blocks_.size(), kNumPreviewBlocks);
+  }
+
+  /**
+   * Gets an upcoming block, whose body is inactive
+   * @param index 0 for the next block, less than GetNumPreviewBlocks
+   * @return the block
+   */
+  const Block& GetPreviewBlock(size_t index) const {
+    return *preview_blocks_[index];
+  }
+
+  // the block put aside, or nullptr
+  const Block* GetHeldBlock() const {
+    return held_block_.get();
+  }
+
+  bool IsHoldUsed() const {
+    return is_hold_used_;
   }
 
   b2World* GetB2World() const {
-    return b2_world_;
+    return b2_world_.get();
+  }
+
+  const Board& GetBoard() const {
+    return board_;
   }
 
-  const std::vector<std::vector<Block::Tile>>& GetFloorTileArray() const {
-    return floor_tile_array_;
+  const std::vector<Debris>& GetDebris() const {
+    return debris_;
   }
 
-  std::vector<std::vector<Block::Tile>>& GetFloorTileArray() {
-    return floor_tile_array_;
+  const AllocationSampler& GetTickAllocations() const {
+    return tick_allocations_;
   }
 
-  size_t GetScore() {
+  const std::array<float, kNumStepPhases>& GetStepPhaseTimes() const {
+    return step_phase_times_;
+  }
+
+  static const char* GetStepPhaseName(StepPhase phase);
+
+  Board& GetBoard() {
+    return board_;
+  }
+
+  size_t GetScore() const {
     return current_score_;
   }
 
@@ -177,6 +544,7 @@ class World {
 
   void SetIsTileDisconnectedMode(bool tile_disconnected) {
     is_tile_disconnected_mode_ = tile_disconnected;
+    SelectModeFunctions();
   }
 
   bool GetIsTileDisconnectedMode() const {
@@ -185,16 +553,47 @@ class World {
 
   void SetIsBombMode(bool is_bomb) {
     is_bomb_mode_ = is_bomb;
+    SelectModeFunctions();
   }
 
   bool GetIsBombMode() const {
     return is_bomb_mode_;
   }
 
+  /**
+   * Spawns blocks of a loaded piece set in every mode, call before the
+   * game starts
+   * @param piece_set the set, which must outlive the world, or nullptr for
+   * the blocks of the mode
+   */
+  void SetPieceSet(const PieceSet* piece_set);
+
+  const PieceSet* GetPieceSet() const {
+    return piece_set_;
+  }
+
   double GetExpectedBlockSpeed() const {
     return expected_block_speed_;
   }
 
+  /**
+   * Sets the level, and with it the speed of the blocks spawned after
+   * @param level the level, at most kMaxLevel
+   */
+  void SetLevel(size_t level);
+
+  size_t GetLevel() const {
+    return level_;
+  }
+
+  /**
+   * Gets how much faster than the starting speed blocks fall at a level,
+   * growing by the same factor every level up to kMaxGravity
+   * @param level the level
+   * @return speed multiplier
+   */
+  static double GetGravityMultiplier(size_t level);
+
   /**
    * Check the move status for testing
    */
@@ -0,0 +1,90 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#ifndef FINALPROJECT_WORLD_LISTENER_H
+#define FINALPROJECT_WORLD_LISTENER_H
+
+#include <cinder/Color.h>
+
+#include <vector>
+
+namespace tetris {
+
+class Block;
+class World;
+
+/**
+ * Row and column of a single tile on the floor
+ */
+struct TilePosition {
+  size_t row_;
+  size_t col_;
+};
+
+/**
+ * Gets told about game events as the world steps. Register with
+ * World::AddListener; the world does not own its listeners.
+ */
+class WorldListener {
+ public:
+  virtual ~WorldListener() = default;
+
+  /**
+   * Called after a new moving block is created
+   * @param world the world
+   * @param block the new moving block
+   */
+  virtual void OnBlockSpawned(const World& /* world */,
+      const Block& /* block */) {}
+
+  /**
+   * Called when the moving block becomes part of the floor
+   * @param world the world
+   * @param block the block, whose body is about to be destroyed
+   * @param tiles floor positions the block's tiles were added at
+   */
+  virtual void OnBlockLocked(const World& /* world */,
+      const Block& /* block */,
+      const std::vector<TilePosition>& /* tiles */) {}
+
+  /**
+   * Called when a complete row is removed, before rows above move down
+   * @param world the world
+   * @param row index of the removed row
+   */
+  virtual void OnRowCleared(const World& /* world */, size_t /* row */) {}
+
+  /**
+   * Called when a bomb clears the 3 by 3 area around a tile
+   * @param world the world
+   * @param center position the bomb exploded at
+   */
+  virtual void OnBombExploded(const World& /* world */,
+      const TilePosition& /* center */) {}
+
+  /**
+   * Called after garbage rows push the floor up
+   * @param world the world
+   * @param num_rows number of rows added at the bottom
+   * @param open_col column left empty in every added row
+   * @param color color of the added tiles
+   */
+  virtual void OnGarbageRowsAdded(const World& /* world */,
+      size_t /* num_rows */, size_t /* open_col */,
+      const cinder::Color& /* color */) {}
+
+  /**
+   * Called once when the game reaches the end screen
+   * @param world the world
+   */
+  virtual void OnGameOver(const World& /* world */) {}
+
+  /**
+   * Called at the end of every step while a game is in progress
+   * @param world the world
+   */
+  virtual void OnStepFinished(const World& /* world */) {}
+};
+
+} // namespace tetris
+
+#endif  // FINALPROJECT_WORLD_LISTENER_H
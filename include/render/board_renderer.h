@@ -0,0 +1,72 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#ifndef FINALPROJECT_BOARD_RENDERER_H
+#define FINALPROJECT_BOARD_RENDERER_H
+
+#include <Box2D/Collision/b2Collision.h>
+
+#include <cstdint>
+#include <string>
+
+#include "physics/world.h"
+#include "render/framebuffer.h"
+
+namespace tetris {
+
+/**
+ * Draws a world the way the game window does, the floor, the moving block
+ * with its landing outline, loose debris and the score, into a
+ * Framebuffer on the CPU. Used to make replay thumbnails and frames on
+ * machines without a GPU.
+ */
+class BoardRenderer {
+ public:
+  static const int kDefaultTileSize = 20;
+
+ private:
+  // pixels per tile
+  int tile_size_;
+  Framebuffer framebuffer_;
+
+  /**
+   * Fills a box given in world units
+   * @param box the box, y pointing up
+   * @param num_rows rows of the board, to flip y
+   * @param color packed color
+   */
+  void FillWorldBox(const b2AABB& box, size_t num_rows, uint32_t color);
+
+  /**
+   * Draws text with a small built in font, for digits and the few
+   * letters the renderer needs; other characters are left blank
+   * @param text the text
+   * @param left left edge in pixels
+   * @param top top edge in pixels
+   * @param scale pixels per font pixel
+   * @param color packed color
+   */
+  void DrawText(const std::string& text, int left, int top, int scale,
+      uint32_t color);
+
+ public:
+  /**
+   * Creates a renderer
+   * @param tile_size pixels per tile
+   */
+  explicit BoardRenderer(int tile_size = kDefaultTileSize);
+
+  /**
+   * Draws the current state of a world, resizing the framebuffer to fit
+   * its board
+   * @param world the world
+   */
+  void Render(const World& world);
+
+  const Framebuffer& GetFramebuffer() const {
+    return framebuffer_;
+  }
+};
+
+} // namespace tetris
+
+#endif  // FINALPROJECT_BOARD_RENDERER_H
@@ -0,0 +1,119 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#ifndef FINALPROJECT_FRAMEBUFFER_H
+#define FINALPROJECT_FRAMEBUFFER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace tetris {
+
+/**
+ * An RGBA image in memory that rectangles are drawn into on the CPU, for
+ * rendering without a GPU. Every pixel is four bytes in R, G, B, A order,
+ * rows top to bottom. Rectangles are filled a row span at a time, four
+ * pixels per store where SSE2 or NEON is available.
+ */
+class Framebuffer {
+ private:
+  int width_;
+  int height_;
+  std::vector<uint32_t> pixels_;
+
+  /**
+   * Sets a run of pixels to one color
+   * @param pixels first pixel of the run
+   * @param count number of pixels
+   * @param color packed color
+   */
+  static void FillSpan(uint32_t* pixels, size_t count, uint32_t color);
+
+ public:
+  Framebuffer();
+
+  /**
+   * Changes the size of the image, leaving its contents undefined
+   * @param width width in pixels
+   * @param height height in pixels
+   */
+  void Resize(int width, int height);
+
+  /**
+   * Packs a color into a pixel
+   * @param red red from 0 to 255
+   * @param green green from 0 to 255
+   * @param blue blue from 0 to 255
+   * @param alpha alpha from 0 to 255
+   * @return the pixel
+   */
+  static uint32_t PackColor(uint8_t red, uint8_t green, uint8_t blue,
+      uint8_t alpha = 255);
+
+  /**
+   * Packs a color with channels from 0 to 1 into a pixel
+   * @param red red from 0 to 1
+   * @param green green from 0 to 1
+   * @param blue blue from 0 to 1
+   * @return the pixel, opaque
+   */
+  static uint32_t PackColor(float red, float green, float blue);
+
+  void Clear(uint32_t color);
+
+  /**
+   * Fills a rectangle, clipped to the image
+   * @param left first column
+   * @param top first row
+   * @param right one past the last column
+   * @param bottom one past the last row
+   * @param color packed color
+   */
+  void FillRect(int left, int top, int right, int bottom, uint32_t color);
+
+  /**
+   * Draws the one pixel wide outline of a rectangle, clipped to the image
+   * @param left first column
+   * @param top first row
+   * @param right one past the last column
+   * @param bottom one past the last row
+   * @param color packed color
+   */
+  void StrokeRect(int left, int top, int right, int bottom, uint32_t color);
+
+  uint32_t GetPixel(int x, int y) const {
+    return pixels_[static_cast<size_t>(y) * width_ + x];
+  }
+
+  int GetWidth() const {
+    return width_;
+  }
+
+  int GetHeight() const {
+    return height_;
+  }
+
+  const std::vector<uint32_t>& GetPixels() const {
+    return pixels_;
+  }
+
+  /**
+   * Writes the image as a binary PPM, dropping alpha
+   * @param path file to write
+   * @return false if the file could not be written
+   */
+  bool WritePpm(const std::string& path) const;
+
+  /**
+   * Writes the image as an RGBA PNG. The image data is stored without
+   * compression, which keeps writing fast and needs no zlib.
+   * @param path file to write
+   * @return false if the file could not be written
+   */
+  bool WritePng(const std::string& path) const;
+};
+
+} // namespace tetris
+
+#endif  // FINALPROJECT_FRAMEBUFFER_H
@@ -0,0 +1,140 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#ifndef FINALPROJECT_TERMINAL_CANVAS_H
+#define FINALPROJECT_TERMINAL_CANVAS_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace tetris {
+
+/**
+ * A grid of character cells drawn to an ANSI terminal. Drawing goes into a
+ * back buffer; Flush compares it with what the terminal already shows and
+ * returns escape codes for only the cells that changed, moving the cursor
+ * and switching colors only when it has to. A still frame costs nothing to
+ * redraw, which keeps play smooth over slow SSH links.
+ */
+class TerminalCanvas {
+ public:
+  // the terminal's own foreground or background color
+  static const uint16_t kDefaultColor = 256;
+
+  struct Cell {
+    char glyph_;
+    // xterm 256 color palette indices, or kDefaultColor
+    uint16_t foreground_;
+    uint16_t background_;
+
+    bool operator==(const Cell& other) const {
+      return glyph_ == other.glyph_ && foreground_ == other.foreground_
+          && background_ == other.background_;
+    }
+
+    bool operator!=(const Cell& other) const {
+      return !(*this == other);
+    }
+  };
+
+ private:
+  int width_;
+  int height_;
+  // what is being drawn
+  std::vector<Cell> back_cells_;
+  // what the terminal shows
+  std::vector<Cell> front_cells_;
+  // the screen is cleared and fully redrawn on the next flush
+  bool is_invalid_;
+  // colors the terminal is set to after the last flush, kept so the next
+  // flush doesn't have to repeat them
+  uint16_t current_foreground_;
+  uint16_t current_background_;
+
+  /**
+   * Appends the escape code that selects the given colors, leaving out
+   * the ones the terminal already has
+   * @param cell cell whose colors to select
+   * @param output where to append
+   */
+  void AppendColors(const Cell& cell, std::string* output);
+
+ public:
+  TerminalCanvas();
+
+  /**
+   * Changes the size of the canvas, blanking it and redrawing the whole
+   * screen on the next flush
+   * @param width columns
+   * @param height rows
+   */
+  void Resize(int width, int height);
+
+  /**
+   * Makes the next flush clear the screen and redraw every cell, for when
+   * something else has written to the terminal
+   */
+  void Invalidate();
+
+  /**
+   * Sets every cell to a blank of the given background
+   * @param background palette index or kDefaultColor
+   */
+  void Clear(uint16_t background = kDefaultColor);
+
+  /**
+   * Sets a cell, ignoring cells outside the canvas
+   * @param col column
+   * @param row row, from the top
+   * @param glyph printable ASCII character
+   * @param foreground palette index or kDefaultColor
+   * @param background palette index or kDefaultColor
+   */
+  void SetCell(int col, int row, char glyph, uint16_t foreground,
+      uint16_t background);
+
+  /**
+   * Writes text along a row, clipped to the canvas
+   * @param col column of the first character
+   * @param row row, from the top
+   * @param text printable ASCII text
+   * @param foreground palette index or kDefaultColor
+   * @param background palette index or kDefaultColor
+   */
+  void DrawText(int col, int row, const std::string& text,
+      uint16_t foreground = kDefaultColor,
+      uint16_t background = kDefaultColor);
+
+  /**
+   * Builds the escape codes that bring the terminal up to date with what
+   * was drawn, and treats them as written
+   * @return bytes to write to the terminal, empty if nothing changed
+   */
+  std::string Flush();
+
+  /**
+   * Finds the closest color of the 6x6x6 color cube of the 256 color
+   * palette
+   * @param red red from 0 to 1
+   * @param green green from 0 to 1
+   * @param blue blue from 0 to 1
+   * @return palette index
+   */
+  static uint16_t GetColorIndex(float red, float green, float blue);
+
+  const Cell& GetCell(int col, int row) const {
+    return back_cells_[static_cast<size_t>(row) * width_ + col];
+  }
+
+  int GetWidth() const {
+    return width_;
+  }
+
+  int GetHeight() const {
+    return height_;
+  }
+};
+
+} // namespace tetris
+
+#endif  // FINALPROJECT_TERMINAL_CANVAS_H
@@ -0,0 +1,126 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#ifndef FINALPROJECT_MATCH_SERVER_H
+#define FINALPROJECT_MATCH_SERVER_H
+
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "server/work_stealing_pool.h"
+#include "stream/spectator_publisher.h"
+#include "stream/spectator_stream.h"
+#include "tetris_engine.h"
+
+namespace tetris {
+
+/**
+ * Hosts a battle royale match of many worlds in one process. Every tick
+ * steps all worlds in parallel, then sends the garbage from cleared rows
+ * to opponents once every world has finished the tick.
+ */
+class MatchServer {
+ public:
+  /**
+   * Summary of the measured tick times, in microseconds
+   */
+  struct TickStatistics {
+    size_t num_ticks_;
+    size_t num_missed_deadlines_;
+    double mean_;
+    double p50_;
+    double p90_;
+    double p99_;
+    double max_;
+  };
+
+  // garbage rows sent for clearing 0, 1, 2, 3 and 4 rows at once
+  constexpr static const size_t kGarbageForRowsCleared[] = {0, 0, 1, 2, 4};
+  constexpr static const size_t kMaxRowsClearedAtOnce = 4;
+
+ private:
+  std::vector<std::unique_ptr<TetrisEngine>> engines_;
+  // garbage rows waiting to be added to each world at the next tick boundary
+  std::vector<size_t> incoming_garbage_;
+  WorkStealingPool pool_;
+  // picks the opponent that receives garbage
+  std::mt19937 target_random_;
+  // time taken by every tick, in microseconds
+  std::vector<double> tick_durations_;
+  size_t num_missed_deadlines_;
+  // one per world once spectators are enabled
+  std::vector<std::unique_ptr<SpectatorPublisher>> spectator_publishers_;
+  std::vector<std::unique_ptr<SpectatorEncoder>> spectator_encoders_;
+
+  /**
+   * Sends garbage for rows cleared during the last tick to a random
+   * opponent that is still playing, then adds incoming garbage
+   */
+  void RouteGarbage();
+
+ public:
+  /**
+   * Creates a match with every world already started in the given mode
+   * @param num_worlds number of worlds in the match
+   * @param num_threads number of threads stepping the worlds
+   * @param game_state mode every world plays in
+   */
+  MatchServer(size_t num_worlds, size_t num_threads,
+      World::GameState game_state);
+
+  /**
+   * Publishes every world to its own spectator socket, named
+   * world_<index>.sock inside the directory
+   * @param directory existing directory for the sockets
+   * @return false if a socket could not be created
+   */
+  bool EnableSpectators(const std::string& directory);
+
+  /**
+   * Steps every world once and routes garbage at the end of the tick
+   */
+  void Tick();
+
+  /**
+   * Runs ticks at a fixed rate, counting ticks that finish after their
+   * deadline. A late tick does not make the following ticks run early.
+   * @param num_ticks number of ticks to run
+   * @param tick_rate ticks per second
+   */
+  void Run(size_t num_ticks, double tick_rate);
+
+  /**
+   * Gets the tick time percentiles measured so far
+   * @return tick statistics
+   */
+  TickStatistics GetTickStatistics() const;
+
+  /**
+   * Counts the worlds that have not reached the end screen
+   * @return number of worlds still playing
+   */
+  size_t GetNumAlive() const;
+
+  /**
+   * Gets the mean memory footprint of the hosted worlds
+   * @return approximate size in bytes
+   */
+  size_t GetMeanWorldMemoryFootprint() const;
+
+  size_t GetNumWorlds() const {
+    return engines_.size();
+  }
+
+  TetrisEngine& GetEngine(size_t index) {
+    return *engines_[index];
+  }
+
+  const TetrisEngine& GetEngine(size_t index) const {
+    return *engines_[index];
+  }
+};
+
+} // namespace tetris
+
+#endif  // FINALPROJECT_MATCH_SERVER_H
@@ -0,0 +1,116 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#ifndef FINALPROJECT_WORK_STEALING_POOL_H
+#define FINALPROJECT_WORK_STEALING_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace tetris {
+
+/**
+ * Runs tasks on a fixed set of threads. Every thread owns a queue of tasks,
+ * and a thread that runs out of work steals from the front of another
+ * thread's queue, so uneven tasks still keep every core busy.
+ */
+class WorkStealingPool {
+ public:
+  using Task = std::function<void()>;
+
+ private:
+  /**
+   * Holds the tasks waiting to be run by a single worker thread
+   */
+  struct TaskQueue {
+    std::mutex mutex_;
+    std::deque<Task> tasks_;
+  };
+
+  std::vector<std::unique_ptr<TaskQueue>> queues_;
+  std::vector<std::thread> workers_;
+  // tasks submitted but not yet finished
+  std::atomic<size_t> num_pending_;
+  // tasks submitted but not yet taken from a queue
+  std::atomic<size_t> num_queued_;
+  // queue used by the next task submitted from outside the pool
+  std::atomic<size_t> next_queue_;
+  std::mutex wake_mutex_;
+  std::condition_variable wake_condition_;
+  std::condition_variable idle_condition_;
+  bool is_stopping_;
+
+  /**
+   * Takes the newest task from the back of a worker's own queue
+   * @param queue_index index of the worker's queue
+   * @param task set to the task taken
+   * @return true if a task was taken
+   */
+  bool TryPopTask(size_t queue_index, Task* task);
+
+  /**
+   * Takes the oldest task from the front of another worker's queue
+   * @param thief_index index of the stealing worker, or the number of
+   * queues when the caller is not a worker
+   * @param task set to the task taken
+   * @return true if a task was taken
+   */
+  bool TryStealTask(size_t thief_index, Task* task);
+
+  /**
+   * Runs a task and wakes up waiting callers if it was the last one
+   * @param task task to run
+   */
+  void RunTask(Task& task);
+
+  /**
+   * Main loop of a single worker thread
+   * @param index index of the worker
+   */
+  void WorkerLoop(size_t index);
+
+ public:
+  /**
+   * Starts the worker threads
+   * @param num_threads number of threads, at least one is always started
+   */
+  explicit WorkStealingPool(
+      size_t num_threads = std::thread::hardware_concurrency());
+
+  ~WorkStealingPool();
+
+  WorkStealingPool(const WorkStealingPool&) = delete;
+  WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+  /**
+   * Queues a task. Tasks submitted from a worker go to that worker's queue.
+   * @param task task to run
+   */
+  void Submit(Task task);
+
+  /**
+   * Blocks until every submitted task has finished, running queued tasks
+   * on the calling thread in the meantime. Must not be called from a task.
+   */
+  void Wait();
+
+  /**
+   * Runs the body once for every index and waits for all of them
+   * @param count number of indices
+   * @param body function called with each index in [0, count)
+   */
+  void ParallelFor(size_t count, const std::function<void(size_t)>& body);
+
+  size_t GetNumThreads() const {
+    return workers_.size();
+  }
+};
+
+} // namespace tetris
+
+#endif  // FINALPROJECT_WORK_STEALING_POOL_H
@@ -0,0 +1,87 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#ifndef FINALPROJECT_SPECTATOR_PUBLISHER_H
+#define FINALPROJECT_SPECTATOR_PUBLISHER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "stream/spectator_stream.h"
+
+namespace tetris {
+
+/**
+ * Sends spectator frames to viewers connected to a Unix domain socket, or
+ * to pipes added directly. Writes never block the game: bytes a viewer
+ * can't take yet are buffered, and a viewer that falls too far behind is
+ * disconnected. Viewers only get deltas after they have had a keyframe.
+ */
+class SpectatorPublisher : public SpectatorFrameSink {
+ public:
+  // bytes buffered for a slow viewer before it is disconnected
+  static const size_t kMaxBufferedBytes = 1 << 18;
+
+ private:
+  /**
+   * A connected viewer
+   */
+  struct Client {
+    int fd_;
+    bool is_socket_;
+    bool is_waiting_for_keyframe_;
+    // bytes not yet taken by the viewer
+    std::vector<uint8_t> pending_;
+  };
+
+  int listen_fd_;
+  std::string socket_path_;
+  std::vector<Client> clients_;
+
+  /**
+   * Accepts viewers waiting on the listening socket
+   */
+  void AcceptClients();
+
+  /**
+   * Writes as many pending bytes as the viewer takes without blocking
+   * @param client the viewer
+   * @return false if the viewer disconnected
+   */
+  static bool FlushClient(Client* client);
+
+ public:
+  SpectatorPublisher();
+
+  ~SpectatorPublisher() override;
+
+  SpectatorPublisher(const SpectatorPublisher&) = delete;
+  SpectatorPublisher& operator=(const SpectatorPublisher&) = delete;
+
+  /**
+   * Starts listening for viewers, replacing any file at the path
+   * @param socket_path path of the Unix domain socket
+   * @return false if the socket could not be created
+   */
+  bool Listen(const std::string& socket_path);
+
+  /**
+   * Adds a viewer that reads from an already open file descriptor, such
+   * as the write end of a pipe. The publisher closes it when done.
+   * @param fd file descriptor to write frames to
+   */
+  void AddClient(int fd);
+
+  bool NeedsKeyframe() override;
+
+  void WriteFrame(const std::vector<uint8_t>& frame,
+      bool is_keyframe) override;
+
+  size_t GetNumClients() const {
+    return clients_.size();
+  }
+};
+
+} // namespace tetris
+
+#endif  // FINALPROJECT_SPECTATOR_PUBLISHER_H
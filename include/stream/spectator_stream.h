@@ -0,0 +1,275 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#ifndef FINALPROJECT_SPECTATOR_STREAM_H
+#define FINALPROJECT_SPECTATOR_STREAM_H
+
+#include <cstdint>
+#include <vector>
+
+#include "physics/world.h"
+#include "physics/world_listener.h"
+
+namespace tetris {
+
+/**
+ * Spectator stream frames. Every frame starts with a 10 byte header:
+ * magic byte, frame type, tick (u32) and payload size (u32), all little
+ * endian. A keyframe holds the whole board so a viewer can join at any
+ * time; a delta only holds what changed during one tick.
+ */
+namespace spectator {
+
+constexpr const uint8_t kFrameMagic = 'T';
+constexpr const size_t kFrameHeaderSize = 10;
+
+enum FrameType : uint8_t {
+  kKeyframe,
+  kDelta
+};
+
+// delta flags, saying which sections follow in the payload
+enum DeltaFlag : uint8_t {
+  kPieceSpawned = 1 << 0,
+  kPieceMoved = 1 << 1,
+  kPieceRemoved = 1 << 2,
+  kScoreChanged = 1 << 3,
+  kGameStateChanged = 1 << 4,
+  kBoardChanged = 1 << 5
+};
+
+// board events in the order the world reported them
+enum BoardEvent : uint8_t {
+  kTileLocked,
+  kTileCleared,
+  kRowCleared,
+  kGarbageAdded
+};
+
+}  // namespace spectator
+
+/**
+ * Receives encoded spectator frames
+ */
+class SpectatorFrameSink {
+ public:
+  virtual ~SpectatorFrameSink() = default;
+
+  /**
+   * Asked before every frame is encoded
+   * @return true if the next frame must be a keyframe
+   */
+  virtual bool NeedsKeyframe() = 0;
+
+  /**
+   * Receives an encoded frame
+   * @param frame header and payload
+   * @param is_keyframe true if the frame holds the whole board
+   */
+  virtual void WriteFrame(const std::vector<uint8_t>& frame,
+      bool is_keyframe) = 0;
+};
+
+/**
+ * Listens to a world and writes one frame per tick to a sink
+ */
+class SpectatorEncoder : public WorldListener {
+ public:
+  static const size_t kDefaultKeyframeInterval = 300;
+
+ private:
+  SpectatorFrameSink* sink_;
+  size_t keyframe_interval_;
+  size_t ticks_since_keyframe_;
+  // encoded board events collected during the current tick
+  std::vector<uint8_t> board_events_;
+  uint16_t num_board_events_;
+  // reused between frames so encoding does not allocate once warmed up
+  std::vector<uint8_t> frame_;
+  bool is_piece_spawned_;
+  // last values sent, so unchanged values are skipped
+  bool has_sent_piece_;
+  int16_t sent_piece_x_;
+  int16_t sent_piece_y_;
+  int16_t sent_piece_angle_;
+  size_t sent_score_;
+  uint8_t sent_game_state_;
+
+  /**
+   * Writes the header, payload size is filled in by FinishFrame
+   * @param type frame type
+   * @param tick world tick
+   */
+  void BeginFrame(spectator::FrameType type, size_t tick);
+
+  /**
+   * Fills in the payload size of the frame being written
+   */
+  void FinishFrame();
+
+  /**
+   * Appends the moving block's shape and color
+   * @param block the moving block
+   */
+  void WritePieceShape(const Block& block);
+
+  /**
+   * Appends the moving block's position and angle, remembering them
+   * @param block the moving block
+   */
+  void WritePieceTransform(const Block& block);
+
+  void EncodeKeyframe(const World& world);
+
+  void EncodeDelta(const World& world);
+
+ public:
+  /**
+   * @param sink receives every frame, must outlive the encoder
+   * @param keyframe_interval ticks between keyframes
+   */
+  explicit SpectatorEncoder(SpectatorFrameSink* sink,
+      size_t keyframe_interval = kDefaultKeyframeInterval);
+
+  void OnBlockSpawned(const World& world, const Block& block) override;
+
+  void OnBlockLocked(const World& world, const Block& block,
+      const std::vector<TilePosition>& tiles) override;
+
+  void OnRowCleared(const World& world, size_t row) override;
+
+  void OnBombExploded(const World& world,
+      const TilePosition& center) override;
+
+  void OnGarbageRowsAdded(const World& world, size_t num_rows,
+      size_t open_col, const cinder::Color& color) override;
+
+  void OnStepFinished(const World& world) override;
+};
+
+/**
+ * Rebuilds a world's board from spectator frames
+ */
+class BoardMirror {
+ public:
+  /**
+   * A tile of the mirrored board
+   */
+  struct Tile {
+    bool is_filled_;
+    uint8_t r_;
+    uint8_t g_;
+    uint8_t b_;
+  };
+
+  /**
+   * Offset of a single tile of the moving block from the block's position
+   */
+  struct PieceTile {
+    int8_t x_;
+    int8_t y_;
+  };
+
+ private:
+  bool has_keyframe_;
+  size_t tick_;
+  size_t num_rows_;
+  size_t num_cols_;
+  size_t score_;
+  World::GameState game_state_;
+  // row major, row 0 is the bottom of the board
+  std::vector<Tile> tiles_;
+  bool has_piece_;
+  std::vector<PieceTile> piece_tiles_;
+  Tile piece_color_;
+  // block position in tiles and angle in radians
+  float piece_x_;
+  float piece_y_;
+  float piece_angle_;
+
+  void RemoveRow(size_t row);
+
+ public:
+  BoardMirror();
+
+  /**
+   * Applies a single frame. Deltas that arrive before the first keyframe
+   * are skipped.
+   * @param frame header and payload of one frame
+   * @param size size of the frame
+   * @return false if the frame is malformed
+   */
+  bool ApplyFrame(const uint8_t* frame, size_t size);
+
+  /**
+   * Gets the board positions covered by the moving block
+   * @return positions of the block's tiles, may be off the board
+   */
+  std::vector<std::pair<int, int>> GetPieceTilePositions() const;
+
+  bool HasKeyframe() const {
+    return has_keyframe_;
+  }
+
+  size_t GetTick() const {
+    return tick_;
+  }
+
+  size_t GetNumRows() const {
+    return num_rows_;
+  }
+
+  size_t GetNumCols() const {
+    return num_cols_;
+  }
+
+  size_t GetScore() const {
+    return score_;
+  }
+
+  World::GameState GetGameState() const {
+    return game_state_;
+  }
+
+  const Tile& GetTile(size_t row, size_t col) const {
+    return tiles_[row * num_cols_ + col];
+  }
+
+  bool HasPiece() const {
+    return has_piece_;
+  }
+
+  const Tile& GetPieceColor() const {
+    return piece_color_;
+  }
+};
+
+/**
+ * Splits a byte stream into whole spectator frames
+ */
+class SpectatorFrameReader {
+ private:
+  std::vector<uint8_t> buffer_;
+  size_t read_offset_;
+
+ public:
+  SpectatorFrameReader();
+
+  /**
+   * Adds bytes read from the stream
+   * @param data bytes read
+   * @param size number of bytes
+   */
+  void Append(const uint8_t* data, size_t size);
+
+  /**
+   * Takes the next whole frame from the buffered bytes
+   * @param frame set to the frame's header and payload
+   * @return false if no whole frame is buffered yet, or the stream is
+   * corrupt
+   */
+  bool NextFrame(std::vector<uint8_t>* frame);
+};
+
+} // namespace tetris
+
+#endif  // FINALPROJECT_SPECTATOR_STREAM_H
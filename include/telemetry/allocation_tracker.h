@@ -0,0 +1,156 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#ifndef FINALPROJECT_ALLOCATION_TRACKER_H
+#define FINALPROJECT_ALLOCATION_TRACKER_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace tetris {
+
+/**
+ * Heap allocations made by one subsystem, counted since the program
+ * started or over some span of time
+ */
+struct AllocationCounts {
+  uint64_t num_allocations_ = 0;
+  uint64_t num_frees_ = 0;
+  uint64_t bytes_allocated_ = 0;
+  uint64_t bytes_freed_ = 0;
+
+  AllocationCounts& operator+=(const AllocationCounts& other);
+  AllocationCounts operator-(const AllocationCounts& other) const;
+
+  /**
+   * Gets the number of allocations not freed yet
+   * @return allocations minus frees, negative if more was freed than
+   * allocated over the span counted
+   */
+  int64_t GetNumLive() const {
+    return static_cast<int64_t>(num_allocations_ - num_frees_);
+  }
+
+  int64_t GetLiveBytes() const {
+    return static_cast<int64_t>(bytes_allocated_ - bytes_freed_);
+  }
+};
+
+/**
+ * Counts every heap allocation of the process by the subsystem that made
+ * it. Global operator new and delete are replaced to do the counting, and
+ * Box2D's b2Alloc and b2Free are wrapped at link time where the linker
+ * supports it. Each thread charges its allocations to the subsystem of its
+ * innermost AllocationScope; memory is credited back to the subsystem that
+ * allocated it no matter where it is freed. Builds with
+ * TETRIS_TRACK_ALLOCATIONS off replace nothing and count nothing.
+ */
+class AllocationTracker {
+ public:
+  enum Subsystem : uint8_t {
+    // anything outside a scope, such as Cinder and the standard library
+    kOther,
+    // game rules, blocks, the board and listeners
+    kEngine,
+    // Box2D and the bodies the engine creates in it
+    kPhysics,
+    // textures and other temporaries made while drawing a frame
+    kRenderer,
+    kNumSubsystems
+  };
+
+  /**
+   * Gets the counts of a subsystem since the program started
+   * @param subsystem the subsystem
+   * @return the counts
+   */
+  static AllocationCounts GetCounts(Subsystem subsystem);
+
+  /**
+   * Gets the counts of every subsystem added together
+   * @return the counts
+   */
+  static AllocationCounts GetTotalCounts();
+
+  static Subsystem GetCurrentSubsystem();
+
+  static const char* GetSubsystemName(Subsystem subsystem);
+
+  /**
+   * Tells if allocations are counted in this build, which is left out
+   * when built with TETRIS_TRACK_ALLOCATIONS off
+   * @return true if operator new and delete were replaced
+   */
+  static bool IsTracked();
+
+  /**
+   * Tells if Box2D's own allocations are counted in this build
+   * @return true if b2Alloc and b2Free were wrapped at link time
+   */
+  static bool IsBox2DTracked();
+
+ private:
+  friend class AllocationScope;
+
+  static void SetCurrentSubsystem(Subsystem subsystem);
+};
+
+/**
+ * Charges the allocations of the current thread to a subsystem for as long
+ * as it is alive, restoring the enclosing subsystem when it goes away
+ */
+class AllocationScope {
+ private:
+  AllocationTracker::Subsystem previous_subsystem_;
+
+ public:
+  explicit AllocationScope(AllocationTracker::Subsystem subsystem);
+  ~AllocationScope();
+
+  AllocationScope(const AllocationScope&) = delete;
+  AllocationScope& operator=(const AllocationScope&) = delete;
+};
+
+/**
+ * Measures the allocations made between two points in time, such as over
+ * one frame or one world step
+ */
+class AllocationSampler {
+ private:
+  std::array<AllocationCounts, AllocationTracker::kNumSubsystems> start_;
+  std::array<AllocationCounts, AllocationTracker::kNumSubsystems> delta_;
+
+ public:
+  AllocationSampler();
+
+  /**
+   * Starts measuring from now
+   */
+  void Restart();
+
+  /**
+   * Stores the allocations made since the last Restart or Sample, then
+   * starts measuring again from now
+   */
+  void Sample();
+
+  /**
+   * Gets the allocations of a subsystem over the last sample
+   * @param subsystem the subsystem
+   * @return the counts
+   */
+  const AllocationCounts& GetDelta(
+      AllocationTracker::Subsystem subsystem) const {
+    return delta_[subsystem];
+  }
+
+  /**
+   * Gets the allocations of every subsystem over the last sample
+   * @return the counts added together
+   */
+  AllocationCounts GetTotalDelta() const;
+};
+
+} // namespace tetris
+
+#endif  // FINALPROJECT_ALLOCATION_TRACKER_H
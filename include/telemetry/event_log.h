@@ -0,0 +1,179 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#ifndef FINALPROJECT_EVENT_LOG_H
+#define FINALPROJECT_EVENT_LOG_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <thread>
+
+#include "physics/world_listener.h"
+#include "telemetry/spsc_ring_buffer.h"
+
+namespace tetris {
+
+/**
+ * Start of every log file, so old or foreign files are not misread
+ */
+struct TelemetryLogHeader {
+  char magic_[4];
+  uint32_t version_;
+  uint32_t record_size_;
+  uint32_t reserved_;
+};
+
+/**
+ * A single gameplay event as stored in the log. Records are written in
+ * the host's byte order, one after another after the file header.
+ */
+struct TelemetryEvent {
+  enum Type : uint8_t {
+    kBlockSpawned,
+    kBlockLocked,
+    kRowCleared,
+    kBombExploded,
+    kGameOver
+  };
+
+  static const size_t kMaxTiles = 8;
+  // ticks since spawn of a lock whose block's spawn wasn't seen
+  static const uint32_t kUnknownTicks = UINT32_MAX;
+
+  // nanoseconds on the steady clock
+  uint64_t timestamp_;
+  uint32_t tick_;
+  // score for game over, cleared row for row clears
+  uint32_t value_;
+  // kUnknownTicks for settled debris, see EventLogWriter::OnBlockLocked
+  uint32_t ticks_since_spawn_;
+  uint8_t type_;
+  uint8_t template_id_;
+  uint8_t num_tiles_;
+  uint8_t padding_;
+  // row then column of every locked tile, or the bomb's center
+  uint8_t tiles_[kMaxTiles][2];
+};
+
+static_assert(sizeof(TelemetryEvent) == 40, "log records must stay 40 bytes");
+
+/**
+ * Writes gameplay events of a world to an append-only binary log. The game
+ * thread only copies events into a lock-free buffer; a background thread
+ * writes them out in batches and syncs the file to disk now and then. If
+ * the writer falls behind, events are dropped and counted instead of
+ * blocking the game.
+ */
+class EventLogWriter : public WorldListener {
+ public:
+  static const size_t kBufferCapacity = 1 << 14;
+  // the background writer checks for events this often
+  static const int kWriteIntervalMs = 5;
+  // and syncs the file to disk at least this often
+  static const int kSyncIntervalMs = 500;
+
+ private:
+  SpscRingBuffer<TelemetryEvent, kBufferCapacity> buffer_;
+  // only touched by the writer thread once it has started
+  std::unique_ptr<FILE, int (*)(FILE*)> file_;
+  std::thread writer_thread_;
+  std::atomic<bool> is_stopping_;
+  std::atomic<size_t> num_dropped_;
+  std::atomic<size_t> num_written_;
+  size_t spawn_tick_;
+
+  /**
+   * Adds an event to the buffer, stamping the time and tick
+   * @param world the world the event happened in
+   * @param event the event
+   */
+  void Record(const World& world, TelemetryEvent& event);
+
+  /**
+   * Drains the buffer to the file until the writer stops
+   */
+  void WriterLoop();
+
+ public:
+  EventLogWriter();
+
+  /**
+   * Stops the writer thread after writing every buffered event
+   */
+  ~EventLogWriter() override;
+
+  EventLogWriter(const EventLogWriter&) = delete;
+  EventLogWriter& operator=(const EventLogWriter&) = delete;
+
+  /**
+   * Opens or creates the log and starts the writer thread
+   * @param path path of the log file, appended to if it exists
+   * @return false if the file could not be opened
+   */
+  bool Open(const std::string& path);
+
+  size_t GetNumDropped() const {
+    return num_dropped_;
+  }
+
+  size_t GetNumWritten() const {
+    return num_written_;
+  }
+
+  void OnBlockSpawned(const World& world, const Block& block) override;
+
+  void OnBlockLocked(const World& world, const Block& block,
+      const std::vector<TilePosition>& tiles) override;
+
+  void OnRowCleared(const World& world, size_t row) override;
+
+  void OnBombExploded(const World& world,
+      const TilePosition& center) override;
+
+  void OnGameOver(const World& world) override;
+};
+
+/**
+ * Reads events back from a log written by EventLogWriter
+ */
+class EventLogReader {
+ private:
+  std::unique_ptr<FILE, int (*)(FILE*)> file_;
+
+ public:
+  EventLogReader();
+
+  /**
+   * Opens a log and checks its header
+   * @param path path of the log file
+   * @return false if the file is missing or is not an event log
+   */
+  bool Open(const std::string& path);
+
+  /**
+   * Reads the next event
+   * @param event set to the event read
+   * @return false at the end of the log
+   */
+  bool Next(TelemetryEvent* event);
+};
+
+/**
+ * Writes the column names of WriteEventCsvRow
+ * @param output stream to write to
+ */
+void WriteEventCsvHeader(std::ostream& output);
+
+/**
+ * Writes an event as one CSV row, tiles as "row:col" separated by spaces
+ * @param output stream to write to
+ * @param event the event
+ */
+void WriteEventCsvRow(std::ostream& output, const TelemetryEvent& event);
+
+} // namespace tetris
+
+#endif  // FINALPROJECT_EVENT_LOG_H
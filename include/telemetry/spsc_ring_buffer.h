@@ -0,0 +1,86 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#ifndef FINALPROJECT_SPSC_RING_BUFFER_H
+#define FINALPROJECT_SPSC_RING_BUFFER_H
+
+#include <atomic>
+#include <cstddef>
+
+namespace tetris {
+
+/**
+ * Fixed size queue for exactly one producer thread and one consumer
+ * thread. Neither side ever locks or blocks; pushing to a full buffer
+ * fails instead.
+ * @tparam T trivially copyable element type
+ * @tparam kCapacity number of slots, must be a power of two
+ */
+template <typename T, size_t kCapacity>
+class SpscRingBuffer {
+  static_assert((kCapacity & (kCapacity - 1)) == 0,
+      "capacity must be a power of two");
+
+ private:
+  static const size_t kCacheLineSize = 64;
+
+  // padded onto separate cache lines so the two threads don't share one,
+  // without alignas which plain operator new can't honor before C++17
+  char front_padding_[kCacheLineSize];
+  std::atomic<size_t> head_;
+  char middle_padding_[kCacheLineSize - sizeof(std::atomic<size_t>)];
+  std::atomic<size_t> tail_;
+  char back_padding_[kCacheLineSize - sizeof(std::atomic<size_t>)];
+  T slots_[kCapacity];
+
+ public:
+  SpscRingBuffer() : head_(0), tail_(0) {}
+
+  /**
+   * Adds an element, called only by the producer
+   * @param value element to add
+   * @return false if the buffer is full
+   */
+  bool TryPush(const T& value) {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) == kCapacity) {
+      return false;
+    }
+
+    slots_[tail & (kCapacity - 1)] = value;
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * Removes the oldest element, called only by the consumer
+   * @param value set to the removed element
+   * @return false if the buffer is empty
+   */
+  bool TryPop(T* value) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) {
+      return false;
+    }
+
+    *value = slots_[head & (kCapacity - 1)];
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * Counts elements waiting, exact only when both threads are idle
+   * @return number of elements
+   */
+  size_t GetSize() const {
+    return tail_.load(std::memory_order_acquire)
+        - head_.load(std::memory_order_acquire);
+  }
+
+  static constexpr size_t GetCapacity() {
+    return kCapacity;
+  }
+};
+
+} // namespace tetris
+
+#endif  // FINALPROJECT_SPSC_RING_BUFFER_H
@@ -0,0 +1,62 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#ifndef FINALPROJECT_TIMING_HISTORY_H
+#define FINALPROJECT_TIMING_HISTORY_H
+
+#include <array>
+#include <cstddef>
+
+namespace tetris {
+
+/**
+ * The last few seconds of a time measured once a frame, kept in a fixed
+ * ring so adding a sample never allocates
+ */
+class TimingHistory {
+ public:
+  // four seconds at 60 frames a second
+  static const size_t kMaxSamples = 240;
+
+ private:
+  std::array<float, kMaxSamples> samples_ms_;
+  // where the next sample goes
+  size_t next_index_;
+  size_t num_samples_;
+
+ public:
+  TimingHistory();
+
+  /**
+   * Adds a sample, replacing the oldest one once the history is full
+   * @param sample_ms the time in milliseconds
+   */
+  void Add(float sample_ms);
+
+  /**
+   * Gets a sample by how long ago it was added
+   * @param age 0 for the newest sample, less than GetNumSamples
+   * @return the time in milliseconds
+   */
+  float Get(size_t age) const {
+    return samples_ms_[(next_index_ + kMaxSamples - 1 - age) % kMaxSamples];
+  }
+
+  size_t GetNumSamples() const {
+    return num_samples_;
+  }
+
+  float GetMean() const;
+
+  float GetMax() const;
+
+  /**
+   * Gets how much the samples vary, which for the time between frames is
+   * how unevenly they are paced
+   * @return standard deviation in milliseconds
+   */
+  float GetStandardDeviation() const;
+};
+
+} // namespace tetris
+
+#endif  // FINALPROJECT_TIMING_HISTORY_H
@@ -0,0 +1,114 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#ifndef FINALPROJECT_TRACE_H
+#define FINALPROJECT_TRACE_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace tetris {
+
+/**
+ * A finished span as read back from the trace buffers
+ */
+struct TraceRecord {
+  // a string literal naming what ran
+  const char* name_;
+  // nanoseconds on the steady clock
+  uint64_t start_ns_;
+  uint64_t duration_ns_;
+  // small number given to each thread the first time it records
+  uint32_t thread_id_;
+};
+
+/**
+ * Records timed spans of work on any thread so a stutter can be looked at
+ * on a timeline afterwards. Every thread writes into its own fixed size
+ * ring, overwriting its oldest spans, without locks or allocation; only
+ * the first span of a thread takes a lock to register its ring. The rings
+ * are dumped on demand as Chrome trace-event JSON, which Perfetto and
+ * chrome://tracing open.
+ */
+class Tracer {
+ public:
+  // spans kept per thread, about ten seconds of a 60 Hz game
+  static const size_t kBufferCapacity = 1 << 14;
+
+  /**
+   * Turns recording on or off for every thread, off at start
+   * @param is_enabled true to record spans
+   */
+  static void SetEnabled(bool is_enabled);
+
+  static bool IsEnabled();
+
+  /**
+   * Names the calling thread in the dumped trace
+   * @param name thread name, copied
+   */
+  static void SetThreadName(const std::string& name);
+
+  /**
+   * Records a finished span on the calling thread, if recording is on
+   * @param name a string literal, stored by pointer
+   * @param start when the span started
+   * @param end when the span ended
+   */
+  static void Record(const char* name,
+      std::chrono::steady_clock::time_point start,
+      std::chrono::steady_clock::time_point end);
+
+  /**
+   * Copies the spans still in every thread's ring, oldest first per
+   * thread. Threads may keep recording while this runs; spans they
+   * overwrite in the meantime are left out.
+   * @return the spans
+   */
+  static std::vector<TraceRecord> Collect();
+
+  /**
+   * Writes every collected span as Chrome trace-event JSON
+   * @param path file to write
+   * @return false if the file could not be written
+   */
+  static bool WriteChromeTrace(const std::string& path);
+};
+
+/**
+ * Records the time from its creation to its destruction as a span
+ */
+class TraceSpan {
+ private:
+  const char* name_;
+  std::chrono::steady_clock::time_point start_;
+  // decided at the start, so a span that began before recording was
+  // turned on isn't read from an unset start time
+  bool is_recording_;
+
+ public:
+  /**
+   * Starts a span
+   * @param name a string literal naming the work
+   */
+  explicit TraceSpan(const char* name) : name_(name),
+      is_recording_(Tracer::IsEnabled()) {
+    if (is_recording_) {
+      start_ = std::chrono::steady_clock::now();
+    }
+  }
+
+  ~TraceSpan() {
+    if (is_recording_) {
+      Tracer::Record(name_, start_, std::chrono::steady_clock::now());
+    }
+  }
+
+  TraceSpan(const TraceSpan&) = delete;
+  TraceSpan& operator=(const TraceSpan&) = delete;
+};
+
+} // namespace tetris
+
+#endif  // FINALPROJECT_TRACE_H
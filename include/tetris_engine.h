@@ -2,6 +2,7 @@
 #ifndef TETRIS_H_
 #define TETRIS_H_
 
+#include <persistence/replay.h>
 #include <physics/world.h>
 
 namespace tetris {
@@ -10,17 +11,34 @@ class TetrisEngine {
 
  private:
   World world_;
+  // inputs of the game in progress
+  Replay replay_;
 
  public:
 
-  TetrisEngine();
+  /**
+   * Creates an engine with an empty world
+   * @param is_sound_enabled false to run without sound effects
+   */
+  explicit TetrisEngine(bool is_sound_enabled = true);
 
   /**
    * Moves/rotates the block in the direction given
    * @param move direction/rotation
+   * @return true if the block moved, false if the move was illegal
    */
-  void Move(Block::Move move) {
-    world_.Move(move);
+  bool Move(Block::Move move) {
+    bool is_playing = world_.GetCurrentGameState() == World::kClassic
+        || world_.GetCurrentGameState() == World::kReloaded;
+    size_t tick = world_.GetTickCount();
+    bool is_legal = world_.Move(move);
+
+    // illegal moves change nothing, so a replay can leave them out
+    if (is_playing && is_legal) {
+      replay_.AddInput(tick, move);
+    }
+
+    return is_legal;
   }
 
   World& GetWorld() {
@@ -35,10 +53,22 @@ class TetrisEngine {
     return world_.GetCurrentGameState();
   };
 
+  /**
+   * Sets the game state, starting a new replay when a game starts. Set the
+   * bomb and disconnected modes before starting the game.
+   * @param game_mode game state
+   */
   void SetCurrentGameState(World::GameState game_mode) {
     world_.SetCurrentGameState(game_mode);
+    if (game_mode == World::kClassic || game_mode == World::kReloaded) {
+      replay_.Start(world_);
+    }
   };
 
+  const Replay& GetReplay() const {
+    return replay_;
+  }
+
 };
 
 }  // namespace physics
@@ -0,0 +1,278 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#include "telemetry/allocation_tracker.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace tetris {
+
+namespace {
+
+/**
+ * Placed in front of every counted allocation, so a free knows how big the
+ * allocation was and which subsystem to credit. It keeps the memory after
+ * it as aligned as malloc's.
+ */
+struct alignas(alignof(std::max_align_t)) AllocationHeader {
+  size_t size_;
+  AllocationTracker::Subsystem subsystem_;
+};
+
+/**
+ * Running totals of one subsystem. Atomics with trivial constructors are
+ * zeroed before any static constructor runs, so allocations made during
+ * static initialization are counted too.
+ */
+struct SubsystemCounters {
+  std::atomic<uint64_t> num_allocations_;
+  std::atomic<uint64_t> num_frees_;
+  std::atomic<uint64_t> bytes_allocated_;
+  std::atomic<uint64_t> bytes_freed_;
+};
+
+SubsystemCounters counters[AllocationTracker::kNumSubsystems];
+thread_local AllocationTracker::Subsystem current_subsystem =
+    AllocationTracker::kOther;
+
+const char* const kSubsystemNames[AllocationTracker::kNumSubsystems] = {
+    "other", "engine", "physics", "renderer"};
+
+#ifdef TETRIS_TRACK_ALLOCATIONS
+/**
+ * Fills in the header of a new allocation and counts it
+ * @param block memory from the allocator, with room for the header
+ * @param size bytes asked for, not counting the header
+ * @param subsystem subsystem to charge
+ * @return memory after the header, nullptr if block is nullptr
+ */
+void* RecordAllocation(void* block, size_t size,
+    AllocationTracker::Subsystem subsystem) {
+  if (block == nullptr) {
+    return nullptr;
+  }
+
+  AllocationHeader* header = static_cast<AllocationHeader*>(block);
+  header->size_ = size;
+  header->subsystem_ = subsystem;
+  SubsystemCounters& counter = counters[subsystem];
+  counter.num_allocations_.fetch_add(1, std::memory_order_relaxed);
+  counter.bytes_allocated_.fetch_add(size, std::memory_order_relaxed);
+  return header + 1;
+}
+
+/**
+ * Counts the free of memory from RecordAllocation, crediting the
+ * subsystem that made it
+ * @param memory memory after the header, may be nullptr
+ * @return the block to give back to the allocator, nullptr if none
+ */
+void* ReleaseCounted(void* memory) {
+  if (memory == nullptr) {
+    return nullptr;
+  }
+
+  AllocationHeader* header = static_cast<AllocationHeader*>(memory) - 1;
+  SubsystemCounters& counter = counters[header->subsystem_];
+  counter.num_frees_.fetch_add(1, std::memory_order_relaxed);
+  counter.bytes_freed_.fetch_add(header->size_, std::memory_order_relaxed);
+  return header;
+}
+#endif
+
+} // namespace
+
+AllocationCounts& AllocationCounts::operator+=(const AllocationCounts& other) {
+  num_allocations_ += other.num_allocations_;
+  num_frees_ += other.num_frees_;
+  bytes_allocated_ += other.bytes_allocated_;
+  bytes_freed_ += other.bytes_freed_;
+  return *this;
+}
+
+AllocationCounts AllocationCounts::operator-(
+    const AllocationCounts& other) const {
+  AllocationCounts difference;
+  difference.num_allocations_ = num_allocations_ - other.num_allocations_;
+  difference.num_frees_ = num_frees_ - other.num_frees_;
+  difference.bytes_allocated_ = bytes_allocated_ - other.bytes_allocated_;
+  difference.bytes_freed_ = bytes_freed_ - other.bytes_freed_;
+  return difference;
+}
+
+AllocationCounts AllocationTracker::GetCounts(Subsystem subsystem) {
+  const SubsystemCounters& counter = counters[subsystem];
+  AllocationCounts counts;
+  counts.num_allocations_ =
+      counter.num_allocations_.load(std::memory_order_relaxed);
+  counts.num_frees_ = counter.num_frees_.load(std::memory_order_relaxed);
+  counts.bytes_allocated_ =
+      counter.bytes_allocated_.load(std::memory_order_relaxed);
+  counts.bytes_freed_ = counter.bytes_freed_.load(std::memory_order_relaxed);
+  return counts;
+}
+
+AllocationCounts AllocationTracker::GetTotalCounts() {
+  AllocationCounts total;
+  for (size_t subsystem = 0; subsystem < kNumSubsystems; subsystem++) {
+    total += GetCounts(static_cast<Subsystem>(subsystem));
+  }
+
+  return total;
+}
+
+AllocationTracker::Subsystem AllocationTracker::GetCurrentSubsystem() {
+  return current_subsystem;
+}
+
+void AllocationTracker::SetCurrentSubsystem(Subsystem subsystem) {
+  current_subsystem = subsystem;
+}
+
+const char* AllocationTracker::GetSubsystemName(Subsystem subsystem) {
+  return kSubsystemNames[subsystem];
+}
+
+bool AllocationTracker::IsTracked() {
+#ifdef TETRIS_TRACK_ALLOCATIONS
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool AllocationTracker::IsBox2DTracked() {
+#ifdef TETRIS_WRAP_BOX2D_ALLOC
+  return true;
+#else
+  return false;
+#endif
+}
+
+AllocationScope::AllocationScope(AllocationTracker::Subsystem subsystem) :
+    previous_subsystem_(AllocationTracker::GetCurrentSubsystem()) {
+  AllocationTracker::SetCurrentSubsystem(subsystem);
+}
+
+AllocationScope::~AllocationScope() {
+  AllocationTracker::SetCurrentSubsystem(previous_subsystem_);
+}
+
+AllocationSampler::AllocationSampler() {
+  Restart();
+}
+
+void AllocationSampler::Restart() {
+  for (size_t subsystem = 0; subsystem < AllocationTracker::kNumSubsystems;
+       subsystem++) {
+    start_[subsystem] = AllocationTracker::GetCounts(
+        static_cast<AllocationTracker::Subsystem>(subsystem));
+  }
+}
+
+void AllocationSampler::Sample() {
+  for (size_t subsystem = 0; subsystem < AllocationTracker::kNumSubsystems;
+       subsystem++) {
+    AllocationCounts now = AllocationTracker::GetCounts(
+        static_cast<AllocationTracker::Subsystem>(subsystem));
+    delta_[subsystem] = now - start_[subsystem];
+    start_[subsystem] = now;
+  }
+}
+
+AllocationCounts AllocationSampler::GetTotalDelta() const {
+  AllocationCounts total;
+  for (const AllocationCounts& delta : delta_) {
+    total += delta;
+  }
+
+  return total;
+}
+
+} // namespace tetris
+
+#ifdef TETRIS_TRACK_ALLOCATIONS
+using tetris::AllocationTracker;
+
+void* operator new(std::size_t size) {
+  void* memory;
+  while ((memory = tetris::RecordAllocation(
+      std::malloc(sizeof(tetris::AllocationHeader) + size), size,
+      AllocationTracker::GetCurrentSubsystem())) == nullptr) {
+    std::new_handler handler = std::get_new_handler();
+    if (handler == nullptr) {
+      throw std::bad_alloc();
+    }
+
+    handler();
+  }
+
+  return memory;
+}
+
+void* operator new[](std::size_t size) {
+  return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+  try {
+    return operator new(size);
+  } catch (const std::bad_alloc&) {
+    return nullptr;
+  }
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+  return operator new(size, std::nothrow);
+}
+
+void operator delete(void* memory) noexcept {
+  std::free(tetris::ReleaseCounted(memory));
+}
+
+void operator delete[](void* memory) noexcept {
+  operator delete(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+  operator delete(memory);
+}
+
+void operator delete[](void* memory, std::size_t) noexcept {
+  operator delete(memory);
+}
+
+void operator delete(void* memory, const std::nothrow_t&) noexcept {
+  operator delete(memory);
+}
+
+void operator delete[](void* memory, const std::nothrow_t&) noexcept {
+  operator delete(memory);
+}
+#endif
+
+#ifdef TETRIS_WRAP_BOX2D_ALLOC
+// Box2D 2.3 allocates with plain b2Alloc and b2Free functions that can't
+// be replaced, so the linker is told to send calls to them here instead,
+// and these reach the originals through their __real_ names. The names
+// are the mangled b2Alloc(int32) and b2Free(void*).
+extern "C" {
+
+void* __real__Z7b2Alloci(int32_t size);
+void __real__Z6b2FreePv(void* memory);
+
+void* __wrap__Z7b2Alloci(int32_t size) {
+  // Box2D's allocations are charged to physics whatever scope made them
+  size_t num_bytes = static_cast<size_t>(size);
+  return tetris::RecordAllocation(__real__Z7b2Alloci(
+      static_cast<int32_t>(sizeof(tetris::AllocationHeader) + num_bytes)),
+      num_bytes, AllocationTracker::kPhysics);
+}
+
+void __wrap__Z6b2FreePv(void* memory) {
+  __real__Z6b2FreePv(tetris::ReleaseCounted(memory));
+}
+
+}
+#endif
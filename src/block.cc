@@ -9,33 +9,30 @@
 
 namespace tetris {
 
-b2AABB Block::GetBlockBox(World* world) {
-  b2Fixture* fixture_list = body_->GetFixtureList();
+b2AABB Block::GetBlockBox(const World* world) const {
+  // the fixture boxes only change when the body's transform does
+  const b2Transform& transform = body_->GetTransform();
+  if (is_box_cached_ && std::memcmp(&transform, &cached_transform_,
+      sizeof(b2Transform)) == 0) {
+    return cached_box_;
+  }
+
   b2AABB body_aabb;
   // manually set constructor
   body_aabb.lowerBound.x = world->GetTotalNumCol();
   body_aabb.lowerBound.y = world->GetTotalNumRow();
   body_aabb.upperBound.x = 0.0;
   body_aabb.upperBound.y = 0.0;
-  for (b2Fixture* fixture = fixture_list; fixture != nullptr;
-      fixture = fixture->GetNext()) {
-    body_aabb.Combine(fixture->GetAABB(0));
+  for (const b2AABB& tile_box : GetBoundingBoxList()) {
+    body_aabb.Combine(tile_box);
   }
 
+  cached_box_ = body_aabb;
+  cached_transform_ = transform;
+  is_box_cached_ = true;
   return body_aabb;
 }
 
-const std::vector<b2AABB> Block::GetBoundingBoxList() const {
-  std::vector<b2AABB> bound_box_list;
-  b2Fixture* fixture_list = body_->GetFixtureList();
-  for (b2Fixture* fixture = fixture_list; fixture != nullptr;
-       fixture = fixture->GetNext()) {
-    bound_box_list.push_back(fixture->GetAABB(0));
-  }
-
-  return bound_box_list;
-}
-
 void Block::SetTileShapeAtColRow(b2PolygonShape* shape,
     double col, double row) {
   // smaller blocks for easier collision
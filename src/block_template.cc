@@ -0,0 +1,11 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#include "physics/block_template.h"
+
+namespace tetris {
+
+// the one copy of each table, see BlockTemplateTables
+constexpr BlockTemplate BlockTemplateTables::kClassic[];
+constexpr BlockTemplate BlockTemplateTables::kReloaded[];
+
+} // namespace tetris
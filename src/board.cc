@@ -0,0 +1,207 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#include "physics/board.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace tetris {
+
+const uint8_t Board::kEmptyColor;
+const uint8_t Board::kExplosionColor;
+const size_t Board::kMaxPaletteSize;
+
+/**
+ * Gets how far apart two colors are
+ * @param first a color
+ * @param second another color
+ * @return squared distance between the colors
+ */
+static float GetColorDistance(const cinder::Color& first,
+    const cinder::Color& second) {
+  float red = first.r - second.r;
+  float green = first.g - second.g;
+  float blue = first.b - second.b;
+  return red * red + green * green + blue * blue;
+}
+
+Board::Board() : num_rows_(0), num_cols_(0),
+    palette_{cinder::Color::black(), cinder::Color::white()} {}
+
+void Board::Reset(size_t num_rows, size_t num_cols) {
+  num_rows_ = num_rows;
+  num_cols_ = num_cols;
+  cells_.assign(num_rows * num_cols, kEmptyColor);
+  fixtures_.clear();
+  column_heights_.assign(num_cols, 0);
+  row_counts_.assign(num_rows, 0);
+}
+
+bool Board::Restore(size_t num_rows, size_t num_cols,
+    const std::vector<uint8_t>& cells,
+    const std::vector<cinder::Color>& palette) {
+  if (cells.size() != num_rows * num_cols || palette.size() <= kExplosionColor
+      || palette.size() > kMaxPaletteSize) {
+    return false;
+  }
+
+  for (uint8_t cell : cells) {
+    if (cell >= palette.size()) {
+      return false;
+    }
+  }
+
+  Reset(num_rows, num_cols);
+  cells_ = cells;
+  palette_ = palette;
+  for (size_t row = 0; row < num_rows; row++) {
+    for (size_t col = 0; col < num_cols; col++) {
+      if (IsFilled(row, col)) {
+        row_counts_[row]++;
+        column_heights_[col] = static_cast<uint16_t>(row + 1);
+      }
+    }
+  }
+
+  return true;
+}
+
+uint16_t Board::FindColumnHeight(size_t col, size_t below_row) const {
+  for (size_t row = below_row; row > 0; row--) {
+    if (IsFilled(row - 1, col)) {
+      return static_cast<uint16_t>(row);
+    }
+  }
+
+  return 0;
+}
+
+uint8_t Board::GetColorIndex(const cinder::Color& color) {
+  // tiles are filled with a handful of template colors, so a linear
+  // search over the palette is short; the reserved colors are skipped
+  // so a black or white tile still counts as filled
+  size_t closest_index = kExplosionColor + 1;
+  for (size_t index = kExplosionColor + 1; index < palette_.size(); index++) {
+    if (palette_[index] == color) {
+      return static_cast<uint8_t>(index);
+    }
+
+    if (GetColorDistance(palette_[index], color)
+        < GetColorDistance(palette_[closest_index], color)) {
+      closest_index = index;
+    }
+  }
+
+  if (palette_.size() < kMaxPaletteSize) {
+    palette_.push_back(color);
+    return static_cast<uint8_t>(palette_.size() - 1);
+  }
+
+  return static_cast<uint8_t>(closest_index);
+}
+
+void Board::FillTile(size_t row, size_t col, const cinder::Color& color) {
+  if (!IsFilled(row, col)) {
+    row_counts_[row]++;
+    if (row >= column_heights_[col]) {
+      column_heights_[col] = static_cast<uint16_t>(row + 1);
+    }
+  }
+
+  cells_[GetIndex(row, col)] = GetColorIndex(color);
+}
+
+void Board::ClearTile(size_t row, size_t col, bool is_exploded) {
+  bool was_filled = IsFilled(row, col);
+  cells_[GetIndex(row, col)] = is_exploded ? kExplosionColor : kEmptyColor;
+  if (!was_filled) {
+    return;
+  }
+
+  row_counts_[row]--;
+  // only clearing the top tile lowers the column
+  if (column_heights_[col] == row + 1) {
+    column_heights_[col] = FindColumnHeight(col, row);
+  }
+}
+
+void Board::RemoveRow(size_t row) {
+  uint8_t* removed = &cells_[GetIndex(row, 0)];
+  std::memmove(removed, removed + num_cols_,
+      (num_rows_ - row - 1) * num_cols_);
+  std::memset(&cells_[GetIndex(num_rows_ - 1, 0)], kEmptyColor, num_cols_);
+  row_counts_.erase(row_counts_.begin() + row);
+  row_counts_.push_back(0);
+
+  for (size_t col = 0; col < num_cols_; col++) {
+    if (column_heights_[col] <= row) {
+      continue;
+    }
+
+    // a column topped by the removed row drops to the next tile below it
+    if (column_heights_[col] == row + 1) {
+      column_heights_[col] = FindColumnHeight(col, row);
+    } else {
+      column_heights_[col]--;
+    }
+  }
+}
+
+void Board::InsertBottomRow() {
+  std::memmove(&cells_[num_cols_], &cells_[0],
+      (num_rows_ - 1) * num_cols_);
+  std::memset(&cells_[0], kEmptyColor, num_cols_);
+  row_counts_.pop_back();
+  row_counts_.insert(row_counts_.begin(), 0);
+
+  for (size_t col = 0; col < num_cols_; col++) {
+    if (column_heights_[col] == 0) {
+      continue;
+    }
+
+    // a column topped by the dropped row is found again from the top
+    if (column_heights_[col] == num_rows_) {
+      column_heights_[col] = FindColumnHeight(col, num_rows_);
+    } else {
+      column_heights_[col]++;
+    }
+  }
+}
+
+void Board::SetFixture(size_t row, size_t col, b2Fixture* fixture) {
+  size_t index = GetIndex(row, col);
+  // the floor is rebuilt in tile order, so this is almost always an append
+  if (fixtures_.empty() || fixtures_.back().first < index) {
+    fixtures_.emplace_back(index, fixture);
+    return;
+  }
+
+  auto position = std::lower_bound(fixtures_.begin(), fixtures_.end(),
+      std::make_pair(index, static_cast<b2Fixture*>(nullptr)));
+  if (position != fixtures_.end() && position->first == index) {
+    position->second = fixture;
+  } else {
+    fixtures_.insert(position, std::make_pair(index, fixture));
+  }
+}
+
+b2Fixture* Board::GetFixture(size_t row, size_t col) const {
+  size_t index = GetIndex(row, col);
+  auto position = std::lower_bound(fixtures_.begin(), fixtures_.end(),
+      std::make_pair(index, static_cast<b2Fixture*>(nullptr)));
+  if (position == fixtures_.end() || position->first != index) {
+    return nullptr;
+  }
+
+  return position->second;
+}
+
+size_t Board::GetMemoryFootprint() const {
+  return cells_.capacity()
+      + palette_.capacity() * sizeof(cinder::Color)
+      + fixtures_.capacity() * sizeof(std::pair<size_t, b2Fixture*>)
+      + (column_heights_.capacity() + row_counts_.capacity())
+      * sizeof(uint16_t);
+}
+
+} // namespace tetris
@@ -0,0 +1,164 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#include "render/board_renderer.h"
+
+#include <Box2D/Dynamics/b2Body.h>
+#include <Box2D/Dynamics/b2Fixture.h>
+
+#include <algorithm>
+#include <cmath>
+
+#include "physics/block.h"
+#include "physics/block_template.h"
+
+namespace tetris {
+
+namespace {
+
+const int kGlyphWidth = 3;
+const int kGlyphHeight = 5;
+// floor tiles are drawn from 0.05 to 0.95 of their cell, as in the game
+const float kFloorTileInset = 0.05f;
+
+/**
+ * Gets the pixels of a character of the built in font, five rows of three
+ * bits with the top row in the highest bits
+ * @param character the character
+ * @return the glyph, 0 for characters the font doesn't have
+ */
+uint16_t GetGlyph(char character) {
+  static const uint16_t kDigits[10] = {
+      075557, 026227, 071747, 071717, 055711,
+      074717, 074757, 071111, 075757, 075717};
+  if (character >= '0' && character <= '9') {
+    return kDigits[character - '0'];
+  }
+
+  switch (character) {
+    case 'C':
+      return 074447;
+    case 'E':
+      return 074647;
+    case 'L':
+      return 044447;
+    case 'O':
+      return 075557;
+    case 'R':
+      return 065655;
+    case 'S':
+      return 074717;
+    case 'V':
+      return 055552;
+    default:
+      return 0;
+  }
+}
+
+} // namespace
+
+const int BoardRenderer::kDefaultTileSize;
+
+BoardRenderer::BoardRenderer(int tile_size) : tile_size_(tile_size) {}
+
+void BoardRenderer::FillWorldBox(const b2AABB& box, size_t num_rows,
+    uint32_t color) {
+  float rows = static_cast<float>(num_rows);
+  float tile_size = static_cast<float>(tile_size_);
+  framebuffer_.FillRect(
+      static_cast<int>(std::lround(box.lowerBound.x * tile_size)),
+      static_cast<int>(std::lround((rows - box.upperBound.y) * tile_size)),
+      static_cast<int>(std::lround(box.upperBound.x * tile_size)),
+      static_cast<int>(std::lround((rows - box.lowerBound.y) * tile_size)),
+      color);
+}
+
+void BoardRenderer::DrawText(const std::string& text, int left, int top,
+    int scale, uint32_t color) {
+  for (char character : text) {
+    uint16_t glyph = GetGlyph(character);
+    for (int row = 0; row < kGlyphHeight; row++) {
+      for (int col = 0; col < kGlyphWidth; col++) {
+        int bit = (kGlyphHeight - 1 - row) * kGlyphWidth
+            + (kGlyphWidth - 1 - col);
+        if ((glyph >> bit) & 1) {
+          int x = left + col * scale;
+          int y = top + row * scale;
+          framebuffer_.FillRect(x, y, x + scale, y + scale, color);
+        }
+      }
+    }
+
+    // one blank column between characters
+    left += (kGlyphWidth + 1) * scale;
+  }
+}
+
+void BoardRenderer::Render(const World& world) {
+  size_t num_rows = world.GetTotalNumRow();
+  size_t num_cols = world.GetTotalNumCol();
+  framebuffer_.Resize(static_cast<int>(num_cols) * tile_size_,
+      static_cast<int>(num_rows) * tile_size_);
+  framebuffer_.Clear(Framebuffer::PackColor(0.0f, 0.0f, 0.0f));
+
+  const Board& board = world.GetBoard();
+  for (size_t row = 0; row < board.GetNumRows(); row++) {
+    for (size_t col = 0; col < board.GetNumCols(); col++) {
+      if (!board.IsFilled(row, col) && !board.IsExploded(row, col)) {
+        continue;
+      }
+
+      const cinder::Color& color = board.GetTileColor(row, col);
+      float left = static_cast<float>(col);
+      float bottom = static_cast<float>(row);
+      b2AABB tile;
+      tile.lowerBound.Set(left + kFloorTileInset, bottom + kFloorTileInset);
+      tile.upperBound.Set(left + 1.0f - kFloorTileInset,
+          bottom + 1.0f - kFloorTileInset);
+      FillWorldBox(tile, num_rows,
+          Framebuffer::PackColor(color.r, color.g, color.b));
+    }
+  }
+
+  for (const World::Debris& debris : world.GetDebris()) {
+    const BlockTemplate& block_template = *debris.block_template_;
+    FillWorldBox(debris.body_->GetFixtureList()->GetAABB(0), num_rows,
+        Framebuffer::PackColor(block_template.red_, block_template.green_,
+            block_template.blue_));
+  }
+
+  const Block* block = world.GetMovingBlock();
+  if (block != nullptr) {
+    // the game flashes the bomb between greys, a still frame shows one
+    cinder::Color block_color = block->IsBomb()
+        ? cinder::Color(0.6f, 0.6f, 0.6f) : block->GetColor();
+    uint32_t color = Framebuffer::PackColor(block_color.r, block_color.g,
+        block_color.b);
+    float drop_distance = world.GetDropDistance();
+    float rows = static_cast<float>(num_rows);
+    float tile_size = static_cast<float>(tile_size_);
+    for (const b2AABB& tile : block->GetBoundingBoxList()) {
+      if (drop_distance > 0.0f) {
+        framebuffer_.StrokeRect(
+            static_cast<int>(std::lround(tile.lowerBound.x * tile_size)),
+            static_cast<int>(std::lround(
+                (rows - tile.upperBound.y + drop_distance) * tile_size)),
+            static_cast<int>(std::lround(tile.upperBound.x * tile_size)),
+            static_cast<int>(std::lround(
+                (rows - tile.lowerBound.y + drop_distance) * tile_size)),
+            color);
+      }
+
+      FillWorldBox(tile, num_rows, color);
+    }
+  }
+
+  // the score sits at the top center, as in the game
+  std::string score_text = "SCORE " + std::to_string(world.GetScore());
+  int scale = std::max(tile_size_ / 8, 1);
+  int text_width = static_cast<int>(score_text.size())
+      * (kGlyphWidth + 1) * scale - scale;
+  DrawText(score_text, (framebuffer_.GetWidth() - text_width) / 2, scale * 2,
+      scale, Framebuffer::PackColor(1.0f, 1.0f, 1.0f));
+}
+
+} // namespace tetris
@@ -0,0 +1,287 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#include "telemetry/event_log.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "physics/block.h"
+#include "physics/world.h"
+
+namespace tetris {
+
+const size_t TelemetryEvent::kMaxTiles;
+const uint32_t TelemetryEvent::kUnknownTicks;
+const size_t EventLogWriter::kBufferCapacity;
+const int EventLogWriter::kWriteIntervalMs;
+const int EventLogWriter::kSyncIntervalMs;
+
+const char kLogMagic[4] = {'T', 'T', 'L', 'G'};
+const uint32_t kLogVersion = 1;
+// events written by a single call to fwrite
+const size_t kWriteBatchSize = 256;
+
+const char* const kEventTypeNames[] = {
+    "spawn", "lock", "row_clear", "bomb", "game_over"};
+
+/**
+ * Pushes buffered writes of a file through to the disk
+ * @param file the file
+ */
+static void SyncFile(FILE* file) {
+  fflush(file);
+#ifdef _WIN32
+  _commit(_fileno(file));
+#else
+  fsync(fileno(file));
+#endif
+}
+
+/**
+ * Cuts a file down to a size
+ * @param file the file
+ * @param size the size to keep
+ * @return false if the file could not be cut
+ */
+static bool TruncateFile(FILE* file, long size) {
+#ifdef _WIN32
+  return _chsize_s(_fileno(file), size) == 0;
+#else
+  return ftruncate(fileno(file), static_cast<off_t>(size)) == 0;
+#endif
+}
+
+EventLogWriter::EventLogWriter()
+    : file_(nullptr, fclose), is_stopping_(false), num_dropped_(0),
+      num_written_(0), spawn_tick_(0) {}
+
+EventLogWriter::~EventLogWriter() {
+  is_stopping_ = true;
+  if (writer_thread_.joinable()) {
+    writer_thread_.join();
+  }
+}
+
+bool EventLogWriter::Open(const std::string& path) {
+  if (writer_thread_.joinable()) {
+    return false;
+  }
+
+  file_.reset(fopen(path.c_str(), "ab+"));
+  if (!file_) {
+    return false;
+  }
+
+  TelemetryLogHeader header = {};
+  std::memcpy(header.magic_, kLogMagic, sizeof(kLogMagic));
+  header.version_ = kLogVersion;
+  header.record_size_ = sizeof(TelemetryEvent);
+
+  fseek(file_.get(), 0, SEEK_END);
+  if (ftell(file_.get()) == 0) {
+    fwrite(&header, sizeof(header), 1, file_.get());
+  } else {
+    // only append to logs with the same record layout
+    TelemetryLogHeader existing_header;
+    rewind(file_.get());
+    if (fread(&existing_header, sizeof(existing_header), 1, file_.get()) != 1
+        || std::memcmp(&existing_header, &header, sizeof(header)) != 0) {
+      file_.reset();
+      return false;
+    }
+
+    // a record cut short by a crash is dropped, so the records appended
+    // after it still line up
+    fseek(file_.get(), 0, SEEK_END);
+    long size = ftell(file_.get());
+    long records_size = size - static_cast<long>(sizeof(header));
+    long whole_size = size - records_size
+        % static_cast<long>(sizeof(TelemetryEvent));
+    if (whole_size != size && !TruncateFile(file_.get(), whole_size)) {
+      file_.reset();
+      return false;
+    }
+
+    fseek(file_.get(), 0, SEEK_END);
+  }
+
+  writer_thread_ = std::thread(&EventLogWriter::WriterLoop, this);
+  return true;
+}
+
+void EventLogWriter::Record(const World& world, TelemetryEvent& event) {
+  if (!file_) {
+    return;
+  }
+
+  event.timestamp_ = static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch()).count());
+  event.tick_ = static_cast<uint32_t>(world.GetTickCount());
+  if (!buffer_.TryPush(event)) {
+    num_dropped_.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+void EventLogWriter::WriterLoop() {
+  TelemetryEvent batch[kWriteBatchSize];
+  auto last_sync_time = std::chrono::steady_clock::now();
+  bool has_unsynced_writes = false;
+
+  while (true) {
+    // read the flag first so no event pushed before it is missed
+    bool is_stopping = is_stopping_;
+
+    size_t num_events = 0;
+    while (num_events < kWriteBatchSize
+           && buffer_.TryPop(&batch[num_events])) {
+      num_events++;
+    }
+
+    if (num_events > 0) {
+      fwrite(batch, sizeof(TelemetryEvent), num_events, file_.get());
+      num_written_.fetch_add(num_events, std::memory_order_relaxed);
+      has_unsynced_writes = true;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    if (has_unsynced_writes && (is_stopping
+        || now - last_sync_time
+            >= std::chrono::milliseconds(kSyncIntervalMs))) {
+      SyncFile(file_.get());
+      last_sync_time = now;
+      has_unsynced_writes = false;
+    }
+
+    if (num_events == kWriteBatchSize) {
+      continue;
+    }
+
+    if (is_stopping) {
+      return;
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(kWriteIntervalMs));
+  }
+}
+
+void EventLogWriter::OnBlockSpawned(const World& world, const Block& block) {
+  spawn_tick_ = world.GetTickCount();
+
+  TelemetryEvent event = {};
+  event.type_ = TelemetryEvent::kBlockSpawned;
+  event.template_id_ = static_cast<uint8_t>(block.GetTemplateId());
+  Record(world, event);
+}
+
+void EventLogWriter::OnBlockLocked(const World& world, const Block& block,
+    const std::vector<TilePosition>& tiles) {
+  TelemetryEvent event = {};
+  event.type_ = TelemetryEvent::kBlockLocked;
+  event.template_id_ = static_cast<uint8_t>(block.GetTemplateId());
+  // debris settles long after the next block spawned, so only the moving
+  // block's own lock is timed from spawn_tick_
+  event.ticks_since_spawn_ = &block == world.GetMovingBlock()
+      ? static_cast<uint32_t>(world.GetTickCount() - spawn_tick_)
+      : TelemetryEvent::kUnknownTicks;
+  event.num_tiles_ = static_cast<uint8_t>(
+      std::min(tiles.size(), TelemetryEvent::kMaxTiles));
+  for (size_t index = 0; index < event.num_tiles_; index++) {
+    event.tiles_[index][0] = static_cast<uint8_t>(tiles[index].row_);
+    event.tiles_[index][1] = static_cast<uint8_t>(tiles[index].col_);
+  }
+
+  Record(world, event);
+}
+
+void EventLogWriter::OnRowCleared(const World& world, size_t row) {
+  TelemetryEvent event = {};
+  event.type_ = TelemetryEvent::kRowCleared;
+  event.value_ = static_cast<uint32_t>(row);
+  Record(world, event);
+}
+
+void EventLogWriter::OnBombExploded(const World& world,
+    const TilePosition& center) {
+  TelemetryEvent event = {};
+  event.type_ = TelemetryEvent::kBombExploded;
+  event.num_tiles_ = 1;
+  event.tiles_[0][0] = static_cast<uint8_t>(center.row_);
+  event.tiles_[0][1] = static_cast<uint8_t>(center.col_);
+  Record(world, event);
+}
+
+void EventLogWriter::OnGameOver(const World& world) {
+  TelemetryEvent event = {};
+  event.type_ = TelemetryEvent::kGameOver;
+  event.value_ = static_cast<uint32_t>(world.GetScore());
+  Record(world, event);
+}
+
+EventLogReader::EventLogReader() : file_(nullptr, fclose) {}
+
+bool EventLogReader::Open(const std::string& path) {
+  file_.reset(fopen(path.c_str(), "rb"));
+  if (!file_) {
+    return false;
+  }
+
+  TelemetryLogHeader header;
+  if (fread(&header, sizeof(header), 1, file_.get()) != 1
+      || std::memcmp(header.magic_, kLogMagic, sizeof(kLogMagic)) != 0
+      || header.version_ != kLogVersion
+      || header.record_size_ != sizeof(TelemetryEvent)) {
+    file_.reset();
+    return false;
+  }
+
+  return true;
+}
+
+bool EventLogReader::Next(TelemetryEvent* event) {
+  // a record cut short by a crash counts as the end of the log
+  return file_ && fread(event, sizeof(TelemetryEvent), 1, file_.get()) == 1;
+}
+
+void WriteEventCsvHeader(std::ostream& output) {
+  output << "timestamp_ns,tick,type,template_id,ticks_since_spawn,value,tiles"
+         << '\n';
+}
+
+void WriteEventCsvRow(std::ostream& output, const TelemetryEvent& event) {
+  const char* type_name = event.type_ <= TelemetryEvent::kGameOver
+      ? kEventTypeNames[event.type_] : "unknown";
+  output << event.timestamp_ << ',' << event.tick_ << ',' << type_name << ',';
+  if (event.type_ == TelemetryEvent::kBlockSpawned
+      || event.type_ == TelemetryEvent::kBlockLocked) {
+    output << static_cast<int>(event.template_id_);
+  }
+
+  output << ',';
+  if (event.ticks_since_spawn_ != TelemetryEvent::kUnknownTicks) {
+    output << event.ticks_since_spawn_;
+  }
+
+  output << ',' << event.value_ << ',';
+  size_t num_tiles = std::min<size_t>(event.num_tiles_,
+      TelemetryEvent::kMaxTiles);
+  for (size_t index = 0; index < num_tiles; index++) {
+    if (index > 0) {
+      output << ' ';
+    }
+
+    output << static_cast<int>(event.tiles_[index][0]) << ':'
+           << static_cast<int>(event.tiles_[index][1]);
+  }
+
+  output << '\n';
+}
+
+} // namespace tetris
@@ -0,0 +1,257 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#include "render/framebuffer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define TETRIS_FRAMEBUFFER_SSE2
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define TETRIS_FRAMEBUFFER_NEON
+#endif
+
+namespace tetris {
+
+namespace {
+
+// the largest block of stored, uncompressed deflate data
+const size_t kMaxStoredBlockSize = 65535;
+
+/**
+ * Appends a number in big endian order, as PNG wants
+ * @param bytes where to append
+ * @param value the number
+ */
+void AppendBigEndian(std::vector<uint8_t>* bytes, uint32_t value) {
+  bytes->push_back(static_cast<uint8_t>(value >> 24));
+  bytes->push_back(static_cast<uint8_t>(value >> 16));
+  bytes->push_back(static_cast<uint8_t>(value >> 8));
+  bytes->push_back(static_cast<uint8_t>(value));
+}
+
+/**
+ * Lookup table for CRC-32, one entry per byte value
+ */
+struct Crc32Table {
+  uint32_t values_[256];
+
+  Crc32Table() {
+    for (uint32_t index = 0; index < 256; index++) {
+      uint32_t value = index;
+      for (int bit = 0; bit < 8; bit++) {
+        value = (value & 1) ? 0xEDB88320u ^ (value >> 1) : value >> 1;
+      }
+
+      values_[index] = value;
+    }
+  }
+};
+
+/**
+ * Computes the CRC-32 that ends every PNG chunk
+ * @param data the bytes
+ * @param size number of bytes
+ * @return the checksum
+ */
+uint32_t ComputeCrc32(const uint8_t* data, size_t size) {
+  // built once, safely even if frames are written from many threads
+  static const Crc32Table table;
+  uint32_t crc = 0xFFFFFFFFu;
+  for (size_t index = 0; index < size; index++) {
+    crc = table.values_[(crc ^ data[index]) & 0xFF] ^ (crc >> 8);
+  }
+
+  return crc ^ 0xFFFFFFFFu;
+}
+
+/**
+ * Computes the Adler-32 that ends a zlib stream
+ * @param data the bytes
+ * @param size number of bytes
+ * @return the checksum
+ */
+uint32_t ComputeAdler32(const uint8_t* data, size_t size) {
+  const uint32_t kModulus = 65521;
+  uint32_t low = 1;
+  uint32_t high = 0;
+  for (size_t index = 0; index < size; index++) {
+    low = (low + data[index]) % kModulus;
+    high = (high + low) % kModulus;
+  }
+
+  return (high << 16) | low;
+}
+
+/**
+ * Writes a PNG chunk
+ * @param file the file
+ * @param type four letter chunk type
+ * @param data chunk data
+ */
+void WritePngChunk(FILE* file, const char* type,
+    const std::vector<uint8_t>& data) {
+  std::vector<uint8_t> chunk;
+  chunk.reserve(data.size() + 12);
+  AppendBigEndian(&chunk, static_cast<uint32_t>(data.size()));
+  chunk.insert(chunk.end(), type, type + 4);
+  chunk.insert(chunk.end(), data.begin(), data.end());
+  // the checksum covers the type and the data, not the length
+  AppendBigEndian(&chunk, ComputeCrc32(chunk.data() + 4, data.size() + 4));
+  fwrite(chunk.data(), 1, chunk.size(), file);
+}
+
+} // namespace
+
+Framebuffer::Framebuffer() : width_(0), height_(0) {}
+
+void Framebuffer::Resize(int width, int height) {
+  width_ = std::max(width, 0);
+  height_ = std::max(height, 0);
+  pixels_.resize(static_cast<size_t>(width_) * height_);
+}
+
+uint32_t Framebuffer::PackColor(uint8_t red, uint8_t green, uint8_t blue,
+    uint8_t alpha) {
+  // copied as bytes, so the pixel is R, G, B, A in memory on any machine
+  const uint8_t channels[4] = {red, green, blue, alpha};
+  uint32_t pixel;
+  std::memcpy(&pixel, channels, sizeof(pixel));
+  return pixel;
+}
+
+uint32_t Framebuffer::PackColor(float red, float green, float blue) {
+  auto to_byte = [](float channel) {
+    return static_cast<uint8_t>(
+        std::min(std::max(channel, 0.0f), 1.0f) * 255.0f + 0.5f);
+  };
+  return PackColor(to_byte(red), to_byte(green), to_byte(blue));
+}
+
+void Framebuffer::FillSpan(uint32_t* pixels, size_t count, uint32_t color) {
+  size_t index = 0;
+#if defined(TETRIS_FRAMEBUFFER_SSE2)
+  __m128i colors = _mm_set1_epi32(static_cast<int>(color));
+  for (; index + 4 <= count; index += 4) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(pixels + index), colors);
+  }
+#elif defined(TETRIS_FRAMEBUFFER_NEON)
+  uint32x4_t colors = vdupq_n_u32(color);
+  for (; index + 4 <= count; index += 4) {
+    vst1q_u32(pixels + index, colors);
+  }
+#endif
+
+  for (; index < count; index++) {
+    pixels[index] = color;
+  }
+}
+
+void Framebuffer::Clear(uint32_t color) {
+  FillSpan(pixels_.data(), pixels_.size(), color);
+}
+
+void Framebuffer::FillRect(int left, int top, int right, int bottom,
+    uint32_t color) {
+  left = std::max(left, 0);
+  top = std::max(top, 0);
+  right = std::min(right, width_);
+  bottom = std::min(bottom, height_);
+  if (left >= right || top >= bottom) {
+    return;
+  }
+
+  size_t span_width = static_cast<size_t>(right - left);
+  for (int row = top; row < bottom; row++) {
+    FillSpan(&pixels_[static_cast<size_t>(row) * width_ + left], span_width,
+        color);
+  }
+}
+
+void Framebuffer::StrokeRect(int left, int top, int right, int bottom,
+    uint32_t color) {
+  FillRect(left, top, right, top + 1, color);
+  FillRect(left, bottom - 1, right, bottom, color);
+  FillRect(left, top + 1, left + 1, bottom - 1, color);
+  FillRect(right - 1, top + 1, right, bottom - 1, color);
+}
+
+bool Framebuffer::WritePpm(const std::string& path) const {
+  std::unique_ptr<FILE, int (*)(FILE*)> file(fopen(path.c_str(), "wb"),
+      &fclose);
+  if (!file) {
+    return false;
+  }
+
+  fprintf(file.get(), "P6\n%d %d\n255\n", width_, height_);
+  std::vector<uint8_t> row(static_cast<size_t>(width_) * 3);
+  for (int y = 0; y < height_; y++) {
+    const uint8_t* pixel = reinterpret_cast<const uint8_t*>(
+        &pixels_[static_cast<size_t>(y) * width_]);
+    for (int x = 0; x < width_; x++, pixel += 4) {
+      std::memcpy(&row[static_cast<size_t>(x) * 3], pixel, 3);
+    }
+
+    fwrite(row.data(), 1, row.size(), file.get());
+  }
+
+  return !ferror(file.get());
+}
+
+bool Framebuffer::WritePng(const std::string& path) const {
+  std::unique_ptr<FILE, int (*)(FILE*)> file(fopen(path.c_str(), "wb"),
+      &fclose);
+  if (!file) {
+    return false;
+  }
+
+  const uint8_t kSignature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+  fwrite(kSignature, 1, sizeof(kSignature), file.get());
+
+  std::vector<uint8_t> header;
+  AppendBigEndian(&header, static_cast<uint32_t>(width_));
+  AppendBigEndian(&header, static_cast<uint32_t>(height_));
+  // 8 bits per channel, RGBA, default compression, filter and interlace
+  const uint8_t kFormat[] = {8, 6, 0, 0, 0};
+  header.insert(header.end(), kFormat, kFormat + sizeof(kFormat));
+  WritePngChunk(file.get(), "IHDR", header);
+
+  // every row starts with filter type 0, leaving its pixels as they are
+  size_t row_size = static_cast<size_t>(width_) * 4;
+  std::vector<uint8_t> rows;
+  rows.reserve((row_size + 1) * height_);
+  for (int y = 0; y < height_; y++) {
+    const uint8_t* pixel = reinterpret_cast<const uint8_t*>(
+        &pixels_[static_cast<size_t>(y) * width_]);
+    rows.push_back(0);
+    rows.insert(rows.end(), pixel, pixel + row_size);
+  }
+
+  // a zlib stream of stored deflate blocks
+  std::vector<uint8_t> data = {0x78, 0x01};
+  data.reserve(rows.size() + rows.size() / kMaxStoredBlockSize * 5 + 16);
+  size_t offset = 0;
+  do {
+    size_t block_size = std::min(rows.size() - offset, kMaxStoredBlockSize);
+    bool is_last = offset + block_size == rows.size();
+    data.push_back(is_last ? 1 : 0);
+    data.push_back(static_cast<uint8_t>(block_size));
+    data.push_back(static_cast<uint8_t>(block_size >> 8));
+    data.push_back(static_cast<uint8_t>(~block_size));
+    data.push_back(static_cast<uint8_t>(~block_size >> 8));
+    data.insert(data.end(), rows.begin() + offset,
+        rows.begin() + offset + block_size);
+    offset += block_size;
+  } while (offset < rows.size());
+  AppendBigEndian(&data, ComputeAdler32(rows.data(), rows.size()));
+  WritePngChunk(file.get(), "IDAT", data);
+
+  WritePngChunk(file.get(), "IEND", std::vector<uint8_t>());
+  return !ferror(file.get());
+}
+
+} // namespace tetris
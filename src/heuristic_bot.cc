@@ -0,0 +1,176 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#include "bot/heuristic_bot.h"
+
+#include <algorithm>
+#include <bitset>
+#include <cstdlib>
+
+#include "physics/row_bits.h"
+
+namespace tetris {
+
+// weights found by tuning on the classic board, a good start for both
+const HeuristicBot::Weights HeuristicBot::kDefaultWeights = {
+    -0.35663, -0.510066, -0.184483, -0.05, 0.760666};
+
+static const char* const kFeatureNames[HeuristicBot::kNumFeatures] = {
+    "holes", "aggregate height", "bumpiness", "wells", "lines cleared"};
+
+/**
+ * Gets the height of each column, one above its highest filled tile
+ * @param rows filled tiles of each row
+ * @param num_cols width of the board
+ * @param heights set to the height of each column
+ */
+static void GetHeights(const std::vector<uint32_t>& rows, size_t num_cols,
+    std::array<int, 32>* heights) {
+  heights->fill(0);
+  uint32_t covered = 0;
+  for (size_t row = rows.size(); row-- > 0;) {
+    uint32_t new_bits = rows[row] & ~covered;
+    for (size_t col = 0; col < num_cols && new_bits != 0; col++) {
+      if ((new_bits >> col) & 1u) {
+        (*heights)[col] = static_cast<int>(row) + 1;
+        new_bits &= ~(1u << col);
+      }
+    }
+
+    covered |= rows[row];
+  }
+}
+
+/**
+ * Gets the tiles of a rotation state with its bounding box moved to the
+ * bottom left corner, to tell rotations of the same shape apart
+ * @param block_template template of the block
+ * @param rotation rotation state
+ * @return the tiles as bits of the 4 by 4 box
+ */
+static uint16_t GetShapeMask(const BlockTemplate& block_template,
+    size_t rotation) {
+  const BlockTemplate::Box& box = block_template.boxes_[rotation];
+  uint16_t mask = 0;
+  for (size_t tile = 0; tile < block_template.num_tiles_; tile++) {
+    const BlockTemplate::Cell& cell = block_template.cells_[rotation][tile];
+    mask = static_cast<uint16_t>(mask | 1u << BlockTemplate::GetMaskBit(
+        cell.col_ - box.min_col_, cell.row_ - box.min_row_));
+  }
+
+  return mask;
+}
+
+HeuristicBot::HeuristicBot(const Weights& weights) : weights_(weights) {}
+
+HeuristicBot::Placement HeuristicBot::Choose(
+    const std::vector<uint32_t>& rows, size_t num_cols,
+    const BlockTemplate& block_template) const {
+  Placement best = {false, 0, 0, 0, 0, 0.0};
+  std::array<int, 32> heights;
+  GetHeights(rows, num_cols, &heights);
+  std::array<uint16_t, BlockTemplate::kNumRotations> shapes;
+  std::vector<uint32_t> board;
+
+  for (size_t rotation = 0; rotation < BlockTemplate::kNumRotations;
+       rotation++) {
+    shapes[rotation] = GetShapeMask(block_template, rotation);
+    if (std::find(shapes.begin(), shapes.begin() + rotation,
+        shapes[rotation]) != shapes.begin() + rotation) {
+      continue;
+    }
+
+    const BlockTemplate::Box& box = block_template.boxes_[rotation];
+    int width = box.max_col_ - box.min_col_ + 1;
+    int height = box.max_row_ - box.min_row_ + 1;
+    for (int col = 0; col + width <= static_cast<int>(num_cols); col++) {
+      // the block rests on whichever of its tiles meets the stack first
+      int row = 0;
+      for (size_t tile = 0; tile < block_template.num_tiles_; tile++) {
+        const BlockTemplate::Cell& cell =
+            block_template.cells_[rotation][tile];
+        row = std::max(row, heights[col + cell.col_ - box.min_col_]
+            - (cell.row_ - box.min_row_));
+      }
+
+      if (row + height > static_cast<int>(rows.size())) {
+        continue;
+      }
+
+      Placement placement = {true, rotation, col, row, 0, 0.0};
+      board = rows;
+      placement.num_cleared_ =
+          Place(placement, block_template, num_cols, &board);
+      placement.score_ = Score(board, num_cols, placement.num_cleared_);
+      if (!best.is_found_ || placement.score_ > best.score_) {
+        best = placement;
+      }
+    }
+  }
+
+  return best;
+}
+
+double HeuristicBot::Score(const std::vector<uint32_t>& rows,
+    size_t num_cols, size_t num_cleared) const {
+  std::array<double, kNumFeatures> features =
+      GetFeatures(rows, num_cols, num_cleared);
+  double score = 0.0;
+  for (size_t feature = 0; feature < kNumFeatures; feature++) {
+    score += weights_[feature] * features[feature];
+  }
+
+  return score;
+}
+
+std::array<double, HeuristicBot::kNumFeatures> HeuristicBot::GetFeatures(
+    const std::vector<uint32_t>& rows, size_t num_cols,
+    size_t num_cleared) {
+  std::array<double, kNumFeatures> features = {};
+  features[kLinesCleared] = static_cast<double>(num_cleared);
+
+  // an empty tile is a hole once any row above it is filled there
+  uint32_t full_row = GetFullRowBits(num_cols);
+  uint32_t covered = 0;
+  size_t num_holes = 0;
+  for (size_t row = rows.size(); row-- > 0;) {
+    num_holes += std::bitset<32>(covered & ~rows[row] & full_row).count();
+    covered |= rows[row];
+  }
+
+  features[kHoles] = static_cast<double>(num_holes);
+
+  std::array<int, 32> heights;
+  GetHeights(rows, num_cols, &heights);
+  int num_cols_int = static_cast<int>(num_cols);
+  for (int col = 0; col < num_cols_int; col++) {
+    features[kAggregateHeight] += heights[col];
+    if (col + 1 < num_cols_int) {
+      features[kBumpiness] += std::abs(heights[col] - heights[col + 1]);
+    }
+
+    int left = col > 0 ? heights[col - 1] : heights[col + 1];
+    int right = col + 1 < num_cols_int ? heights[col + 1] : left;
+    int depth = std::min(left, right) - heights[col];
+    if (depth > 0 && num_cols_int > 1) {
+      features[kWells] += depth;
+    }
+  }
+
+  return features;
+}
+
+size_t HeuristicBot::Place(const Placement& placement,
+    const BlockTemplate& block_template, size_t num_cols,
+    std::vector<uint32_t>* rows) {
+  size_t num_rows = rows->size();
+  size_t num_cleared = PlaceOnRows(block_template, placement.rotation_,
+      placement.col_, placement.row_, num_cols, rows);
+  rows->resize(num_rows, 0);
+  return num_cleared;
+}
+
+const char* HeuristicBot::GetFeatureName(Feature feature) {
+  return kFeatureNames[feature];
+}
+
+} // namespace tetris
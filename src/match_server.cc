@@ -0,0 +1,174 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#include "server/match_server.h"
+
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+#include <thread>
+
+#include "telemetry/trace.h"
+
+namespace tetris {
+
+constexpr const size_t MatchServer::kGarbageForRowsCleared[];
+
+/**
+ * Gets the value below which the given fraction of samples fall
+ * @param samples samples, reordered by this call
+ * @param fraction fraction between 0 and 1
+ * @return percentile value
+ */
+static double GetPercentile(std::vector<double>& samples, double fraction) {
+  size_t index = static_cast<size_t>(
+      fraction * static_cast<double>(samples.size() - 1));
+  std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+  return samples[index];
+}
+
+MatchServer::MatchServer(size_t num_worlds, size_t num_threads,
+    World::GameState game_state)
+    : incoming_garbage_(num_worlds, 0), pool_(num_threads),
+      target_random_(std::random_device()()), num_missed_deadlines_(0) {
+  for (size_t index = 0; index < num_worlds; index++) {
+    // a server has no window to play sounds in
+    engines_.emplace_back(new TetrisEngine(false));
+    engines_.back()->SetCurrentGameState(game_state);
+  }
+}
+
+bool MatchServer::EnableSpectators(const std::string& directory) {
+  for (size_t index = spectator_encoders_.size(); index < engines_.size();
+       index++) {
+    spectator_publishers_.emplace_back(new SpectatorPublisher);
+    std::string socket_path =
+        directory + "/world_" + std::to_string(index) + ".sock";
+    if (!spectator_publishers_.back()->Listen(socket_path)) {
+      spectator_publishers_.pop_back();
+      return false;
+    }
+
+    // encoders run on whichever thread steps their world
+    spectator_encoders_.emplace_back(
+        new SpectatorEncoder(spectator_publishers_.back().get()));
+    engines_[index]->GetWorld().AddListener(spectator_encoders_.back().get());
+  }
+
+  return true;
+}
+
+void MatchServer::Tick() {
+  TraceSpan span("MatchServer::Tick");
+  auto start_time = std::chrono::steady_clock::now();
+
+  pool_.ParallelFor(engines_.size(), [this](size_t index) {
+    engines_[index]->GetWorld().Step();
+  });
+
+  {
+    TraceSpan garbage_span("MatchServer::RouteGarbage");
+    RouteGarbage();
+  }
+
+  std::chrono::duration<double, std::micro> duration =
+      std::chrono::steady_clock::now() - start_time;
+  tick_durations_.push_back(duration.count());
+}
+
+void MatchServer::Run(size_t num_ticks, double tick_rate) {
+  std::chrono::duration<double> tick_period(1.0 / tick_rate);
+  auto deadline = std::chrono::steady_clock::now()
+      + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+          tick_period);
+
+  for (size_t tick = 0; tick < num_ticks; tick++) {
+    Tick();
+
+    auto now = std::chrono::steady_clock::now();
+    if (now > deadline) {
+      num_missed_deadlines_++;
+      // start the schedule over instead of rushing to catch up
+      deadline = now;
+    } else {
+      std::this_thread::sleep_until(deadline);
+    }
+
+    deadline += std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        tick_period);
+  }
+}
+
+void MatchServer::RouteGarbage() {
+  std::vector<size_t> alive_indices;
+  for (size_t index = 0; index < engines_.size(); index++) {
+    if (engines_[index]->GetCurrentGameState() != World::kEndScreen) {
+      alive_indices.push_back(index);
+    }
+  }
+
+  for (size_t index : alive_indices) {
+    size_t rows_cleared = std::min(
+        engines_[index]->GetWorld().TakeClearedRowCount(),
+        kMaxRowsClearedAtOnce);
+    size_t garbage = kGarbageForRowsCleared[rows_cleared];
+    if (garbage == 0 || alive_indices.size() < 2) {
+      continue;
+    }
+
+    // pick any opponent other than the sender
+    std::uniform_int_distribution<size_t> dist(0, alive_indices.size() - 2);
+    size_t target = alive_indices[dist(target_random_)];
+    if (target == index) {
+      target = alive_indices.back();
+    }
+
+    incoming_garbage_[target] += garbage;
+  }
+
+  // garbage is only added once every world has finished the tick,
+  // so the order worlds are stepped in never matters
+  for (size_t index : alive_indices) {
+    engines_[index]->GetWorld().AddGarbageRows(incoming_garbage_[index]);
+    incoming_garbage_[index] = 0;
+  }
+}
+
+MatchServer::TickStatistics MatchServer::GetTickStatistics() const {
+  TickStatistics statistics = {};
+  statistics.num_ticks_ = tick_durations_.size();
+  statistics.num_missed_deadlines_ = num_missed_deadlines_;
+  if (tick_durations_.empty()) {
+    return statistics;
+  }
+
+  std::vector<double> samples = tick_durations_;
+  statistics.mean_ = std::accumulate(samples.begin(), samples.end(), 0.0)
+      / static_cast<double>(samples.size());
+  statistics.p50_ = GetPercentile(samples, 0.5);
+  statistics.p90_ = GetPercentile(samples, 0.9);
+  statistics.p99_ = GetPercentile(samples, 0.99);
+  statistics.max_ = *std::max_element(samples.begin(), samples.end());
+  return statistics;
+}
+
+size_t MatchServer::GetNumAlive() const {
+  return std::count_if(engines_.begin(), engines_.end(),
+      [](const std::unique_ptr<TetrisEngine>& engine) {
+        return engine->GetCurrentGameState() != World::kEndScreen;
+      });
+}
+
+size_t MatchServer::GetMeanWorldMemoryFootprint() const {
+  if (engines_.empty()) {
+    return 0;
+  }
+
+  size_t num_bytes = 0;
+  for (const std::unique_ptr<TetrisEngine>& engine : engines_) {
+    num_bytes += engine->GetWorld().GetMemoryFootprint();
+  }
+
+  return num_bytes / engines_.size();
+}
+
+} // namespace tetris
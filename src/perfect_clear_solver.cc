@@ -0,0 +1,377 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#include "physics/perfect_clear_solver.h"
+
+#include <algorithm>
+#include <bitset>
+
+#include "physics/board.h"
+#include "physics/row_bits.h"
+#include "server/work_stealing_pool.h"
+
+namespace tetris {
+
+const size_t PerfectClearSolver::kMaxBoardBits;
+const size_t PerfectClearSolver::kSplitDepth;
+const size_t PerfectClearSolver::kNumTableShards;
+
+/**
+ * Counts the filled tiles of a bitboard
+ * @param bits the bitboard
+ * @return number of bits set
+ */
+static size_t CountBits(uint64_t bits) {
+  return std::bitset<64>(bits).count();
+}
+
+/**
+ * Gets the bits of the lowest rows of a bitboard
+ * @param num_bits rows times columns
+ * @return mask of those bits
+ */
+static uint64_t GetLowBits(size_t num_bits) {
+  return num_bits >= 64 ? ~0ull : (1ull << num_bits) - 1;
+}
+
+/**
+ * Finds the greatest common divisor
+ * @param first a number
+ * @param second another number
+ * @return their greatest common divisor, the other number when one is 0
+ */
+static size_t GetGcd(size_t first, size_t second) {
+  while (second != 0) {
+    size_t remainder = first % second;
+    first = second;
+    second = remainder;
+  }
+
+  return first;
+}
+
+size_t PerfectClearSolver::FailedPositionHash::operator()(
+    const FailedPosition& position) const {
+  // the 64 bit finalizer of MurmurHash3, so nearby boards spread out
+  uint64_t hash = position.board_ ^ (position.depth_ * 0x9E3779B97F4A7C15ull);
+  hash ^= hash >> 33;
+  hash *= 0xFF51AFD7ED558CCDull;
+  hash ^= hash >> 33;
+  hash *= 0xC4CEB9FE1A85EC53ull;
+  hash ^= hash >> 33;
+  return static_cast<size_t>(hash);
+}
+
+PerfectClearSolver::PerfectClearSolver(size_t num_cols, WorkStealingPool* pool)
+    : num_cols_(num_cols), pool_(pool), num_used_(0), is_found_(false),
+      num_nodes_(0) {
+  for (std::unique_ptr<TableShard>& shard : table_) {
+    shard.reset(new TableShard);
+  }
+}
+
+PerfectClearSolver::Result PerfectClearSolver::Solve(
+    const std::vector<uint32_t>& rows,
+    const std::vector<const BlockTemplate*>& pieces, size_t max_pieces) {
+  Result result = {false, 0, {}, 0};
+  size_t num_pieces = std::min(max_pieces, pieces.size());
+  size_t stack_height = rows.size();
+  while (stack_height > 0 && rows[stack_height - 1] == 0) {
+    stack_height--;
+  }
+
+  size_t num_filled = 0;
+  uint64_t board = 0;
+  if (stack_height * num_cols_ > kMaxBoardBits) {
+    return result;
+  }
+
+  for (size_t row = 0; row < stack_height; row++) {
+    uint64_t row_bits = rows[row] & GetLowBits(num_cols_);
+    num_filled += CountBits(row_bits);
+    board |= row_bits << (row * num_cols_);
+  }
+
+  shapes_.assign(num_pieces, {});
+  for (size_t piece = 0; piece < num_pieces; piece++) {
+    const BlockTemplate& block_template = *pieces[piece];
+    for (size_t rotation = 0; rotation < BlockTemplate::kNumRotations;
+         rotation++) {
+      const BlockTemplate::Box& box = block_template.boxes_[rotation];
+      Shape& shape = shapes_[piece][rotation];
+      shape.bits_ = 0;
+      shape.width_ = box.max_col_ - box.min_col_ + 1;
+      shape.height_ = box.max_row_ - box.min_row_ + 1;
+      // a rotation taller than the bitboard can never be placed
+      if (static_cast<size_t>(shape.height_) * num_cols_ > kMaxBoardBits) {
+        shape.is_distinct_ = false;
+        continue;
+      }
+
+      for (size_t tile = 0; tile < block_template.num_tiles_; tile++) {
+        const BlockTemplate::Cell& cell = block_template.cells_[rotation][tile];
+        shape.bits_ |= 1ull << (static_cast<size_t>(cell.row_ - box.min_row_)
+            * num_cols_ + static_cast<size_t>(cell.col_ - box.min_col_));
+      }
+
+      shape.is_distinct_ = true;
+      for (size_t earlier = 0; earlier < rotation; earlier++) {
+        if (shapes_[piece][earlier].bits_ == shape.bits_) {
+          shape.is_distinct_ = false;
+        }
+      }
+    }
+  }
+
+  // an empty board is cleared again from the first row up, so the answer
+  // says if the blocks can make a perfect clear of their own. Every block
+  // and every cleared row keeps the empty cells under the clear height
+  // equal to the tiles of the blocks left, so each height needs exactly
+  // the blocks that fill it
+  for (size_t height = std::max<size_t>(stack_height, 1);
+       height * num_cols_ <= kMaxBoardBits; height++) {
+    size_t num_empty = height * num_cols_ - num_filled;
+    size_t num_tiles = 0;
+    num_used_ = 0;
+    while (num_used_ < num_pieces && num_tiles < num_empty) {
+      num_tiles += pieces[num_used_++]->num_tiles_;
+    }
+
+    if (num_tiles != num_empty) {
+      continue;
+    }
+
+    tile_gcds_.assign(num_used_ + 1, 0);
+    for (size_t piece = num_used_; piece > 0; piece--) {
+      tile_gcds_[piece - 1] =
+          GetGcd(tile_gcds_[piece], pieces[piece - 1]->num_tiles_);
+    }
+
+    for (std::unique_ptr<TableShard>& shard : table_) {
+      shard->positions_.clear();
+    }
+
+    is_found_ = false;
+    num_nodes_ = 0;
+    solution_.clear();
+    pool_->Submit([this, board, height] {
+      SearchTask(board, static_cast<int>(height), 0, {});
+    });
+    pool_->Wait();
+
+    result.num_nodes_ += num_nodes_;
+    if (is_found_) {
+      result.is_found_ = true;
+      result.height_ = height;
+      result.placements_ = solution_;
+      return result;
+    }
+  }
+
+  return result;
+}
+
+bool PerfectClearSolver::CanStillClear(uint64_t board, int height,
+    size_t depth) const {
+  size_t tile_gcd = tile_gcds_[depth];
+  if (tile_gcd <= 1) {
+    return true;
+  }
+
+  uint64_t row_mask = GetLowBits(num_cols_);
+  uint64_t full_cols = row_mask;
+  for (int row = 0; row < height; row++) {
+    full_cols &= board >> (static_cast<size_t>(row) * num_cols_);
+  }
+
+  if (full_cols == 0) {
+    return true;
+  }
+
+  uint64_t empty = ~board & GetLowBits(static_cast<size_t>(height)
+      * num_cols_);
+  size_t first_col = 0;
+  for (size_t col = 0; col <= num_cols_; col++) {
+    if (col < num_cols_ && (full_cols >> col & 1u) == 0) {
+      continue;
+    }
+
+    uint64_t segment_cols = GetLowBits(col) & ~GetLowBits(first_col);
+    uint64_t segment = 0;
+    for (int row = 0; row < height; row++) {
+      segment |= segment_cols << (static_cast<size_t>(row) * num_cols_);
+    }
+
+    if (CountBits(empty & segment) % tile_gcd != 0) {
+      return false;
+    }
+
+    first_col = col + 1;
+  }
+
+  return true;
+}
+
+void PerfectClearSolver::FindMoves(uint64_t board, int height, size_t piece,
+    std::vector<Move>* moves) const {
+  moves->clear();
+  uint64_t row_mask = GetLowBits(num_cols_);
+  for (size_t rotation = 0; rotation < BlockTemplate::kNumRotations;
+       rotation++) {
+    const Shape& shape = shapes_[piece][rotation];
+    if (!shape.is_distinct_ || shape.height_ > height
+        || static_cast<size_t>(shape.width_) > num_cols_) {
+      continue;
+    }
+
+    for (int col = 0; col + shape.width_ <= static_cast<int>(num_cols_);
+         col++) {
+      // moved across above the stack, then dropped straight down
+      int row = height - shape.height_;
+      uint64_t bits = shape.bits_ << (static_cast<size_t>(row) * num_cols_
+          + static_cast<size_t>(col));
+      if ((board & bits) != 0) {
+        continue;
+      }
+
+      while (row > 0 && (board & bits >> num_cols_) == 0) {
+        bits >>= num_cols_;
+        row--;
+      }
+
+      // full rows go from the top down, so lower rows keep their place
+      uint64_t placed = board | bits;
+      int placed_height = height;
+      for (int check_row = row + shape.height_ - 1; check_row >= row;
+           check_row--) {
+        size_t shift = static_cast<size_t>(check_row) * num_cols_;
+        if ((placed >> shift & row_mask) != row_mask) {
+          continue;
+        }
+
+        uint64_t above = shift + num_cols_ >= 64 ? 0
+            : placed >> (shift + num_cols_) << shift;
+        placed = (placed & GetLowBits(shift)) | above;
+        placed_height--;
+      }
+
+      bool is_repeat = false;
+      for (const Move& move : *moves) {
+        is_repeat = is_repeat || move.board_ == placed;
+      }
+
+      if (!is_repeat) {
+        moves->push_back(Move{Placement{piece, rotation, col, row}, placed,
+                              placed_height});
+      }
+    }
+  }
+}
+
+bool PerfectClearSolver::Search(uint64_t board, int height, size_t depth,
+    std::vector<Placement>* path, size_t* num_nodes) {
+  (*num_nodes)++;
+  if (height == 0) {
+    return true;
+  }
+
+  FailedPosition position = {board, depth};
+  if (depth == num_used_ || is_found_ || !CanStillClear(board, height, depth)
+      || IsFailed(position)) {
+    return false;
+  }
+
+  std::vector<Move> moves;
+  FindMoves(board, height, depth, &moves);
+  for (const Move& move : moves) {
+    path->push_back(move.placement_);
+    if (Search(move.board_, move.height_, depth + 1, path, num_nodes)) {
+      return true;
+    }
+
+    path->pop_back();
+  }
+
+  // a search cut short by a clear elsewhere didn't see everything
+  if (!is_found_) {
+    MarkFailed(position);
+  }
+
+  return false;
+}
+
+void PerfectClearSolver::SearchTask(uint64_t board, int height, size_t depth,
+    const std::vector<Placement>& path) {
+  if (is_found_) {
+    return;
+  }
+
+  if (depth >= kSplitDepth || height == 0) {
+    std::vector<Placement> local_path = path;
+    size_t num_nodes = 0;
+    if (Search(board, height, depth, &local_path, &num_nodes)) {
+      ReportSolution(local_path);
+    }
+
+    num_nodes_ += num_nodes;
+    return;
+  }
+
+  num_nodes_++;
+  if (depth == num_used_ || !CanStillClear(board, height, depth)) {
+    return;
+  }
+
+  std::vector<Move> moves;
+  FindMoves(board, height, depth, &moves);
+  for (const Move& move : moves) {
+    std::vector<Placement> child_path = path;
+    child_path.push_back(move.placement_);
+    pool_->Submit([this, move, depth, child_path] {
+      SearchTask(move.board_, move.height_, depth + 1, child_path);
+    });
+  }
+}
+
+void PerfectClearSolver::ReportSolution(const std::vector<Placement>& path) {
+  std::lock_guard<std::mutex> lock(result_mutex_);
+  if (!is_found_) {
+    solution_ = path;
+    is_found_ = true;
+  }
+}
+
+bool PerfectClearSolver::IsFailed(const FailedPosition& position) {
+  TableShard& shard =
+      *table_[FailedPositionHash()(position) % kNumTableShards];
+  std::lock_guard<std::mutex> lock(shard.mutex_);
+  return shard.positions_.count(position) != 0;
+}
+
+void PerfectClearSolver::MarkFailed(const FailedPosition& position) {
+  TableShard& shard =
+      *table_[FailedPositionHash()(position) % kNumTableShards];
+  std::lock_guard<std::mutex> lock(shard.mutex_);
+  shard.positions_.insert(position);
+}
+
+std::vector<uint32_t> PerfectClearSolver::GetRows(const Board& board) {
+  std::vector<uint32_t> rows(board.GetNumRows());
+  for (size_t row = 0; row < board.GetNumRows(); row++) {
+    for (size_t col = 0; col < board.GetNumCols(); col++) {
+      if (board.IsFilled(row, col)) {
+        rows[row] |= 1u << col;
+      }
+    }
+  }
+
+  return rows;
+}
+
+size_t PerfectClearSolver::Place(const Placement& placement,
+    const BlockTemplate& block_template, size_t num_cols,
+    std::vector<uint32_t>* rows) {
+  return PlaceOnRows(block_template, placement.rotation_, placement.col_,
+      placement.row_, num_cols, rows);
+}
+
+} // namespace tetris
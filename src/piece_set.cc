@@ -0,0 +1,439 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#include "physics/piece_set.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <sstream>
+
+namespace tetris {
+
+const size_t PieceSet::kMaxPieces;
+const uint32_t PieceSet::kMaxWeight;
+
+const uint32_t kCacheMagic = 0x53505254;  // "TRPS" in a little endian file
+// raise when BlockTemplate or the cache layout changes
+const uint32_t kCacheVersion = 1;
+const uint64_t kFnvOffsetBasis = 14695981039346656037ull;
+const uint64_t kFnvPrime = 1099511628211ull;
+
+namespace {
+
+/**
+ * Start of a cache file, followed by the templates and then the weights.
+ * The cache is only read on the machine that wrote it, so it keeps the
+ * structs as they are in memory, and the size check catches a build that
+ * lays them out differently.
+ */
+struct CacheHeader {
+  uint32_t magic_;
+  uint32_t version_;
+  uint32_t template_size_;
+  uint32_t num_pieces_;
+  uint64_t source_hash_;
+};
+
+/**
+ * A piece as it is read from the text, before it is compiled
+ */
+struct PieceDefinition {
+  std::string name_;
+  size_t line_;
+  std::vector<BlockTemplate::Cell> cells_;
+  float color_[3];
+  bool has_color_;
+  uint32_t weight_;
+  bool has_weight_;
+};
+
+} // namespace
+
+/**
+ * Hashes the text a cache is made from
+ * @param text the text
+ * @return FNV-1a hash of the text
+ */
+static uint64_t HashText(const std::string& text) {
+  uint64_t hash = kFnvOffsetBasis;
+  for (char character : text) {
+    hash = (hash ^ static_cast<uint8_t>(character)) * kFnvPrime;
+  }
+
+  return hash;
+}
+
+/**
+ * Sets an error message that points at a line of the text
+ * @param line line number, counting from 1
+ * @param message what is wrong
+ * @param error set to the message
+ * @return false, so callers can return it
+ */
+static bool Fail(size_t line, const std::string& message,
+    std::string* error) {
+  *error = "line " + std::to_string(line) + ": " + message;
+  return false;
+}
+
+/**
+ * Checks that the tiles of a block all touch, through their sides
+ * @param mask occupancy mask of the tiles
+ * @return true if the tiles form one piece
+ */
+static bool IsConnected(uint16_t mask) {
+  // grows a region from the lowest tile until it stops changing
+  uint32_t region = mask & (~mask + 1u);
+  uint32_t grown = 0;
+  const uint32_t kNotLeftColumn = 0xEEEE;
+  const uint32_t kNotRightColumn = 0x7777;
+  while (grown != region) {
+    grown = region;
+    region |= ((region << 1) & kNotLeftColumn)
+        | ((region >> 1) & kNotRightColumn)
+        | (region << BlockTemplate::kBoxSize)
+        | (region >> BlockTemplate::kBoxSize);
+    region &= mask;
+  }
+
+  return region == mask;
+}
+
+/**
+ * Checks a template read from a cache, so a damaged cache is compiled
+ * again rather than used
+ * @param block_template the template
+ * @param template_id the id it should have
+ * @return true if the template can be used
+ */
+static bool IsTemplateValid(const BlockTemplate& block_template,
+    size_t template_id) {
+  if (block_template.template_id_ != template_id
+      || block_template.num_tiles_ == 0
+      || block_template.num_tiles_ > BlockTemplate::kMaxTiles) {
+    return false;
+  }
+
+  for (size_t rotation = 0; rotation < BlockTemplate::kNumRotations;
+       rotation++) {
+    for (size_t tile = 0; tile < block_template.num_tiles_; tile++) {
+      const BlockTemplate::Cell& cell = block_template.cells_[rotation][tile];
+      if (cell.col_ < 0 || cell.col_ >= BlockTemplate::kBoxSize
+          || cell.row_ < 0 || cell.row_ >= BlockTemplate::kBoxSize) {
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+PieceSet::PieceSet() : data_(nullptr), size_(0), is_mapped_(false),
+    templates_(nullptr), weights_(nullptr), num_pieces_(0), total_weight_(0),
+    is_from_cache_(false) {}
+
+PieceSet::~PieceSet() {
+  Close();
+}
+
+bool PieceSet::Load(const std::string& path, std::string* error) {
+  Close();
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    *error = "could not read " + path;
+    return false;
+  }
+
+  // hashing the text is much cheaper than parsing it and building every
+  // rotation, so it is all a good cache costs
+  std::string text((std::istreambuf_iterator<char>(file)),
+      std::istreambuf_iterator<char>());
+  uint64_t source_hash = HashText(text);
+  std::string cache_path = GetCachePath(path);
+  if (OpenCache(cache_path, source_hash)) {
+    is_from_cache_ = true;
+    return true;
+  }
+
+  if (!Compile(text, &compiled_templates_, &compiled_weights_, error)) {
+    return false;
+  }
+
+  templates_ = compiled_templates_.data();
+  weights_ = compiled_weights_.data();
+  num_pieces_ = compiled_templates_.size();
+  for (uint32_t weight : compiled_weights_) {
+    total_weight_ += weight;
+  }
+
+  WriteCache(cache_path, source_hash);
+  return true;
+}
+
+void PieceSet::WriteCache(const std::string& cache_path,
+    uint64_t source_hash) const {
+  // other processes may have the old cache mapped, so the new one is
+  // written beside it and swapped in whole
+  std::string temp_path = cache_path + ".tmp";
+  {
+    // the set still works from memory when its directory is read only
+    std::unique_ptr<FILE, int (*)(FILE*)> cache(
+        fopen(temp_path.c_str(), "wb"), &fclose);
+    if (!cache) {
+      return;
+    }
+
+    CacheHeader header = {kCacheMagic, kCacheVersion,
+                          static_cast<uint32_t>(sizeof(BlockTemplate)),
+                          static_cast<uint32_t>(num_pieces_), source_hash};
+    bool is_written =
+        fwrite(&header, sizeof(header), 1, cache.get()) == 1
+        && fwrite(templates_, sizeof(BlockTemplate), num_pieces_,
+               cache.get()) == num_pieces_
+        && fwrite(weights_, sizeof(uint32_t), num_pieces_, cache.get())
+               == num_pieces_
+        && fflush(cache.get()) == 0;
+    if (!is_written) {
+      cache.reset();
+      std::remove(temp_path.c_str());
+      return;
+    }
+  }
+
+  if (std::rename(temp_path.c_str(), cache_path.c_str()) != 0) {
+    std::remove(temp_path.c_str());
+  }
+}
+
+bool PieceSet::OpenCache(const std::string& cache_path,
+    uint64_t source_hash) {
+#ifdef _WIN32
+  std::ifstream file(cache_path, std::ios::binary);
+  if (!file) {
+    return false;
+  }
+
+  contents_.assign(std::istreambuf_iterator<char>(file),
+      std::istreambuf_iterator<char>());
+  data_ = contents_.data();
+  size_ = contents_.size();
+#else
+  int fd = open(cache_path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0) {
+    close(fd);
+    return false;
+  }
+
+  void* mapping = mmap(nullptr, static_cast<size_t>(file_stat.st_size),
+      PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    return false;
+  }
+
+  data_ = static_cast<const uint8_t*>(mapping);
+  size_ = static_cast<size_t>(file_stat.st_size);
+  is_mapped_ = true;
+#endif
+
+  CacheHeader header;
+  if (size_ < sizeof(header)) {
+    Close();
+    return false;
+  }
+
+  std::memcpy(&header, data_, sizeof(header));
+  size_t num_pieces = header.num_pieces_;
+  if (header.magic_ != kCacheMagic || header.version_ != kCacheVersion
+      || header.template_size_ != sizeof(BlockTemplate)
+      || header.source_hash_ != source_hash || num_pieces == 0
+      || num_pieces > kMaxPieces || size_ != sizeof(header)
+          + num_pieces * (sizeof(BlockTemplate) + sizeof(uint32_t))) {
+    Close();
+    return false;
+  }
+
+  // the mapping is page aligned and the header keeps what follows aligned
+  templates_ = reinterpret_cast<const BlockTemplate*>(data_ + sizeof(header));
+  weights_ = reinterpret_cast<const uint32_t*>(templates_ + num_pieces);
+  num_pieces_ = num_pieces;
+  for (size_t index = 0; index < num_pieces_; index++) {
+    if (!IsTemplateValid(templates_[index], index) || weights_[index] == 0
+        || weights_[index] > kMaxWeight) {
+      Close();
+      return false;
+    }
+
+    total_weight_ += weights_[index];
+  }
+
+  return true;
+}
+
+void PieceSet::Close() {
+#ifndef _WIN32
+  if (is_mapped_) {
+    munmap(const_cast<uint8_t*>(data_), size_);
+  }
+#endif
+
+  contents_.clear();
+  compiled_templates_.clear();
+  compiled_weights_.clear();
+  data_ = nullptr;
+  size_ = 0;
+  is_mapped_ = false;
+  templates_ = nullptr;
+  weights_ = nullptr;
+  num_pieces_ = 0;
+  total_weight_ = 0;
+  is_from_cache_ = false;
+}
+
+bool PieceSet::Compile(const std::string& text,
+    std::vector<BlockTemplate>* templates, std::vector<uint32_t>* weights,
+    std::string* error) {
+  std::vector<PieceDefinition> pieces;
+  std::istringstream lines(text);
+  std::string line;
+  for (size_t line_number = 1; std::getline(lines, line); line_number++) {
+    line = line.substr(0, line.find('#'));
+    std::istringstream words(line);
+    std::string keyword;
+    if (!(words >> keyword)) {
+      continue;
+    }
+
+    if (keyword == "piece") {
+      PieceDefinition piece = {};
+      piece.line_ = line_number;
+      piece.weight_ = 1;
+      if (!(words >> piece.name_)) {
+        return Fail(line_number, "a piece needs a name", error);
+      }
+
+      pieces.push_back(piece);
+    } else if (pieces.empty()) {
+      return Fail(line_number, "'" + keyword + "' comes before any piece",
+          error);
+    } else if (keyword == "color") {
+      PieceDefinition& piece = pieces.back();
+      if (piece.has_color_) {
+        return Fail(line_number, "color is given twice", error);
+      }
+
+      for (float& channel : piece.color_) {
+        if (!(words >> channel) || channel < 0.0f || channel > 1.0f) {
+          return Fail(line_number,
+              "color needs red, green and blue from 0 to 1", error);
+        }
+      }
+
+      piece.has_color_ = true;
+    } else if (keyword == "weight") {
+      PieceDefinition& piece = pieces.back();
+      long weight = 0;
+      if (piece.has_weight_ || !(words >> weight) || weight < 1
+          || weight > static_cast<long>(kMaxWeight)) {
+        return Fail(line_number, "weight must be given once, from 1 to "
+            + std::to_string(kMaxWeight), error);
+      }
+
+      piece.weight_ = static_cast<uint32_t>(weight);
+      piece.has_weight_ = true;
+    } else if (keyword == "cells") {
+      PieceDefinition& piece = pieces.back();
+      if (!piece.cells_.empty()) {
+        return Fail(line_number, "cells are given twice", error);
+      }
+
+      std::string pair;
+      uint16_t mask = 0;
+      while (words >> pair) {
+        int col = -1;
+        int row = -1;
+        char extra;
+        if (sscanf(pair.c_str(), "%d,%d%c", &col, &row, &extra) != 2
+            || col < 0 || col >= BlockTemplate::kBoxSize
+            || row < 0 || row >= BlockTemplate::kBoxSize) {
+          return Fail(line_number, "'" + pair
+              + "' is not a column,row in the 4 by 4 box", error);
+        }
+
+        uint16_t bit =
+            static_cast<uint16_t>(1u << BlockTemplate::GetMaskBit(col, row));
+        if ((mask & bit) != 0) {
+          return Fail(line_number, "cell " + pair + " is listed twice", error);
+        }
+
+        mask = static_cast<uint16_t>(mask | bit);
+        piece.cells_.push_back(BlockTemplate::Cell{static_cast<int8_t>(col),
+                                                   static_cast<int8_t>(row)});
+      }
+
+      if (piece.cells_.empty()
+          || piece.cells_.size() > BlockTemplate::kMaxTiles) {
+        return Fail(line_number, "a piece needs 1 to "
+            + std::to_string(BlockTemplate::kMaxTiles) + " cells", error);
+      }
+
+      if (!IsConnected(mask)) {
+        return Fail(line_number, "cells must touch each other", error);
+      }
+    } else {
+      return Fail(line_number, "unknown keyword '" + keyword + "'", error);
+    }
+  }
+
+  if (pieces.empty() || pieces.size() > kMaxPieces) {
+    return Fail(1, "a piece set needs 1 to " + std::to_string(kMaxPieces)
+        + " pieces", error);
+  }
+
+  templates->clear();
+  weights->clear();
+  for (const PieceDefinition& piece : pieces) {
+    if (piece.cells_.empty() || !piece.has_color_) {
+      return Fail(piece.line_, "piece " + piece.name_
+          + " needs both cells and a color", error);
+    }
+
+    templates->push_back(BuildBlockTemplate(
+        static_cast<uint8_t>(templates->size()), piece.cells_.data(),
+        piece.cells_.size(), piece.color_[0], piece.color_[1],
+        piece.color_[2]));
+    weights->push_back(piece.weight_);
+  }
+
+  return true;
+}
+
+size_t PieceSet::PickPiece(std::mt19937* random) const {
+  std::uniform_int_distribution<uint32_t> dist(0, total_weight_ - 1);
+  uint32_t roll = dist(*random);
+  for (size_t index = 0; index + 1 < num_pieces_; index++) {
+    if (roll < weights_[index]) {
+      return index;
+    }
+
+    roll -= weights_[index];
+  }
+
+  return num_pieces_ - 1;
+}
+
+} // namespace tetris
@@ -0,0 +1,276 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#include "physics/polyomino.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <unordered_set>
+
+#include "server/work_stealing_pool.h"
+
+namespace tetris {
+
+const size_t Polyomino::kMaxCells;
+
+// a shape turned or flipped, as the eight ways a square maps onto itself
+const size_t kNumSymmetries = 8;
+// tasks per thread when growing a size, so stealing evens them out
+const size_t kGrowTasksPerThread = 8;
+// hash shards per thread when merging the shapes a size grew into
+const size_t kMergeShardsPerThread = 4;
+const uint64_t kFnvOffsetBasis = 14695981039346656037ull;
+const uint64_t kFnvPrime = 1099511628211ull;
+
+using PolyominoSet = std::unordered_set<Polyomino, PolyominoHash>;
+
+Polyomino Polyomino::FromCells(const std::vector<BlockTemplate::Cell>& cells) {
+  int min_col = static_cast<int>(kMaxCells);
+  int min_row = static_cast<int>(kMaxCells);
+  int max_col = -1;
+  int max_row = -1;
+  for (const BlockTemplate::Cell& cell : cells) {
+    min_col = std::min<int>(min_col, cell.col_);
+    min_row = std::min<int>(min_row, cell.row_);
+    max_col = std::max<int>(max_col, cell.col_);
+    max_row = std::max<int>(max_row, cell.row_);
+  }
+
+  int width = max_col - min_col + 1;
+  int height = max_row - min_row + 1;
+  Polyomino best;
+  best.num_cells_ = static_cast<uint8_t>(cells.size());
+  for (size_t symmetry = 0; symmetry < kNumSymmetries; symmetry++) {
+    Polyomino turned;
+    turned.num_cells_ = best.num_cells_;
+    for (const BlockTemplate::Cell& cell : cells) {
+      int col = cell.col_ - min_col;
+      int row = cell.row_ - min_row;
+      int mirrored_col = width - 1 - col;
+      int mirrored_row = height - 1 - row;
+      // identity, the three quarter turns, then their mirror images
+      const int turned_cols[kNumSymmetries] = {
+          col, row, mirrored_col, mirrored_row,
+          mirrored_col, row, col, mirrored_row};
+      const int turned_rows[kNumSymmetries] = {
+          row, mirrored_col, mirrored_row, col,
+          row, col, mirrored_row, mirrored_col};
+      uint16_t& turned_row = turned.rows_[turned_rows[symmetry]];
+      turned_row = static_cast<uint16_t>(
+          turned_row | 1u << turned_cols[symmetry]);
+    }
+
+    if (symmetry == 0 || turned < best) {
+      best = turned;
+    }
+  }
+
+  return best;
+}
+
+std::vector<BlockTemplate::Cell> Polyomino::GetCells() const {
+  std::vector<BlockTemplate::Cell> cells;
+  for (size_t row = 0; row < kMaxCells; row++) {
+    for (size_t col = 0; col < kMaxCells; col++) {
+      if ((rows_[row] >> col & 1u) != 0) {
+        cells.push_back(BlockTemplate::Cell{static_cast<int8_t>(col),
+                                            static_cast<int8_t>(row)});
+      }
+    }
+  }
+
+  return cells;
+}
+
+void Polyomino::Grow(std::vector<Polyomino>* children) const {
+  if (num_cells_ >= kMaxCells) {
+    return;
+  }
+
+  // moved up and right by one, so tiles can be added below and left
+  std::vector<BlockTemplate::Cell> cells = GetCells();
+  std::array<uint32_t, kMaxCells + 2> occupied = {};
+  for (BlockTemplate::Cell& cell : cells) {
+    cell.col_++;
+    cell.row_++;
+    occupied[cell.row_] |= 1u << cell.col_;
+  }
+
+  const int kNeighbourCols[] = {-1, 1, 0, 0};
+  const int kNeighbourRows[] = {0, 0, -1, 1};
+  std::array<uint32_t, kMaxCells + 2> tried = occupied;
+  size_t num_cells = cells.size();
+  for (size_t tile = 0; tile < num_cells; tile++) {
+    for (size_t side = 0; side < 4; side++) {
+      int col = cells[tile].col_ + kNeighbourCols[side];
+      int row = cells[tile].row_ + kNeighbourRows[side];
+      if ((tried[row] >> col & 1u) != 0) {
+        continue;
+      }
+
+      tried[row] |= 1u << col;
+      cells.push_back(BlockTemplate::Cell{static_cast<int8_t>(col),
+                                          static_cast<int8_t>(row)});
+      children->push_back(FromCells(cells));
+      cells.pop_back();
+    }
+  }
+}
+
+bool Polyomino::FitsBox(int box_size) const {
+  return GetWidth() <= box_size && GetHeight() <= box_size;
+}
+
+bool Polyomino::CanLieFlat() const {
+  int width = GetWidth();
+  int height = GetHeight();
+  uint32_t full_row = (1u << width) - 1;
+  if (rows_[0] == full_row || rows_[height - 1] == full_row) {
+    return true;
+  }
+
+  // a quarter turn either way puts the first or last column at the bottom
+  bool is_first_col_full = true;
+  bool is_last_col_full = true;
+  for (int row = 0; row < height; row++) {
+    is_first_col_full = is_first_col_full && (rows_[row] & 1u) != 0;
+    is_last_col_full = is_last_col_full
+        && (rows_[row] >> (width - 1) & 1u) != 0;
+  }
+
+  return is_first_col_full || is_last_col_full;
+}
+
+int Polyomino::GetWidth() const {
+  uint32_t filled_cols = 0;
+  for (uint16_t row : rows_) {
+    filled_cols |= row;
+  }
+
+  int width = 0;
+  while (filled_cols >> width != 0) {
+    width++;
+  }
+
+  return width;
+}
+
+int Polyomino::GetHeight() const {
+  int height = static_cast<int>(kMaxCells);
+  while (height > 0 && rows_[height - 1] == 0) {
+    height--;
+  }
+
+  return height;
+}
+
+uint64_t Polyomino::GetHash() const {
+  uint64_t hash = kFnvOffsetBasis;
+  for (uint16_t row : rows_) {
+    hash = (hash ^ (row & 0xFFu)) * kFnvPrime;
+    hash = (hash ^ (row >> 8u)) * kFnvPrime;
+  }
+
+  return hash;
+}
+
+std::vector<std::vector<Polyomino>> PolyominoEnumerator::Enumerate(
+    size_t max_cells, WorkStealingPool* pool) {
+  std::vector<std::vector<Polyomino>> sizes;
+  max_cells = std::min(max_cells, Polyomino::kMaxCells);
+  if (max_cells == 0) {
+    return sizes;
+  }
+
+  sizes.push_back({Polyomino::FromCells({BlockTemplate::Cell{0, 0}})});
+  size_t num_shards = pool->GetNumThreads() * kMergeShardsPerThread;
+  while (sizes.size() < max_cells) {
+    const std::vector<Polyomino>& parents = sizes.back();
+    size_t num_tasks = std::min(parents.size(),
+        pool->GetNumThreads() * kGrowTasksPerThread);
+
+    // every task grows its share of the parents and drops the repeats it
+    // sees itself, sorting what is left into shards by hash
+    std::vector<std::vector<std::vector<Polyomino>>> grown(num_tasks,
+        std::vector<std::vector<Polyomino>>(num_shards));
+    pool->ParallelFor(num_tasks, [&](size_t task) {
+      PolyominoSet seen;
+      std::vector<Polyomino> children;
+      // interleaved, since parents sorted together grow alike
+      for (size_t index = task; index < parents.size(); index += num_tasks) {
+        children.clear();
+        parents[index].Grow(&children);
+        for (const Polyomino& child : children) {
+          if (seen.insert(child).second) {
+            grown[task][(child.GetHash() >> 32) % num_shards].push_back(child);
+          }
+        }
+      }
+    });
+
+    // a shape always lands in the same shard, so shards merge on their own
+    std::vector<std::vector<Polyomino>> shards(num_shards);
+    pool->ParallelFor(num_shards, [&](size_t shard) {
+      PolyominoSet seen;
+      for (std::vector<std::vector<Polyomino>>& task_shards : grown) {
+        for (const Polyomino& child : task_shards[shard]) {
+          if (seen.insert(child).second) {
+            shards[shard].push_back(child);
+          }
+        }
+
+        std::vector<Polyomino>().swap(task_shards[shard]);
+      }
+    });
+
+    std::vector<Polyomino> children;
+    for (const std::vector<Polyomino>& shard : shards) {
+      children.insert(children.end(), shard.begin(), shard.end());
+    }
+
+    std::sort(children.begin(), children.end());
+    sizes.push_back(std::move(children));
+  }
+
+  return sizes;
+}
+
+std::string PolyominoEnumerator::WritePieceSet(
+    const std::vector<Polyomino>& pieces) {
+  std::string text = "# " + std::to_string(pieces.size())
+      + " pieces from polyomino_enumerator\n";
+  char line[64];
+  for (size_t index = 0; index < pieces.size(); index++) {
+    const Polyomino& piece = pieces[index];
+    snprintf(line, sizeof(line), "\npiece p%zu_%zu\n", piece.GetNumCells(),
+        index);
+    text += line;
+
+    // hues spread around the color wheel, at full brightness
+    float hue = 6.0f * static_cast<float>(index)
+        / static_cast<float>(pieces.size());
+    float rising = hue - std::floor(hue);
+    float channels[6][3] = {{1.0f, rising, 0.0f}, {1.0f - rising, 1.0f, 0.0f},
+                            {0.0f, 1.0f, rising}, {0.0f, 1.0f - rising, 1.0f},
+                            {rising, 0.0f, 1.0f}, {1.0f, 0.0f, 1.0f - rising}};
+    const float* color = channels[static_cast<size_t>(hue) % 6];
+    snprintf(line, sizeof(line), "color %.2f %.2f %.2f\ncells", color[0],
+        color[1], color[2]);
+    text += line;
+
+    // centered, so the block turns about its middle
+    int col_offset = (BlockTemplate::kBoxSize - piece.GetWidth()) / 2;
+    int row_offset = (BlockTemplate::kBoxSize - piece.GetHeight()) / 2;
+    for (const BlockTemplate::Cell& cell : piece.GetCells()) {
+      snprintf(line, sizeof(line), " %d,%d", cell.col_ + col_offset,
+          cell.row_ + row_offset);
+      text += line;
+    }
+
+    text += "\n";
+  }
+
+  return text;
+}
+
+} // namespace tetris
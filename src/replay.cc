@@ -0,0 +1,154 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#include "persistence/replay.h"
+
+#include <algorithm>
+
+namespace tetris {
+
+const uint8_t kReplayVersion = 1;
+// version, game state, flags, seed and input count
+const size_t kReplayHeaderSize = 11;
+// tick and move
+const size_t kReplayInputSize = 5;
+const uint8_t kBombModeFlag = 1;
+const uint8_t kTileDisconnectedModeFlag = 2;
+
+/**
+ * Appends a number in little endian byte order
+ * @param value the number
+ * @param bytes bytes to append to
+ */
+static void AppendUint32(uint32_t value, std::vector<uint8_t>* bytes) {
+  for (size_t shift = 0; shift < 32; shift += 8) {
+    bytes->push_back(static_cast<uint8_t>(value >> shift));
+  }
+}
+
+/**
+ * Reads a number written by AppendUint32
+ * @param bytes first of the four bytes
+ * @return the number
+ */
+static uint32_t ReadUint32(const uint8_t* bytes) {
+  return static_cast<uint32_t>(bytes[0])
+      | static_cast<uint32_t>(bytes[1]) << 8
+      | static_cast<uint32_t>(bytes[2]) << 16
+      | static_cast<uint32_t>(bytes[3]) << 24;
+}
+
+Replay::Replay() : seed_(0), game_state_(World::kClassic),
+    is_bomb_mode_(false), is_tile_disconnected_mode_(false) {}
+
+void Replay::Start(const World& world) {
+  seed_ = world.GetSeed();
+  game_state_ = world.GetCurrentGameState();
+  is_bomb_mode_ = world.GetIsBombMode();
+  is_tile_disconnected_mode_ = world.GetIsTileDisconnectedMode();
+  inputs_.clear();
+}
+
+void Replay::AddInput(size_t tick, Block::Move move) {
+  inputs_.push_back(Input{static_cast<uint32_t>(tick), move});
+}
+
+std::vector<uint8_t> Replay::Serialize() const {
+  std::vector<uint8_t> blob;
+  blob.reserve(kReplayHeaderSize + inputs_.size() * kReplayInputSize);
+  blob.push_back(kReplayVersion);
+  blob.push_back(static_cast<uint8_t>(game_state_));
+  blob.push_back((is_bomb_mode_ ? kBombModeFlag : 0)
+      | (is_tile_disconnected_mode_ ? kTileDisconnectedModeFlag : 0));
+  AppendUint32(seed_, &blob);
+  AppendUint32(static_cast<uint32_t>(inputs_.size()), &blob);
+  for (const Input& input : inputs_) {
+    AppendUint32(input.tick_, &blob);
+    blob.push_back(static_cast<uint8_t>(input.move_));
+  }
+
+  return blob;
+}
+
+bool Replay::Deserialize(const std::vector<uint8_t>& blob) {
+  if (blob.size() < kReplayHeaderSize || blob[0] != kReplayVersion
+      || (blob[1] != World::kClassic && blob[1] != World::kReloaded)) {
+    return false;
+  }
+
+  size_t num_inputs = ReadUint32(&blob[7]);
+  if (blob.size() != kReplayHeaderSize + num_inputs * kReplayInputSize) {
+    return false;
+  }
+
+  std::vector<Input> inputs;
+  inputs.reserve(num_inputs);
+  for (size_t index = 0; index < num_inputs; index++) {
+    const uint8_t* input = &blob[kReplayHeaderSize + index * kReplayInputSize];
+    if (input[4] > Block::kHold) {
+      return false;
+    }
+
+    inputs.push_back(
+        Input{ReadUint32(input), static_cast<Block::Move>(input[4])});
+  }
+
+  game_state_ = static_cast<World::GameState>(blob[1]);
+  is_bomb_mode_ = (blob[2] & kBombModeFlag) != 0;
+  is_tile_disconnected_mode_ = (blob[2] & kTileDisconnectedModeFlag) != 0;
+  seed_ = ReadUint32(&blob[3]);
+  inputs_.swap(inputs);
+  return true;
+}
+
+bool Replay::Play(World* world, size_t max_ticks,
+    const std::function<bool(const World&)>& is_stopped) const {
+  Begin(world);
+  return Advance(world, max_ticks, is_stopped);
+}
+
+void Replay::Begin(World* world) const {
+  world->SetSeed(seed_);
+  world->SetIsBombMode(is_bomb_mode_);
+  world->SetIsTileDisconnectedMode(is_tile_disconnected_mode_);
+  world->SetCurrentGameState(game_state_);
+}
+
+bool Replay::Advance(World* world, size_t end_tick,
+    const std::function<bool(const World&)>& is_stopped) const {
+  // moves recorded before the world's tick were made before it got there
+  auto next_input = std::lower_bound(inputs_.begin(), inputs_.end(),
+      world->GetTickCount(), [](const Input& input, size_t tick) {
+        return input.tick_ < tick;
+      });
+  while ((world->GetCurrentGameState() == World::kClassic
+          || world->GetCurrentGameState() == World::kReloaded)
+         && world->GetTickCount() < end_tick) {
+    // moves were made between steps, before the tick they were recorded at
+    while (next_input != inputs_.end()
+           && next_input->tick_ <= world->GetTickCount()) {
+      world->Move(next_input->move_);
+      ++next_input;
+    }
+
+    world->Step();
+    if (is_stopped && is_stopped(*world)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+std::string Replay::GetModeName() const {
+  if (is_bomb_mode_) {
+    return "bomb";
+  }
+
+  if (is_tile_disconnected_mode_) {
+    return "blitz";
+  }
+
+  return game_state_ == World::kReloaded ? "reloaded" : "classic";
+}
+
+} // namespace tetris
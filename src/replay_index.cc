@@ -0,0 +1,359 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#include "persistence/replay_index.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <memory>
+
+#include "physics/world_listener.h"
+
+namespace tetris {
+
+const size_t ReplayIndex::kDefaultKeyframeInterval;
+const size_t ReplayIndex::kNoTick;
+
+const uint32_t kIndexMagic = 0x494B5254;  // "TRKI" read as little endian
+const uint32_t kIndexVersion = 1;
+const size_t kIndexHeaderSize = 24;
+// offset and size of a keyframe
+const size_t kKeyframeEntrySize = 12;
+
+/**
+ * Appends a number in little endian byte order
+ * @param value the number
+ * @param bytes bytes to append to
+ */
+static void AppendUint32(uint32_t value, std::vector<uint8_t>* bytes) {
+  for (size_t shift = 0; shift < 32; shift += 8) {
+    bytes->push_back(static_cast<uint8_t>(value >> shift));
+  }
+}
+
+/**
+ * Appends a number in little endian byte order
+ * @param value the number
+ * @param bytes bytes to append to
+ */
+static void AppendUint64(uint64_t value, std::vector<uint8_t>* bytes) {
+  AppendUint32(static_cast<uint32_t>(value), bytes);
+  AppendUint32(static_cast<uint32_t>(value >> 32), bytes);
+}
+
+/**
+ * Reads a number written by AppendUint32
+ * @param bytes first of the four bytes
+ * @return the number
+ */
+static uint32_t ReadUint32(const uint8_t* bytes) {
+  return static_cast<uint32_t>(bytes[0])
+      | static_cast<uint32_t>(bytes[1]) << 8
+      | static_cast<uint32_t>(bytes[2]) << 16
+      | static_cast<uint32_t>(bytes[3]) << 24;
+}
+
+/**
+ * Reads a number written by AppendUint64
+ * @param bytes first of the eight bytes
+ * @return the number
+ */
+static uint64_t ReadUint64(const uint8_t* bytes) {
+  return ReadUint32(bytes) | static_cast<uint64_t>(ReadUint32(bytes + 4)) << 32;
+}
+
+namespace {
+
+/**
+ * Records the hash of every tick and a keyframe every interval while an
+ * index is built
+ */
+class KeyframeRecorder : public WorldListener {
+ private:
+  size_t keyframe_interval_;
+  std::vector<uint64_t> hashes_;
+  std::vector<std::vector<uint8_t>> keyframes_;
+
+ public:
+  explicit KeyframeRecorder(size_t keyframe_interval)
+      : keyframe_interval_(keyframe_interval) {}
+
+  void OnStepFinished(const World& world) override {
+    Record(world);
+  }
+
+  /**
+   * Records the world as it is now
+   * @param world the world
+   */
+  void Record(const World& world) {
+    hashes_.push_back(world.GetStateHash());
+    // a game that just ended has nothing left to seek into
+    bool is_playing = world.GetCurrentGameState() == World::kClassic
+        || world.GetCurrentGameState() == World::kReloaded;
+    if (is_playing && world.GetTickCount() % keyframe_interval_ == 0) {
+      keyframes_.push_back(world.SaveSnapshot());
+    }
+  }
+
+  const std::vector<uint64_t>& GetHashes() const {
+    return hashes_;
+  }
+
+  const std::vector<std::vector<uint8_t>>& GetKeyframes() const {
+    return keyframes_;
+  }
+};
+
+} // namespace
+
+ReplayIndex::ReplayIndex() : data_(nullptr), size_(0), is_mapped_(false),
+    keyframe_interval_(0), num_ticks_(0), num_keyframes_(0),
+    hashes_(nullptr), keyframe_table_(nullptr) {}
+
+ReplayIndex::~ReplayIndex() {
+  Close();
+}
+
+bool ReplayIndex::Build(const Replay& replay, size_t keyframe_interval,
+    size_t max_ticks, const std::string& path) {
+  if (keyframe_interval == 0) {
+    return false;
+  }
+
+  World world(false);
+  KeyframeRecorder recorder(keyframe_interval);
+  replay.Begin(&world);
+  recorder.Record(world);
+  world.AddListener(&recorder);
+  replay.Advance(&world, max_ticks);
+  world.RemoveListener(&recorder);
+
+  const std::vector<uint64_t>& hashes = recorder.GetHashes();
+  const std::vector<std::vector<uint8_t>>& keyframes =
+      recorder.GetKeyframes();
+  std::vector<uint8_t> replay_blob = replay.Serialize();
+  std::vector<uint8_t> head;
+  AppendUint32(kIndexMagic, &head);
+  AppendUint32(kIndexVersion, &head);
+  AppendUint32(static_cast<uint32_t>(keyframe_interval), &head);
+  AppendUint32(static_cast<uint32_t>(hashes.size() - 1), &head);
+  AppendUint32(static_cast<uint32_t>(keyframes.size()), &head);
+  AppendUint32(static_cast<uint32_t>(replay_blob.size()), &head);
+  head.insert(head.end(), replay_blob.begin(), replay_blob.end());
+  for (uint64_t hash : hashes) {
+    AppendUint64(hash, &head);
+  }
+
+  uint64_t offset = head.size() + keyframes.size() * kKeyframeEntrySize;
+  for (const std::vector<uint8_t>& keyframe : keyframes) {
+    AppendUint64(offset, &head);
+    AppendUint32(static_cast<uint32_t>(keyframe.size()), &head);
+    offset += keyframe.size();
+  }
+
+  std::unique_ptr<FILE, int (*)(FILE*)> file(fopen(path.c_str(), "wb"),
+      &fclose);
+  if (!file) {
+    return false;
+  }
+
+  fwrite(head.data(), 1, head.size(), file.get());
+  for (const std::vector<uint8_t>& keyframe : keyframes) {
+    fwrite(keyframe.data(), 1, keyframe.size(), file.get());
+  }
+
+  return !ferror(file.get());
+}
+
+bool ReplayIndex::Open(const std::string& path) {
+  Close();
+#ifdef _WIN32
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    return false;
+  }
+
+  contents_.assign(std::istreambuf_iterator<char>(file),
+      std::istreambuf_iterator<char>());
+  data_ = contents_.data();
+  size_ = contents_.size();
+#else
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0) {
+    close(fd);
+    return false;
+  }
+
+  // pages are read in by the OS as keyframes are touched, so opening a
+  // long game costs the same as a short one
+  void* mapping = mmap(nullptr, static_cast<size_t>(file_stat.st_size),
+      PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    return false;
+  }
+
+  data_ = static_cast<const uint8_t*>(mapping);
+  size_ = static_cast<size_t>(file_stat.st_size);
+  is_mapped_ = true;
+#endif
+
+  if (size_ < kIndexHeaderSize || ReadUint32(data_) != kIndexMagic
+      || ReadUint32(data_ + 4) != kIndexVersion || ReadUint32(data_ + 8) == 0) {
+    Close();
+    return false;
+  }
+
+  keyframe_interval_ = ReadUint32(data_ + 8);
+  num_ticks_ = ReadUint32(data_ + 12);
+  num_keyframes_ = ReadUint32(data_ + 16);
+  size_t replay_size = ReadUint32(data_ + 20);
+  size_t hashes_offset = kIndexHeaderSize + replay_size;
+  size_t table_offset = hashes_offset + (num_ticks_ + 1) * sizeof(uint64_t);
+  if (num_keyframes_ == 0 || hashes_offset > size_ || table_offset > size_
+      || size_ - table_offset < num_keyframes_ * kKeyframeEntrySize
+      || !replay_.Deserialize(std::vector<uint8_t>(
+          data_ + kIndexHeaderSize, data_ + hashes_offset))) {
+    Close();
+    return false;
+  }
+
+  hashes_ = data_ + hashes_offset;
+  keyframe_table_ = data_ + table_offset;
+  return true;
+}
+
+void ReplayIndex::Close() {
+#ifndef _WIN32
+  if (is_mapped_) {
+    munmap(const_cast<uint8_t*>(data_), size_);
+  }
+#endif
+
+  contents_.clear();
+  data_ = nullptr;
+  size_ = 0;
+  is_mapped_ = false;
+  keyframe_interval_ = 0;
+  num_ticks_ = 0;
+  num_keyframes_ = 0;
+  hashes_ = nullptr;
+  keyframe_table_ = nullptr;
+}
+
+bool ReplayIndex::RestoreKeyframe(size_t keyframe, World* world) const {
+  const uint8_t* entry = keyframe_table_ + keyframe * kKeyframeEntrySize;
+  uint64_t offset = ReadUint64(entry);
+  size_t size = ReadUint32(entry + 8);
+  if (offset > size_ || size_ - offset < size) {
+    return false;
+  }
+
+  return world->RestoreSnapshot(data_ + offset, size);
+}
+
+size_t ReplayIndex::GetKeyframeBefore(size_t tick) const {
+  return std::min(tick / keyframe_interval_, num_keyframes_ - 1);
+}
+
+bool ReplayIndex::SeekTo(World* world, size_t tick) const {
+  if (data_ == nullptr) {
+    return false;
+  }
+
+  tick = std::min(tick, num_ticks_);
+  if (!RestoreKeyframe(GetKeyframeBefore(tick), world)) {
+    return false;
+  }
+
+  replay_.Advance(world, tick);
+  return world->GetTickCount() == tick;
+}
+
+size_t ReplayIndex::FindDesync(size_t keyframe) const {
+  World world(false);
+  if (keyframe >= num_keyframes_ || !RestoreKeyframe(keyframe, &world)) {
+    return keyframe * keyframe_interval_;
+  }
+
+  // the last keyframe runs on to the end of the game
+  size_t end_tick = keyframe + 1 < num_keyframes_
+      ? (keyframe + 1) * keyframe_interval_ : num_ticks_;
+  for (size_t tick = world.GetTickCount(); ; tick++) {
+    if (world.GetTickCount() != tick
+        || world.GetStateHash() != GetTickHash(tick)) {
+      return tick;
+    }
+
+    if (tick >= end_tick) {
+      return kNoTick;
+    }
+
+    replay_.Advance(&world, tick + 1);
+  }
+}
+
+size_t ReplayIndex::Bisect(
+    const std::function<bool(const World&)>& predicate) const {
+  if (data_ == nullptr) {
+    return kNoTick;
+  }
+
+  // finds the first keyframe where the condition already holds
+  World world(false);
+  size_t low = 0;
+  size_t high = num_keyframes_;
+  while (low < high) {
+    size_t middle = low + (high - low) / 2;
+    if (RestoreKeyframe(middle, &world) && predicate(world)) {
+      high = middle;
+    } else {
+      low = middle + 1;
+    }
+  }
+
+  if (low == 0) {
+    return RestoreKeyframe(0, &world) && predicate(world) ? 0 : kNoTick;
+  }
+
+  // it turned true somewhere after the keyframe before that one
+  if (!RestoreKeyframe(low - 1, &world)) {
+    return kNoTick;
+  }
+
+  size_t end_tick = low < num_keyframes_ ? low * keyframe_interval_
+                                         : num_ticks_;
+  while (world.GetTickCount() < end_tick) {
+    size_t tick = world.GetTickCount();
+    replay_.Advance(&world, tick + 1);
+    if (world.GetTickCount() == tick) {
+      break;
+    }
+
+    if (predicate(world)) {
+      return world.GetTickCount();
+    }
+  }
+
+  return kNoTick;
+}
+
+uint64_t ReplayIndex::GetTickHash(size_t tick) const {
+  return ReadUint64(hashes_ + tick * sizeof(uint64_t));
+}
+
+} // namespace tetris
@@ -0,0 +1,34 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#include "physics/row_bits.h"
+
+#include <algorithm>
+
+namespace tetris {
+
+uint32_t GetFullRowBits(size_t num_cols) {
+  return num_cols >= 32 ? ~0u : (1u << num_cols) - 1;
+}
+
+size_t PlaceOnRows(const BlockTemplate& block_template, size_t rotation,
+    int col, int row, size_t num_cols, std::vector<uint32_t>* rows) {
+  const BlockTemplate::Box& box = block_template.boxes_[rotation];
+  for (size_t tile = 0; tile < block_template.num_tiles_; tile++) {
+    const BlockTemplate::Cell& cell = block_template.cells_[rotation][tile];
+    size_t tile_row = static_cast<size_t>(row + cell.row_ - box.min_row_);
+    size_t tile_col = static_cast<size_t>(col + cell.col_ - box.min_col_);
+    if (tile_row >= rows->size()) {
+      rows->resize(tile_row + 1);
+    }
+
+    (*rows)[tile_row] |= 1u << tile_col;
+  }
+
+  uint32_t full_row = GetFullRowBits(num_cols);
+  size_t num_rows = rows->size();
+  rows->erase(std::remove(rows->begin(), rows->end(), full_row),
+      rows->end());
+  return num_rows - rows->size();
+}
+
+} // namespace tetris
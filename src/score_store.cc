@@ -0,0 +1,250 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#include "persistence/score_store.h"
+
+#include <sqlite3.h>
+
+#include <algorithm>
+
+namespace tetris {
+
+const size_t ScoreStore::kDefaultLeaderboardSize;
+
+const char kCreateTableSql[] =
+    "CREATE TABLE IF NOT EXISTS scores ("
+    "id INTEGER PRIMARY KEY, "
+    "score INTEGER NOT NULL, "
+    "mode TEXT NOT NULL, "
+    "seed INTEGER NOT NULL, "
+    "played_at INTEGER NOT NULL, "
+    "replay BLOB);"
+    "CREATE INDEX IF NOT EXISTS scores_by_mode ON scores (mode, score DESC);";
+const char kInsertSql[] =
+    "INSERT INTO scores (score, mode, seed, played_at, replay) "
+    "VALUES (?, ?, ?, ?, ?);";
+const char kSelectModesSql[] = "SELECT DISTINCT mode FROM scores;";
+const char kSelectBestSql[] =
+    "SELECT score, seed, played_at FROM scores WHERE mode = ? "
+    "ORDER BY score DESC, id LIMIT ?;";
+
+ScoreStore::ScoreStore() : database_(nullptr), insert_statement_(nullptr),
+    leaderboard_size_(kDefaultLeaderboardSize), num_in_flight_(0),
+    num_stored_(0), is_stopping_(false) {}
+
+ScoreStore::~ScoreStore() {
+  if (writer_thread_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      is_stopping_ = true;
+    }
+
+    has_pending_.notify_one();
+    writer_thread_.join();
+  }
+
+  sqlite3_finalize(insert_statement_);
+  sqlite3_close(database_);
+}
+
+bool ScoreStore::Open(const std::string& path, size_t leaderboard_size) {
+  if (database_ != nullptr) {
+    return false;
+  }
+
+  leaderboard_size_ = leaderboard_size;
+  if (sqlite3_open(path.c_str(), &database_) != SQLITE_OK) {
+    sqlite3_close(database_);
+    database_ = nullptr;
+    return false;
+  }
+
+  // the write-ahead log lets readers in while a batch is being written,
+  // and only syncs to disk at checkpoints rather than every commit
+  if (sqlite3_exec(database_, "PRAGMA journal_mode = WAL;"
+                   "PRAGMA synchronous = NORMAL;", nullptr, nullptr, nullptr)
+          != SQLITE_OK
+      || sqlite3_exec(database_, kCreateTableSql, nullptr, nullptr, nullptr)
+          != SQLITE_OK
+      || sqlite3_prepare_v2(database_, kInsertSql, -1, &insert_statement_,
+          nullptr) != SQLITE_OK
+      || !LoadLeaderboards()) {
+    sqlite3_finalize(insert_statement_);
+    insert_statement_ = nullptr;
+    sqlite3_close(database_);
+    database_ = nullptr;
+    return false;
+  }
+
+  writer_thread_ = std::thread(&ScoreStore::WriterLoop, this);
+  return true;
+}
+
+bool ScoreStore::LoadLeaderboards() {
+  sqlite3_stmt* modes_statement = nullptr;
+  sqlite3_stmt* best_statement = nullptr;
+  if (sqlite3_prepare_v2(database_, kSelectModesSql, -1, &modes_statement,
+          nullptr) != SQLITE_OK
+      || sqlite3_prepare_v2(database_, kSelectBestSql, -1, &best_statement,
+          nullptr) != SQLITE_OK) {
+    sqlite3_finalize(modes_statement);
+    return false;
+  }
+
+  while (sqlite3_step(modes_statement) == SQLITE_ROW) {
+    std::string mode = reinterpret_cast<const char*>(
+        sqlite3_column_text(modes_statement, 0));
+    std::vector<LeaderboardEntry>& leaderboard = leaderboards_[mode];
+
+    sqlite3_bind_text(best_statement, 1, mode.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_int64(best_statement, 2, leaderboard_size_);
+    while (sqlite3_step(best_statement) == SQLITE_ROW) {
+      leaderboard.push_back(LeaderboardEntry{
+          static_cast<size_t>(sqlite3_column_int64(best_statement, 0)),
+          static_cast<uint32_t>(sqlite3_column_int64(best_statement, 1)),
+          sqlite3_column_int64(best_statement, 2)});
+    }
+
+    sqlite3_reset(best_statement);
+  }
+
+  sqlite3_finalize(modes_statement);
+  sqlite3_finalize(best_statement);
+  return true;
+}
+
+void ScoreStore::AddToLeaderboard(const ScoreRecord& record) {
+  std::vector<LeaderboardEntry>& leaderboard = leaderboards_[record.mode_];
+  // ties keep the earlier score ahead
+  auto position = std::upper_bound(leaderboard.begin(), leaderboard.end(),
+      record.score_, [](size_t score, const LeaderboardEntry& entry) {
+        return score > entry.score_;
+      });
+  if (static_cast<size_t>(position - leaderboard.begin())
+      >= leaderboard_size_) {
+    return;
+  }
+
+  leaderboard.insert(position,
+      LeaderboardEntry{record.score_, record.seed_, record.played_at_});
+  if (leaderboard.size() > leaderboard_size_) {
+    leaderboard.pop_back();
+  }
+}
+
+void ScoreStore::Submit(ScoreRecord record) {
+  if (database_ == nullptr) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_records_.push_back(std::move(record));
+  }
+
+  has_pending_.notify_one();
+}
+
+void ScoreStore::Flush() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  is_flushed_.wait(lock, [this] {
+    return pending_records_.empty() && num_in_flight_ == 0;
+  });
+}
+
+std::vector<LeaderboardEntry> ScoreStore::GetLeaderboard(
+    const std::string& mode) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto leaderboard = leaderboards_.find(mode);
+  if (leaderboard == leaderboards_.end()) {
+    return {};
+  }
+
+  return leaderboard->second;
+}
+
+size_t ScoreStore::GetNumStored() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return num_stored_;
+}
+
+void ScoreStore::WriterLoop() {
+  std::vector<ScoreRecord> batch;
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    has_pending_.wait(lock, [this] {
+      return is_stopping_ || !pending_records_.empty();
+    });
+
+    if (pending_records_.empty()) {
+      return;
+    }
+
+    // take everything queued so far, so batches grow with the load
+    batch.swap(pending_records_);
+    num_in_flight_ = batch.size();
+    lock.unlock();
+
+    InsertBatch(&batch);
+
+    // only committed scores reach the leaderboards, so they never show a
+    // score the database doesn't have
+    lock.lock();
+    for (const ScoreRecord& record : batch) {
+      AddToLeaderboard(record);
+    }
+
+    num_stored_ += batch.size();
+    batch.clear();
+    num_in_flight_ = 0;
+    if (pending_records_.empty()) {
+      is_flushed_.notify_all();
+    }
+  }
+}
+
+void ScoreStore::InsertBatch(std::vector<ScoreRecord>* records) {
+  if (sqlite3_exec(database_, "BEGIN;", nullptr, nullptr, nullptr)
+      != SQLITE_OK) {
+    records->clear();
+    return;
+  }
+
+  size_t num_inserted = 0;
+  for (ScoreRecord& record : *records) {
+    sqlite3_bind_int64(insert_statement_, 1,
+        static_cast<sqlite3_int64>(record.score_));
+    sqlite3_bind_text(insert_statement_, 2, record.mode_.c_str(),
+        static_cast<int>(record.mode_.size()), SQLITE_STATIC);
+    sqlite3_bind_int64(insert_statement_, 3, record.seed_);
+    sqlite3_bind_int64(insert_statement_, 4, record.played_at_);
+    if (record.replay_.empty()) {
+      sqlite3_bind_null(insert_statement_, 5);
+    } else {
+      sqlite3_bind_blob(insert_statement_, 5, record.replay_.data(),
+          static_cast<int>(record.replay_.size()), SQLITE_STATIC);
+    }
+
+    bool is_inserted = sqlite3_step(insert_statement_) == SQLITE_DONE;
+    sqlite3_reset(insert_statement_);
+    sqlite3_clear_bindings(insert_statement_);
+    if (is_inserted) {
+      // inserted records are packed at the front, in order
+      if (&(*records)[num_inserted] != &record) {
+        (*records)[num_inserted] = std::move(record);
+      }
+
+      num_inserted++;
+    }
+  }
+
+  if (sqlite3_exec(database_, "COMMIT;", nullptr, nullptr, nullptr)
+      != SQLITE_OK) {
+    sqlite3_exec(database_, "ROLLBACK;", nullptr, nullptr, nullptr);
+    records->clear();
+    return;
+  }
+
+  records->resize(num_inserted);
+}
+
+} // namespace tetris
@@ -0,0 +1,201 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#include "stream/spectator_publisher.h"
+
+#include <algorithm>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#endif
+
+namespace tetris {
+
+#ifdef MSG_NOSIGNAL
+const int kSendFlags = MSG_NOSIGNAL;
+#else
+// macOS sets SO_NOSIGPIPE on the socket instead
+const int kSendFlags = 0;
+#endif
+
+#ifndef _WIN32
+/**
+ * Writes to a pipe without the SIGPIPE a closed read end raises, which
+ * would otherwise end the game when a viewer goes away. Pipes can't take
+ * MSG_NOSIGNAL, so the signal is blocked on this thread for the write
+ * and taken back if the write raised it.
+ * @param fd write end of the pipe
+ * @param data bytes to write
+ * @param size number of bytes
+ * @return as write() returns, with errno EPIPE once the viewer is gone
+ */
+static ssize_t WritePipe(int fd, const uint8_t* data, size_t size) {
+  sigset_t sigpipe_set;
+  sigemptyset(&sigpipe_set);
+  sigaddset(&sigpipe_set, SIGPIPE);
+  sigset_t old_set;
+  pthread_sigmask(SIG_BLOCK, &sigpipe_set, &old_set);
+
+  // a SIGPIPE raised before this write is left for the thread to handle
+  sigset_t pending_set;
+  sigpending(&pending_set);
+  bool was_pending = sigismember(&pending_set, SIGPIPE) == 1;
+
+  ssize_t result = write(fd, data, size);
+  int write_errno = errno;
+  if (result < 0 && write_errno == EPIPE && !was_pending) {
+    int signal_number;
+    sigwait(&sigpipe_set, &signal_number);
+  }
+
+  pthread_sigmask(SIG_SETMASK, &old_set, nullptr);
+  errno = write_errno;
+  return result;
+}
+#endif
+
+SpectatorPublisher::SpectatorPublisher() : listen_fd_(-1) {}
+
+SpectatorPublisher::~SpectatorPublisher() {
+#ifndef _WIN32
+  for (const Client& client : clients_) {
+    close(client.fd_);
+  }
+
+  if (listen_fd_ >= 0) {
+    close(listen_fd_);
+    unlink(socket_path_.c_str());
+  }
+#endif
+}
+
+bool SpectatorPublisher::Listen(const std::string& socket_path) {
+#ifdef _WIN32
+  return false;
+#else
+  sockaddr_un address = {};
+  if (listen_fd_ >= 0 || socket_path.size() >= sizeof(address.sun_path)) {
+    return false;
+  }
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    return false;
+  }
+
+  address.sun_family = AF_UNIX;
+  std::strncpy(address.sun_path, socket_path.c_str(),
+      sizeof(address.sun_path) - 1);
+  unlink(socket_path.c_str());
+  if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0
+      || listen(fd, SOMAXCONN) != 0) {
+    close(fd);
+    return false;
+  }
+
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+  listen_fd_ = fd;
+  socket_path_ = socket_path;
+  return true;
+#endif
+}
+
+void SpectatorPublisher::AddClient(int fd) {
+#ifndef _WIN32
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+  clients_.push_back(Client{fd, false, true, {}});
+#endif
+}
+
+void SpectatorPublisher::AcceptClients() {
+#ifndef _WIN32
+  if (listen_fd_ < 0) {
+    return;
+  }
+
+  int fd;
+  while ((fd = accept(listen_fd_, nullptr, nullptr)) >= 0) {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+#ifdef SO_NOSIGPIPE
+    int enable = 1;
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &enable, sizeof(enable));
+#endif
+    clients_.push_back(Client{fd, true, true, {}});
+  }
+#endif
+}
+
+bool SpectatorPublisher::NeedsKeyframe() {
+  AcceptClients();
+  return std::any_of(clients_.begin(), clients_.end(),
+      [](const Client& client) { return client.is_waiting_for_keyframe_; });
+}
+
+void SpectatorPublisher::WriteFrame(const std::vector<uint8_t>& frame,
+    bool is_keyframe) {
+#ifndef _WIN32
+  for (Client& client : clients_) {
+    if (client.is_waiting_for_keyframe_ && !is_keyframe) {
+      continue;
+    }
+
+    client.is_waiting_for_keyframe_ = false;
+    client.pending_.insert(client.pending_.end(), frame.begin(), frame.end());
+  }
+
+  // drop viewers that disconnected or can't keep up
+  std::vector<Client>::iterator end = std::remove_if(
+      clients_.begin(), clients_.end(), [](Client& client) {
+        if (FlushClient(&client)
+            && client.pending_.size() <= kMaxBufferedBytes) {
+          return false;
+        }
+
+        close(client.fd_);
+        return true;
+      });
+  clients_.erase(end, clients_.end());
+#endif
+}
+
+bool SpectatorPublisher::FlushClient(Client* client) {
+#ifdef _WIN32
+  return false;
+#else
+  size_t num_written = 0;
+  while (num_written < client->pending_.size()) {
+    const uint8_t* data = client->pending_.data() + num_written;
+    size_t size = client->pending_.size() - num_written;
+    ssize_t result = client->is_socket_
+        ? send(client->fd_, data, size, kSendFlags)
+        : WritePipe(client->fd_, data, size);
+
+    if (result < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+
+      if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        return false;
+      }
+
+      break;
+    }
+
+    num_written += static_cast<size_t>(result);
+  }
+
+  client->pending_.erase(client->pending_.begin(),
+      client->pending_.begin() + num_written);
+  return true;
+#endif
+}
+
+} // namespace tetris
@@ -0,0 +1,569 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#include "stream/spectator_stream.h"
+
+#include <Box2D/Dynamics/b2Body.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace tetris {
+
+using spectator::kFrameMagic;
+using spectator::kFrameHeaderSize;
+using spectator::FrameType;
+using spectator::kKeyframe;
+using spectator::kDelta;
+using spectator::kPieceSpawned;
+using spectator::kPieceMoved;
+using spectator::kPieceRemoved;
+using spectator::kScoreChanged;
+using spectator::kGameStateChanged;
+using spectator::kBoardChanged;
+using spectator::kTileLocked;
+using spectator::kTileCleared;
+using spectator::kRowCleared;
+using spectator::kGarbageAdded;
+
+// Positions are sent as fixed point with 8 fractional bits
+const float kPositionScale = 256.0f;
+// Angles are sent as fixed point radians in [-pi, pi)
+const float kAngleScale = 8192.0f;
+// Frames larger than this are treated as a corrupt stream
+const uint32_t kMaxPayloadSize = 1 << 24;
+
+static void AppendU8(std::vector<uint8_t>* bytes, uint8_t value) {
+  bytes->push_back(value);
+}
+
+static void AppendU16(std::vector<uint8_t>* bytes, uint16_t value) {
+  bytes->push_back(static_cast<uint8_t>(value));
+  bytes->push_back(static_cast<uint8_t>(value >> 8));
+}
+
+static void AppendI16(std::vector<uint8_t>* bytes, int16_t value) {
+  AppendU16(bytes, static_cast<uint16_t>(value));
+}
+
+static void AppendVarint(std::vector<uint8_t>* bytes, size_t value) {
+  while (value >= 0x80) {
+    bytes->push_back(static_cast<uint8_t>(value | 0x80));
+    value >>= 7;
+  }
+
+  bytes->push_back(static_cast<uint8_t>(value));
+}
+
+static void AppendColor(std::vector<uint8_t>* bytes,
+    const cinder::Color& color) {
+  for (float channel : {color.r, color.g, color.b}) {
+    float clamped = std::min(std::max(channel, 0.0f), 1.0f);
+    bytes->push_back(static_cast<uint8_t>(std::lround(clamped * 255.0f)));
+  }
+}
+
+static int16_t QuantizePosition(float position) {
+  float scaled = std::round(position * kPositionScale);
+  return static_cast<int16_t>(std::min(std::max(scaled, -32768.0f), 32767.0f));
+}
+
+static int16_t QuantizeAngle(float angle) {
+  // blocks keep turning the same way, so the angle grows without bound
+  float wrapped = std::remainder(angle, 2.0f * static_cast<float>(M_PI));
+  return static_cast<int16_t>(std::round(wrapped * kAngleScale));
+}
+
+/**
+ * Reads little endian values from a frame, failing once past the end
+ */
+class FrameParser {
+ private:
+  const uint8_t* data_;
+  size_t size_;
+  size_t offset_;
+  bool is_valid_;
+
+ public:
+  FrameParser(const uint8_t* data, size_t size)
+      : data_(data), size_(size), offset_(0), is_valid_(true) {}
+
+  bool IsValid() const {
+    return is_valid_;
+  }
+
+  bool IsAtEnd() const {
+    return offset_ == size_;
+  }
+
+  uint8_t ReadU8() {
+    if (offset_ >= size_) {
+      is_valid_ = false;
+      return 0;
+    }
+
+    return data_[offset_++];
+  }
+
+  uint16_t ReadU16() {
+    uint16_t low = ReadU8();
+    return static_cast<uint16_t>(low | (ReadU8() << 8));
+  }
+
+  int16_t ReadI16() {
+    return static_cast<int16_t>(ReadU16());
+  }
+
+  uint32_t ReadU32() {
+    uint32_t low = ReadU16();
+    return low | (static_cast<uint32_t>(ReadU16()) << 16);
+  }
+
+  size_t ReadVarint() {
+    size_t value = 0;
+    for (size_t shift = 0; shift < 64; shift += 7) {
+      uint8_t byte = ReadU8();
+      value |= static_cast<size_t>(byte & 0x7F) << shift;
+      if ((byte & 0x80) == 0) {
+        return value;
+      }
+    }
+
+    is_valid_ = false;
+    return 0;
+  }
+};
+
+SpectatorEncoder::SpectatorEncoder(SpectatorFrameSink* sink,
+    size_t keyframe_interval)
+    : sink_(sink), keyframe_interval_(keyframe_interval),
+      // the first frame is always a keyframe
+      ticks_since_keyframe_(keyframe_interval), num_board_events_(0),
+      is_piece_spawned_(false), has_sent_piece_(false), sent_piece_x_(0),
+      sent_piece_y_(0), sent_piece_angle_(0), sent_score_(0),
+      sent_game_state_(0) {}
+
+void SpectatorEncoder::OnBlockSpawned(const World& /* world */,
+    const Block& /* block */) {
+  is_piece_spawned_ = true;
+}
+
+void SpectatorEncoder::OnBlockLocked(const World& /* world */,
+    const Block& block, const std::vector<TilePosition>& tiles) {
+  for (const TilePosition& tile : tiles) {
+    AppendU8(&board_events_, kTileLocked);
+    AppendU8(&board_events_, static_cast<uint8_t>(tile.row_));
+    AppendU8(&board_events_, static_cast<uint8_t>(tile.col_));
+    AppendColor(&board_events_, block.GetColor());
+    num_board_events_++;
+  }
+}
+
+void SpectatorEncoder::OnRowCleared(const World& /* world */, size_t row) {
+  AppendU8(&board_events_, kRowCleared);
+  AppendU8(&board_events_, static_cast<uint8_t>(row));
+  num_board_events_++;
+}
+
+void SpectatorEncoder::OnBombExploded(const World& world,
+    const TilePosition& center) {
+  const Board& board = world.GetBoard();
+
+  // same 3 by 3 area the world clears
+  for (size_t row = center.row_ == 0 ? 0 : center.row_ - 1;
+       row <= center.row_ + 1 && row < board.GetNumRows(); row++) {
+    for (size_t col = center.col_ == 0 ? 0 : center.col_ - 1;
+         col <= center.col_ + 1 && col < board.GetNumCols(); col++) {
+      AppendU8(&board_events_, kTileCleared);
+      AppendU8(&board_events_, static_cast<uint8_t>(row));
+      AppendU8(&board_events_, static_cast<uint8_t>(col));
+      num_board_events_++;
+    }
+  }
+}
+
+void SpectatorEncoder::OnGarbageRowsAdded(const World& /* world */,
+    size_t num_rows, size_t open_col, const cinder::Color& color) {
+  AppendU8(&board_events_, kGarbageAdded);
+  AppendU8(&board_events_, static_cast<uint8_t>(num_rows));
+  AppendU8(&board_events_, static_cast<uint8_t>(open_col));
+  AppendColor(&board_events_, color);
+  num_board_events_++;
+}
+
+void SpectatorEncoder::OnStepFinished(const World& world) {
+  ticks_since_keyframe_++;
+  if (sink_->NeedsKeyframe() || ticks_since_keyframe_ >= keyframe_interval_) {
+    EncodeKeyframe(world);
+    ticks_since_keyframe_ = 0;
+  } else {
+    EncodeDelta(world);
+  }
+
+  board_events_.clear();
+  num_board_events_ = 0;
+  is_piece_spawned_ = false;
+}
+
+void SpectatorEncoder::BeginFrame(FrameType type, size_t tick) {
+  frame_.clear();
+  AppendU8(&frame_, kFrameMagic);
+  AppendU8(&frame_, type);
+  AppendU16(&frame_, static_cast<uint16_t>(tick));
+  AppendU16(&frame_, static_cast<uint16_t>(tick >> 16));
+  // payload size, filled in once the payload is written
+  AppendU16(&frame_, 0);
+  AppendU16(&frame_, 0);
+}
+
+void SpectatorEncoder::FinishFrame() {
+  size_t payload_size = frame_.size() - kFrameHeaderSize;
+  for (size_t byte = 0; byte < 4; byte++) {
+    frame_[kFrameHeaderSize - 4 + byte] =
+        static_cast<uint8_t>(payload_size >> (8 * byte));
+  }
+}
+
+void SpectatorEncoder::WritePieceShape(const Block& block) {
+  const BlockTemplate& block_template = block.GetTemplate();
+  AppendU8(&frame_, block_template.num_tiles_);
+  // unrotated tiles, the transform carries the rotation
+  for (size_t tile = 0; tile < block_template.num_tiles_; tile++) {
+    AppendU8(&frame_,
+        static_cast<uint8_t>(block_template.cells_[0][tile].col_));
+    AppendU8(&frame_,
+        static_cast<uint8_t>(block_template.cells_[0][tile].row_));
+  }
+
+  AppendColor(&frame_, block.GetColor());
+}
+
+void SpectatorEncoder::WritePieceTransform(const Block& block) {
+  const b2Transform& transform = block.GetBody()->GetTransform();
+  sent_piece_x_ = QuantizePosition(transform.p.x);
+  sent_piece_y_ = QuantizePosition(transform.p.y);
+  sent_piece_angle_ = QuantizeAngle(transform.q.GetAngle());
+  AppendI16(&frame_, sent_piece_x_);
+  AppendI16(&frame_, sent_piece_y_);
+  AppendI16(&frame_, sent_piece_angle_);
+}
+
+void SpectatorEncoder::EncodeKeyframe(const World& world) {
+  const Board& board = world.GetBoard();
+  size_t num_rows = board.GetNumRows();
+  size_t num_cols = board.GetNumCols();
+
+  BeginFrame(kKeyframe, world.GetTickCount());
+  sent_game_state_ = static_cast<uint8_t>(world.GetCurrentGameState());
+  sent_score_ = world.GetScore();
+  AppendU8(&frame_, sent_game_state_);
+  AppendU8(&frame_, static_cast<uint8_t>(num_rows));
+  AppendU8(&frame_, static_cast<uint8_t>(num_cols));
+  AppendVarint(&frame_, sent_score_);
+
+  // filled tiles are counted first, then written
+  const std::vector<uint8_t>& cells = board.GetCells();
+  uint16_t num_filled = static_cast<uint16_t>(std::count_if(cells.begin(),
+      cells.end(), [](uint8_t cell) {
+        return cell > Board::kExplosionColor;
+      }));
+
+  AppendU16(&frame_, num_filled);
+  for (size_t row = 0; row < num_rows; row++) {
+    for (size_t col = 0; col < num_cols; col++) {
+      if (!board.IsFilled(row, col)) {
+        continue;
+      }
+
+      AppendU8(&frame_, static_cast<uint8_t>(row));
+      AppendU8(&frame_, static_cast<uint8_t>(col));
+      AppendColor(&frame_, board.GetTileColor(row, col));
+    }
+  }
+
+  const Block* block = world.GetMovingBlock();
+  has_sent_piece_ = block != nullptr;
+  AppendU8(&frame_, has_sent_piece_ ? 1 : 0);
+  if (has_sent_piece_) {
+    WritePieceShape(*block);
+    WritePieceTransform(*block);
+  }
+
+  FinishFrame();
+  sink_->WriteFrame(frame_, true);
+}
+
+void SpectatorEncoder::EncodeDelta(const World& world) {
+  BeginFrame(kDelta, world.GetTickCount());
+  // flags are filled in once every section is known
+  size_t flags_offset = frame_.size();
+  AppendU8(&frame_, 0);
+  uint8_t flags = 0;
+
+  const Block* block = world.GetMovingBlock();
+  if (block == nullptr) {
+    if (has_sent_piece_) {
+      flags |= kPieceRemoved;
+      has_sent_piece_ = false;
+    }
+  } else {
+    if (is_piece_spawned_ || !has_sent_piece_) {
+      flags |= kPieceSpawned;
+      WritePieceShape(*block);
+    }
+
+    const b2Transform& transform = block->GetBody()->GetTransform();
+    if ((flags & kPieceSpawned) != 0
+        || QuantizePosition(transform.p.x) != sent_piece_x_
+        || QuantizePosition(transform.p.y) != sent_piece_y_
+        || QuantizeAngle(transform.q.GetAngle()) != sent_piece_angle_) {
+      flags |= kPieceMoved;
+      WritePieceTransform(*block);
+    }
+
+    has_sent_piece_ = true;
+  }
+
+  size_t score = world.GetScore();
+  if (score != sent_score_) {
+    flags |= kScoreChanged;
+    sent_score_ = score;
+    AppendVarint(&frame_, sent_score_);
+  }
+
+  uint8_t game_state = static_cast<uint8_t>(world.GetCurrentGameState());
+  if (game_state != sent_game_state_) {
+    flags |= kGameStateChanged;
+    sent_game_state_ = game_state;
+    AppendU8(&frame_, sent_game_state_);
+  }
+
+  if (num_board_events_ > 0) {
+    flags |= kBoardChanged;
+    AppendU16(&frame_, num_board_events_);
+    frame_.insert(frame_.end(), board_events_.begin(), board_events_.end());
+  }
+
+  frame_[flags_offset] = flags;
+  FinishFrame();
+  sink_->WriteFrame(frame_, false);
+}
+
+BoardMirror::BoardMirror()
+    : has_keyframe_(false), tick_(0), num_rows_(0), num_cols_(0), score_(0),
+      game_state_(World::kChooseMode), has_piece_(false), piece_color_(),
+      piece_x_(0), piece_y_(0), piece_angle_(0) {}
+
+/**
+ * Reads a block's shape and color
+ */
+static void ReadPieceShape(FrameParser* parser,
+    std::vector<BoardMirror::PieceTile>* piece_tiles,
+    BoardMirror::Tile* color) {
+  size_t num_tiles = parser->ReadU8();
+  piece_tiles->clear();
+  for (size_t tile = 0; tile < num_tiles; tile++) {
+    int8_t x = static_cast<int8_t>(parser->ReadU8());
+    int8_t y = static_cast<int8_t>(parser->ReadU8());
+    piece_tiles->push_back(BoardMirror::PieceTile{x, y});
+  }
+
+  color->is_filled_ = true;
+  color->r_ = parser->ReadU8();
+  color->g_ = parser->ReadU8();
+  color->b_ = parser->ReadU8();
+}
+
+bool BoardMirror::ApplyFrame(const uint8_t* frame, size_t size) {
+  FrameParser parser(frame, size);
+  if (parser.ReadU8() != kFrameMagic) {
+    return false;
+  }
+
+  uint8_t type = parser.ReadU8();
+  uint32_t tick = parser.ReadU32();
+  uint32_t payload_size = parser.ReadU32();
+  if (!parser.IsValid() || payload_size != size - kFrameHeaderSize) {
+    return false;
+  }
+
+  if (type == kKeyframe) {
+    game_state_ = static_cast<World::GameState>(parser.ReadU8());
+    num_rows_ = parser.ReadU8();
+    num_cols_ = parser.ReadU8();
+    score_ = parser.ReadVarint();
+    tiles_.assign(num_rows_ * num_cols_, Tile{false, 0, 0, 0});
+
+    size_t num_filled = parser.ReadU16();
+    for (size_t filled = 0; filled < num_filled && parser.IsValid();
+         filled++) {
+      size_t row = parser.ReadU8();
+      size_t col = parser.ReadU8();
+      Tile tile{true, parser.ReadU8(), parser.ReadU8(), parser.ReadU8()};
+      if (row >= num_rows_ || col >= num_cols_) {
+        return false;
+      }
+
+      tiles_[row * num_cols_ + col] = tile;
+    }
+
+    has_piece_ = parser.ReadU8() != 0;
+    if (has_piece_) {
+      ReadPieceShape(&parser, &piece_tiles_, &piece_color_);
+      piece_x_ = parser.ReadI16() / kPositionScale;
+      piece_y_ = parser.ReadI16() / kPositionScale;
+      piece_angle_ = parser.ReadI16() / kAngleScale;
+    }
+
+    has_keyframe_ = parser.IsValid() && parser.IsAtEnd();
+    tick_ = tick;
+    return has_keyframe_;
+  }
+
+  if (type != kDelta) {
+    return false;
+  }
+
+  // a viewer that joined mid-game waits for its first keyframe
+  if (!has_keyframe_) {
+    return true;
+  }
+
+  uint8_t flags = parser.ReadU8();
+  if ((flags & kPieceRemoved) != 0) {
+    has_piece_ = false;
+  }
+
+  if ((flags & kPieceSpawned) != 0) {
+    ReadPieceShape(&parser, &piece_tiles_, &piece_color_);
+    has_piece_ = true;
+  }
+
+  if ((flags & kPieceMoved) != 0) {
+    piece_x_ = parser.ReadI16() / kPositionScale;
+    piece_y_ = parser.ReadI16() / kPositionScale;
+    piece_angle_ = parser.ReadI16() / kAngleScale;
+  }
+
+  if ((flags & kScoreChanged) != 0) {
+    score_ = parser.ReadVarint();
+  }
+
+  if ((flags & kGameStateChanged) != 0) {
+    game_state_ = static_cast<World::GameState>(parser.ReadU8());
+  }
+
+  size_t num_events = (flags & kBoardChanged) != 0 ? parser.ReadU16() : 0;
+  for (size_t event = 0; event < num_events && parser.IsValid(); event++) {
+    uint8_t event_type = parser.ReadU8();
+    if (event_type == kTileLocked) {
+      size_t row = parser.ReadU8();
+      size_t col = parser.ReadU8();
+      Tile tile{true, parser.ReadU8(), parser.ReadU8(), parser.ReadU8()};
+      if (row >= num_rows_ || col >= num_cols_) {
+        return false;
+      }
+
+      tiles_[row * num_cols_ + col] = tile;
+    } else if (event_type == kTileCleared) {
+      size_t row = parser.ReadU8();
+      size_t col = parser.ReadU8();
+      if (row >= num_rows_ || col >= num_cols_) {
+        return false;
+      }
+
+      tiles_[row * num_cols_ + col].is_filled_ = false;
+    } else if (event_type == kRowCleared) {
+      size_t row = parser.ReadU8();
+      if (row >= num_rows_) {
+        return false;
+      }
+
+      RemoveRow(row);
+    } else if (event_type == kGarbageAdded) {
+      size_t num_added = std::min<size_t>(parser.ReadU8(), num_rows_);
+      size_t open_col = parser.ReadU8();
+      Tile tile{true, parser.ReadU8(), parser.ReadU8(), parser.ReadU8()};
+
+      // everything moves up, rows pushed past the top are lost
+      tiles_.erase(tiles_.end() - num_added * num_cols_, tiles_.end());
+      tiles_.insert(tiles_.begin(), num_added * num_cols_, tile);
+      for (size_t row = 0; row < num_added; row++) {
+        if (open_col < num_cols_) {
+          tiles_[row * num_cols_ + open_col].is_filled_ = false;
+        }
+      }
+    } else {
+      return false;
+    }
+  }
+
+  tick_ = tick;
+  return parser.IsValid() && parser.IsAtEnd();
+}
+
+void BoardMirror::RemoveRow(size_t row) {
+  // rows above move down and an empty row appears at the top
+  tiles_.erase(tiles_.begin() + row * num_cols_,
+      tiles_.begin() + (row + 1) * num_cols_);
+  tiles_.insert(tiles_.end(), num_cols_, Tile{false, 0, 0, 0});
+}
+
+std::vector<std::pair<int, int>> BoardMirror::GetPieceTilePositions() const {
+  std::vector<std::pair<int, int>> positions;
+  if (!has_piece_) {
+    return positions;
+  }
+
+  float cos_angle = std::cos(piece_angle_);
+  float sin_angle = std::sin(piece_angle_);
+  for (const PieceTile& tile : piece_tiles_) {
+    // rotate the center of the tile about the block's origin
+    float local_x = tile.x_ + 0.5f;
+    float local_y = tile.y_ + 0.5f;
+    float x = piece_x_ + cos_angle * local_x - sin_angle * local_y;
+    float y = piece_y_ + sin_angle * local_x + cos_angle * local_y;
+    positions.emplace_back(static_cast<int>(std::floor(y)),
+        static_cast<int>(std::floor(x)));
+  }
+
+  return positions;
+}
+
+SpectatorFrameReader::SpectatorFrameReader() : read_offset_(0) {}
+
+void SpectatorFrameReader::Append(const uint8_t* data, size_t size) {
+  // drop frames already read before the buffer grows
+  if (read_offset_ > 0 && read_offset_ * 2 >= buffer_.size()) {
+    buffer_.erase(buffer_.begin(), buffer_.begin() + read_offset_);
+    read_offset_ = 0;
+  }
+
+  buffer_.insert(buffer_.end(), data, data + size);
+}
+
+bool SpectatorFrameReader::NextFrame(std::vector<uint8_t>* frame) {
+  while (buffer_.size() - read_offset_ >= kFrameHeaderSize) {
+    const uint8_t* header = buffer_.data() + read_offset_;
+    FrameParser parser(header + kFrameHeaderSize - 4, 4);
+    uint32_t payload_size = parser.ReadU32();
+
+    // skip bytes until the stream lines up with a frame again
+    if (header[0] != kFrameMagic || payload_size > kMaxPayloadSize) {
+      read_offset_++;
+      continue;
+    }
+
+    size_t frame_size = kFrameHeaderSize + payload_size;
+    if (buffer_.size() - read_offset_ < frame_size) {
+      return false;
+    }
+
+    frame->assign(header, header + frame_size);
+    read_offset_ += frame_size;
+    return true;
+  }
+
+  return false;
+}
+
+} // namespace tetris
@@ -0,0 +1,166 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#include "render/terminal_canvas.h"
+
+#include <algorithm>
+
+namespace tetris {
+
+namespace {
+
+const TerminalCanvas::Cell kBlankCell = {' ', TerminalCanvas::kDefaultColor,
+                                         TerminalCanvas::kDefaultColor};
+// marks the terminal's colors as unknown, so the next cell sets them
+const uint16_t kUnknownColor = 0xFFFF;
+
+/**
+ * Appends a number in decimal
+ * @param value the number
+ * @param output where to append
+ */
+void AppendNumber(int value, std::string* output) {
+  char digits[12];
+  int num_digits = 0;
+  do {
+    digits[num_digits++] = static_cast<char>('0' + value % 10);
+    value /= 10;
+  } while (value > 0);
+
+  while (num_digits > 0) {
+    output->push_back(digits[--num_digits]);
+  }
+}
+
+} // namespace
+
+const uint16_t TerminalCanvas::kDefaultColor;
+
+TerminalCanvas::TerminalCanvas() : width_(0), height_(0), is_invalid_(true),
+    current_foreground_(kUnknownColor), current_background_(kUnknownColor) {}
+
+void TerminalCanvas::Resize(int width, int height) {
+  width_ = std::max(width, 0);
+  height_ = std::max(height, 0);
+  back_cells_.assign(static_cast<size_t>(width_) * height_, kBlankCell);
+  front_cells_.assign(back_cells_.size(), kBlankCell);
+  Invalidate();
+}
+
+void TerminalCanvas::Invalidate() {
+  is_invalid_ = true;
+}
+
+void TerminalCanvas::Clear(uint16_t background) {
+  Cell blank = kBlankCell;
+  blank.background_ = background;
+  std::fill(back_cells_.begin(), back_cells_.end(), blank);
+}
+
+void TerminalCanvas::SetCell(int col, int row, char glyph,
+    uint16_t foreground, uint16_t background) {
+  if (col < 0 || col >= width_ || row < 0 || row >= height_) {
+    return;
+  }
+
+  Cell& cell = back_cells_[static_cast<size_t>(row) * width_ + col];
+  cell.glyph_ = glyph;
+  cell.foreground_ = foreground;
+  cell.background_ = background;
+}
+
+void TerminalCanvas::DrawText(int col, int row, const std::string& text,
+    uint16_t foreground, uint16_t background) {
+  for (char glyph : text) {
+    SetCell(col++, row, glyph, foreground, background);
+  }
+}
+
+void TerminalCanvas::AppendColors(const Cell& cell, std::string* output) {
+  bool is_foreground_changed = cell.foreground_ != current_foreground_;
+  bool is_background_changed = cell.background_ != current_background_;
+  if (!is_foreground_changed && !is_background_changed) {
+    return;
+  }
+
+  output->append("\x1b[");
+  if (is_foreground_changed) {
+    if (cell.foreground_ == kDefaultColor) {
+      output->append("39");
+    } else {
+      output->append("38;5;");
+      AppendNumber(cell.foreground_, output);
+    }
+  }
+
+  if (is_background_changed) {
+    if (is_foreground_changed) {
+      output->push_back(';');
+    }
+
+    if (cell.background_ == kDefaultColor) {
+      output->append("49");
+    } else {
+      output->append("48;5;");
+      AppendNumber(cell.background_, output);
+    }
+  }
+
+  output->push_back('m');
+  current_foreground_ = cell.foreground_;
+  current_background_ = cell.background_;
+}
+
+std::string TerminalCanvas::Flush() {
+  std::string output;
+  if (is_invalid_) {
+    // after a reset and clear every cell on screen is a default blank
+    output.append("\x1b[0m\x1b[2J");
+    current_foreground_ = kDefaultColor;
+    current_background_ = kDefaultColor;
+    std::fill(front_cells_.begin(), front_cells_.end(), kBlankCell);
+    is_invalid_ = false;
+  }
+
+  // where the terminal's cursor is, -1 when unknown
+  int cursor_col = -1;
+  int cursor_row = -1;
+  for (int row = 0; row < height_; row++) {
+    for (int col = 0; col < width_; col++) {
+      size_t index = static_cast<size_t>(row) * width_ + col;
+      const Cell& cell = back_cells_[index];
+      if (cell == front_cells_[index]) {
+        continue;
+      }
+
+      if (col != cursor_col || row != cursor_row) {
+        output.append("\x1b[");
+        AppendNumber(row + 1, &output);
+        output.push_back(';');
+        AppendNumber(col + 1, &output);
+        output.push_back('H');
+      }
+
+      AppendColors(cell, &output);
+      output.push_back(cell.glyph_);
+      front_cells_[index] = cell;
+
+      // writing the last column leaves the cursor waiting to wrap, which
+      // terminals handle differently, so it is moved explicitly next time
+      cursor_row = row;
+      cursor_col = col + 1 < width_ ? col + 1 : -1;
+    }
+  }
+
+  return output;
+}
+
+uint16_t TerminalCanvas::GetColorIndex(float red, float green, float blue) {
+  auto to_level = [](float channel) {
+    return static_cast<uint16_t>(
+        std::min(std::max(channel, 0.0f), 1.0f) * 5.0f + 0.5f);
+  };
+  return static_cast<uint16_t>(
+      16 + 36 * to_level(red) + 6 * to_level(green) + to_level(blue));
+}
+
+} // namespace tetris
@@ -4,6 +4,7 @@
 
 namespace tetris {
 
-TetrisEngine::TetrisEngine() : world_() {};
+TetrisEngine::TetrisEngine(bool is_sound_enabled)
+    : world_(is_sound_enabled) {};
 
 }  // namespace physics
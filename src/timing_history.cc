@@ -0,0 +1,59 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#include "telemetry/timing_history.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace tetris {
+
+const size_t TimingHistory::kMaxSamples;
+
+TimingHistory::TimingHistory() : next_index_(0), num_samples_(0) {
+  samples_ms_.fill(0.0f);
+}
+
+void TimingHistory::Add(float sample_ms) {
+  samples_ms_[next_index_] = sample_ms;
+  next_index_ = (next_index_ + 1) % kMaxSamples;
+  num_samples_ = std::min(num_samples_ + 1, kMaxSamples);
+}
+
+float TimingHistory::GetMean() const {
+  if (num_samples_ == 0) {
+    return 0.0f;
+  }
+
+  float total = 0.0f;
+  for (size_t age = 0; age < num_samples_; age++) {
+    total += Get(age);
+  }
+
+  return total / static_cast<float>(num_samples_);
+}
+
+float TimingHistory::GetMax() const {
+  float max = 0.0f;
+  for (size_t age = 0; age < num_samples_; age++) {
+    max = std::max(max, Get(age));
+  }
+
+  return max;
+}
+
+float TimingHistory::GetStandardDeviation() const {
+  if (num_samples_ == 0) {
+    return 0.0f;
+  }
+
+  float mean = GetMean();
+  float total = 0.0f;
+  for (size_t age = 0; age < num_samples_; age++) {
+    float difference = Get(age) - mean;
+    total += difference * difference;
+  }
+
+  return std::sqrt(total / static_cast<float>(num_samples_));
+}
+
+} // namespace tetris
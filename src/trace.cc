@@ -0,0 +1,214 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#include "telemetry/trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+
+namespace tetris {
+
+const size_t Tracer::kBufferCapacity;
+
+namespace {
+
+/**
+ * One span in a ring. The fields are relaxed atomics so a dump can read a
+ * slot while its thread overwrites it; the dump notices and drops it.
+ */
+struct TraceSlot {
+  std::atomic<const char*> name_;
+  std::atomic<uint64_t> start_ns_;
+  std::atomic<uint64_t> duration_ns_;
+};
+
+/**
+ * The ring of one thread, written only by that thread
+ */
+struct ThreadTrace {
+  uint32_t thread_id_;
+  // guarded by registry_mutex
+  std::string thread_name_;
+  // spans ever written, the next one goes in slot num_written_ % capacity
+  std::atomic<uint64_t> num_written_;
+  TraceSlot slots_[Tracer::kBufferCapacity];
+};
+
+std::atomic<bool> is_tracing_enabled(false);
+std::mutex registry_mutex;
+thread_local ThreadTrace* thread_trace = nullptr;
+
+/**
+ * Gets every thread's ring, which live until the program exits so the
+ * spans of finished threads can still be dumped
+ * @return the rings, only used with registry_mutex held
+ */
+std::vector<std::unique_ptr<ThreadTrace>>& GetThreadTraces() {
+  static std::vector<std::unique_ptr<ThreadTrace>> thread_traces;
+  return thread_traces;
+}
+
+/**
+ * Gets the ring of the calling thread, registering one the first time
+ * @return the ring
+ */
+ThreadTrace* GetThreadTrace() {
+  if (thread_trace != nullptr) {
+    return thread_trace;
+  }
+
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  std::vector<std::unique_ptr<ThreadTrace>>& thread_traces =
+      GetThreadTraces();
+  // value initialized, so every slot and count starts at zero
+  thread_traces.emplace_back(new ThreadTrace());
+  thread_trace = thread_traces.back().get();
+  thread_trace->thread_id_ = static_cast<uint32_t>(thread_traces.size());
+  thread_trace->thread_name_ =
+      "thread " + std::to_string(thread_trace->thread_id_);
+  return thread_trace;
+}
+
+uint64_t ToNanoseconds(std::chrono::steady_clock::time_point time) {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          time.time_since_epoch()).count());
+}
+
+/**
+ * Writes a string as a quoted JSON string
+ * @param file the file
+ * @param text the string
+ */
+void WriteJsonString(FILE* file, const char* text) {
+  fputc('"', file);
+  for (const char* character = text; *character != '\0'; character++) {
+    if (*character == '"' || *character == '\\') {
+      fputc('\\', file);
+    }
+
+    // control characters can't appear raw in JSON and never should here
+    if (static_cast<unsigned char>(*character) >= ' ') {
+      fputc(*character, file);
+    }
+  }
+
+  fputc('"', file);
+}
+
+} // namespace
+
+void Tracer::SetEnabled(bool is_enabled) {
+  is_tracing_enabled.store(is_enabled, std::memory_order_relaxed);
+}
+
+bool Tracer::IsEnabled() {
+  return is_tracing_enabled.load(std::memory_order_relaxed);
+}
+
+void Tracer::SetThreadName(const std::string& name) {
+  ThreadTrace* trace = GetThreadTrace();
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  trace->thread_name_ = name;
+}
+
+void Tracer::Record(const char* name,
+    std::chrono::steady_clock::time_point start,
+    std::chrono::steady_clock::time_point end) {
+  if (!IsEnabled()) {
+    return;
+  }
+
+  ThreadTrace* trace = GetThreadTrace();
+  uint64_t index = trace->num_written_.load(std::memory_order_relaxed);
+  TraceSlot& slot = trace->slots_[index % kBufferCapacity];
+  uint64_t start_ns = ToNanoseconds(start);
+  slot.name_.store(name, std::memory_order_relaxed);
+  slot.start_ns_.store(start_ns, std::memory_order_relaxed);
+  slot.duration_ns_.store(ToNanoseconds(end) - start_ns,
+      std::memory_order_relaxed);
+  trace->num_written_.store(index + 1, std::memory_order_release);
+}
+
+std::vector<TraceRecord> Tracer::Collect() {
+  std::vector<TraceRecord> records;
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  for (const std::unique_ptr<ThreadTrace>& trace : GetThreadTraces()) {
+    uint64_t end = trace->num_written_.load(std::memory_order_acquire);
+    uint64_t begin = end > kBufferCapacity ? end - kBufferCapacity : 0;
+    size_t first_record = records.size();
+    for (uint64_t index = begin; index < end; index++) {
+      const TraceSlot& slot = trace->slots_[index % kBufferCapacity];
+      TraceRecord record;
+      record.name_ = slot.name_.load(std::memory_order_relaxed);
+      record.start_ns_ = slot.start_ns_.load(std::memory_order_relaxed);
+      record.duration_ns_ = slot.duration_ns_.load(std::memory_order_relaxed);
+      record.thread_id_ = trace->thread_id_;
+      records.push_back(record);
+    }
+
+    // the thread may have lapped the oldest slots while they were copied;
+    // the slot of a span being written right now counts as lapped too
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint64_t written = trace->num_written_.load(std::memory_order_relaxed);
+    uint64_t first_intact = written + 1 > kBufferCapacity
+        ? written + 1 - kBufferCapacity : 0;
+    if (first_intact > begin) {
+      size_t num_lapped =
+          static_cast<size_t>(std::min(first_intact, end) - begin);
+      records.erase(records.begin() + first_record,
+          records.begin() + first_record + num_lapped);
+    }
+  }
+
+  return records;
+}
+
+bool Tracer::WriteChromeTrace(const std::string& path) {
+  std::vector<TraceRecord> records = Collect();
+  std::unique_ptr<FILE, int (*)(FILE*)> file(fopen(path.c_str(), "w"),
+      &fclose);
+  if (!file) {
+    return false;
+  }
+
+  // timestamps are written relative to the oldest span, in microseconds
+  uint64_t origin_ns = 0;
+  if (!records.empty()) {
+    origin_ns = std::min_element(records.begin(), records.end(),
+        [](const TraceRecord& first, const TraceRecord& second) {
+          return first.start_ns_ < second.start_ns_;
+        })->start_ns_;
+  }
+
+  fputs("{\"traceEvents\":[\n", file.get());
+  bool is_first = true;
+  {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    for (const std::unique_ptr<ThreadTrace>& trace : GetThreadTraces()) {
+      fprintf(file.get(), "%s{\"name\":\"thread_name\",\"ph\":\"M\","
+          "\"pid\":1,\"tid\":%u,\"args\":{\"name\":",
+          is_first ? "" : ",\n", trace->thread_id_);
+      WriteJsonString(file.get(), trace->thread_name_.c_str());
+      fputs("}}", file.get());
+      is_first = false;
+    }
+  }
+
+  for (const TraceRecord& record : records) {
+    fprintf(file.get(), "%s{\"name\":", is_first ? "" : ",\n");
+    WriteJsonString(file.get(), record.name_);
+    fprintf(file.get(), ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,"
+        "\"ts\":%.3f,\"dur\":%.3f}", record.thread_id_,
+        static_cast<double>(record.start_ns_ - origin_ns) / 1000.0,
+        static_cast<double>(record.duration_ns_) / 1000.0);
+    is_first = false;
+  }
+
+  fputs("\n]}\n", file.get());
+  return !ferror(file.get());
+}
+
+} // namespace tetris
@@ -0,0 +1,394 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#include "bot/weight_tuner.h"
+
+#include <Box2D/Dynamics/b2Fixture.h>
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <numeric>
+
+#include "physics/block.h"
+#include "physics/block_generator.h"
+#include "physics/perfect_clear_solver.h"
+#include "server/work_stealing_pool.h"
+
+namespace tetris {
+
+static const char* const kCheckpointMagic = "tetris-tuner";
+static const int kCheckpointVersion = 1;
+// share of samples that should beat the last parents, the 1/5 rule
+static const double kTargetSuccess = 0.2;
+static const double kMinStep = 1e-3;
+static const double kMaxStep = 1.0;
+
+/**
+ * Scales weights to unit length, leaving all zero weights as they are
+ * @param weights the weights
+ */
+static void Normalize(HeuristicBot::Weights* weights) {
+  double length = 0.0;
+  for (double weight : *weights) {
+    length += weight * weight;
+  }
+
+  length = std::sqrt(length);
+  if (length > 0.0) {
+    for (double& weight : *weights) {
+      weight /= length;
+    }
+  }
+}
+
+/**
+ * Plays a game on rows of bits, dropping each block where the bot puts it
+ * @param bot the player
+ * @param mode kClassic or kReloaded
+ * @param seed seed of the block order
+ * @param max_pieces most blocks to play
+ * @return how far the game got
+ */
+static WeightTuner::GameResult PlayGridGame(const HeuristicBot& bot,
+    World::GameState mode, uint32_t seed, size_t max_pieces) {
+  bool is_reloaded = mode == World::kReloaded;
+  // reloaded tiles are half as wide, so the board has twice as many
+  double ratio = is_reloaded ? 2.0 : 1.0;
+  size_t num_cols = static_cast<size_t>(World::kDefaultWorldNumCol * ratio);
+  size_t num_rows = static_cast<size_t>(World::kDefaultWorldNumRow * ratio);
+  BlockGenerator generator(false, seed);
+  BlockTemplateList templates = generator.GetBlockTemplateList(is_reloaded);
+  std::vector<uint32_t> rows(num_rows, 0);
+
+  WeightTuner::GameResult result = {0, 0};
+  while (result.num_pieces_ < max_pieces) {
+    const BlockTemplate& block_template =
+        templates[generator.PickTemplateId(is_reloaded)];
+    HeuristicBot::Placement placement =
+        bot.Choose(rows, num_cols, block_template);
+    if (!placement.is_found_) {
+      break;
+    }
+
+    result.num_lines_ +=
+        HeuristicBot::Place(placement, block_template, num_cols, &rows);
+    result.num_pieces_++;
+
+    // the world ends the game once a tile is left in its top two rows
+    if (rows[num_rows - 1] != 0 || rows[num_rows - 2] != 0) {
+      break;
+    }
+  }
+
+  return result;
+}
+
+/**
+ * Plays a game in a world without sound, turning and moving each block
+ * above the stack before hard dropping it
+ * @param bot the player
+ * @param mode kClassic or kReloaded
+ * @param seed seed of every random choice of the world
+ * @param max_pieces most blocks to play
+ * @return how far the game got
+ */
+static WeightTuner::GameResult PlayWorldGame(const HeuristicBot& bot,
+    World::GameState mode, uint32_t seed, size_t max_pieces) {
+  World world(false);
+  world.SetSeed(seed);
+  world.SetCurrentGameState(mode);
+  size_t num_cols = world.GetTotalNumCol();
+
+  WeightTuner::GameResult result = {0, 0};
+  while (result.num_pieces_ < max_pieces
+      && world.GetCurrentGameState() != World::kEndScreen) {
+    // the next block spawns on the step after one locks
+    world.Step();
+    result.num_lines_ += world.TakeClearedRowCount();
+    const Block* block = world.GetMovingBlock();
+    if (block == nullptr) {
+      continue;
+    }
+
+    HeuristicBot::Placement placement = bot.Choose(
+        PerfectClearSolver::GetRows(world.GetBoard()), num_cols,
+        block->GetTemplate());
+    for (size_t turn = 0; turn < placement.rotation_; turn++) {
+      world.Move(Block::kRotate);
+    }
+
+    // a move into a wall or the stack fails, so the block stops short
+    // instead of looping forever
+    int min_col = INT_MAX;
+    for (const b2Fixture* fixture = block->GetBody()->GetFixtureList();
+         fixture != nullptr; fixture = fixture->GetNext()) {
+      min_col = std::min(min_col,
+          static_cast<int>(std::floor(Block::GetTileCenter(fixture).x)));
+    }
+
+    Block::Move shift =
+        placement.col_ < min_col ? Block::kMoveLeft : Block::kMoveRight;
+    for (int moves = std::abs(placement.col_ - min_col); moves > 0;
+         moves--) {
+      if (!world.Move(shift)) {
+        break;
+      }
+    }
+
+    world.Move(Block::kHardDrop);
+    result.num_lines_ += world.TakeClearedRowCount();
+    result.num_pieces_++;
+  }
+
+  return result;
+}
+
+WeightTuner::WeightTuner(const Options& options, WorkStealingPool* pool)
+    : options_(options), pool_(pool), generation_(0),
+      mean_(HeuristicBot::kDefaultWeights), step_(options.initial_step_),
+      parent_fitness_(0.0), best_weights_(HeuristicBot::kDefaultWeights),
+      best_fitness_(-1.0), random_(options.seed_) {
+  Normalize(&mean_);
+  Normalize(&best_weights_);
+}
+
+WeightTuner::Report WeightTuner::RunGeneration() {
+  auto start = std::chrono::steady_clock::now();
+  size_t population = std::max<size_t>(options_.population_, 1);
+  size_t num_parents = std::min(std::max<size_t>(options_.num_parents_, 1),
+      population);
+
+  std::normal_distribution<double> normal(0.0, 1.0);
+  std::vector<HeuristicBot::Weights> samples(population, mean_);
+  for (HeuristicBot::Weights& sample : samples) {
+    for (double& weight : sample) {
+      weight += step_ * normal(random_);
+    }
+
+    Normalize(&sample);
+  }
+
+  // every sample plays the same games, so their fitness differs only by
+  // how they play, while each generation plays new seeds so the weights
+  // don't fit one block order
+  size_t games_per_sample = options_.modes_.size() * options_.games_per_mode_;
+  size_t num_games = population * games_per_sample;
+  std::vector<GameResult> results(num_games);
+  std::vector<double> game_seconds(num_games);
+  uint32_t first_seed = options_.seed_
+      + static_cast<uint32_t>(generation_ * options_.games_per_mode_);
+  for (size_t index = 0; index < num_games; index++) {
+    pool_->Submit([&, index] {
+      auto game_start = std::chrono::steady_clock::now();
+      size_t game = index % games_per_sample;
+      HeuristicBot bot(samples[index / games_per_sample]);
+      results[index] = PlayGame(bot,
+          options_.modes_[game / options_.games_per_mode_],
+          first_seed + static_cast<uint32_t>(game % options_.games_per_mode_),
+          options_.max_pieces_, options_.backend_);
+      std::chrono::duration<double> elapsed =
+          std::chrono::steady_clock::now() - game_start;
+      game_seconds[index] = elapsed.count();
+    });
+  }
+
+  pool_->Wait();
+
+  Report report = {};
+  std::vector<double> fitness(population, 0.0);
+  for (size_t index = 0; index < num_games; index++) {
+    fitness[index / games_per_sample] +=
+        static_cast<double>(results[index].num_lines_);
+    report.num_pieces_ += results[index].num_pieces_;
+  }
+
+  for (double& sample_fitness : fitness) {
+    sample_fitness /= static_cast<double>(std::max<size_t>(
+        games_per_sample, 1));
+  }
+
+  std::vector<size_t> order(population);
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(),
+      [&fitness](size_t first, size_t second) {
+        return fitness[first] > fitness[second];
+      });
+
+  // better parents pull the mean harder, with weights falling off like a
+  // logarithm as in CMA-ES
+  HeuristicBot::Weights mean = {};
+  double total_weight = 0.0;
+  double parent_fitness = 0.0;
+  for (size_t rank = 0; rank < num_parents; rank++) {
+    double weight = std::log(static_cast<double>(num_parents) + 0.5)
+        - std::log(static_cast<double>(rank) + 1.0);
+    for (size_t feature = 0; feature < mean.size(); feature++) {
+      mean[feature] += weight * samples[order[rank]][feature];
+    }
+
+    total_weight += weight;
+    parent_fitness += fitness[order[rank]];
+  }
+
+  for (double& weight : mean) {
+    weight /= total_weight;
+  }
+
+  Normalize(&mean);
+
+  // widen the search while samples keep beating the last parents, and
+  // narrow it once they seldom do
+  if (generation_ > 0) {
+    size_t num_successes = static_cast<size_t>(std::count_if(
+        fitness.begin(), fitness.end(), [this](double sample_fitness) {
+          return sample_fitness > parent_fitness_;
+        }));
+    double success = static_cast<double>(num_successes)
+        / static_cast<double>(population);
+    step_ = std::min(std::max(step_ * std::exp(success - kTargetSuccess),
+        kMinStep), kMaxStep);
+  }
+
+  mean_ = mean;
+  parent_fitness_ = parent_fitness / static_cast<double>(num_parents);
+  if (fitness[order[0]] > best_fitness_) {
+    best_fitness_ = fitness[order[0]];
+    best_weights_ = samples[order[0]];
+  }
+
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  double busy_seconds =
+      std::accumulate(game_seconds.begin(), game_seconds.end(), 0.0);
+  // the thread waiting on the pool runs games too
+  double thread_seconds =
+      elapsed.count() * static_cast<double>(pool_->GetNumThreads() + 1);
+
+  report.generation_ = generation_;
+  report.best_fitness_ = fitness[order[0]];
+  report.mean_fitness_ =
+      std::accumulate(fitness.begin(), fitness.end(), 0.0)
+      / static_cast<double>(population);
+  report.step_ = step_;
+  report.best_weights_ = samples[order[0]];
+  report.num_games_ = num_games;
+  report.seconds_ = elapsed.count();
+  report.utilization_ =
+      thread_seconds > 0.0 ? busy_seconds / thread_seconds : 0.0;
+
+  generation_++;
+  return report;
+}
+
+WeightTuner::GameResult WeightTuner::PlayGame(const HeuristicBot& bot,
+    World::GameState mode, uint32_t seed, size_t max_pieces,
+    Backend backend) {
+  if (backend == kWorldBackend) {
+    return PlayWorldGame(bot, mode, seed, max_pieces);
+  }
+
+  return PlayGridGame(bot, mode, seed, max_pieces);
+}
+
+bool WeightTuner::SaveCheckpoint(const std::string& path,
+    std::string* error) const {
+  std::string temp_path = path + ".tmp";
+  {
+    std::ofstream file(temp_path);
+    if (!file) {
+      *error = "could not open " + temp_path;
+      return false;
+    }
+
+    file.precision(std::numeric_limits<double>::max_digits10);
+    file << kCheckpointMagic << ' ' << kCheckpointVersion << '\n';
+    file << "generation " << generation_ << '\n';
+    file << "step " << step_ << '\n';
+    file << "parent_fitness " << parent_fitness_ << '\n';
+    file << "best_fitness " << best_fitness_ << '\n';
+    file << "mean";
+    for (double weight : mean_) {
+      file << ' ' << weight;
+    }
+
+    file << "\nbest";
+    for (double weight : best_weights_) {
+      file << ' ' << weight;
+    }
+
+    file << "\nrandom " << random_ << '\n';
+    if (!file.flush()) {
+      *error = "could not write " + temp_path;
+      return false;
+    }
+  }
+
+  if (std::rename(temp_path.c_str(), path.c_str()) != 0) {
+    *error = "could not replace " + path;
+    return false;
+  }
+
+  return true;
+}
+
+bool WeightTuner::LoadCheckpoint(const std::string& path,
+    std::string* error) {
+  std::ifstream file(path);
+  if (!file) {
+    *error = "could not open " + path;
+    return false;
+  }
+
+  std::string magic;
+  int version = 0;
+  file >> magic >> version;
+  if (magic != kCheckpointMagic || version != kCheckpointVersion) {
+    *error = "not a tuner checkpoint of this version";
+    return false;
+  }
+
+  size_t generation = 0;
+  double step = 0.0;
+  double parent_fitness = 0.0;
+  double best_fitness = 0.0;
+  HeuristicBot::Weights mean;
+  HeuristicBot::Weights best_weights;
+  std::mt19937 random;
+  std::string key;
+  bool is_read = static_cast<bool>(file >> key >> generation)
+      && key == "generation";
+  is_read = is_read && file >> key >> step && key == "step";
+  is_read = is_read && file >> key >> parent_fitness
+      && key == "parent_fitness";
+  is_read = is_read && file >> key >> best_fitness && key == "best_fitness";
+  is_read = is_read && file >> key && key == "mean";
+  for (double& weight : mean) {
+    is_read = is_read && file >> weight;
+  }
+
+  is_read = is_read && file >> key && key == "best";
+  for (double& weight : best_weights) {
+    is_read = is_read && file >> weight;
+  }
+
+  is_read = is_read && file >> key >> random && key == "random";
+  if (!is_read) {
+    *error = "checkpoint is cut short or has an unknown field";
+    return false;
+  }
+
+  generation_ = generation;
+  step_ = step;
+  parent_fitness_ = parent_fitness;
+  best_fitness_ = best_fitness;
+  mean_ = mean;
+  best_weights_ = best_weights;
+  random_ = random;
+  return true;
+}
+
+} // namespace tetris
@@ -0,0 +1,171 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#include "server/work_stealing_pool.h"
+
+#include <algorithm>
+#include <string>
+
+#include "telemetry/trace.h"
+
+namespace tetris {
+
+// Lets Submit find the queue of the worker it is called from
+static thread_local const WorkStealingPool* current_pool = nullptr;
+static thread_local size_t current_worker_index = 0;
+
+WorkStealingPool::WorkStealingPool(size_t num_threads)
+    : num_pending_(0), num_queued_(0), next_queue_(0), is_stopping_(false) {
+  num_threads = std::max<size_t>(num_threads, 1);
+  for (size_t index = 0; index < num_threads; index++) {
+    queues_.emplace_back(new TaskQueue);
+  }
+
+  for (size_t index = 0; index < num_threads; index++) {
+    workers_.emplace_back(&WorkStealingPool::WorkerLoop, this, index);
+  }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+  {
+    std::lock_guard<std::mutex> lock(wake_mutex_);
+    is_stopping_ = true;
+  }
+
+  wake_condition_.notify_all();
+  for (std::thread& worker : workers_) {
+    worker.join();
+  }
+}
+
+void WorkStealingPool::Submit(Task task) {
+  size_t queue_index;
+  if (current_pool == this) {
+    queue_index = current_worker_index;
+  } else {
+    queue_index = next_queue_++ % queues_.size();
+  }
+
+  num_pending_++;
+  {
+    // queued under the wake lock so a sleeping worker can't miss it
+    std::lock_guard<std::mutex> wake_lock(wake_mutex_);
+    std::lock_guard<std::mutex> queue_lock(queues_[queue_index]->mutex_);
+    queues_[queue_index]->tasks_.push_back(std::move(task));
+    num_queued_++;
+  }
+
+  wake_condition_.notify_one();
+  // a thread blocked in Wait can help with the new task
+  idle_condition_.notify_one();
+}
+
+void WorkStealingPool::Wait() {
+  // the caller is not a worker, so it may steal from every queue
+  size_t caller_index = queues_.size();
+  while (num_pending_ > 0) {
+    Task task;
+    if (TryStealTask(caller_index, &task)) {
+      RunTask(task);
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(wake_mutex_);
+    idle_condition_.wait(lock, [this] {
+      return num_pending_ == 0 || num_queued_ > 0;
+    });
+  }
+}
+
+void WorkStealingPool::ParallelFor(size_t count,
+    const std::function<void(size_t)>& body) {
+  // a few chunks per thread leaves room for stealing without
+  // paying for one task per index
+  size_t num_chunks = std::min(count, workers_.size() * 4);
+  if (num_chunks == 0) {
+    return;
+  }
+
+  size_t chunk_size = (count + num_chunks - 1) / num_chunks;
+  for (size_t begin = 0; begin < count; begin += chunk_size) {
+    size_t end = std::min(count, begin + chunk_size);
+    Submit([&body, begin, end] {
+      for (size_t index = begin; index < end; index++) {
+        body(index);
+      }
+    });
+  }
+
+  Wait();
+}
+
+bool WorkStealingPool::TryPopTask(size_t queue_index, Task* task) {
+  TaskQueue& queue = *queues_[queue_index];
+  std::lock_guard<std::mutex> lock(queue.mutex_);
+  if (queue.tasks_.empty()) {
+    return false;
+  }
+
+  *task = std::move(queue.tasks_.back());
+  queue.tasks_.pop_back();
+  num_queued_--;
+  return true;
+}
+
+bool WorkStealingPool::TryStealTask(size_t thief_index, Task* task) {
+  // start with the queue after the thief's own to spread out steals
+  for (size_t offset = 1; offset <= queues_.size(); offset++) {
+    size_t victim_index = (thief_index + offset) % queues_.size();
+    if (victim_index == thief_index) {
+      continue;
+    }
+
+    TaskQueue& queue = *queues_[victim_index];
+    std::lock_guard<std::mutex> lock(queue.mutex_);
+    if (queue.tasks_.empty()) {
+      continue;
+    }
+
+    *task = std::move(queue.tasks_.front());
+    queue.tasks_.pop_front();
+    num_queued_--;
+    return true;
+  }
+
+  return false;
+}
+
+void WorkStealingPool::RunTask(Task& task) {
+  task();
+  if (--num_pending_ == 0) {
+    std::lock_guard<std::mutex> lock(wake_mutex_);
+    idle_condition_.notify_all();
+  }
+}
+
+void WorkStealingPool::WorkerLoop(size_t index) {
+  current_pool = this;
+  current_worker_index = index;
+  // only threads that record spans take up a trace ring
+  if (Tracer::IsEnabled()) {
+    Tracer::SetThreadName("worker " + std::to_string(index));
+  }
+
+  while (true) {
+    Task task;
+    if (TryPopTask(index, &task) || TryStealTask(index, &task)) {
+      RunTask(task);
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(wake_mutex_);
+    wake_condition_.wait(lock, [this] {
+      return is_stopping_ || num_queued_ > 0;
+    });
+
+    if (is_stopping_) {
+      return;
+    }
+  }
+}
+
+} // namespace tetris
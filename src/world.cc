@@ -5,68 +5,354 @@
 #include "physics/world.h"
 
 #include <Box2D/Collision/Shapes/b2PolygonShape.h>
+#include <Box2D/Collision/b2Collision.h>
 #include <Box2D/Common/b2Math.h>
 #include <Box2D/Dynamics/b2Body.h>
 #include <Box2D/Dynamics/b2Fixture.h>
 #include <Box2D/Dynamics/b2World.h>
+#include <Box2D/Dynamics/b2WorldCallbacks.h>
+#include <Box2D/Dynamics/Contacts/b2Contact.h>
 #include <cinder/app/AppBase.h>
 #include <cinder/audio/Voice.h>
 #include <math.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <sstream>
 #include <physics/block_contact_listener.h>
+#include <physics/game_mode.h>
 
 #include "../apps/tetris_game.h"
 
 namespace tetris {
 
+const size_t World::kMaxLevel;
+
 // Audio file paths
 constexpr const static char kCompleteRowSound[] = "Row_Complete_Sound.mp3";
 constexpr const static char kBlockCollisionSound[] = "Block_Collision.mp3";
 constexpr const static char kBombExplodeSound[] = "Explosion_Sound.mp3";
+const char* const kStepPhaseNames[World::kNumStepPhases] = {
+    "physics", "landing", "debris", "listeners"};
+const uint8_t kSnapshotVersion = 2;
+const uint8_t kSnapshotBombModeFlag = 1;
+const uint8_t kSnapshotTileDisconnectedModeFlag = 2;
+const uint8_t kSnapshotPieceSetFlag = 4;
+// which table a debris tile's template is in
+const uint8_t kClassicTemplateTable = 0;
+const uint8_t kReloadedTemplateTable = 1;
+const uint8_t kPieceSetTemplateTable = 2;
+// block and debris positions are hashed to this fraction of a tile
+const float kStateHashResolution = 64.0f;
+const uint64_t kFnvOffsetBasis = 14695981039346656037ull;
+const uint64_t kFnvPrime = 1099511628211ull;
+
+/**
+ * Appends a number in little endian byte order
+ * @param value the number
+ * @param bytes bytes to append to
+ */
+static void AppendUint32(uint32_t value, std::vector<uint8_t>* bytes) {
+  for (size_t shift = 0; shift < 32; shift += 8) {
+    bytes->push_back(static_cast<uint8_t>(value >> shift));
+  }
+}
+
+/**
+ * Appends a number in little endian byte order
+ * @param value the number
+ * @param bytes bytes to append to
+ */
+static void AppendUint64(uint64_t value, std::vector<uint8_t>* bytes) {
+  AppendUint32(static_cast<uint32_t>(value), bytes);
+  AppendUint32(static_cast<uint32_t>(value >> 32), bytes);
+}
+
+/**
+ * Appends the exact bits of a float, so it reads back unchanged
+ * @param value the number
+ * @param bytes bytes to append to
+ */
+static void AppendFloat(float value, std::vector<uint8_t>* bytes) {
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  AppendUint32(bits, bytes);
+}
+
+/**
+ * Appends the state of a random generator
+ * @param random the generator
+ * @param bytes bytes to append to
+ */
+static void AppendRandom(const std::mt19937& random,
+    std::vector<uint8_t>* bytes) {
+  // the standard only defines a text form of the state, so its numbers
+  // are read out of that and kept as binary
+  std::stringstream stream;
+  stream << random;
+  std::vector<uint32_t> words;
+  unsigned long word;
+  while (stream >> word) {
+    words.push_back(static_cast<uint32_t>(word));
+  }
+
+  AppendUint32(static_cast<uint32_t>(words.size()), bytes);
+  for (uint32_t value : words) {
+    AppendUint32(value, bytes);
+  }
+}
+
+/**
+ * Mixes a number into an FNV-1a hash
+ * @param value the number
+ * @param hash the hash so far
+ */
+static void HashValue(int64_t value, uint64_t* hash) {
+  for (size_t shift = 0; shift < 64; shift += 8) {
+    *hash = (*hash ^ static_cast<uint8_t>(value >> shift)) * kFnvPrime;
+  }
+}
+
+/**
+ * Mixes where a tile is into a hash, to within kStateHashResolution
+ * @param fixture the tile's fixture
+ * @param hash the hash so far
+ */
+static void HashTileCenter(const b2Fixture* fixture, uint64_t* hash) {
+  b2Vec2 center = Block::GetTileCenter(fixture);
+  HashValue(std::lround(center.x * kStateHashResolution), hash);
+  HashValue(std::lround(center.y * kStateHashResolution), hash);
+}
 
-World::World() : moving_block_(nullptr), block_generator_(nullptr),
+namespace {
+
+/**
+ * Reads back the values of a snapshot in the order they were appended.
+ * Reading past the end gives zeros and marks the reader as failed.
+ */
+class SnapshotReader {
+ private:
+  const uint8_t* data_;
+  size_t size_;
+  size_t offset_;
+  bool is_failed_;
+
+  /**
+   * Takes the next bytes
+   * @param count number of bytes
+   * @return the bytes, or nullptr if there are not that many left
+   */
+  const uint8_t* Take(size_t count) {
+    if (is_failed_ || size_ - offset_ < count) {
+      is_failed_ = true;
+      return nullptr;
+    }
+
+    const uint8_t* bytes = data_ + offset_;
+    offset_ += count;
+    return bytes;
+  }
+
+ public:
+  SnapshotReader(const uint8_t* data, size_t size) : data_(data),
+      size_(size), offset_(0), is_failed_(false) {}
+
+  uint8_t ReadUint8() {
+    const uint8_t* bytes = Take(1);
+    return bytes == nullptr ? 0 : bytes[0];
+  }
+
+  uint32_t ReadUint32() {
+    const uint8_t* bytes = Take(4);
+    if (bytes == nullptr) {
+      return 0;
+    }
+
+    return static_cast<uint32_t>(bytes[0])
+        | static_cast<uint32_t>(bytes[1]) << 8
+        | static_cast<uint32_t>(bytes[2]) << 16
+        | static_cast<uint32_t>(bytes[3]) << 24;
+  }
+
+  uint64_t ReadUint64() {
+    uint64_t low = ReadUint32();
+    return low | static_cast<uint64_t>(ReadUint32()) << 32;
+  }
+
+  float ReadFloat() {
+    uint32_t bits = ReadUint32();
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+  }
+
+  /**
+   * Reads bytes into a vector
+   * @param count number of bytes
+   * @param bytes set to the bytes
+   */
+  void ReadBytes(size_t count, std::vector<uint8_t>* bytes) {
+    const uint8_t* data = Take(count);
+    if (data != nullptr) {
+      bytes->assign(data, data + count);
+    }
+  }
+
+  /**
+   * Reads the state of a random generator written by AppendRandom
+   * @param random set to the state
+   */
+  void ReadRandom(std::mt19937* random) {
+    uint32_t num_words = ReadUint32();
+    // the state of a Mersenne twister is a few hundred numbers
+    if (num_words > 1024) {
+      is_failed_ = true;
+      return;
+    }
+
+    std::stringstream stream;
+    for (uint32_t index = 0; index < num_words && !is_failed_; index++) {
+      stream << ReadUint32() << ' ';
+    }
+
+    if (!is_failed_ && !(stream >> *random)) {
+      is_failed_ = true;
+    }
+  }
+
+  void Fail() {
+    is_failed_ = true;
+  }
+
+  /**
+   * Checks that every read so far succeeded and used up the snapshot
+   * @return true if the snapshot was read whole
+   */
+  bool IsComplete() const {
+    return !is_failed_ && offset_ == size_;
+  }
+
+  bool IsFailed() const {
+    return is_failed_;
+  }
+};
+
+/**
+ * Body state a snapshot keeps for the moving block and every debris tile
+ */
+struct BodyState {
+  b2Vec2 position_;
+  float angle_;
+  b2Vec2 linear_velocity_;
+  float angular_velocity_;
+};
+
+} // namespace
+
+/**
+ * Appends the state of a body that a snapshot keeps
+ * @param body the body
+ * @param bytes bytes to append to
+ */
+static void AppendBodyState(const b2Body& body, std::vector<uint8_t>* bytes) {
+  AppendFloat(body.GetPosition().x, bytes);
+  AppendFloat(body.GetPosition().y, bytes);
+  // the sweep angle, from which Box2D derives the rotation every step
+  AppendFloat(body.GetAngle(), bytes);
+  AppendFloat(body.GetLinearVelocity().x, bytes);
+  AppendFloat(body.GetLinearVelocity().y, bytes);
+  AppendFloat(body.GetAngularVelocity(), bytes);
+}
+
+/**
+ * Reads a body state written by AppendBodyState
+ * @param reader the snapshot
+ * @return the state
+ */
+static BodyState ReadBodyState(SnapshotReader* reader) {
+  BodyState state;
+  state.position_.x = reader->ReadFloat();
+  state.position_.y = reader->ReadFloat();
+  state.angle_ = reader->ReadFloat();
+  state.linear_velocity_.x = reader->ReadFloat();
+  state.linear_velocity_.y = reader->ReadFloat();
+  state.angular_velocity_ = reader->ReadFloat();
+  return state;
+}
+
+/**
+ * Moves a body to a saved state
+ * @param state the state
+ * @param body the body
+ */
+static void ApplyBodyState(const BodyState& state, b2Body* body) {
+  body->SetTransform(state.position_, state.angle_);
+  body->SetLinearVelocity(state.linear_velocity_);
+  body->SetAngularVelocity(state.angular_velocity_);
+}
+
+World::World(bool is_sound_enabled) : is_hold_used_(false),
     ground_floor_body_(nullptr),
+    left_wall_body_(nullptr), right_wall_body_(nullptr),
     move_status_(kMoveOk), previous_legal_transform_(b2Transform(), 0),
     current_score_(0), current_game_state_(kChooseMode),
-    block_to_tile_width_ratio_(1), total_num_row_(kDefaultWorldNumRow),
-    total_num_col_(kDefaultWorldNumCol),
-    expected_block_speed_(kDefaultBlockVerticalSpeed), num_illegal_move_(0),
-    is_bomb_mode_(false), is_tile_disconnected_mode_(false) {
-  // Creating audio files
-  cinder::audio::SourceFileRef complete_row_file = cinder::audio::load(
-      cinder::app::loadAsset(kCompleteRowSound));
-  row_complete_sound_ = cinder::audio::Voice::create(complete_row_file);
-  cinder::audio::SourceFileRef block_collide_file = cinder::audio::load(
-      cinder::app::loadAsset(kBlockCollisionSound));
-  block_collide_sound_ = cinder::audio::Voice::create(block_collide_file);
-  cinder::audio::SourceFileRef bomb_explode_file = cinder::audio::load(
-      cinder::app::loadAsset(kBombExplodeSound));
-  bomb_explode_sound_ = cinder::audio::Voice::create(bomb_explode_file);
-  bomb_explode_sound_->setVolume(2);
-
-  // no gravity needed
-  b2Vec2 gravity(0.0f, 0.0f);
-  b2_world_ = new b2World(gravity);
+    block_to_tile_width_ratio_(1), total_num_col_(kDefaultWorldNumCol),
+    total_num_row_(kDefaultWorldNumRow),
+    expected_block_speed_(kDefaultBlockVerticalSpeed), level_(0),
+    num_illegal_move_(0),
+    is_tile_disconnected_mode_(false),
+    is_bomb_mode_(false), piece_set_(nullptr),
+    num_cleared_rows_(0), seed_(std::random_device()()),
+    garbage_random_(seed_),
+    current_tick_(0), step_phase_times_(),
+    step_function_(&World::StepMode<ClassicMode>),
+    move_function_(&World::MoveMode<ClassicMode>) {
+  if (is_sound_enabled) {
+    TraceSpan span("World::LoadSounds");
+    // Creating audio files
+    cinder::audio::SourceFileRef complete_row_file = cinder::audio::load(
+        cinder::app::loadAsset(kCompleteRowSound));
+    row_complete_sound_ = cinder::audio::Voice::create(complete_row_file);
+    cinder::audio::SourceFileRef block_collide_file = cinder::audio::load(
+        cinder::app::loadAsset(kBlockCollisionSound));
+    block_collide_sound_ = cinder::audio::Voice::create(block_collide_file);
+    cinder::audio::SourceFileRef bomb_explode_file = cinder::audio::load(
+        cinder::app::loadAsset(kBombExplodeSound));
+    bomb_explode_sound_ = cinder::audio::Voice::create(bomb_explode_file);
+    bomb_explode_sound_->setVolume(2);
+  }
+
+  // blocks ignore gravity, only loose debris falls with it
+  b2Vec2 gravity(0.0f, kDebrisGravity);
+  {
+    AllocationScope physics_scope(AllocationTracker::kPhysics);
+    b2_world_.reset(new b2World(gravity));
+  }
   // contact listeners for handling illegal move inputs
   // and revert to previous legal position
-  BlockContactListener block_contact_listener;
-  b2_world_->SetContactListener(&block_contact_listener);
+  b2_world_->SetContactListener(&contact_listener_);
 }
 
 void World::BuildGroundFloor() {
+  TraceSpan span("World::BuildGroundFloor");
   // rebuilds ground floor if it already exists
   if (ground_floor_body_ != nullptr) {
     b2_world_->DestroyBody(ground_floor_body_);
     ground_floor_body_ = nullptr;
   }
 
+  // the tile fixtures went with the old body, even if the game ends below
+  board_.ClearFixtures();
+
   // creating a ground floor for the game
   b2BodyDef ground_floor_body_def;
   ground_floor_body_def.position.Set(
       0.0f, -kGroundFloorInitialHeight);
-  b2PolygonShape* box_ground = new b2PolygonShape;
-  box_ground->SetAsBox(50.0f, kGroundFloorInitialHeight);
+  b2PolygonShape box_ground;
+  box_ground.SetAsBox(50.0f, kGroundFloorInitialHeight);
   b2FixtureDef fixture_def;
-  fixture_def.shape = box_ground;
+  fixture_def.shape = &box_ground;
   fixture_def.density = 1.0f;
   fixture_def.friction = 0.0f;
   // elasticity = 0 so block will hit and change speed quickly
@@ -76,57 +362,110 @@ void World::BuildGroundFloor() {
   // block will stop moving
   ground_floor_body_->SetType(b2_staticBody);
 
+  // End the game if the blocks reach the ceiling
+  size_t num_rows = board_.GetNumRows();
+  if (IsToppedOut()) {
+    EndGame();
+    return;
+  }
+
   // physics engine logic code
-  for (size_t row = 0; row < floor_tile_array_.size(); row++) {
-    for (size_t col = 0; col < floor_tile_array_[row].size(); col++) {
-      Block::Tile tile = floor_tile_array_[row][col];
-      // don't color null fixtures with black
-      if (tile.fixture_ == nullptr) {
-        continue;
-      }
+  for (size_t row = 0; row < num_rows; row++) {
+    // skip the empty rows above the stack
+    if (board_.IsRowEmpty(row)) {
+      continue;
+    }
 
-      // End the game if the block hits the ceiling
-      if (row >= floor_tile_array_.size() - 2) {
-        current_game_state_ = kEndScreen;
-        return;
+    for (size_t col = 0; col < board_.GetNumCols(); col++) {
+      if (!board_.IsFilled(row, col)) {
+        continue;
       }
 
       // color in the new block that collided onto the screen
-      b2PolygonShape* copy_shape = new b2PolygonShape;
-      Block::SetTileShapeAtColRow(copy_shape, col,
-          row + kGroundFloorInitialHeight);
-      b2FixtureDef* fixture_def = new b2FixtureDef;
-      fixture_def->shape = copy_shape;
-      fixture_def->density = 1.0f;
-      fixture_def->friction = 0.0f;
-      // elasticity = 0 so block will hit and change speed quickly
-      fixture_def->restitution = 0.0f;
-      ground_floor_body_->CreateFixture(fixture_def);
+      board_.SetFixture(row, col, CreateFloorTileFixture(row, col));
     }
   }
+}
+
+b2Fixture* World::CreateFloorTileFixture(size_t row, size_t col) {
+  // the body copies the shape, so both can live on the stack
+  b2PolygonShape tile_shape;
+  Block::SetTileShapeAtColRow(&tile_shape, col,
+      row + kGroundFloorInitialHeight);
+  b2FixtureDef fixture_def;
+  fixture_def.shape = &tile_shape;
+  fixture_def.density = 1.0f;
+  fixture_def.friction = 0.0f;
+  // elasticity = 0 so block will hit and change speed quickly
+  fixture_def.restitution = 0.0f;
+  return ground_floor_body_->CreateFixture(&fixture_def);
+}
+
+bool World::IsToppedOut() const {
+  size_t num_rows = board_.GetNumRows();
+  return num_rows >= 2 && (!board_.IsRowEmpty(num_rows - 1)
+      || !board_.IsRowEmpty(num_rows - 2));
+}
+
+void World::EndGame() {
+  current_game_state_ = kEndScreen;
+  for (WorldListener* listener : listeners_) {
+    listener->OnGameOver(*this);
+  }
+}
 
+void World::PlaySound(const cinder::audio::VoiceSamplePlayerNodeRef& sound) {
+  // sounds are not loaded when the world runs without sound
+  if (sound) {
+    TraceSpan span("World::PlaySound");
+    sound->start();
+  }
 }
 
-void World::Step() {
+template <typename Mode>
+void World::StepMode() {
   // if game is not in progress, don't do anything
   if (current_game_state_ == kChooseMode
       || current_game_state_ == kEndScreen) {
     return;
   }
 
-  if (is_tile_disconnected_mode_) {
-    // disconnected mode iterations are different for loose collision
-    b2_world_->Step(
-        kTimeStep, kDisconnectVelocityIter, kDisconnectPositionIter);
-  } else {
-    // regular mode with regular iteration checks
-    b2_world_->Step(kTimeStep, kVelocityIterations, kPositionIterations);
+  TraceSpan span("World::Step");
+  AllocationScope engine_scope(AllocationTracker::kEngine);
+  tick_allocations_.Restart();
+  auto phase_start = std::chrono::steady_clock::now();
+  current_tick_++;
+  // a fast block is carried most of the way here, so one physics step is
+  // left with no more than it can move, and debris isn't stepped again
+  b2Vec2 block_velocity;
+  bool is_block_carried = CarryFastBlock(&block_velocity);
+  {
+    AllocationScope physics_scope(AllocationTracker::kPhysics);
+    if (Mode::kIsTileDisconnected) {
+      // disconnected mode iterations are different for loose collision
+      b2_world_->Step(
+          kTimeStep, kDisconnectVelocityIter, kDisconnectPositionIter);
+    } else {
+      // regular mode with regular iteration checks
+      b2_world_->Step(kTimeStep, kVelocityIterations, kPositionIterations);
+    }
+  }
 
+  // a block that touched nothing keeps falling at its own speed
+  if (is_block_carried && moving_block_ != nullptr
+      && move_status_ == kMoveOk) {
+    moving_block_->GetBody()->SetLinearVelocity(block_velocity);
   }
 
+  phase_start = FinishStepPhase(kPhysicsPhase, phase_start);
+
   // Spawn a block if there is none yet
   if (moving_block_ == nullptr) {
     SpawnNewRandomBlock();
+  } else if (preview_blocks_.size() <= kNumPreviewBlocks) {
+    // the spare block is made on the tick after a spawn rather than on
+    // the lock tick, which then only has to switch a body on
+    PrepareNextBlock();
   }
 
   // checking if last move was legal or not
@@ -134,94 +473,295 @@ void World::Step() {
     RevertIllegalMove();
   }
 
-  HandleBlockDroppingOnFloor();
+  HandleBlockDroppingOnFloor<Mode>();
+  phase_start = FinishStepPhase(kLandingPhase, phase_start);
+  if (Mode::kIsTileDisconnected && !debris_.empty()) {
+    SettleDebris();
+  }
+
+  phase_start = FinishStepPhase(kDebrisPhase, phase_start);
   // reset move status
   move_status_ = kMoveOk;
+
+  for (WorldListener* listener : listeners_) {
+    listener->OnStepFinished(*this);
+  }
+
+  FinishStepPhase(kListenerPhase, phase_start);
+  tick_allocations_.Sample();
+}
+
+std::chrono::steady_clock::time_point World::FinishStepPhase(
+    StepPhase phase, std::chrono::steady_clock::time_point start) {
+  auto now = std::chrono::steady_clock::now();
+  step_phase_times_[phase] =
+      std::chrono::duration<float, std::milli>(now - start).count();
+  Tracer::Record(kStepPhaseNames[phase], start, now);
+  return now;
+}
+
+const char* World::GetStepPhaseName(StepPhase phase) {
+  return kStepPhaseNames[phase];
+}
+
+bool World::CarryFastBlock(b2Vec2* velocity) {
+  if (moving_block_ == nullptr) {
+    return false;
+  }
+
+  b2Body* body = moving_block_->GetBody();
+  *velocity = body->GetLinearVelocity();
+  b2Vec2 travel = kTimeStep * *velocity;
+  int num_pieces = std::min(kMaxTravelPieces, static_cast<int>(
+      std::ceil(travel.Length() / kMaxTravelPerPiece)));
+  if (num_pieces <= 1) {
+    return false;
+  }
+
+  // walk the block along its path a piece at a time, keeping the last
+  // piece for the physics step so that step makes the contact
+  b2Vec2 piece = (1.0f / static_cast<float>(num_pieces)) * travel;
+  b2Transform transform = body->GetTransform();
+  for (int count = 1; count < num_pieces; count++) {
+    b2Transform next_trans = transform;
+    next_trans.p += piece;
+    if (!IsBlockClear(next_trans) || IsTouchingDebris(next_trans)) {
+      break;
+    }
+
+    transform = next_trans;
+  }
+
+  body->SetTransform(transform.p, transform.q.GetAngle());
+  body->SetLinearVelocity((1.0f / kTimeStep) * piece);
+  return true;
+}
+
+/**
+ * Looks for a piece of debris in a box, ignoring the block being moved
+ */
+class DebrisQuery : public b2QueryCallback {
+ private:
+  const b2Body* moving_body_;
+  b2AABB box_;
+  bool is_found_ = false;
+
+ public:
+  DebrisQuery(const b2Body* moving_body, const b2AABB& box)
+      : moving_body_(moving_body), box_(box) {}
+
+  bool ReportFixture(b2Fixture* fixture) override {
+    // the board's tiles are all on the static floor body
+    const b2Body* body = fixture->GetBody();
+    if (body == moving_body_ || body->GetType() != b2_dynamicBody
+        || !b2TestOverlap(fixture->GetAABB(0), box_)) {
+      return true;
+    }
+
+    is_found_ = true;
+    return false;
+  }
+
+  bool IsFound() const {
+    return is_found_;
+  }
+};
+
+bool World::IsTouchingDebris(const b2Transform& transform) const {
+  if (debris_.empty()) {
+    return false;
+  }
+
+  const b2Body* body = moving_block_->GetBody();
+  for (const b2Fixture* fixture = body->GetFixtureList();
+       fixture != nullptr; fixture = fixture->GetNext()) {
+    b2AABB tile_box;
+    static_cast<const b2PolygonShape*>(fixture->GetShape())->ComputeAABB(
+        &tile_box, transform, 0);
+    // slight touches of a neighbour don't count, as in IsBlockClear
+    b2Vec2 tolerance(kOverlapTolerance, kOverlapTolerance);
+    tile_box.lowerBound += tolerance;
+    tile_box.upperBound -= tolerance;
+
+    DebrisQuery query(body, tile_box);
+    b2_world_->QueryAABB(&query, tile_box);
+    if (query.IsFound()) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+float World::GetDropDistanceAboveDebris(float drop_distance) const {
+  if (debris_.empty()) {
+    return drop_distance;
+  }
+
+  // walk down a piece at a time, the tiles fall the rest of the way once
+  // the block breaks apart
+  b2Transform transform = moving_block_->GetBody()->GetTransform();
+  float distance = 0.0f;
+  while (distance < drop_distance) {
+    float next_distance =
+        std::min(distance + kMaxTravelPerPiece, drop_distance);
+    b2Transform next_trans = transform;
+    next_trans.p.y -= next_distance;
+    if (IsTouchingDebris(next_trans)) {
+      break;
+    }
+
+    distance = next_distance;
+  }
+
+  return distance;
 }
 
 void World::SpawnNewRandomBlock() {
+  // the preview is only short at the start of a game, or when blocks lock
+  // on back to back ticks before the spare was made
+  while (preview_blocks_.size() <= kNumPreviewBlocks) {
+    PrepareNextBlock();
+  }
+
+  std::unique_ptr<Block> block = std::move(preview_blocks_.front());
+  preview_blocks_.pop_front();
+  is_hold_used_ = false;
+  ActivateBlock(std::move(block));
+}
+
+void World::PrepareNextBlock() {
+  TraceSpan span("World::PrepareNextBlock");
   if (block_generator_ == nullptr) {
-    block_generator_ = new BlockGenerator(is_bomb_mode_);
+    block_generator_.reset(new BlockGenerator(is_bomb_mode_, seed_));
+    block_generator_->SetPieceSet(piece_set_);
   }
 
-  // create first block
-  moving_block_ = block_generator_->CreateRandomBlock(this);
+  // blocks are picked in the order they spawn, so making them early
+  // doesn't change which blocks a seed gives
+  preview_blocks_.push_back(block_generator_->CreateRandomBlock(this, false));
+}
+
+void World::ActivateBlock(std::unique_ptr<Block> block) {
+  // the level may have gone up since the block was made, and a held block
+  // comes back unturned
+  b2Body* body = block->GetBody();
+  body->SetTransform(GetSpawnPosition(), 0.0f);
+  body->SetLinearVelocity(b2Vec2(0.0f, expected_block_speed_));
+  body->SetAngularVelocity(0.0f);
+  body->SetActive(true);
+  block->SetTimesRotated(0);
+  moving_block_ = std::move(block);
   // reset move status
   move_status_ = kMoveOk;
   num_illegal_move_ = 0;
+
+  for (WorldListener* listener : listeners_) {
+    listener->OnBlockSpawned(*this, *moving_block_);
+  }
 }
 
-void World::Move(Block::Move direction) {
-  if (direction == Block::kMoveLeft) {
-    b2AABB bounding_box = moving_block_->GetBlockBox(this);
+void World::ClearWaitingBlocks() {
+  for (const std::unique_ptr<Block>& block : preview_blocks_) {
+    b2_world_->DestroyBody(block->GetBody());
+  }
 
-    // if block is already on left wall, do nothing
-    if ((bounding_box.lowerBound.x - 1.0) >= 0.0) {
-      Block::Transform old_trans(*moving_block_);
-      moving_block_->GetBody()->SetTransform(
-          b2Vec2(old_trans.p.x - 1.0, old_trans.p.y),
-          old_trans.q.GetAngle());
-      move_status_ = kValidateLegalMove;
-      previous_legal_transform_ = old_trans;
-    }
+  preview_blocks_.clear();
+  if (held_block_ != nullptr) {
+    b2_world_->DestroyBody(held_block_->GetBody());
+    held_block_.reset();
+  }
 
-    return;
+  is_hold_used_ = false;
+}
+
+template <typename Mode>
+bool World::MoveMode(Block::Move direction) {
+  // nothing to move before a block spawns or once the game is over
+  if (moving_block_ == nullptr || current_game_state_ == kEndScreen) {
+    return false;
   }
 
-  if (direction == Block::kMoveRight) {
-    b2AABB bounding_box = moving_block_->GetBlockBox(this);
+  if (direction == Block::kHold) {
+    if (is_hold_used_) {
+      return false;
+    }
 
-    // if block is already on right wall, do nothing
-    if ((bounding_box.upperBound.x + 1.0) <= GetTotalNumCol()) {
-      Block::Transform old_trans(*moving_block_);
-      moving_block_->GetBody()->SetTransform(
-          b2Vec2(old_trans.p.x + 1.0, old_trans.p.y),
-          old_trans.q.GetAngle());
-      move_status_ = kValidateLegalMove;
-      previous_legal_transform_ = old_trans;
+    std::unique_ptr<Block> block = std::move(moving_block_);
+    block->GetBody()->SetActive(false);
+    if (held_block_ == nullptr) {
+      held_block_ = std::move(block);
+      SpawnNewRandomBlock();
+    } else {
+      std::swap(held_block_, block);
+      ActivateBlock(std::move(block));
     }
 
-    return;
+    is_hold_used_ = true;
+    return true;
   }
 
-  if (direction == Block::kMoveDown) {
-    moving_block_->GetBody()->SetLinearVelocity(b2Vec2(0,
-        3.0 * GetExpectedBlockSpeed()));
+  b2Body* body = moving_block_->GetBody();
+  Block::Transform current_trans(*moving_block_);
 
-    // ignore checking if block collision was correct if in disconnect mode
-    if (is_tile_disconnected_mode_) {
-      return;
+  if (direction == Block::kMoveLeft || direction == Block::kMoveRight) {
+    b2Transform moved_trans = current_trans;
+    moved_trans.p.x += direction == Block::kMoveLeft ? -1.0f : 1.0f;
+
+    // walls and floor tiles are checked before the block moves
+    if (!IsBlockClear(moved_trans)) {
+      return false;
     }
 
-    // Checking block collides and stops properly
-    move_status_ = kValidateLegalMove;
-    return;
+    body->SetTransform(moved_trans.p, moved_trans.q.GetAngle());
+    return true;
+  }
+
+  if (direction == Block::kMoveDown) {
+    body->SetLinearVelocity(b2Vec2(0, 3.0 * GetExpectedBlockSpeed()));
+    return true;
   }
 
-  if (direction == Block::kRotate) {
-    size_t times_rotated = moving_block_->GetTimesRotated();
-    Block::Transform current_trans(*moving_block_);
-    previous_legal_transform_ = current_trans;
-
-    // Manually change center point of rotation (to 2,2) due to lack of
-    // setter for changing the default (0, 0) point of rotation.
-    // Tried using set mass data, but point of rotation still does not change
-    if ((times_rotated % kRotatesForFullCircle) == 0) {
-      current_trans.p.Set(current_trans.p.x, current_trans.p.y + 4.0f);
-    } else if ((times_rotated % kRotatesForFullCircle == 1)) {
-      current_trans.p.Set(current_trans.p.x + 4.0f, current_trans.p.y);
-    } else if ((times_rotated % kRotatesForFullCircle == 2)) {
-      current_trans.p.Set(current_trans.p.x, current_trans.p.y - 4.0f);
+  if (direction == Block::kHardDrop) {
+    body->SetTransform(
+        body->GetPosition() - b2Vec2(0.0f, GetDropDistance()),
+        body->GetAngle());
+    if (Mode::kIsTileDisconnected) {
+      // comes apart like any other landing in this mode
+      BreakMovingBlockApart();
     } else {
-      // rotated 3 times
-      current_trans.p.Set(current_trans.p.x - 4.0f, current_trans.p.y);
+      LockMovingBlock<Mode>();
     }
 
-    moving_block_->GetBody()->SetTransform(
-        current_trans.p, current_trans.q.GetAngle() - (M_PI / 2));
-    move_status_ = kValidateLegalMove;
-    moving_block_->SetTimesRotated(times_rotated + 1);
+    return true;
   }
+
+  // rotate
+  size_t times_rotated = current_trans.times_rotated_;
+  b2Transform rotated_trans = current_trans;
+
+  // Manually change center point of rotation (to 2,2) due to lack of
+  // setter for changing the default (0, 0) point of rotation.
+  // Tried using set mass data, but point of rotation still does not change
+  if ((times_rotated % kRotatesForFullCircle) == 0) {
+    rotated_trans.p.Set(rotated_trans.p.x, rotated_trans.p.y + 4.0f);
+  } else if ((times_rotated % kRotatesForFullCircle == 1)) {
+    rotated_trans.p.Set(rotated_trans.p.x + 4.0f, rotated_trans.p.y);
+  } else if ((times_rotated % kRotatesForFullCircle == 2)) {
+    rotated_trans.p.Set(rotated_trans.p.x, rotated_trans.p.y - 4.0f);
+  } else {
+    // rotated 3 times
+    rotated_trans.p.Set(rotated_trans.p.x - 4.0f, rotated_trans.p.y);
+  }
+
+  rotated_trans.q.Set(current_trans.q.GetAngle() - (M_PI / 2));
+  if (!IsBlockClear(rotated_trans)) {
+    return false;
+  }
+
+  body->SetTransform(rotated_trans.p, rotated_trans.q.GetAngle());
+  moving_block_->SetTimesRotated(times_rotated + 1);
+  return true;
 }
 
 void World::IllegalMoveCallBack(b2Body* other_body) {
@@ -229,11 +769,10 @@ void World::IllegalMoveCallBack(b2Body* other_body) {
     return;
   }
 
-  // only set previous transform when move is ok
-  if (move_status_ == kMoveOk) {
-    Block::Transform old_trans(*moving_block_);
-    previous_legal_transform_ = old_trans;
-  }
+  // moves are checked before they happen, so the block was legal
+  // right up to this contact
+  Block::Transform old_trans(*moving_block_);
+  previous_legal_transform_ = old_trans;
 
   move_status_ = kDetectIllegal;
   // block has hit the ground
@@ -242,129 +781,637 @@ void World::IllegalMoveCallBack(b2Body* other_body) {
   }
 }
 
+float World::GetDropDistance() const {
+  if (moving_block_ == nullptr) {
+    return 0.0f;
+  }
+
+  // loose tiles in the air stop the block too, so the ghost shows where a
+  // hard drop really ends
+  return GetDropDistanceAboveDebris(GetBoardDropDistance());
+}
+
+float World::GetBoardDropDistance() const {
+  // a falling block sits part way between rows, so it first drops by the
+  // part that lines its tiles up with the rows below them
+  const b2Fixture* fixture_list = moving_block_->GetBody()->GetFixtureList();
+  float center_row = Block::GetTileCenter(fixture_list).y - 0.5f;
+  float row_offset = center_row - std::floor(center_row + kOverlapTolerance);
+
+  // a block above every column it covers lands on the highest of them
+  int drop_rows = static_cast<int>(board_.GetNumRows());
+  bool is_under_overhang = false;
+  for (const b2Fixture* fixture = fixture_list; fixture != nullptr;
+       fixture = fixture->GetNext()) {
+    b2Vec2 center = Block::GetTileCenter(fixture);
+    int col = static_cast<int>(std::floor(center.x));
+    int row = static_cast<int>(std::lround(center.y - 0.5f - row_offset));
+    if (col < 0 || col >= static_cast<int>(board_.GetNumCols())) {
+      return 0.0f;
+    }
+
+    int height = static_cast<int>(board_.GetColumnHeight(col));
+    if (row < height) {
+      is_under_overhang = true;
+      break;
+    }
+
+    drop_rows = std::min(drop_rows, row - height);
+  }
+
+  if (!is_under_overhang) {
+    return row_offset + drop_rows;
+  }
+
+  // a block slid under an overhang walks down one row at a time
+  b2Transform dropped_trans = moving_block_->GetBody()->GetTransform();
+  dropped_trans.p.y -= row_offset + 1.0f;
+  drop_rows = 0;
+  while (IsBlockClear(dropped_trans)) {
+    dropped_trans.p.y -= 1.0f;
+    drop_rows++;
+  }
+
+  return row_offset + drop_rows;
+}
+
+bool World::IsBlockClear(const b2Transform& transform) const {
+  for (const b2Fixture* fixture = moving_block_->GetBody()->GetFixtureList();
+       fixture != nullptr; fixture = fixture->GetNext()) {
+    b2AABB tile_box;
+    static_cast<const b2PolygonShape*>(fixture->GetShape())->ComputeAABB(
+        &tile_box, transform, 0);
+
+    // every tile the box covers, ignoring slight touches of its neighbours
+    int min_col = static_cast<int>(
+        std::floor(tile_box.lowerBound.x + kOverlapTolerance));
+    int max_col = static_cast<int>(
+        std::floor(tile_box.upperBound.x - kOverlapTolerance));
+    int min_row = static_cast<int>(
+        std::floor(tile_box.lowerBound.y + kOverlapTolerance));
+    int max_row = static_cast<int>(
+        std::floor(tile_box.upperBound.y - kOverlapTolerance));
+    if (min_col < 0 || max_col >= static_cast<int>(board_.GetNumCols())
+        || min_row < 0) {
+      return false;
+    }
+
+    // tiles above the board are always empty
+    max_row = std::min(max_row, static_cast<int>(board_.GetNumRows()) - 1);
+    for (int row = min_row; row <= max_row; row++) {
+      for (int col = min_col; col <= max_col; col++) {
+        if (board_.IsFilled(row, col)) {
+          return false;
+        }
+      }
+    }
+  }
+
+  return true;
+}
+
 void World::RevertIllegalMove() {
-  // destroy and create new moving block
-  b2_world_->DestroyBody(moving_block_->GetBody());
-  moving_block_ = block_generator_->CreateBlockByTemplate(
-      this, moving_block_->GetTemplateId());
-  moving_block_->GetBody()->SetTransform(previous_legal_transform_.p,
+  // put the block back where it was, falling at its usual speed
+  b2Body* body = moving_block_->GetBody();
+  body->SetTransform(previous_legal_transform_.p,
       previous_legal_transform_.q.GetAngle());
+  body->SetLinearVelocity(b2Vec2(0.0f, GetExpectedBlockSpeed()));
+  body->SetAngularVelocity(0.0f);
   moving_block_->SetTimesRotated(previous_legal_transform_.times_rotated_);
 }
 
 void World::CheckCompleteRow() {
+  TraceSpan span("World::CheckCompleteRow");
   // Checking if a row was completed and remove if so
-  for (size_t row = 0; row < floor_tile_array_.size(); row++) {
-    size_t filled_tiles = 0;
+  for (size_t row = 0; row < board_.GetNumRows(); row++) {
+    if (board_.IsRowFull(row)) {
+      current_score_++;
+      num_cleared_rows_++;
+      if (current_score_ % kRowsPerLevel == 0 && level_ < kMaxLevel) {
+        SetLevel(level_ + 1);
+      }
 
-    for (size_t col = 0; col < floor_tile_array_[row].size(); col++) {
-      if (floor_tile_array_[row][col].color_ != cinder::Color::black()) {
-        filled_tiles++;
+      for (WorldListener* listener : listeners_) {
+        listener->OnRowCleared(*this, row);
       }
+
+      // move the rows above down and add an empty row at the top
+      board_.RemoveRow(row);
+      // recheck from new row
+      row--;
+
+      // Play sound for completing a row
+      PlaySound(row_complete_sound_);
     }
+  }
+}
 
-    if (filled_tiles == floor_tile_array_[row].size()) {
-      current_score_++;
+void World::AddGarbageRows(size_t num_rows) {
+  // garbage can only be added once the floor exists
+  if (num_rows == 0 || board_.GetNumRows() == 0) {
+    return;
+  }
 
-      // reset row to empty and move to top
-      for (size_t col = 0; col < floor_tile_array_[row].size(); col++) {
-        floor_tile_array_[row][col].color_ = cinder::Color::black();
-        floor_tile_array_[row][col].fixture_ = nullptr;
+  size_t num_col = board_.GetNumCols();
+  std::uniform_int_distribution<size_t> dist(0, num_col - 1);
+  size_t open_col = dist(garbage_random_);
+  cinder::Color garbage_color(0.5, 0.5, 0.5);
+
+  for (size_t row_added = 0; row_added < num_rows; row_added++) {
+    // top row drops off, the top out check happens when the floor is rebuilt
+    board_.InsertBottomRow();
+    for (size_t col = 0; col < num_col; col++) {
+      if (col != open_col) {
+        board_.FillTile(0, col, garbage_color);
       }
+    }
+  }
 
-      std::vector<Block::Tile> empty_row = floor_tile_array_[row];
-      size_t moving_row = row;
+  for (WorldListener* listener : listeners_) {
+    listener->OnGarbageRowsAdded(*this, num_rows, open_col, garbage_color);
+  }
 
-      while (moving_row < (floor_tile_array_.size() - 1)) {
-        floor_tile_array_[moving_row] = floor_tile_array_[moving_row + 1];
-        moving_row++;
-      }
+  BuildGroundFloor();
+}
 
-      floor_tile_array_[floor_tile_array_.size() - 1] = empty_row;
-      // recheck from new row
-      row--;
+size_t World::TakeClearedRowCount() {
+  size_t num_cleared_rows = num_cleared_rows_;
+  num_cleared_rows_ = 0;
+  return num_cleared_rows;
+}
 
-      // Play sound for completing a row
-      row_complete_sound_->start();
+size_t World::GetMemoryFootprint() const {
+  size_t num_bytes = sizeof(World) + sizeof(b2World);
+
+  num_bytes += board_.GetMemoryFootprint();
+  num_bytes += debris_.capacity() * sizeof(Debris);
+
+  if (block_generator_ != nullptr) {
+    num_bytes += sizeof(BlockGenerator);
+  }
+
+  if (moving_block_ != nullptr) {
+    num_bytes += sizeof(Block);
+  }
+
+  num_bytes += preview_blocks_.size() * sizeof(Block);
+  if (held_block_ != nullptr) {
+    num_bytes += sizeof(Block);
+  }
+
+  // physics engine objects come from the b2World's block allocator
+  for (const b2Body* body = b2_world_->GetBodyList(); body != nullptr;
+       body = body->GetNext()) {
+    num_bytes += sizeof(b2Body);
+    for (const b2Fixture* fixture = body->GetFixtureList();
+         fixture != nullptr; fixture = fixture->GetNext()) {
+      num_bytes += sizeof(b2Fixture) + sizeof(b2PolygonShape);
+    }
+  }
+
+  num_bytes += b2_world_->GetContactCount() * sizeof(b2Contact);
+  return num_bytes;
+}
+
+std::vector<uint8_t> World::SaveSnapshot() const {
+  std::vector<uint8_t> bytes;
+  bytes.push_back(kSnapshotVersion);
+  bytes.push_back(static_cast<uint8_t>(current_game_state_));
+  bytes.push_back((is_bomb_mode_ ? kSnapshotBombModeFlag : 0)
+      | (is_tile_disconnected_mode_ ? kSnapshotTileDisconnectedModeFlag : 0)
+      | (piece_set_ != nullptr ? kSnapshotPieceSetFlag : 0));
+  bytes.push_back(static_cast<uint8_t>(move_status_));
+  AppendUint32(seed_, &bytes);
+  AppendUint64(current_tick_, &bytes);
+  AppendUint64(current_score_, &bytes);
+  AppendUint32(static_cast<uint32_t>(level_), &bytes);
+  AppendUint32(static_cast<uint32_t>(num_illegal_move_), &bytes);
+  AppendUint32(static_cast<uint32_t>(num_cleared_rows_), &bytes);
+  AppendRandom(garbage_random_, &bytes);
+  // the generator is only made when the first block spawns
+  bytes.push_back(block_generator_ != nullptr ? 1 : 0);
+  if (block_generator_ != nullptr) {
+    AppendRandom(block_generator_->GetRandom(), &bytes);
+  }
+
+  AppendUint32(static_cast<uint32_t>(board_.GetNumRows()), &bytes);
+  AppendUint32(static_cast<uint32_t>(board_.GetNumCols()), &bytes);
+  bytes.insert(bytes.end(), board_.GetCells().begin(),
+      board_.GetCells().end());
+  AppendUint32(static_cast<uint32_t>(board_.GetPalette().size()), &bytes);
+  for (const cinder::Color& color : board_.GetPalette()) {
+    AppendFloat(color.r, &bytes);
+    AppendFloat(color.g, &bytes);
+    AppendFloat(color.b, &bytes);
+  }
+
+  // the rotation is kept as sine and cosine, as the transform holds it
+  AppendFloat(previous_legal_transform_.p.x, &bytes);
+  AppendFloat(previous_legal_transform_.p.y, &bytes);
+  AppendFloat(previous_legal_transform_.q.s, &bytes);
+  AppendFloat(previous_legal_transform_.q.c, &bytes);
+  AppendUint32(static_cast<uint32_t>(previous_legal_transform_.times_rotated_),
+      &bytes);
+
+  bytes.push_back(moving_block_ != nullptr ? 1 : 0);
+  if (moving_block_ != nullptr) {
+    bytes.push_back(static_cast<uint8_t>(moving_block_->GetTemplateId()));
+    AppendUint32(static_cast<uint32_t>(moving_block_->GetTimesRotated()),
+        &bytes);
+    AppendBodyState(*moving_block_->GetBody(), &bytes);
+  }
+
+  // waiting blocks sit unturned at the spawn point, so only what they are
+  // is kept
+  bytes.push_back(static_cast<uint8_t>(preview_blocks_.size()));
+  for (const std::unique_ptr<Block>& block : preview_blocks_) {
+    bytes.push_back(static_cast<uint8_t>(block->GetTemplateId()));
+  }
+
+  bytes.push_back(held_block_ != nullptr ? 1 : 0);
+  if (held_block_ != nullptr) {
+    bytes.push_back(static_cast<uint8_t>(held_block_->GetTemplateId()));
+  }
+
+  bytes.push_back(is_hold_used_ ? 1 : 0);
+  AppendUint32(static_cast<uint32_t>(debris_.size()), &bytes);
+  const BlockTemplate* classic_end =
+      kClassicBlockTemplates + kNumClassicBlockTemplates + 1;
+  for (const Debris& debris : debris_) {
+    bool is_classic = debris.block_template_ >= kClassicBlockTemplates
+        && debris.block_template_ < classic_end;
+    bool is_reloaded = debris.block_template_ >= kReloadedBlockTemplates
+        && debris.block_template_
+            < kReloadedBlockTemplates + kNumReloadedBlockTemplates;
+    bytes.push_back(is_classic ? kClassicTemplateTable
+                    : is_reloaded ? kReloadedTemplateTable
+                                  : kPieceSetTemplateTable);
+    bytes.push_back(debris.block_template_->template_id_);
+    AppendBodyState(*debris.body_, &bytes);
+    bytes.push_back(debris.body_->IsAwake() ? 1 : 0);
+  }
+
+  return bytes;
+}
+
+bool World::RestoreSnapshot(const uint8_t* data, size_t size) {
+  // everything is read and checked before the world is touched
+  SnapshotReader reader(data, size);
+  uint8_t version = reader.ReadUint8();
+  uint8_t game_state = reader.ReadUint8();
+  uint8_t flags = reader.ReadUint8();
+  uint8_t move_status = reader.ReadUint8();
+  // template ids of a game with loaded blocks only mean something with
+  // the same piece set
+  bool has_piece_set = (flags & kSnapshotPieceSetFlag) != 0;
+  if (version != kSnapshotVersion
+      || (game_state != kClassic && game_state != kReloaded)
+      || move_status > kMoveOk || has_piece_set != (piece_set_ != nullptr)) {
+    return false;
+  }
+
+  uint32_t seed = reader.ReadUint32();
+  uint64_t tick = reader.ReadUint64();
+  uint64_t score = reader.ReadUint64();
+  uint32_t level = reader.ReadUint32();
+  uint32_t num_illegal_move = reader.ReadUint32();
+  uint32_t num_cleared_rows = reader.ReadUint32();
+  std::mt19937 garbage_random;
+  reader.ReadRandom(&garbage_random);
+  bool has_block_generator = reader.ReadUint8() != 0;
+  std::mt19937 block_random;
+  if (has_block_generator) {
+    reader.ReadRandom(&block_random);
+  }
+
+  // the board has the size the mode gives it
+  size_t ratio = game_state == kReloaded ? 2 : 1;
+  size_t num_rows = reader.ReadUint32();
+  size_t num_cols = reader.ReadUint32();
+  if (num_rows != static_cast<size_t>(kDefaultWorldNumRow) * ratio
+      || num_cols != static_cast<size_t>(kDefaultWorldNumCol) * ratio) {
+    return false;
+  }
+
+  std::vector<uint8_t> cells;
+  reader.ReadBytes(num_rows * num_cols, &cells);
+  std::vector<cinder::Color> palette(
+      std::min<size_t>(reader.ReadUint32(), Board::kMaxPaletteSize + 1));
+  for (cinder::Color& color : palette) {
+    color.r = reader.ReadFloat();
+    color.g = reader.ReadFloat();
+    color.b = reader.ReadFloat();
+  }
+
+  Board board;
+  if (reader.IsFailed() || !board.Restore(num_rows, num_cols, cells,
+      palette)) {
+    return false;
+  }
+
+  b2Transform legal_transform;
+  legal_transform.p.x = reader.ReadFloat();
+  legal_transform.p.y = reader.ReadFloat();
+  legal_transform.q.s = reader.ReadFloat();
+  legal_transform.q.c = reader.ReadFloat();
+  size_t legal_times_rotated = reader.ReadUint32();
+
+  size_t num_templates = has_piece_set ? piece_set_->GetNumPieces()
+      : game_state == kReloaded ? kNumReloadedBlockTemplates
+                                : kNumClassicBlockTemplates + 1;
+  bool has_moving_block = reader.ReadUint8() != 0;
+  size_t block_template_id = 0;
+  size_t times_rotated = 0;
+  BodyState block_state = {};
+  if (has_moving_block) {
+    block_template_id = reader.ReadUint8();
+    times_rotated = reader.ReadUint32();
+    block_state = ReadBodyState(&reader);
+    // blocks come from the generator, so there is one once a block exists
+    if (!has_block_generator || block_template_id >= num_templates) {
+      return false;
+    }
+  }
+
+  std::vector<size_t> preview_template_ids(reader.ReadUint8());
+  for (size_t& template_id : preview_template_ids) {
+    template_id = reader.ReadUint8();
+  }
+
+  bool has_held_block = reader.ReadUint8() != 0;
+  size_t held_template_id = has_held_block ? reader.ReadUint8() : 0;
+  bool is_hold_used = reader.ReadUint8() != 0;
+  std::vector<size_t> waiting_template_ids = preview_template_ids;
+  if (has_held_block) {
+    waiting_template_ids.push_back(held_template_id);
+  }
+
+  for (size_t template_id : waiting_template_ids) {
+    if (!has_block_generator || template_id >= num_templates) {
+      return false;
+    }
+  }
+
+  uint32_t num_debris = reader.ReadUint32();
+  std::vector<std::pair<const BlockTemplate*, BodyState>> debris;
+  std::vector<bool> is_debris_awake;
+  for (uint32_t index = 0; index < num_debris && !reader.IsFailed();
+       index++) {
+    uint8_t table = reader.ReadUint8();
+    uint8_t template_id = reader.ReadUint8();
+    BodyState state = ReadBodyState(&reader);
+    is_debris_awake.push_back(reader.ReadUint8() != 0);
+    if (table == kClassicTemplateTable
+        && template_id <= kNumClassicBlockTemplates) {
+      debris.emplace_back(&kClassicBlockTemplates[template_id], state);
+    } else if (table == kReloadedTemplateTable
+        && template_id < kNumReloadedBlockTemplates) {
+      debris.emplace_back(&kReloadedBlockTemplates[template_id], state);
+    } else if (table == kPieceSetTemplateTable && has_piece_set
+        && template_id < piece_set_->GetNumPieces()) {
+      debris.emplace_back(&piece_set_->GetTemplates()[template_id], state);
+    } else {
+      reader.Fail();
+    }
+  }
+
+  if (!reader.IsComplete()) {
+    return false;
+  }
+
+  // the game being replaced goes first, its bodies included
+  if (moving_block_ != nullptr) {
+    b2_world_->DestroyBody(moving_block_->GetBody());
+    moving_block_.reset();
+  }
+
+  ClearWaitingBlocks();
+
+  for (const Debris& old_debris : debris_) {
+    b2_world_->DestroyBody(old_debris.body_);
+  }
+
+  debris_.clear();
+  seed_ = seed;
+  is_bomb_mode_ = (flags & kSnapshotBombModeFlag) != 0;
+  is_tile_disconnected_mode_ = (flags & kSnapshotTileDisconnectedModeFlag) != 0;
+  level_ = std::min<size_t>(level, kMaxLevel);
+  // sizes the world, sets the block speed, builds the walls and picks the
+  // mode's step and move functions
+  SetCurrentGameState(static_cast<GameState>(game_state));
+  board_ = board;
+  BuildGroundFloor();
+
+  current_tick_ = tick;
+  current_score_ = score;
+  num_illegal_move_ = num_illegal_move;
+  num_cleared_rows_ = num_cleared_rows;
+  move_status_ = static_cast<MoveStatus>(move_status);
+  previous_legal_transform_ =
+      Block::Transform(legal_transform, legal_times_rotated);
+  garbage_random_ = garbage_random;
+  block_generator_.reset();
+  if (has_block_generator) {
+    block_generator_.reset(new BlockGenerator(is_bomb_mode_, seed_));
+    block_generator_->SetPieceSet(piece_set_);
+    block_generator_->SetRandom(block_random);
+  }
+
+  if (has_moving_block) {
+    moving_block_ =
+        block_generator_->CreateBlockByTemplate(this, block_template_id);
+    ApplyBodyState(block_state, moving_block_->GetBody());
+    moving_block_->SetTimesRotated(times_rotated);
+  }
+
+  for (size_t template_id : preview_template_ids) {
+    preview_blocks_.push_back(
+        block_generator_->CreateBlockByTemplate(this, template_id, false));
+  }
+
+  if (has_held_block) {
+    held_block_ =
+        block_generator_->CreateBlockByTemplate(this, held_template_id, false);
+  }
+
+  is_hold_used_ = is_hold_used;
+  for (size_t index = 0; index < debris.size(); index++) {
+    const BodyState& state = debris[index].second;
+    AddDebris(*debris[index].first, state.position_, state.linear_velocity_);
+    b2Body* body = debris_.back().body_;
+    ApplyBodyState(state, body);
+    body->SetAwake(is_debris_awake[index]);
+  }
+
+  return true;
+}
+
+uint64_t World::GetStateHash() const {
+  uint64_t hash = kFnvOffsetBasis;
+  HashValue(current_game_state_, &hash);
+  HashValue(static_cast<int64_t>(current_tick_), &hash);
+  HashValue(static_cast<int64_t>(current_score_), &hash);
+  HashValue(static_cast<int64_t>(level_), &hash);
+  for (uint8_t cell : board_.GetCells()) {
+    hash = (hash ^ cell) * kFnvPrime;
+  }
+
+  if (moving_block_ != nullptr) {
+    HashValue(static_cast<int64_t>(moving_block_->GetTemplateId()), &hash);
+    HashValue(static_cast<int64_t>(moving_block_->GetTimesRotated()), &hash);
+    for (const b2Fixture* fixture = moving_block_->GetBody()->GetFixtureList();
+         fixture != nullptr; fixture = fixture->GetNext()) {
+      HashTileCenter(fixture, &hash);
     }
   }
+
+  // the player sees what comes next and what is held too
+  HashValue(static_cast<int64_t>(GetNumPreviewBlocks()), &hash);
+  for (size_t index = 0; index < GetNumPreviewBlocks(); index++) {
+    HashValue(static_cast<int64_t>(preview_blocks_[index]->GetTemplateId()),
+        &hash);
+  }
+
+  HashValue(held_block_ != nullptr
+      ? static_cast<int64_t>(held_block_->GetTemplateId()) : -1, &hash);
+  HashValue(static_cast<int64_t>(debris_.size()), &hash);
+  for (const Debris& debris : debris_) {
+    HashTileCenter(debris.body_->GetFixtureList(), &hash);
+  }
+
+  return hash;
+}
+
+void World::AddListener(WorldListener* listener) {
+  listeners_.push_back(listener);
+}
+
+void World::RemoveListener(WorldListener* listener) {
+  listeners_.erase(std::remove(listeners_.begin(), listeners_.end(), listener),
+      listeners_.end());
+}
+
+void World::SetSeed(uint32_t seed) {
+  seed_ = seed;
+  garbage_random_.seed(seed);
+  if (block_generator_ != nullptr) {
+    block_generator_->SetSeed(seed);
+  }
+}
+
+void World::SetPieceSet(const PieceSet* piece_set) {
+  piece_set_ = piece_set;
+  if (block_generator_ != nullptr) {
+    block_generator_->SetPieceSet(piece_set);
+  }
+}
+
+void World::SelectModeFunctions() {
+  if (is_bomb_mode_) {
+    step_function_ = &World::StepMode<BombMode>;
+    move_function_ = &World::MoveMode<BombMode>;
+  } else if (is_tile_disconnected_mode_) {
+    step_function_ = &World::StepMode<DisjointedMode>;
+    move_function_ = &World::MoveMode<DisjointedMode>;
+  } else if (current_game_state_ == kReloaded) {
+    step_function_ = &World::StepMode<ReloadedMode>;
+    move_function_ = &World::MoveMode<ReloadedMode>;
+  } else {
+    step_function_ = &World::StepMode<ClassicMode>;
+    move_function_ = &World::MoveMode<ClassicMode>;
+  }
 }
 
 void World::SetCurrentGameState(GameState game_state) {
   current_game_state_ = game_state;
-  Block::Tile tile(nullptr, cinder::Color::black());
+  SelectModeFunctions();
   // default size for classic mode
   block_to_tile_width_ratio_ = 1;
-  expected_block_speed_ = kDefaultBlockVerticalSpeed;
 
   if (current_game_state_ == kReloaded) {
     block_to_tile_width_ratio_ = 2;
-    expected_block_speed_ = kDefaultBlockVerticalSpeed * 2.0;
   }
 
+  // reloaded tiles are half size, so blocks cross them twice as fast
+  SetLevel(level_);
+
   total_num_row_ = kDefaultWorldNumRow * block_to_tile_width_ratio_;
   total_num_col_ = kDefaultWorldNumCol * block_to_tile_width_ratio_;
 
-  // create 2d array containing blocks already fallen for reloaded mode
-  for (size_t row = 0; row < kDefaultWorldNumRow * block_to_tile_width_ratio_;
-      row++) {
-    std::vector<Block::Tile> row_colors;
-    for (size_t col = 0;
-        col < kDefaultWorldNumCol * block_to_tile_width_ratio_; col++) {
-      row_colors.push_back(tile);
-    }
-    floor_tile_array_.push_back(row_colors);
-  }
+  // empty floor for the tiles of blocks that have landed
+  board_.Reset(total_num_row_, total_num_col_);
 
   BuildGroundFloor();
   InitializeWalls();
 }
 
+void World::SetLevel(size_t level) {
+  level_ = std::min(level, kMaxLevel);
+  expected_block_speed_ = kDefaultBlockVerticalSpeed
+      * block_to_tile_width_ratio_ * GetGravityMultiplier(level_);
+}
+
+double World::GetGravityMultiplier(size_t level) {
+  return std::pow(kMaxGravity,
+      static_cast<double>(std::min(level, kMaxLevel)) / kMaxLevel);
+}
+
 void World::InitializeWalls() {
+  // walls of an earlier game may be the wrong height
+  if (left_wall_body_ != nullptr) {
+    b2_world_->DestroyBody(left_wall_body_);
+    b2_world_->DestroyBody(right_wall_body_);
+  }
+
   // creating wall on left side of the game
   b2BodyDef left_wall_body_def;
   left_wall_body_def.position.Set(-5.0f, GetTotalNumRow() / 2.0);
-  b2Body* left_wall_body = b2_world_->CreateBody(&left_wall_body_def);
+  left_wall_body_ = b2_world_->CreateBody(&left_wall_body_def);
   b2PolygonShape box_left_wall;
   box_left_wall.SetAsBox(5.0f, GetTotalNumRow() / 2.0);
-  left_wall_body->CreateFixture(&box_left_wall, 0.0f);
+  left_wall_body_->CreateFixture(&box_left_wall, 0.0f);
 
   // creating wall on right side of the game
   b2BodyDef right_wall_body_def;
   right_wall_body_def.position.Set(
       GetTotalNumCol() + 5.0f, GetTotalNumRow() / 2.0);
-  b2Body* right_wall_body = b2_world_->CreateBody(&right_wall_body_def);
+  right_wall_body_ = b2_world_->CreateBody(&right_wall_body_def);
   b2PolygonShape box_right_wall;
   box_right_wall.SetAsBox(5.0f, GetTotalNumRow() / 2.0);
-  right_wall_body->CreateFixture(&box_right_wall, 0.0f);
+  right_wall_body_->CreateFixture(&box_right_wall, 0.0f);
 }
 
 void World::BlowUpSurroundingTiles(size_t row, size_t col) {
-  Block::Tile exploded_tile;
-  exploded_tile.color_ = cinder::Color::white();
-
   // blow up surrounding 3 by 3 blocks,
   // changing them into white color temporarily
-  // using int due to row/col possibly being negative when subtracted
-  for (int current_row = ((int) row - 1); current_row <= (row + 1);
-      current_row++) {
-    for (int current_col = ((int) col - 1); current_col <= (col + 1);
-        current_col++) {
-      if (current_row < 0 || current_row >= floor_tile_array_.size()
-          || current_col < 0 || current_col > floor_tile_array_[0].size()) {
-        continue;
-      }
-
-      floor_tile_array_[current_row][current_col] = exploded_tile;
+  for (size_t current_row = row == 0 ? 0 : row - 1;
+       current_row <= row + 1 && current_row < board_.GetNumRows();
+       current_row++) {
+    for (size_t current_col = col == 0 ? 0 : col - 1;
+         current_col <= col + 1 && current_col < board_.GetNumCols();
+         current_col++) {
+      board_.ClearTile(current_row, current_col, true);
     }
   }
 }
 
+template <typename Mode>
 void World::HandleBlockDroppingOnFloor() {
-  // ingore a block hitting the ground too fast if in disconnect mode
-  // otherwise fix the block from colliding too quickly by the physics engine
+  // in disconnect mode the block falls apart as soon as it hits anything
+  if (Mode::kIsTileDisconnected) {
+    if (moving_block_ != nullptr && (move_status_ == kHitGround
+        || move_status_ == kDetectIllegal
+        || moving_block_->GetBody()->GetLinearVelocity().y
+            > GetExpectedBlockSpeed() + 1)) {
+      BreakMovingBlockApart();
+    }
+
+    return;
+  }
+
+  // fix the block from colliding too quickly by the physics engine
   bool is_block_finished = false;
-  if (!is_tile_disconnected_mode_ && move_status_ == kHitGround) {
+  if (move_status_ == kHitGround) {
     if (moving_block_->GetBody()->GetLinearVelocity().y > 0) {
         // GetExpectedBlockSpeed() ) {
       is_block_finished = true;
@@ -374,7 +1421,7 @@ void World::HandleBlockDroppingOnFloor() {
   }
 
   // reset the block if it has been hitting the floor too many times
-  // occurs in disconnect mode when a block gets stuck while falling apart
+  // occurs when a block gets stuck without slowing down
   if (move_status_ == kHitGround || move_status_ == kDetectIllegal) {
     num_illegal_move_++;
 
@@ -388,51 +1435,183 @@ void World::HandleBlockDroppingOnFloor() {
   if (moving_block_ != nullptr) {
     if ((moving_block_->GetBody()->GetLinearVelocity().y >
            (GetExpectedBlockSpeed() + 1)) || is_block_finished) {
-      b2Fixture* fixture_list = moving_block_->GetBody()->GetFixtureList();
-
-      for (b2Fixture* fixture = fixture_list; fixture != nullptr;
-           fixture = fixture->GetNext()) {
-        // Game logic code
-        b2PolygonShape* shape =
-            static_cast<b2PolygonShape*>(fixture->GetShape());
-        b2AABB bound_box = fixture->GetAABB(0);
-        b2Vec2 bottom_left = bound_box.lowerBound;
-        size_t col = roundf(bottom_left.x);
-        size_t row = roundf(bottom_left.y);
-
-        // if a block reached the top of the screen, end the game
-        if (row >= floor_tile_array_.size()
-            || col >= floor_tile_array_[0].size()) {
-          current_game_state_ = kEndScreen;
-          return;
-        }
+      LockMovingBlock<Mode>();
+    }
+  }
+}
 
-        // check if shape was bomb, and should blow up surrounding
-        // shapes in a 3 by 3 area
-        if (moving_block_->GetTemplateId() == kBombId) {
-          BlowUpSurroundingTiles(row, col);
-          // bomb explosion sound
-          bomb_explode_sound_->start();
-
-          // add the tile in to the ground
-        } else {
-          Block::SetTileShapeAtColRow(shape, col, row);
-          Block::Tile tile(fixture, moving_block_->GetColor());
-          floor_tile_array_[row][col] = tile;
-          // regular collide sound
-          block_collide_sound_->start();
-        }
+template <typename Mode>
+void World::LockMovingBlock() {
+  b2Fixture* fixture_list = moving_block_->GetBody()->GetFixtureList();
+  std::vector<TilePosition> locked_tiles;
+  bool is_topped_out = false;
+
+  for (b2Fixture* fixture = fixture_list; fixture != nullptr;
+       fixture = fixture->GetNext()) {
+    // Game logic code
+    b2AABB bound_box = fixture->GetAABB(0);
+    b2Vec2 bottom_left = bound_box.lowerBound;
+    size_t col = roundf(bottom_left.x);
+    size_t row = roundf(bottom_left.y);
+
+    // if a block reached the top of the screen, end the game
+    if (row >= board_.GetNumRows() || col >= board_.GetNumCols()) {
+      is_topped_out = true;
+      break;
+    }
+
+    // check if shape was bomb, and should blow up surrounding
+    // shapes in a 3 by 3 area
+    if (Mode::kHasBomb && moving_block_->IsBomb()) {
+      BlowUpSurroundingTiles(row, col);
+      // bomb explosion sound
+      PlaySound(bomb_explode_sound_);
+      for (WorldListener* listener : listeners_) {
+        listener->OnBombExploded(*this, TilePosition{row, col});
       }
 
-      b2_world_->DestroyBody(moving_block_->GetBody());
-      moving_block_ = nullptr;
+      // add the tile in to the ground
+    } else {
+      board_.FillTile(row, col, moving_block_->GetColor());
+      locked_tiles.push_back(TilePosition{row, col});
+      // regular collide sound
+      PlaySound(block_collide_sound_);
+    }
+  }
+
+  for (WorldListener* listener : listeners_) {
+    listener->OnBlockLocked(*this, *moving_block_, locked_tiles);
+  }
 
-      // Check for a complete row, then build the floor, and spawn new block
-      CheckCompleteRow();
-      BuildGroundFloor();
-      SpawnNewRandomBlock();
+  if (is_topped_out) {
+    EndGame();
+    return;
+  }
+
+  b2_world_->DestroyBody(moving_block_->GetBody());
+  moving_block_.reset();
+
+  // Check for a complete row, then build the floor, and spawn new block
+  CheckCompleteRow();
+  BuildGroundFloor();
+  SpawnNewRandomBlock();
+}
+
+void World::BreakMovingBlockApart() {
+  b2Body* body = moving_block_->GetBody();
+  for (const b2Fixture* fixture = body->GetFixtureList(); fixture != nullptr;
+       fixture = fixture->GetNext()) {
+    AddDebris(moving_block_->GetTemplate(),
+        Block::GetTileCenter(fixture) - b2Vec2(0.5f, 0.5f),
+        body->GetLinearVelocity());
+  }
+
+  b2_world_->DestroyBody(body);
+  moving_block_.reset();
+  SpawnNewRandomBlock();
+}
+
+void World::AddDebris(const BlockTemplate& block_template,
+    const b2Vec2& position, const b2Vec2& velocity) {
+  // debris has no user data, so only the moving block reports contacts
+  b2BodyDef body_def;
+  body_def.type = b2_dynamicBody;
+  body_def.position = position;
+  body_def.linearVelocity = velocity;
+  b2Body* body = b2_world_->CreateBody(&body_def);
+
+  b2PolygonShape shape;
+  Block::SetTileShapeAtColRow(&shape, 0, 0);
+  b2FixtureDef fixture_def;
+  fixture_def.shape = &shape;
+  fixture_def.density = 1.0f;
+  // some friction so piles of debris come to rest and fall asleep
+  fixture_def.friction = 0.5f;
+  fixture_def.restitution = 0.0f;
+  body->CreateFixture(&fixture_def);
+
+  debris_.push_back(Debris{body, &block_template});
+}
+
+void World::SettleDebris() {
+  // Box2D puts an island of touching bodies to sleep once all of them are
+  // still, so only sleeping debris is looked at closely
+  std::vector<std::pair<b2Vec2, Debris>> settled;
+  for (size_t index = 0; index < debris_.size();) {
+    Debris& debris = debris_[index];
+    b2Vec2 center = Block::GetTileCenter(debris.body_->GetFixtureList());
+    bool is_outside = center.y < -kDebrisCullMargin
+        || center.x < -kDebrisCullMargin
+        || center.x > board_.GetNumCols() + kDebrisCullMargin;
+
+    if (!is_outside && debris.body_->IsAwake()) {
+      index++;
+      continue;
+    }
+
+    if (is_outside) {
+      b2_world_->DestroyBody(debris.body_);
+    } else {
+      settled.emplace_back(center, debris);
     }
+
+    // order doesn't matter, so remove by swapping with the last
+    debris = debris_.back();
+    debris_.pop_back();
+  }
+
+  if (settled.empty()) {
+    return;
+  }
+
+  // snap the lowest debris first so a pile keeps its order
+  std::sort(settled.begin(), settled.end(),
+      [](const std::pair<b2Vec2, Debris>& first,
+          const std::pair<b2Vec2, Debris>& second) {
+        return first.first.y < second.first.y;
+      });
+
+  for (const std::pair<b2Vec2, Debris>& tile : settled) {
+    const b2Vec2& center = tile.first;
+    const Debris& debris = tile.second;
+    size_t col = static_cast<size_t>(std::min(std::max(
+        std::floor(center.x), 0.0f), board_.GetNumCols() - 1.0f));
+    size_t row = static_cast<size_t>(std::max(std::floor(center.y), 0.0f));
+
+    // debris squeezed into a filled tile goes on top of it
+    while (row < board_.GetNumRows() && board_.IsFilled(row, col)) {
+      row++;
+    }
+
+    if (row < board_.GetNumRows()) {
+      Block block(*debris.block_template_, debris.body_);
+      board_.FillTile(row, col, block.GetColor());
+      board_.SetFixture(row, col, CreateFloorTileFixture(row, col));
+      for (WorldListener* listener : listeners_) {
+        listener->OnBlockLocked(*this, block, {TilePosition{row, col}});
+      }
+    }
+
+    b2_world_->DestroyBody(debris.body_);
+  }
+
+  size_t num_rows_before = num_cleared_rows_;
+  CheckCompleteRow();
+  if (num_cleared_rows_ != num_rows_before) {
+    BuildGroundFloor();
+    // debris resting on the cleared rows has to fall again
+    for (Debris& debris : debris_) {
+      debris.body_->SetAwake(true);
+    }
+  } else if (IsToppedOut()) {
+    EndGame();
   }
 }
 
+// batch runs can step a known mode without the runtime dispatch
+template void World::StepMode<ClassicMode>();
+template void World::StepMode<ReloadedMode>();
+template void World::StepMode<DisjointedMode>();
+template void World::StepMode<BombMode>();
+
 } // namespace tetris
@@ -0,0 +1,382 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if defined(__APPLE__)
+#include <mach/mach.h>
+#elif !defined(_WIN32)
+#include <unistd.h>
+#endif
+
+#include "telemetry/allocation_tracker.h"
+#include "tetris_engine.h"
+
+namespace tetris {
+
+const size_t kDefaultNumTicks = 1000000;
+// a move is tried every few ticks and the block is dropped every so often,
+// so blocks also fall and land on their own in between
+const size_t kMoveInterval = 8;
+const size_t kDropInterval = 40;
+const size_t kRssSampleInterval = 10000;
+// allocations per tick may grow by this much even from a baseline of 0
+const double kAllocationSlack = 0.05;
+const uint32_t kFirstSeed = 1;
+
+/**
+ * Numbers measured for one mode, or the baseline they are checked against
+ */
+struct PerfNumbers {
+  double ticks_per_second_;
+  double p99_tick_us_;
+  double peak_rss_kb_;
+  double allocations_per_tick_;
+};
+
+struct PerfBaseline {
+  double tolerance_;
+  std::map<std::string, PerfNumbers> modes_;
+};
+
+/**
+ * A mode as the window starts it
+ */
+struct ScriptedMode {
+  const char* name_;
+  World::GameState game_state_;
+  bool is_tile_disconnected_;
+  bool is_bomb_;
+};
+
+/**
+ * Gets the memory the process has in RAM right now
+ * @return resident size in bytes, 0 if it can't be read
+ */
+static size_t GetResidentBytes() {
+#if defined(__APPLE__)
+  mach_task_basic_info info;
+  mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+  if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO,
+      reinterpret_cast<task_info_t>(&info), &count) != KERN_SUCCESS) {
+    return 0;
+  }
+
+  return info.resident_size;
+#elif defined(_WIN32)
+  return 0;
+#else
+  FILE* statm = fopen("/proc/self/statm", "r");
+  if (statm == nullptr) {
+    return 0;
+  }
+
+  unsigned long num_pages = 0;
+  unsigned long num_resident_pages = 0;
+  int num_read = fscanf(statm, "%lu %lu", &num_pages, &num_resident_pages);
+  fclose(statm);
+  if (num_read != 2) {
+    return 0;
+  }
+
+  return num_resident_pages * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+/**
+ * Gets the ticks each mode plays
+ * @return TETRIS_PERF_TICKS if set, for quicker runs, else a million
+ */
+static size_t GetNumTicks() {
+  const char* num_ticks = std::getenv("TETRIS_PERF_TICKS");
+  if (num_ticks == nullptr) {
+    return kDefaultNumTicks;
+  }
+
+  return std::max<size_t>(std::stoul(num_ticks), 1);
+}
+
+/**
+ * Reads the baseline file
+ * @param path the file
+ * @param baseline set to the tolerance and the numbers of each mode
+ * @return false if the file can't be opened or a line can't be read
+ */
+static bool ReadBaseline(const std::string& path, PerfBaseline* baseline) {
+  std::ifstream file(path);
+  if (!file) {
+    return false;
+  }
+
+  baseline->tolerance_ = 0.0;
+  baseline->modes_.clear();
+  std::string line;
+  while (std::getline(file, line)) {
+    std::istringstream words(line);
+    std::string name;
+    if (!(words >> name) || name[0] == '#') {
+      continue;
+    }
+
+    if (name == "tolerance") {
+      if (!(words >> baseline->tolerance_)) {
+        return false;
+      }
+
+      continue;
+    }
+
+    PerfNumbers& numbers = baseline->modes_[name];
+    if (!(words >> numbers.ticks_per_second_ >> numbers.p99_tick_us_
+          >> numbers.peak_rss_kb_ >> numbers.allocations_per_tick_)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/**
+ * Formats the numbers of one mode as a row of the baseline file
+ * @param name the mode
+ * @param numbers the measured numbers
+ * @return the row
+ */
+static std::string FormatBaselineRow(const std::string& name,
+    const PerfNumbers& numbers) {
+  char row[128];
+  snprintf(row, sizeof(row), "%-12s %-17.0f %-12.0f %-12.0f %.3f",
+      name.c_str(), numbers.ticks_per_second_, numbers.p99_tick_us_,
+      numbers.peak_rss_kb_, numbers.allocations_per_tick_);
+  return row;
+}
+
+/**
+ * Replaces the numbers of one mode in the baseline file, keeping the rest
+ * of the file as it is
+ * @param path the file
+ * @param name the mode
+ * @param numbers the measured numbers
+ * @return false if the file can't be written
+ */
+static bool WriteBaseline(const std::string& path, const std::string& name,
+    const PerfNumbers& numbers) {
+  std::string row = FormatBaselineRow(name, numbers);
+
+  std::vector<std::string> lines;
+  bool is_replaced = false;
+  std::ifstream input(path);
+  std::string line;
+  while (std::getline(input, line)) {
+    std::istringstream words(line);
+    std::string first_word;
+    if (words >> first_word && first_word == name) {
+      line = row;
+      is_replaced = true;
+    }
+
+    lines.push_back(line);
+  }
+
+  if (!is_replaced) {
+    lines.push_back(row);
+  }
+
+  std::ofstream output(path);
+  for (const std::string& output_line : lines) {
+    output << output_line << '\n';
+  }
+
+  return static_cast<bool>(output.flush());
+}
+
+/**
+ * Plays scripted games of a mode back to back, each with the next seed,
+ * until the ticks are used up
+ * @param mode the mode
+ * @param num_ticks ticks to step in total
+ * @return the measured numbers
+ */
+static PerfNumbers PlayScriptedGames(const ScriptedMode& mode,
+    size_t num_ticks) {
+  const Block::Move kMoves[] = {Block::kMoveLeft, Block::kMoveRight,
+                                Block::kRotate, Block::kMoveDown};
+  std::vector<float> tick_times;
+  tick_times.reserve(num_ticks);
+  size_t peak_rss = GetResidentBytes();
+  AllocationCounts start_counts = AllocationTracker::GetTotalCounts();
+  std::chrono::duration<double> total_time(0.0);
+
+  uint32_t seed = kFirstSeed;
+  while (tick_times.size() < num_ticks) {
+    TetrisEngine engine(false);
+    World& world = engine.GetWorld();
+    world.SetSeed(seed);
+    world.SetIsTileDisconnectedMode(mode.is_tile_disconnected_);
+    world.SetIsBombMode(mode.is_bomb_);
+    engine.SetCurrentGameState(mode.game_state_);
+    std::mt19937 random(seed);
+
+    for (size_t tick = 0; tick_times.size() < num_ticks
+         && world.GetCurrentGameState() != World::kEndScreen; tick++) {
+      auto start = std::chrono::steady_clock::now();
+      world.Step();
+      std::chrono::duration<double> elapsed =
+          std::chrono::steady_clock::now() - start;
+      total_time += elapsed;
+      tick_times.push_back(static_cast<float>(elapsed.count() * 1e6));
+
+      if (tick % kMoveInterval == 0) {
+        engine.Move(kMoves[random() % 4]);
+      }
+
+      if (tick % kDropInterval == kDropInterval - 1) {
+        engine.Move(Block::kHardDrop);
+      }
+
+      if (tick_times.size() % kRssSampleInterval == 0) {
+        peak_rss = std::max(peak_rss, GetResidentBytes());
+      }
+    }
+
+    seed++;
+  }
+
+  AllocationCounts counts =
+      AllocationTracker::GetTotalCounts() - start_counts;
+  size_t p99_index = (tick_times.size() - 1) * 99 / 100;
+  std::nth_element(tick_times.begin(), tick_times.begin() + p99_index,
+      tick_times.end());
+
+  PerfNumbers numbers;
+  numbers.ticks_per_second_ =
+      static_cast<double>(num_ticks) / total_time.count();
+  numbers.p99_tick_us_ = tick_times[p99_index];
+  numbers.peak_rss_kb_ =
+      static_cast<double>(std::max(peak_rss, GetResidentBytes())) / 1024.0;
+  numbers.allocations_per_tick_ =
+      static_cast<double>(counts.num_allocations_)
+      / static_cast<double>(num_ticks);
+  return numbers;
+}
+
+/**
+ * Adds a row comparing one number to its budget
+ * @param table the table, one row added
+ * @param metric name of the number
+ * @param baseline number in the baseline
+ * @param budget the worst the number may be
+ * @param measured number measured now
+ * @param is_higher_better true when the measured number must reach the
+ * budget, false when it must stay under it
+ * @return true if the number is within its budget
+ */
+static bool AddRow(std::string* table, const char* metric, double baseline,
+    double budget, double measured, bool is_higher_better) {
+  bool is_within = is_higher_better ? measured >= budget : measured <= budget;
+  double change = baseline > 0.0
+      ? (measured - baseline) / baseline * 100.0 : 0.0;
+  char row[160];
+  snprintf(row, sizeof(row), "%-22s %12.2f %12.2f %12.2f %+8.1f%%  %s\n",
+      metric, baseline, budget, measured, change,
+      is_within ? "ok" : "OVER BUDGET");
+  *table += row;
+  return is_within;
+}
+
+/**
+ * Plays a mode and checks every number against the baseline, failing with
+ * a table of the baseline, the budget and the measured numbers. A mode with
+ * no baseline only warns with what it measured.
+ * @param mode the mode
+ */
+static void CheckMode(const ScriptedMode& mode) {
+  const std::string kBaselinePath = TETRIS_PERF_BASELINE_PATH;
+  size_t num_ticks = GetNumTicks();
+  PerfNumbers measured = PlayScriptedGames(mode, num_ticks);
+
+  if (std::getenv("TETRIS_PERF_WRITE_BASELINE") != nullptr) {
+    REQUIRE(WriteBaseline(kBaselinePath, mode.name_, measured));
+    return;
+  }
+
+  PerfBaseline baseline;
+  REQUIRE(ReadBaseline(kBaselinePath, &baseline));
+  if (baseline.modes_.count(mode.name_) == 0) {
+    // a mode nobody has recorded yet has nothing to be held to, so show
+    // what it measured in the file's own layout and move on
+    WARN("no baseline for " << mode.name_ << " in " << kBaselinePath
+        << ", skipping it. Measured:\n"
+        << "# mode       ticks_per_second  p99_tick_us  peak_rss_kb  "
+        << "allocations_per_tick\n"
+        << FormatBaselineRow(mode.name_, measured));
+    return;
+  }
+
+  const PerfNumbers& expected = baseline.modes_[mode.name_];
+  double tolerance = baseline.tolerance_;
+
+  std::string table = std::string(mode.name_) + ", "
+      + std::to_string(num_ticks) + " ticks, against " + kBaselinePath
+      + ", tolerance " + std::to_string(tolerance) + "\n";
+  char header[160];
+  snprintf(header, sizeof(header), "%-22s %12s %12s %12s %9s\n", "metric",
+      "baseline", "budget", "measured", "change");
+  table += header;
+
+  bool is_within = true;
+  is_within &= AddRow(&table, "ticks per second", expected.ticks_per_second_,
+      expected.ticks_per_second_ * (1.0 - tolerance),
+      measured.ticks_per_second_, true);
+  is_within &= AddRow(&table, "p99 tick time (us)", expected.p99_tick_us_,
+      expected.p99_tick_us_ * (1.0 + tolerance), measured.p99_tick_us_,
+      false);
+  // memory can't be read on every platform
+  if (measured.peak_rss_kb_ > 0.0) {
+    is_within &= AddRow(&table, "peak resident (KiB)", expected.peak_rss_kb_,
+        expected.peak_rss_kb_ * (1.0 + tolerance), measured.peak_rss_kb_,
+        false);
+  }
+
+  // nor can allocations when the build doesn't count them
+  if (AllocationTracker::IsTracked()) {
+    is_within &= AddRow(&table, "allocations per tick",
+        expected.allocations_per_tick_,
+        expected.allocations_per_tick_ * (1.0 + tolerance)
+            + kAllocationSlack,
+        measured.allocations_per_tick_, false);
+  }
+
+  INFO(table);
+  CHECK(is_within);
+}
+
+TEST_CASE("Classic games stay within budget", "[perf]") {
+  CheckMode(ScriptedMode{"classic", World::kClassic, false, false});
+}
+
+TEST_CASE("Reloaded games stay within budget", "[perf]") {
+  CheckMode(ScriptedMode{"reloaded", World::kReloaded, false, false});
+}
+
+TEST_CASE("Disjointed games stay within budget", "[perf]") {
+  CheckMode(ScriptedMode{"disjointed", World::kReloaded, true, false});
+}
+
+TEST_CASE("Bomb games stay within budget", "[perf]") {
+  CheckMode(ScriptedMode{"bomb", World::kClassic, false, true});
+}
+
+} // namespace tetris
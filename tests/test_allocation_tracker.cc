@@ -0,0 +1,105 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#include <catch2/catch.hpp>
+
+#include <memory>
+
+#include "telemetry/allocation_tracker.h"
+
+namespace tetris {
+
+/**
+ * Tells if this build counts allocations, warning when it doesn't
+ * @return false if the counts are always zero
+ */
+static bool IsCounting() {
+  if (!AllocationTracker::IsTracked()) {
+    WARN("allocations are not counted in this build");
+    return false;
+  }
+
+  return true;
+}
+
+TEST_CASE("Allocations are charged to the current scope",
+    "[allocation_tracker]") {
+  if (!IsCounting()) {
+    return;
+  }
+
+  REQUIRE(AllocationTracker::GetCurrentSubsystem()
+      == AllocationTracker::kOther);
+  AllocationSampler sampler;
+
+  {
+    AllocationScope engine_scope(AllocationTracker::kEngine);
+    std::unique_ptr<char[]> engine_bytes(new char[100]);
+    {
+      AllocationScope renderer_scope(AllocationTracker::kRenderer);
+      std::unique_ptr<char[]> renderer_bytes(new char[200]);
+    }
+
+    REQUIRE(AllocationTracker::GetCurrentSubsystem()
+        == AllocationTracker::kEngine);
+  }
+
+  REQUIRE(AllocationTracker::GetCurrentSubsystem()
+      == AllocationTracker::kOther);
+  sampler.Sample();
+
+  const AllocationCounts& engine =
+      sampler.GetDelta(AllocationTracker::kEngine);
+  REQUIRE(engine.num_allocations_ == 1);
+  REQUIRE(engine.bytes_allocated_ == 100);
+  REQUIRE(engine.GetNumLive() == 0);
+  const AllocationCounts& renderer =
+      sampler.GetDelta(AllocationTracker::kRenderer);
+  REQUIRE(renderer.num_allocations_ == 1);
+  REQUIRE(renderer.bytes_allocated_ == 200);
+  REQUIRE(renderer.GetLiveBytes() == 0);
+}
+
+TEST_CASE("Frees are credited to the subsystem that allocated",
+    "[allocation_tracker]") {
+  if (!IsCounting()) {
+    return;
+  }
+
+  std::unique_ptr<char[]> engine_bytes;
+  {
+    AllocationScope engine_scope(AllocationTracker::kEngine);
+    engine_bytes.reset(new char[64]);
+  }
+
+  AllocationSampler sampler;
+  {
+    AllocationScope renderer_scope(AllocationTracker::kRenderer);
+    engine_bytes.reset();
+  }
+
+  sampler.Sample();
+  REQUIRE(sampler.GetDelta(AllocationTracker::kEngine).num_frees_ == 1);
+  REQUIRE(sampler.GetDelta(AllocationTracker::kEngine).bytes_freed_ == 64);
+  REQUIRE(sampler.GetDelta(AllocationTracker::kRenderer).num_frees_ == 0);
+}
+
+TEST_CASE("Sampling restarts the measurement", "[allocation_tracker]") {
+  if (!IsCounting()) {
+    return;
+  }
+
+  AllocationSampler sampler;
+  std::unique_ptr<int> value;
+  {
+    AllocationScope engine_scope(AllocationTracker::kEngine);
+    value.reset(new int(1));
+  }
+
+  sampler.Sample();
+  REQUIRE(sampler.GetDelta(AllocationTracker::kEngine).num_allocations_ == 1);
+
+  sampler.Sample();
+  REQUIRE(sampler.GetDelta(AllocationTracker::kEngine).num_allocations_ == 0);
+}
+
+} // namespace tetris
@@ -13,14 +13,42 @@ namespace tetris {
 
 TEST_CASE("Test block generator constructor", "[block-generator]") {
   BlockGenerator block_generator(false);
-  const std::vector<Block>& shape_list = block_generator.GetBlockTemplateList();
+  BlockTemplateList shape_list = block_generator.GetBlockTemplateList();
   REQUIRE(shape_list.size() == 7);
 }
 
+TEST_CASE("Bomb mode adds the bomb template", "[block-generator][bomb]") {
+  BlockGenerator block_generator(true);
+  BlockTemplateList shape_list = block_generator.GetBlockTemplateList();
+  REQUIRE(shape_list.size() == 8);
+  REQUIRE(shape_list[7].template_id_ == World::kBombId);
+}
+
+TEST_CASE("Template rotations turn inside the 4 by 4 box",
+    "[block-generator][block-template]") {
+  for (const BlockTemplate& block_template : kClassicBlockTemplates) {
+    for (size_t rotation = 0; rotation < BlockTemplate::kNumRotations;
+         rotation++) {
+      const BlockTemplate::Box& box = block_template.boxes_[rotation];
+      REQUIRE(box.min_col_ >= 0);
+      REQUIRE(box.min_row_ >= 0);
+      REQUIRE(box.max_col_ < BlockTemplate::kBoxSize);
+      REQUIRE(box.max_row_ < BlockTemplate::kBoxSize);
+    }
+
+    // four quarter turns come back to the start
+    for (size_t tile = 0; tile < block_template.num_tiles_; tile++) {
+      BlockTemplate::Cell cell = RotateCell(block_template.cells_[3][tile]);
+      REQUIRE(cell.col_ == block_template.cells_[0][tile].col_);
+      REQUIRE(cell.row_ == block_template.cells_[0][tile].row_);
+    }
+  }
+}
+
 TEST_CASE("Create Random Shape", "[block-generator]") {
   BlockGenerator block_generator(false);
   World world;
-  Block* block = block_generator.CreateRandomBlock(&world);
+  std::unique_ptr<Block> block = block_generator.CreateRandomBlock(&world);
   // makes sure the block is created in the correct world
   REQUIRE(block->GetBody()->GetWorld() == world.GetB2World());
 }
@@ -29,7 +57,7 @@ TEST_CASE("Create Set Shape", "[block-generator]") {
   BlockGenerator block_generator(false);
   World world;
   // create 4 by 1 block
-  Block* block = block_generator.CreateBlockByTemplate(&world, 0);
+  std::unique_ptr<Block> block = block_generator.CreateBlockByTemplate(&world, 0);
   // makes sure the block is created in the correct world
   REQUIRE(block->GetBody()->GetWorld() == world.GetB2World());
 }
@@ -39,7 +67,7 @@ TEST_CASE("Create Bomb Block", "[block-generator][bomb]") {
   World world;
   world.SetIsBombMode(true);
   int bomb_id = World::kBombId;
-  Block* block = block_generator.CreateBlockByTemplate(&world, bomb_id);
+  std::unique_ptr<Block> block = block_generator.CreateBlockByTemplate(&world, bomb_id);
   // Check id
   REQUIRE(block->GetTemplateId() == bomb_id);
 }
@@ -48,7 +76,7 @@ TEST_CASE("Check block functions", "[block-generator][create-block][block]") {
   BlockGenerator block_generator(false);
   World world;
   world.SetCurrentGameState(World::kClassic);
-  Block* block = block_generator.CreateBlockByTemplate(&world, 0);
+  std::unique_ptr<Block> block = block_generator.CreateBlockByTemplate(&world, 0);
   SECTION("Check Id") {
     REQUIRE(block->GetTemplateId() == 0);
   }
@@ -73,8 +101,18 @@ TEST_CASE("Check block functions", "[block-generator][create-block][block]") {
     REQUIRE(bound_box.upperBound.y < 26);
   }
 
+  SECTION("Bounding box follows the body") {
+    b2AABB bound_box = block->GetBlockBox(&world);
+    b2Body* body = block->GetBody();
+    body->SetTransform(body->GetPosition() - b2Vec2(2.0f, 0.0f),
+        body->GetAngle());
+    b2AABB moved_box = block->GetBlockBox(&world);
+    REQUIRE(moved_box.lowerBound.x == Approx(bound_box.lowerBound.x - 2.0));
+    REQUIRE(moved_box.upperBound.y == Approx(bound_box.upperBound.y));
+  }
+
   SECTION("Get Bounding Box List") {
-    std::vector<b2AABB> bound_box_list = block->GetBoundingBoxList();
+    FixtureBoxRange bound_box_list = block->GetBoundingBoxList();
     REQUIRE(bound_box_list.size() == 4);
   }
 }
@@ -0,0 +1,190 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#include <Box2D/Collision/Shapes/b2PolygonShape.h>
+#include <Box2D/Dynamics/b2World.h>
+#include <catch2/catch.hpp>
+
+#include "physics/board.h"
+
+namespace tetris {
+
+TEST_CASE("Board starts empty", "[board]") {
+  Board board;
+  board.Reset(24, 10);
+
+  REQUIRE(board.GetNumRows() == 24);
+  REQUIRE(board.GetNumCols() == 10);
+  REQUIRE(board.GetCells().size() == 240);
+  for (size_t row = 0; row < board.GetNumRows(); row++) {
+    REQUIRE_FALSE(board.IsRowFull(row));
+    for (size_t col = 0; col < board.GetNumCols(); col++) {
+      REQUIRE_FALSE(board.IsFilled(row, col));
+      REQUIRE(board.GetFixture(row, col) == nullptr);
+    }
+  }
+}
+
+TEST_CASE("Board palette", "[board]") {
+  Board board;
+  board.Reset(4, 4);
+
+  SECTION("Same color shares an index") {
+    board.FillTile(0, 0, cinder::Color(1, 0, 0));
+    board.FillTile(2, 3, cinder::Color(1, 0, 0));
+    REQUIRE(board.GetTileColorIndex(0, 0) == board.GetTileColorIndex(2, 3));
+    REQUIRE(board.GetPalette().size() == 3);
+    REQUIRE(board.GetTileColor(2, 3) == cinder::Color(1, 0, 0));
+  }
+
+  SECTION("Black and white tiles still count as filled") {
+    board.FillTile(0, 0, cinder::Color::black());
+    board.FillTile(0, 1, cinder::Color::white());
+    REQUIRE(board.IsFilled(0, 0));
+    REQUIRE(board.IsFilled(0, 1));
+    REQUIRE(board.GetTileColor(0, 1) == cinder::Color::white());
+  }
+
+  SECTION("Full palette falls back to the closest color") {
+    for (size_t index = 0; index < Board::kMaxPaletteSize; index++) {
+      board.GetColorIndex(cinder::Color(index / 255.0f, 0, 0));
+    }
+
+    REQUIRE(board.GetPalette().size() == Board::kMaxPaletteSize);
+    board.FillTile(1, 1, cinder::Color(0.1f, 0.9f, 0));
+    REQUIRE(board.GetPalette().size() == Board::kMaxPaletteSize);
+    REQUIRE(board.IsFilled(1, 1));
+  }
+
+  SECTION("Exploded tiles are empty") {
+    board.FillTile(1, 1, cinder::Color(0, 1, 0));
+    board.ClearTile(1, 1, true);
+    REQUIRE_FALSE(board.IsFilled(1, 1));
+    REQUIRE(board.IsExploded(1, 1));
+    REQUIRE(board.GetTileColor(1, 1) == cinder::Color::white());
+
+    board.ClearTile(1, 1);
+    REQUIRE_FALSE(board.IsExploded(1, 1));
+  }
+}
+
+TEST_CASE("Board rows", "[board]") {
+  Board board;
+  board.Reset(4, 3);
+  for (size_t col = 0; col < 3; col++) {
+    board.FillTile(0, col, cinder::Color(1, 0, 0));
+  }
+  board.FillTile(1, 2, cinder::Color(0, 0, 1));
+
+  REQUIRE(board.IsRowFull(0));
+  REQUIRE_FALSE(board.IsRowFull(1));
+
+  SECTION("Removing a row moves the rows above down") {
+    board.RemoveRow(0);
+    REQUIRE_FALSE(board.IsRowFull(0));
+    REQUIRE(board.IsFilled(0, 2));
+    REQUIRE(board.GetTileColor(0, 2) == cinder::Color(0, 0, 1));
+    REQUIRE_FALSE(board.IsFilled(1, 2));
+    REQUIRE_FALSE(board.IsFilled(3, 2));
+  }
+
+  SECTION("Inserting a row moves every row up") {
+    board.InsertBottomRow();
+    REQUIRE_FALSE(board.IsFilled(0, 0));
+    REQUIRE(board.IsRowFull(1));
+    REQUIRE(board.IsFilled(2, 2));
+  }
+}
+
+TEST_CASE("Board column heights", "[board]") {
+  Board board;
+  board.Reset(6, 3);
+  board.FillTile(0, 0, cinder::Color(1, 0, 0));
+  board.FillTile(3, 0, cinder::Color(1, 0, 0));
+  board.FillTile(1, 1, cinder::Color(0, 1, 0));
+  board.FillTile(1, 2, cinder::Color(0, 1, 0));
+  REQUIRE(board.GetColumnHeight(0) == 4);
+  REQUIRE(board.GetColumnHeight(1) == 2);
+  REQUIRE(board.IsRowEmpty(2));
+
+  SECTION("Clearing the top tile finds the next one down") {
+    board.ClearTile(3, 0);
+    REQUIRE(board.GetColumnHeight(0) == 1);
+    board.ClearTile(0, 0, true);
+    REQUIRE(board.GetColumnHeight(0) == 0);
+  }
+
+  SECTION("Removing a row lowers the columns above it") {
+    board.FillTile(1, 0, cinder::Color(1, 0, 0));
+    REQUIRE(board.IsRowFull(1));
+    board.RemoveRow(1);
+    REQUIRE(board.GetColumnHeight(0) == 3);
+    REQUIRE(board.GetColumnHeight(1) == 0);
+    REQUIRE(board.GetColumnHeight(2) == 0);
+    REQUIRE(board.IsRowEmpty(1));
+    REQUIRE_FALSE(board.IsRowEmpty(2));
+  }
+
+  SECTION("Inserting a row raises every column") {
+    board.FillTile(5, 2, cinder::Color(0, 1, 0));
+    board.InsertBottomRow();
+    REQUIRE(board.GetColumnHeight(0) == 5);
+    REQUIRE(board.GetColumnHeight(1) == 3);
+    // the top tile fell off, leaving the one moved up from row 1
+    REQUIRE(board.GetColumnHeight(2) == 3);
+    REQUIRE(board.IsRowEmpty(0));
+  }
+}
+
+TEST_CASE("Board restores saved tiles", "[board]") {
+  Board board;
+  board.Reset(6, 3);
+  board.FillTile(0, 0, cinder::Color(1, 0, 0));
+  board.FillTile(0, 1, cinder::Color(0, 1, 0));
+  board.FillTile(2, 2, cinder::Color(0, 1, 0));
+
+  Board restored;
+  REQUIRE(restored.Restore(board.GetNumRows(), board.GetNumCols(),
+      board.GetCells(), board.GetPalette()));
+  REQUIRE(restored.GetCells() == board.GetCells());
+  REQUIRE(restored.GetTileColor(2, 2) == cinder::Color(0, 1, 0));
+  REQUIRE(restored.GetColumnHeight(2) == 3);
+  REQUIRE(restored.GetColumnHeight(1) == 1);
+  REQUIRE_FALSE(restored.IsRowEmpty(0));
+  REQUIRE(restored.GetFixture(0, 0) == nullptr);
+
+  SECTION("Tiles that don't fit are refused") {
+    REQUIRE_FALSE(restored.Restore(5, 3, board.GetCells(),
+        board.GetPalette()));
+    std::vector<cinder::Color> short_palette(board.GetPalette().begin(),
+        board.GetPalette().begin() + 2);
+    REQUIRE_FALSE(restored.Restore(6, 3, board.GetCells(), short_palette));
+    REQUIRE(restored.GetCells() == board.GetCells());
+  }
+}
+
+TEST_CASE("Board fixtures", "[board]") {
+  Board board;
+  board.Reset(4, 4);
+  b2World b2world(b2Vec2(0, 0));
+  b2BodyDef body_def;
+  b2Body* body = b2world.CreateBody(&body_def);
+  b2PolygonShape shape;
+  shape.SetAsBox(0.4f, 0.4f);
+  b2Fixture* first = body->CreateFixture(&shape, 0);
+  b2Fixture* second = body->CreateFixture(&shape, 0);
+
+  // out of order on purpose to go through the sorted insert
+  board.SetFixture(2, 1, first);
+  board.SetFixture(0, 3, second);
+  REQUIRE(board.GetFixture(2, 1) == first);
+  REQUIRE(board.GetFixture(0, 3) == second);
+  REQUIRE(board.GetFixture(1, 1) == nullptr);
+
+  board.SetFixture(2, 1, second);
+  REQUIRE(board.GetFixture(2, 1) == second);
+
+  board.ClearFixtures();
+  REQUIRE(board.GetFixture(2, 1) == nullptr);
+}
+
+} // namespace tetris
@@ -0,0 +1,185 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#include <catch2/catch.hpp>
+
+#include <cstdio>
+#include <memory>
+#include <sstream>
+
+#include "physics/world.h"
+#include "telemetry/event_log.h"
+#include "telemetry/spsc_ring_buffer.h"
+
+namespace tetris {
+
+const char kTestLogPath[] = "test_event_log.bin";
+
+TEST_CASE("Ring buffer keeps order and capacity", "[telemetry]") {
+  SpscRingBuffer<int, 4> buffer;
+  for (int value = 0; value < 4; value++) {
+    REQUIRE(buffer.TryPush(value));
+  }
+
+  REQUIRE_FALSE(buffer.TryPush(4));
+  REQUIRE(buffer.GetSize() == 4);
+
+  int value;
+  REQUIRE(buffer.TryPop(&value));
+  REQUIRE(value == 0);
+  REQUIRE(buffer.TryPush(4));
+  for (int expected = 1; expected <= 4; expected++) {
+    REQUIRE(buffer.TryPop(&value));
+    REQUIRE(value == expected);
+  }
+
+  REQUIRE_FALSE(buffer.TryPop(&value));
+}
+
+TEST_CASE("Event log round trip", "[telemetry]") {
+  std::remove(kTestLogPath);
+  World world(false);
+  world.SetCurrentGameState(World::kClassic);
+  {
+    std::unique_ptr<EventLogWriter> writer(new EventLogWriter);
+    REQUIRE(writer->Open(kTestLogPath));
+    world.AddListener(writer.get());
+    while (world.GetCurrentGameState() != World::kEndScreen) {
+      world.Step();
+    }
+
+    world.RemoveListener(writer.get());
+    REQUIRE(writer->GetNumDropped() == 0);
+  }
+
+  EventLogReader reader;
+  REQUIRE(reader.Open(kTestLogPath));
+  std::vector<TelemetryEvent> events;
+  TelemetryEvent event;
+  while (reader.Next(&event)) {
+    events.push_back(event);
+  }
+
+  REQUIRE(events.size() >= 3);
+  REQUIRE(events.front().type_ == TelemetryEvent::kBlockSpawned);
+  REQUIRE(events.back().type_ == TelemetryEvent::kGameOver);
+  REQUIRE(events.back().value_ == world.GetScore());
+
+  SECTION("Locks record their tiles and time since spawn") {
+    bool has_lock = false;
+    for (size_t index = 1; index < events.size(); index++) {
+      if (events[index].type_ != TelemetryEvent::kBlockLocked) {
+        continue;
+      }
+
+      has_lock = true;
+      REQUIRE(events[index].num_tiles_ == 4);
+      REQUIRE(events[index].ticks_since_spawn_ > 0);
+      REQUIRE(events[index].tick_ >= events[index - 1].tick_);
+    }
+
+    REQUIRE(has_lock);
+  }
+
+  SECTION("Events convert to CSV") {
+    std::ostringstream output;
+    WriteEventCsvRow(output, events.front());
+    REQUIRE(output.str().find(",spawn,") != std::string::npos);
+  }
+
+  SECTION("Reopening appends to the same log") {
+    {
+      std::unique_ptr<EventLogWriter> writer(new EventLogWriter);
+      REQUIRE(writer->Open(kTestLogPath));
+    }
+
+    EventLogReader second_reader;
+    REQUIRE(second_reader.Open(kTestLogPath));
+  }
+}
+
+TEST_CASE("A record cut short is dropped before appending", "[telemetry]") {
+  std::remove(kTestLogPath);
+  {
+    std::unique_ptr<EventLogWriter> writer(new EventLogWriter);
+    REQUIRE(writer->Open(kTestLogPath));
+  }
+
+  // part of a record, as a crash in the middle of a write leaves it
+  FILE* file = fopen(kTestLogPath, "ab");
+  fputs("crash", file);
+  fclose(file);
+
+  World world(false);
+  world.SetCurrentGameState(World::kClassic);
+  {
+    std::unique_ptr<EventLogWriter> writer(new EventLogWriter);
+    REQUIRE(writer->Open(kTestLogPath));
+    world.AddListener(writer.get());
+    world.Step();
+    world.RemoveListener(writer.get());
+  }
+
+  EventLogReader reader;
+  REQUIRE(reader.Open(kTestLogPath));
+  TelemetryEvent event;
+  REQUIRE(reader.Next(&event));
+  REQUIRE(event.type_ == TelemetryEvent::kBlockSpawned);
+  REQUIRE_FALSE(reader.Next(&event));
+  std::remove(kTestLogPath);
+}
+
+TEST_CASE("Settled debris locks with no time since spawn", "[telemetry]") {
+  std::remove(kTestLogPath);
+  World world(false);
+  world.SetSeed(3);
+  world.SetIsTileDisconnectedMode(true);
+  world.SetCurrentGameState(World::kReloaded);
+  world.AddDebris(kReloadedBlockTemplates[1], b2Vec2(3.0f, 10.0f),
+      b2Vec2(0.0f, 0.0f));
+  {
+    std::unique_ptr<EventLogWriter> writer(new EventLogWriter);
+    REQUIRE(writer->Open(kTestLogPath));
+    world.AddListener(writer.get());
+    for (size_t tick = 0; tick < 200 && world.GetBoard().IsRowEmpty(0);
+         tick++) {
+      world.Step();
+    }
+
+    world.RemoveListener(writer.get());
+  }
+
+  EventLogReader reader;
+  REQUIRE(reader.Open(kTestLogPath));
+  bool has_lock = false;
+  TelemetryEvent event;
+  while (reader.Next(&event)) {
+    if (event.type_ != TelemetryEvent::kBlockLocked) {
+      continue;
+    }
+
+    // blocks in this mode only ever lock as settled debris
+    has_lock = true;
+    REQUIRE(event.num_tiles_ == 1);
+    REQUIRE(event.ticks_since_spawn_ == TelemetryEvent::kUnknownTicks);
+    std::ostringstream output;
+    WriteEventCsvRow(output, event);
+    REQUIRE(output.str().find(",lock,1,,") != std::string::npos);
+  }
+
+  REQUIRE(has_lock);
+  std::remove(kTestLogPath);
+}
+
+TEST_CASE("Foreign files are not read as logs", "[telemetry]") {
+  FILE* file = fopen(kTestLogPath, "wb");
+  fputs("not a log", file);
+  fclose(file);
+
+  EventLogReader reader;
+  REQUIRE_FALSE(reader.Open(kTestLogPath));
+  std::unique_ptr<EventLogWriter> writer(new EventLogWriter);
+  REQUIRE_FALSE(writer->Open(kTestLogPath));
+  std::remove(kTestLogPath);
+}
+
+} // namespace tetris
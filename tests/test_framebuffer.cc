@@ -0,0 +1,72 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#include <catch2/catch.hpp>
+
+#include <cstring>
+
+#include "render/framebuffer.h"
+
+namespace tetris {
+
+TEST_CASE("Packed colors are RGBA in memory", "[framebuffer]") {
+  uint32_t pixel = Framebuffer::PackColor(static_cast<uint8_t>(1), 2, 3, 4);
+  uint8_t bytes[4];
+  std::memcpy(bytes, &pixel, sizeof(bytes));
+  REQUIRE(bytes[0] == 1);
+  REQUIRE(bytes[1] == 2);
+  REQUIRE(bytes[2] == 3);
+  REQUIRE(bytes[3] == 4);
+
+  REQUIRE(Framebuffer::PackColor(1.0f, 0.0f, 2.0f)
+      == Framebuffer::PackColor(static_cast<uint8_t>(255), 0, 255, 255));
+}
+
+TEST_CASE("Fill covers exactly the rectangle", "[framebuffer]") {
+  const uint32_t kBackground = Framebuffer::PackColor(0.0f, 0.0f, 0.0f);
+  const uint32_t kFill = Framebuffer::PackColor(1.0f, 0.0f, 0.0f);
+  Framebuffer framebuffer;
+  framebuffer.Resize(13, 7);
+  framebuffer.Clear(kBackground);
+  // wide enough to use the vector stores and the scalar tail
+  framebuffer.FillRect(2, 1, 11, 4, kFill);
+
+  for (int y = 0; y < 7; y++) {
+    for (int x = 0; x < 13; x++) {
+      bool is_inside = x >= 2 && x < 11 && y >= 1 && y < 4;
+      REQUIRE(framebuffer.GetPixel(x, y) == (is_inside ? kFill : kBackground));
+    }
+  }
+}
+
+TEST_CASE("Fill is clipped to the image", "[framebuffer]") {
+  const uint32_t kFill = Framebuffer::PackColor(0.0f, 1.0f, 0.0f);
+  Framebuffer framebuffer;
+  framebuffer.Resize(4, 4);
+  framebuffer.Clear(0);
+  framebuffer.FillRect(-5, -5, 100, 2, kFill);
+  framebuffer.FillRect(10, 10, 20, 20, kFill);
+
+  REQUIRE(framebuffer.GetPixel(0, 0) == kFill);
+  REQUIRE(framebuffer.GetPixel(3, 1) == kFill);
+  REQUIRE(framebuffer.GetPixel(0, 2) == 0);
+  REQUIRE(framebuffer.GetPixel(3, 3) == 0);
+}
+
+TEST_CASE("Stroke draws only the outline", "[framebuffer]") {
+  const uint32_t kStroke = Framebuffer::PackColor(0.0f, 0.0f, 1.0f);
+  Framebuffer framebuffer;
+  framebuffer.Resize(6, 6);
+  framebuffer.Clear(0);
+  framebuffer.StrokeRect(1, 1, 5, 5, kStroke);
+
+  REQUIRE(framebuffer.GetPixel(1, 1) == kStroke);
+  REQUIRE(framebuffer.GetPixel(4, 4) == kStroke);
+  REQUIRE(framebuffer.GetPixel(1, 3) == kStroke);
+  REQUIRE(framebuffer.GetPixel(4, 2) == kStroke);
+  REQUIRE(framebuffer.GetPixel(2, 2) == 0);
+  REQUIRE(framebuffer.GetPixel(3, 3) == 0);
+  REQUIRE(framebuffer.GetPixel(0, 0) == 0);
+  REQUIRE(framebuffer.GetPixel(5, 5) == 0);
+}
+
+} // namespace tetris
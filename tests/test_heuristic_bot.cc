@@ -0,0 +1,76 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#include <catch2/catch.hpp>
+
+#include <vector>
+
+#include "bot/heuristic_bot.h"
+#include "physics/block_template.h"
+
+namespace tetris {
+
+const size_t kTestNumCols = 10;
+const size_t kTestNumRows = 24;
+// indices into kClassicBlockTemplates
+const size_t kLine = 0;
+const size_t kSquare = 3;
+
+TEST_CASE("Features measure the surface of the board", "[heuristic-bot]") {
+  std::vector<uint32_t> rows(kTestNumRows, 0);
+  // columns 0 and 1 are two high with a hole under column 1, column 3 is
+  // one high and column 2 is a well between them
+  rows[0] = 0x009;
+  rows[1] = 0x003;
+
+  std::array<double, HeuristicBot::kNumFeatures> features =
+      HeuristicBot::GetFeatures(rows, kTestNumCols, 1);
+  REQUIRE(features[HeuristicBot::kHoles] == Approx(1.0));
+  REQUIRE(features[HeuristicBot::kAggregateHeight] == Approx(5.0));
+  // 0 + 2 + 1 + 1
+  REQUIRE(features[HeuristicBot::kBumpiness] == Approx(4.0));
+  // column 2 sits one below column 3
+  REQUIRE(features[HeuristicBot::kWells] == Approx(1.0));
+  REQUIRE(features[HeuristicBot::kLinesCleared] == Approx(1.0));
+}
+
+TEST_CASE("Bot completes rows when it can", "[heuristic-bot]") {
+  HeuristicBot bot;
+  std::vector<uint32_t> rows(kTestNumRows, 0);
+
+  SECTION("A line fills a gap four wide") {
+    rows[0] = 0x3F0;
+    HeuristicBot::Placement placement =
+        bot.Choose(rows, kTestNumCols, kClassicBlockTemplates[kLine]);
+    REQUIRE(placement.is_found_);
+    REQUIRE(placement.col_ == 0);
+    REQUIRE(placement.row_ == 0);
+    REQUIRE(placement.num_cleared_ == 1);
+
+    REQUIRE(HeuristicBot::Place(placement, kClassicBlockTemplates[kLine],
+        kTestNumCols, &rows) == 1);
+    REQUIRE(rows.size() == kTestNumRows);
+    for (uint32_t row : rows) {
+      REQUIRE(row == 0);
+    }
+  }
+
+  SECTION("A square fills two rows with a gap two wide") {
+    rows[0] = 0x3CF;
+    rows[1] = 0x3CF;
+    HeuristicBot::Placement placement =
+        bot.Choose(rows, kTestNumCols, kClassicBlockTemplates[kSquare]);
+    REQUIRE(placement.col_ == 4);
+    REQUIRE(placement.num_cleared_ == 2);
+  }
+}
+
+TEST_CASE("Bot finds no place on a full board", "[heuristic-bot]") {
+  HeuristicBot bot;
+  // every row has one gap, so nothing clears and nothing fits on top
+  std::vector<uint32_t> rows(kTestNumRows, 0x1FF);
+  REQUIRE_FALSE(
+      bot.Choose(rows, kTestNumCols, kClassicBlockTemplates[kSquare])
+          .is_found_);
+}
+
+} // namespace tetris
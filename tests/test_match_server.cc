@@ -0,0 +1,90 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#include <atomic>
+#include <catch2/catch.hpp>
+
+#include "server/match_server.h"
+#include "server/work_stealing_pool.h"
+
+namespace tetris {
+
+TEST_CASE("Work stealing pool runs every index once",
+    "[work-stealing-pool][server]") {
+  WorkStealingPool pool(4);
+  std::vector<std::atomic<int>> times_run(1000);
+  for (std::atomic<int>& count : times_run) {
+    count = 0;
+  }
+
+  pool.ParallelFor(times_run.size(), [&times_run](size_t index) {
+    times_run[index]++;
+  });
+
+  for (const std::atomic<int>& count : times_run) {
+    REQUIRE(count == 1);
+  }
+}
+
+TEST_CASE("Work stealing pool waits for nested tasks",
+    "[work-stealing-pool][server]") {
+  WorkStealingPool pool(3);
+  std::atomic<int> num_run(0);
+  for (size_t task = 0; task < 10; task++) {
+    pool.Submit([&pool, &num_run] {
+      num_run++;
+      // tasks submitted by a worker go to its own queue
+      for (size_t subtask = 0; subtask < 5; subtask++) {
+        pool.Submit([&num_run] { num_run++; });
+      }
+    });
+  }
+
+  pool.Wait();
+  REQUIRE(num_run == 60);
+}
+
+TEST_CASE("Match server ticks", "[match-server][server]") {
+  MatchServer server(8, 2, World::kClassic);
+  REQUIRE(server.GetNumWorlds() == 8);
+  REQUIRE(server.GetNumAlive() == 8);
+
+  for (size_t tick = 0; tick < 10; tick++) {
+    server.Tick();
+  }
+
+  SECTION("Every world has a moving block") {
+    for (size_t index = 0; index < server.GetNumWorlds(); index++) {
+      REQUIRE(server.GetEngine(index).GetWorld().GetMovingBlock() != nullptr);
+    }
+  }
+
+  SECTION("Tick statistics") {
+    MatchServer::TickStatistics statistics = server.GetTickStatistics();
+    REQUIRE(statistics.num_ticks_ == 10);
+    REQUIRE(statistics.p50_ <= statistics.p99_);
+    REQUIRE(statistics.p99_ <= statistics.max_);
+  }
+
+  SECTION("Memory footprint") {
+    REQUIRE(server.GetMeanWorldMemoryFootprint() > sizeof(World));
+  }
+}
+
+TEST_CASE("Match server steps each world in its own mode",
+    "[match-server][server]") {
+  MatchServer server(2, 2, World::kReloaded);
+  World& disjointed_world = server.GetEngine(0).GetWorld();
+  disjointed_world.SetIsTileDisconnectedMode(true);
+
+  // only a disjointed world breaks its landed blocks into debris
+  bool is_debris_seen = false;
+  for (size_t tick = 0; tick < 2000 && !is_debris_seen; tick++) {
+    server.Tick();
+    is_debris_seen = !disjointed_world.GetDebris().empty();
+  }
+
+  REQUIRE(is_debris_seen);
+  REQUIRE(server.GetEngine(1).GetWorld().GetDebris().empty());
+}
+
+} // namespace tetris
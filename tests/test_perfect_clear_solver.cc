@@ -0,0 +1,110 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#include <catch2/catch.hpp>
+
+#include <vector>
+
+#include "physics/block_template.h"
+#include "physics/perfect_clear_solver.h"
+#include "server/work_stealing_pool.h"
+
+namespace tetris {
+
+const size_t kTestNumCols = 10;
+// indices into kClassicBlockTemplates
+const size_t kLine = 0;
+const size_t kSquare = 3;
+const size_t kBackwardsZ = 4;
+const size_t kT = 5;
+
+/**
+ * Makes a sequence of classic blocks
+ * @param ids template ids, in order
+ * @return the templates
+ */
+static std::vector<const BlockTemplate*> MakeSequence(
+    const std::vector<size_t>& ids) {
+  std::vector<const BlockTemplate*> pieces;
+  for (size_t id : ids) {
+    pieces.push_back(&kClassicBlockTemplates[id]);
+  }
+
+  return pieces;
+}
+
+/**
+ * Follows a solution and checks that it leaves the board empty
+ * @param result the solution
+ * @param pieces the blocks it places
+ * @param rows the board it starts from
+ */
+static void RequireClears(const PerfectClearSolver::Result& result,
+    const std::vector<const BlockTemplate*>& pieces,
+    std::vector<uint32_t> rows) {
+  REQUIRE(result.is_found_);
+  for (size_t index = 0; index < result.placements_.size(); index++) {
+    const PerfectClearSolver::Placement& placement =
+        result.placements_[index];
+    REQUIRE(placement.piece_ == index);
+    PerfectClearSolver::Place(placement, *pieces[placement.piece_],
+        kTestNumCols, &rows);
+  }
+
+  for (uint32_t row : rows) {
+    REQUIRE(row == 0);
+  }
+}
+
+TEST_CASE("Solver finishes a nearly full board", "[perfect-clear]") {
+  WorkStealingPool pool(2);
+  PerfectClearSolver solver(kTestNumCols, &pool);
+
+  // the four left columns of the bottom row are open
+  std::vector<uint32_t> rows = {0x3F0};
+  std::vector<const BlockTemplate*> pieces = MakeSequence({kLine, kT});
+  PerfectClearSolver::Result result = solver.Solve(rows, pieces, 2);
+  REQUIRE(result.height_ == 1);
+  REQUIRE(result.placements_.size() == 1);
+  RequireClears(result, pieces, rows);
+
+  SECTION("A block that doesn't fit the gap can't clear it") {
+    std::vector<const BlockTemplate*> squares = MakeSequence({kSquare});
+    REQUIRE_FALSE(solver.Solve(rows, squares, 1).is_found_);
+  }
+}
+
+TEST_CASE("Solver clears an empty board with ten blocks",
+    "[perfect-clear]") {
+  WorkStealingPool pool(4);
+  PerfectClearSolver solver(kTestNumCols, &pool);
+  std::vector<const BlockTemplate*> pieces = MakeSequence(
+      {kT, kLine, kSquare, 2, 1, kBackwardsZ, 6, kT, kSquare, kLine});
+  PerfectClearSolver::Result result = solver.Solve({}, pieces, 10);
+  REQUIRE(result.height_ == 4);
+  REQUIRE(result.placements_.size() == 10);
+  RequireClears(result, pieces, {});
+
+  SECTION("Fewer blocks than the rows need can't clear") {
+    REQUIRE_FALSE(solver.Solve({}, pieces, 4).is_found_);
+  }
+}
+
+TEST_CASE("Pruning doesn't change the answer", "[perfect-clear]") {
+  // squares tile two rows, while backwards Zs always leave a hole under
+  // themselves on a flat floor
+  std::vector<const BlockTemplate*> squares =
+      MakeSequence({kSquare, kSquare, kSquare, kSquare, kSquare});
+  std::vector<const BlockTemplate*> zigzags = MakeSequence(
+      {kBackwardsZ, kBackwardsZ, kBackwardsZ, kBackwardsZ, kBackwardsZ});
+
+  for (size_t num_threads : {1, 4}) {
+    WorkStealingPool pool(num_threads);
+    PerfectClearSolver solver(kTestNumCols, &pool);
+    PerfectClearSolver::Result result = solver.Solve({}, squares, 5);
+    RequireClears(result, squares, {});
+    REQUIRE(result.height_ == 2);
+    REQUIRE_FALSE(solver.Solve({}, zigzags, 5).is_found_);
+  }
+}
+
+} // namespace tetris
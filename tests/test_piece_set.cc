@@ -0,0 +1,200 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#include <catch2/catch.hpp>
+
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "physics/piece_set.h"
+#include "physics/world.h"
+
+namespace tetris {
+
+const char kTestPiecesPath[] = "test_pieces.txt";
+
+// the classic blocks, with the line three times as likely
+const char kTestPieces[] =
+    "# classic blocks\n"
+    "piece line\n"
+    "color 0 1 1\n"
+    "weight 3\n"
+    "cells 0,1 1,1 2,1 3,1\n"
+    "\n"
+    "piece backwards_l\n"
+    "color 0 0 1\n"
+    "cells 1,1 2,1 3,1 1,2\n"
+    "piece l\n"
+    "color 1 0.7 1\n"
+    "cells 0,1 1,1 2,1 2,2\n"
+    "piece square  # turns in place\n"
+    "color 1 1 0\n"
+    "cells 1,1 2,1 2,2 1,2\n"
+    "piece backwards_z\n"
+    "color 0 1 0\n"
+    "cells 1,1 2,1 2,2 3,2\n"
+    "piece t\n"
+    "color 0.5 0 0.5\n"
+    "cells 1,1 2,1 3,1 2,2\n"
+    "piece z\n"
+    "color 1 0 0\n"
+    "cells 1,1 2,1 2,0 3,0\n";
+
+/**
+ * Writes a file for a test
+ * @param path the file
+ * @param text what to write
+ */
+static void WriteTextFile(const std::string& path, const std::string& text) {
+  std::FILE* file = std::fopen(path.c_str(), "wb");
+  REQUIRE(file != nullptr);
+  std::fputs(text.c_str(), file);
+  std::fclose(file);
+}
+
+/**
+ * Compiles text that should have a mistake
+ * @param text the text
+ * @return the error message
+ */
+static std::string CompileError(const std::string& text) {
+  std::vector<BlockTemplate> templates;
+  std::vector<uint32_t> weights;
+  std::string error;
+  REQUIRE_FALSE(PieceSet::Compile(text, &templates, &weights, &error));
+  return error;
+}
+
+TEST_CASE("Compiled pieces match the built in templates", "[piece-set]") {
+  std::vector<BlockTemplate> templates;
+  std::vector<uint32_t> weights;
+  std::string error;
+  REQUIRE(PieceSet::Compile(kTestPieces, &templates, &weights, &error));
+  REQUIRE(templates.size() == kNumClassicBlockTemplates);
+  REQUIRE(weights == std::vector<uint32_t>({3, 1, 1, 1, 1, 1, 1}));
+
+  for (size_t id = 0; id < templates.size(); id++) {
+    const BlockTemplate& compiled = templates[id];
+    const BlockTemplate& built_in = kClassicBlockTemplates[id];
+    REQUIRE(compiled.template_id_ == id);
+    REQUIRE(compiled.num_tiles_ == built_in.num_tiles_);
+    for (size_t rotation = 0; rotation < BlockTemplate::kNumRotations;
+         rotation++) {
+      REQUIRE(compiled.masks_[rotation] == built_in.masks_[rotation]);
+      REQUIRE(compiled.boxes_[rotation].min_col_
+          == built_in.boxes_[rotation].min_col_);
+      REQUIRE(compiled.boxes_[rotation].max_row_
+          == built_in.boxes_[rotation].max_row_);
+    }
+  }
+}
+
+TEST_CASE("Mistakes are reported with their line", "[piece-set]") {
+  REQUIRE(CompileError("color 1 1 1\n")
+      == "line 1: 'color' comes before any piece");
+  REQUIRE(CompileError("piece a\ncolor 1 1 2\n").find("line 2:") == 0);
+  REQUIRE(CompileError("piece a\ncolor 1 1 1\nweight 0\n").find("line 3:")
+      == 0);
+  REQUIRE(CompileError("piece a\ncells 0,0 4,0\n").find("line 2:") == 0);
+  REQUIRE(CompileError("piece a\ncells 0,0 0,0\n").find("line 2:") == 0);
+  REQUIRE(CompileError("piece a\ncells 0,0 2,0\n")
+      == "line 2: cells must touch each other");
+  REQUIRE(CompileError("piece a\nspin 2\n")
+      == "line 2: unknown keyword 'spin'");
+  REQUIRE(CompileError("piece a\ncells 0,0\n\npiece b\ncolor 1 1 1\n")
+      .find("line 1:") == 0);
+  REQUIRE(CompileError("# nothing here\n").find("1 to 64 pieces")
+      != std::string::npos);
+}
+
+TEST_CASE("The second load maps the cache", "[piece-set]") {
+  std::string cache_path = PieceSet::GetCachePath(kTestPiecesPath);
+  std::remove(cache_path.c_str());
+  WriteTextFile(kTestPiecesPath, kTestPieces);
+
+  std::string error;
+  PieceSet compiled;
+  REQUIRE(compiled.Load(kTestPiecesPath, &error));
+  REQUIRE_FALSE(compiled.IsFromCache());
+
+  PieceSet cached;
+  REQUIRE(cached.Load(kTestPiecesPath, &error));
+  REQUIRE(cached.IsFromCache());
+  REQUIRE(cached.GetNumPieces() == compiled.GetNumPieces());
+  for (size_t id = 0; id < cached.GetNumPieces(); id++) {
+    REQUIRE(cached.GetWeight(id) == compiled.GetWeight(id));
+    REQUIRE(cached.GetTemplates()[id].masks_[1]
+        == compiled.GetTemplates()[id].masks_[1]);
+  }
+
+  SECTION("A changed file is compiled again") {
+    WriteTextFile(kTestPiecesPath, "piece dot\ncolor 1 1 1\ncells 1,1\n");
+    PieceSet changed;
+    REQUIRE(changed.Load(kTestPiecesPath, &error));
+    REQUIRE_FALSE(changed.IsFromCache());
+    REQUIRE(changed.GetNumPieces() == 1);
+  }
+
+  SECTION("A damaged cache is compiled again") {
+    WriteTextFile(cache_path, "not a cache");
+    PieceSet damaged;
+    REQUIRE(damaged.Load(kTestPiecesPath, &error));
+    REQUIRE_FALSE(damaged.IsFromCache());
+    REQUIRE(damaged.GetNumPieces() == kNumClassicBlockTemplates);
+  }
+
+  std::remove(kTestPiecesPath);
+  std::remove(cache_path.c_str());
+}
+
+TEST_CASE("Pieces spawn by weight", "[piece-set]") {
+  WriteTextFile(kTestPiecesPath, kTestPieces);
+  PieceSet piece_set;
+  std::string error;
+  REQUIRE(piece_set.Load(kTestPiecesPath, &error));
+
+  std::mt19937 random(5);
+  std::vector<size_t> counts(piece_set.GetNumPieces());
+  const size_t kNumPicks = 9000;
+  for (size_t pick = 0; pick < kNumPicks; pick++) {
+    counts[piece_set.PickPiece(&random)]++;
+  }
+
+  // the line has 3 of the 9 weight, every other piece 1
+  REQUIRE(counts[0] > 2700);
+  REQUIRE(counts[0] < 3300);
+  for (size_t id = 1; id < counts.size(); id++) {
+    REQUIRE(counts[id] > 800);
+    REQUIRE(counts[id] < 1200);
+  }
+
+  SECTION("Worlds spawn only pieces of the set") {
+    World world(false);
+    world.SetSeed(2);
+    world.SetPieceSet(&piece_set);
+    world.SetCurrentGameState(World::kReloaded);
+    BlockTemplateList templates = piece_set.GetTemplates();
+    for (size_t tick = 0; tick < 30; tick++) {
+      world.Step();
+      const BlockTemplate& spawned = world.GetMovingBlock()->GetTemplate();
+      REQUIRE(&spawned >= templates.begin());
+      REQUIRE(&spawned < templates.end());
+      if (tick % 5 == 0) {
+        world.Move(Block::kHardDrop);
+      }
+    }
+
+    std::vector<uint8_t> snapshot = world.SaveSnapshot();
+    World restored(false);
+    REQUIRE_FALSE(restored.RestoreSnapshot(snapshot.data(), snapshot.size()));
+    restored.SetPieceSet(&piece_set);
+    REQUIRE(restored.RestoreSnapshot(snapshot.data(), snapshot.size()));
+    REQUIRE(restored.GetStateHash() == world.GetStateHash());
+  }
+
+  std::remove(kTestPiecesPath);
+  std::remove(PieceSet::GetCachePath(kTestPiecesPath).c_str());
+}
+
+} // namespace tetris
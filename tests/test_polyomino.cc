@@ -0,0 +1,92 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "physics/piece_set.h"
+#include "physics/polyomino.h"
+#include "server/work_stealing_pool.h"
+
+namespace tetris {
+
+TEST_CASE("Turned and flipped shapes are the same", "[polyomino]") {
+  // an L, a mirrored J and both turned
+  Polyomino l_shape = Polyomino::FromCells({{0, 0}, {0, 1}, {0, 2}, {1, 0}});
+  Polyomino j_shape = Polyomino::FromCells({{1, 0}, {1, 1}, {1, 2}, {0, 0}});
+  Polyomino turned = Polyomino::FromCells({{5, 5}, {6, 5}, {7, 5}, {7, 6}});
+  REQUIRE(l_shape == j_shape);
+  REQUIRE(l_shape == turned);
+  REQUIRE(l_shape.GetHash() == turned.GetHash());
+  REQUIRE(Polyomino::FromCells(l_shape.GetCells()) == l_shape);
+
+  Polyomino t_shape = Polyomino::FromCells({{0, 0}, {1, 0}, {2, 0}, {1, 1}});
+  REQUIRE_FALSE(t_shape == l_shape);
+  REQUIRE(t_shape.GetNumCells() == 4);
+}
+
+TEST_CASE("Enumeration counts every free polyomino", "[polyomino]") {
+  WorkStealingPool pool(4);
+  std::vector<std::vector<Polyomino>> sizes =
+      PolyominoEnumerator::Enumerate(10, &pool);
+
+  // free polyominoes of 1 to 10 tiles
+  const std::vector<size_t> kCounts = {1, 1, 2, 5, 12, 35, 108, 369, 1285,
+                                       4655};
+  REQUIRE(sizes.size() == kCounts.size());
+  for (size_t size = 0; size < sizes.size(); size++) {
+    REQUIRE(sizes[size].size() == kCounts[size]);
+    for (const Polyomino& polyomino : sizes[size]) {
+      REQUIRE(polyomino.GetNumCells() == size + 1);
+    }
+  }
+
+  SECTION("The result doesn't depend on the number of threads") {
+    WorkStealingPool one_thread(1);
+    REQUIRE(PolyominoEnumerator::Enumerate(8, &one_thread)[7] == sizes[7]);
+  }
+}
+
+TEST_CASE("Filters keep shapes that play", "[polyomino]") {
+  Polyomino line = Polyomino::FromCells({{0, 0}, {1, 0}, {2, 0}, {3, 0}});
+  Polyomino long_line =
+      Polyomino::FromCells({{0, 0}, {1, 0}, {2, 0}, {3, 0}, {4, 0}});
+  Polyomino plus =
+      Polyomino::FromCells({{1, 0}, {0, 1}, {1, 1}, {2, 1}, {1, 2}});
+  Polyomino t_shape = Polyomino::FromCells({{0, 0}, {1, 0}, {2, 0}, {1, 1}});
+  REQUIRE(line.FitsBox(4));
+  REQUIRE_FALSE(long_line.FitsBox(4));
+  REQUIRE(line.CanLieFlat());
+  REQUIRE(t_shape.CanLieFlat());
+  REQUIRE_FALSE(plus.CanLieFlat());
+}
+
+TEST_CASE("Written piece sets load", "[polyomino]") {
+  WorkStealingPool pool(2);
+  std::vector<std::vector<Polyomino>> sizes =
+      PolyominoEnumerator::Enumerate(5, &pool);
+  std::vector<Polyomino> pieces = sizes[3];
+  pieces.insert(pieces.end(), sizes[4].begin(), sizes[4].end());
+  pieces.erase(std::remove_if(pieces.begin(), pieces.end(),
+      [](const Polyomino& piece) {
+        return !piece.FitsBox(BlockTemplate::kBoxSize);
+      }), pieces.end());
+
+  std::vector<BlockTemplate> templates;
+  std::vector<uint32_t> weights;
+  std::string error;
+  REQUIRE(PieceSet::Compile(PolyominoEnumerator::WritePieceSet(pieces),
+      &templates, &weights, &error));
+  REQUIRE(templates.size() == pieces.size());
+  for (size_t id = 0; id < templates.size(); id++) {
+    REQUIRE(templates[id].num_tiles_ == pieces[id].GetNumCells());
+    // centered shapes turn inside the box
+    const BlockTemplate::Box& box = templates[id].boxes_[1];
+    REQUIRE(box.min_col_ >= 0);
+    REQUIRE(box.max_row_ < static_cast<int>(BlockTemplate::kBoxSize));
+  }
+}
+
+} // namespace tetris
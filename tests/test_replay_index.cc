@@ -0,0 +1,178 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+#include "persistence/replay_index.h"
+#include "physics/world.h"
+#include "tetris_engine.h"
+
+namespace tetris {
+
+const char kTestIndexPath[] = "test_replay_index.bin";
+const size_t kTestInterval = 50;
+const size_t kTestTicks = 400;
+
+/**
+ * Plays a classic game with a move every few ticks and records it
+ * @return the replay
+ */
+static Replay RecordGame() {
+  TetrisEngine engine(false);
+  engine.GetWorld().SetSeed(11);
+  engine.SetCurrentGameState(World::kClassic);
+  const Block::Move moves[] = {Block::kMoveLeft, Block::kRotate,
+                               Block::kMoveRight, Block::kHardDrop};
+  for (size_t tick = 0; tick < kTestTicks; tick++) {
+    if (tick % 7 == 0) {
+      engine.Move(moves[(tick / 7) % 4]);
+    }
+
+    engine.GetWorld().Step();
+  }
+
+  return engine.GetReplay();
+}
+
+TEST_CASE("Snapshot restores the same state", "[replay-index]") {
+  World world(false);
+  world.SetSeed(4);
+  world.SetCurrentGameState(World::kClassic);
+  for (size_t tick = 0; tick < 120; tick++) {
+    if (tick % 30 == 0) {
+      world.Move(Block::kHardDrop);
+    }
+
+    world.Step();
+  }
+
+  std::vector<uint8_t> snapshot = world.SaveSnapshot();
+  World restored(false);
+  REQUIRE(restored.RestoreSnapshot(snapshot.data(), snapshot.size()));
+  REQUIRE(restored.GetStateHash() == world.GetStateHash());
+  REQUIRE(restored.GetTickCount() == world.GetTickCount());
+  REQUIRE(restored.GetBoard().GetCells() == world.GetBoard().GetCells());
+
+  SECTION("Both worlds spawn the same blocks afterwards") {
+    for (size_t tick = 0; tick < 60; tick++) {
+      world.Step();
+      restored.Step();
+    }
+
+    REQUIRE(restored.GetMovingBlock()->GetTemplateId()
+        == world.GetMovingBlock()->GetTemplateId());
+    REQUIRE(restored.GetBoard().GetCells() == world.GetBoard().GetCells());
+    REQUIRE(restored.GetScore() == world.GetScore());
+  }
+
+  SECTION("Damaged snapshots are refused") {
+    REQUIRE_FALSE(restored.RestoreSnapshot(snapshot.data(),
+        snapshot.size() - 1));
+    snapshot[0] ^= 0xFF;
+    REQUIRE_FALSE(restored.RestoreSnapshot(snapshot.data(),
+        snapshot.size()));
+  }
+}
+
+TEST_CASE("Snapshot keeps loose debris", "[replay-index]") {
+  World world(false);
+  world.SetSeed(6);
+  world.SetIsTileDisconnectedMode(true);
+  world.SetCurrentGameState(World::kReloaded);
+  world.Step();
+  // tiles of both reloaded templates falling from the middle of the board
+  world.AddDebris(kReloadedBlockTemplates[0], b2Vec2(3.0f, 20.0f),
+      b2Vec2(0.0f, -2.0f));
+  world.AddDebris(kReloadedBlockTemplates[2], b2Vec2(9.0f, 24.0f),
+      b2Vec2(0.0f, -4.0f));
+  world.Step();
+  REQUIRE(world.GetDebris().size() == 2);
+
+  std::vector<uint8_t> snapshot = world.SaveSnapshot();
+  World restored(false);
+  REQUIRE(restored.RestoreSnapshot(snapshot.data(), snapshot.size()));
+  REQUIRE(restored.GetDebris().size() == 2);
+  for (size_t index = 0; index < 2; index++) {
+    REQUIRE(restored.GetDebris()[index].block_template_
+        == world.GetDebris()[index].block_template_);
+  }
+
+  REQUIRE(restored.GetStateHash() == world.GetStateHash());
+}
+
+TEST_CASE("Index seeks to any tick", "[replay-index]") {
+  std::remove(kTestIndexPath);
+  Replay replay = RecordGame();
+  REQUIRE(ReplayIndex::Build(replay, kTestInterval, kTestTicks,
+      kTestIndexPath));
+
+  ReplayIndex index;
+  REQUIRE(index.Open(kTestIndexPath));
+  REQUIRE(index.GetKeyframeInterval() == kTestInterval);
+  REQUIRE(index.GetNumTicks() <= kTestTicks);
+  REQUIRE(index.GetReplay().GetSeed() == 11);
+
+  // the same game played straight through, tick by tick
+  World played(false);
+  replay.Begin(&played);
+  std::vector<uint64_t> hashes = {played.GetStateHash()};
+  while (played.GetTickCount() < index.GetNumTicks()) {
+    replay.Advance(&played, played.GetTickCount() + 1);
+    hashes.push_back(played.GetStateHash());
+  }
+
+  SECTION("Recorded hashes match a straight replay") {
+    for (size_t tick = 0; tick <= index.GetNumTicks(); tick++) {
+      REQUIRE(index.GetTickHash(tick) == hashes[tick]);
+    }
+  }
+
+  SECTION("Seeking forward and back lands on the recorded state") {
+    World world(false);
+    for (size_t tick : {173, 50, 0, 399, 99, 100}) {
+      size_t target = std::min<size_t>(tick, index.GetNumTicks());
+      REQUIRE(index.SeekTo(&world, target));
+      REQUIRE(world.GetTickCount() == target);
+      REQUIRE(world.GetStateHash() == hashes[target]);
+    }
+  }
+
+  SECTION("Every interval replays without a desync") {
+    for (size_t keyframe = 0; keyframe < index.GetNumKeyframes();
+         keyframe++) {
+      REQUIRE(index.FindDesync(keyframe) == ReplayIndex::kNoTick);
+    }
+  }
+
+  SECTION("Bisect finds the first tick a condition holds") {
+    REQUIRE(index.Bisect([](const World& world) {
+      return world.GetTickCount() >= 123;
+    }) == 123);
+    REQUIRE(index.Bisect([](const World&) {
+      return false;
+    }) == ReplayIndex::kNoTick);
+  }
+
+  // failing to open closes the index, so the file can be removed
+  index.Open("missing_replay_index.bin");
+  std::remove(kTestIndexPath);
+}
+
+TEST_CASE("Files that are not indexes don't open", "[replay-index]") {
+  std::FILE* file = std::fopen(kTestIndexPath, "wb");
+  REQUIRE(file != nullptr);
+  std::fputs("not an index at all", file);
+  std::fclose(file);
+
+  ReplayIndex index;
+  REQUIRE_FALSE(index.Open(kTestIndexPath));
+  REQUIRE_FALSE(index.Open("missing_replay_index.bin"));
+  World world(false);
+  REQUIRE_FALSE(index.SeekTo(&world, 0));
+  std::remove(kTestIndexPath);
+}
+
+} // namespace tetris
@@ -0,0 +1,120 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#include <catch2/catch.hpp>
+
+#include <cstdio>
+#include <string>
+
+#include "persistence/replay.h"
+#include "persistence/score_store.h"
+#include "physics/world.h"
+
+namespace tetris {
+
+const char kTestDatabasePath[] = "test_scores.db";
+
+/**
+ * Deletes the test database along with its write-ahead log
+ */
+static void RemoveTestDatabase() {
+  std::remove(kTestDatabasePath);
+  std::remove((std::string(kTestDatabasePath) + "-wal").c_str());
+  std::remove((std::string(kTestDatabasePath) + "-shm").c_str());
+}
+
+TEST_CASE("Scores are stored and ranked", "[persistence]") {
+  RemoveTestDatabase();
+  {
+    ScoreStore store;
+    REQUIRE(store.Open(kTestDatabasePath, 3));
+    for (size_t score = 0; score < 1000; score++) {
+      store.Submit(ScoreRecord{score, "classic", 7, 0, {1, 2, 3}});
+    }
+
+    store.Submit(ScoreRecord{5, "bomb", 7, 0, {}});
+
+    // the leaderboard is only updated once the scores are committed
+    store.Flush();
+    REQUIRE(store.GetNumStored() == 1001);
+    std::vector<LeaderboardEntry> leaderboard =
+        store.GetLeaderboard("classic");
+    REQUIRE(leaderboard.size() == 3);
+    REQUIRE(leaderboard[0].score_ == 999);
+    REQUIRE(leaderboard[2].score_ == 997);
+  }
+
+  SECTION("Reopening loads the leaderboards") {
+    ScoreStore store;
+    REQUIRE(store.Open(kTestDatabasePath, 3));
+    std::vector<LeaderboardEntry> leaderboard =
+        store.GetLeaderboard("classic");
+    REQUIRE(leaderboard.size() == 3);
+    REQUIRE(leaderboard[0].score_ == 999);
+    REQUIRE(store.GetLeaderboard("bomb").size() == 1);
+    REQUIRE(store.GetLeaderboard("reloaded").empty());
+  }
+
+  SECTION("Low scores stay off a full leaderboard") {
+    ScoreStore store;
+    REQUIRE(store.Open(kTestDatabasePath, 3));
+    store.Submit(ScoreRecord{10, "classic", 7, 0, {}});
+    store.Flush();
+    REQUIRE(store.GetLeaderboard("classic").back().score_ == 997);
+  }
+
+  RemoveTestDatabase();
+}
+
+TEST_CASE("Replays survive serialization", "[persistence]") {
+  World world(false);
+  world.SetSeed(42);
+  world.SetIsBombMode(true);
+  world.SetCurrentGameState(World::kClassic);
+
+  Replay replay;
+  replay.Start(world);
+  replay.AddInput(3, Block::kMoveLeft);
+  replay.AddInput(70000, Block::kRotate);
+
+  Replay copy;
+  REQUIRE(copy.Deserialize(replay.Serialize()));
+  REQUIRE(copy.GetSeed() == 42);
+  REQUIRE(copy.GetModeName() == "bomb");
+  REQUIRE(copy.GetInputs().size() == 2);
+  REQUIRE(copy.GetInputs()[1].tick_ == 70000);
+  REQUIRE(copy.GetInputs()[1].move_ == Block::kRotate);
+
+  std::vector<uint8_t> truncated = replay.Serialize();
+  truncated.pop_back();
+  REQUIRE_FALSE(copy.Deserialize(truncated));
+}
+
+TEST_CASE("Replays play the same game again", "[persistence]") {
+  World world(false);
+  world.SetSeed(1234);
+  world.SetCurrentGameState(World::kClassic);
+  Replay replay;
+  replay.Start(world);
+
+  const Block::Move moves[] = {Block::kMoveLeft, Block::kRotate,
+                               Block::kMoveRight, Block::kMoveDown};
+  for (size_t tick = 0; tick < 2000
+       && world.GetCurrentGameState() != World::kEndScreen; tick++) {
+    if (tick % 15 == 0) {
+      Block::Move move = moves[(tick / 15) % 4];
+      replay.AddInput(world.GetTickCount(), move);
+      world.Move(move);
+    }
+
+    world.Step();
+  }
+
+  World replayed_world(false);
+  replay.Play(&replayed_world, world.GetTickCount());
+  REQUIRE(replayed_world.GetTickCount() == world.GetTickCount());
+  REQUIRE(replayed_world.GetScore() == world.GetScore());
+  REQUIRE(replayed_world.GetCurrentGameState()
+      == world.GetCurrentGameState());
+}
+
+} // namespace tetris
@@ -0,0 +1,136 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#include <catch2/catch.hpp>
+
+#include "physics/world.h"
+#include "stream/spectator_stream.h"
+
+namespace tetris {
+
+/**
+ * Keeps every frame written by an encoder
+ */
+class FrameCollector : public SpectatorFrameSink {
+ public:
+  std::vector<std::vector<uint8_t>> frames_;
+  std::vector<bool> is_keyframe_;
+  bool needs_keyframe_ = false;
+
+  bool NeedsKeyframe() override {
+    bool needs_keyframe = needs_keyframe_;
+    needs_keyframe_ = false;
+    return needs_keyframe;
+  }
+
+  void WriteFrame(const std::vector<uint8_t>& frame,
+      bool is_keyframe) override {
+    frames_.push_back(frame);
+    is_keyframe_.push_back(is_keyframe);
+  }
+};
+
+/**
+ * Checks that the mirror holds the same filled tiles as the world
+ */
+static bool IsBoardMirrored(const World& world, const BoardMirror& mirror) {
+  const Board& board = world.GetBoard();
+  for (size_t row = 0; row < board.GetNumRows(); row++) {
+    for (size_t col = 0; col < board.GetNumCols(); col++) {
+      if (board.IsFilled(row, col) != mirror.GetTile(row, col).is_filled_) {
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+TEST_CASE("Spectator frames follow the world", "[spectator][stream]") {
+  FrameCollector collector;
+  SpectatorEncoder encoder(&collector, 50);
+  World world(false);
+  world.SetCurrentGameState(World::kClassic);
+  world.AddListener(&encoder);
+  BoardMirror mirror;
+
+  for (size_t tick = 0; tick < 400; tick++) {
+    if (tick == 100) {
+      world.AddGarbageRows(2);
+    }
+
+    world.Step();
+
+    REQUIRE(collector.frames_.size() == tick + 1);
+    const std::vector<uint8_t>& frame = collector.frames_.back();
+    REQUIRE(mirror.ApplyFrame(frame.data(), frame.size()));
+    REQUIRE(mirror.GetTick() == world.GetTickCount());
+    REQUIRE(mirror.GetScore() == world.GetScore());
+    REQUIRE(IsBoardMirrored(world, mirror));
+  }
+
+  SECTION("First frame and every interval are keyframes") {
+    REQUIRE(collector.is_keyframe_[0]);
+    REQUIRE(collector.is_keyframe_[50]);
+    REQUIRE_FALSE(collector.is_keyframe_[1]);
+  }
+
+  SECTION("Deltas are smaller than keyframes") {
+    REQUIRE(collector.frames_[1].size() < collector.frames_[0].size());
+  }
+}
+
+TEST_CASE("Viewer joins mid-game", "[spectator][stream]") {
+  FrameCollector collector;
+  SpectatorEncoder encoder(&collector, 1000);
+  World world(false);
+  world.SetCurrentGameState(World::kClassic);
+  world.AddListener(&encoder);
+  for (size_t tick = 0; tick < 10; tick++) {
+    world.Step();
+  }
+
+  BoardMirror mirror;
+  const std::vector<uint8_t>& delta = collector.frames_.back();
+  // deltas before a keyframe are skipped
+  REQUIRE(mirror.ApplyFrame(delta.data(), delta.size()));
+  REQUIRE_FALSE(mirror.HasKeyframe());
+
+  collector.needs_keyframe_ = true;
+  world.Step();
+  REQUIRE(collector.is_keyframe_.back());
+  const std::vector<uint8_t>& keyframe = collector.frames_.back();
+  REQUIRE(mirror.ApplyFrame(keyframe.data(), keyframe.size()));
+  REQUIRE(mirror.HasKeyframe());
+  REQUIRE(mirror.HasPiece());
+  REQUIRE(mirror.GetPieceTilePositions().size() == 4);
+}
+
+TEST_CASE("Frame reader splits a stream", "[spectator][stream]") {
+  FrameCollector collector;
+  SpectatorEncoder encoder(&collector);
+  World world(false);
+  world.SetCurrentGameState(World::kClassic);
+  world.AddListener(&encoder);
+  world.Step();
+  world.Step();
+
+  // a stray byte in front, then two frames fed one byte at a time
+  std::vector<uint8_t> stream = {0};
+  for (const std::vector<uint8_t>& frame : collector.frames_) {
+    stream.insert(stream.end(), frame.begin(), frame.end());
+  }
+
+  SpectatorFrameReader reader;
+  std::vector<uint8_t> frame;
+  std::vector<std::vector<uint8_t>> frames_read;
+  for (uint8_t byte : stream) {
+    reader.Append(&byte, 1);
+    while (reader.NextFrame(&frame)) {
+      frames_read.push_back(frame);
+    }
+  }
+
+  REQUIRE(frames_read == collector.frames_);
+}
+
+} // namespace tetris
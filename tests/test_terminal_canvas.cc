@@ -0,0 +1,68 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#include <catch2/catch.hpp>
+
+#include "render/terminal_canvas.h"
+
+namespace tetris {
+
+TEST_CASE("First flush clears the screen", "[terminal_canvas]") {
+  TerminalCanvas canvas;
+  canvas.Resize(4, 2);
+  canvas.Clear();
+  REQUIRE(canvas.Flush() == "\x1b[0m\x1b[2J");
+}
+
+TEST_CASE("Unchanged frame flushes nothing", "[terminal_canvas]") {
+  TerminalCanvas canvas;
+  canvas.Resize(8, 3);
+  canvas.DrawText(1, 1, "hi", 196);
+  canvas.Flush();
+
+  canvas.Clear();
+  canvas.DrawText(1, 1, "hi", 196);
+  REQUIRE(canvas.Flush().empty());
+}
+
+TEST_CASE("Flush writes only changed cells", "[terminal_canvas]") {
+  TerminalCanvas canvas;
+  canvas.Resize(8, 3);
+  canvas.DrawText(0, 0, "abc");
+  canvas.Flush();
+
+  canvas.SetCell(1, 0, 'x', TerminalCanvas::kDefaultColor,
+      TerminalCanvas::kDefaultColor);
+  REQUIRE(canvas.Flush() == "\x1b[1;2Hx");
+
+  // neighbouring cells share one cursor move, and colors are set once
+  canvas.DrawText(3, 2, "yz", 21, 46);
+  REQUIRE(canvas.Flush() == "\x1b[3;4H\x1b[38;5;21;48;5;46myz");
+}
+
+TEST_CASE("Invalidate redraws every cell", "[terminal_canvas]") {
+  TerminalCanvas canvas;
+  canvas.Resize(3, 1);
+  canvas.DrawText(0, 0, "ab");
+  canvas.Flush();
+
+  canvas.Invalidate();
+  REQUIRE(canvas.Flush() == "\x1b[0m\x1b[2J\x1b[1;1Hab");
+}
+
+TEST_CASE("Cells outside the canvas are ignored", "[terminal_canvas]") {
+  TerminalCanvas canvas;
+  canvas.Resize(2, 2);
+  canvas.Clear();
+  canvas.DrawText(1, 1, "abc");
+  canvas.SetCell(-1, 0, 'x', 0, 0);
+  REQUIRE(canvas.GetCell(1, 1).glyph_ == 'a');
+  REQUIRE(canvas.GetCell(0, 0).glyph_ == ' ');
+}
+
+TEST_CASE("Colors map onto the color cube", "[terminal_canvas]") {
+  REQUIRE(TerminalCanvas::GetColorIndex(0.0f, 0.0f, 0.0f) == 16);
+  REQUIRE(TerminalCanvas::GetColorIndex(1.0f, 1.0f, 1.0f) == 231);
+  REQUIRE(TerminalCanvas::GetColorIndex(1.0f, 0.0f, 0.0f) == 196);
+}
+
+} // namespace tetris
@@ -0,0 +1,44 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#include <catch2/catch.hpp>
+
+#include "telemetry/timing_history.h"
+
+namespace tetris {
+
+TEST_CASE("Timing history starts empty", "[timing_history]") {
+  TimingHistory history;
+  REQUIRE(history.GetNumSamples() == 0);
+  REQUIRE(history.GetMean() == Approx(0.0f));
+  REQUIRE(history.GetMax() == Approx(0.0f));
+  REQUIRE(history.GetStandardDeviation() == Approx(0.0f));
+}
+
+TEST_CASE("Timing history statistics", "[timing_history]") {
+  TimingHistory history;
+  history.Add(2.0f);
+  history.Add(4.0f);
+  history.Add(6.0f);
+
+  REQUIRE(history.GetNumSamples() == 3);
+  REQUIRE(history.Get(0) == Approx(6.0f));
+  REQUIRE(history.Get(2) == Approx(2.0f));
+  REQUIRE(history.GetMean() == Approx(4.0f));
+  REQUIRE(history.GetMax() == Approx(6.0f));
+  REQUIRE(history.GetStandardDeviation() == Approx(1.63299f));
+}
+
+TEST_CASE("Timing history keeps only the newest samples",
+    "[timing_history]") {
+  TimingHistory history;
+  for (size_t sample = 0; sample < TimingHistory::kMaxSamples + 10;
+       sample++) {
+    history.Add(static_cast<float>(sample));
+  }
+
+  REQUIRE(history.GetNumSamples() == TimingHistory::kMaxSamples);
+  REQUIRE(history.Get(0) == Approx(TimingHistory::kMaxSamples + 9));
+  REQUIRE(history.Get(TimingHistory::kMaxSamples - 1) == Approx(10.0f));
+}
+
+} // namespace tetris
@@ -0,0 +1,89 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#include <catch2/catch.hpp>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#include "telemetry/trace.h"
+
+namespace tetris {
+
+/**
+ * Counts the collected spans with a name
+ * @param name the name
+ * @return number of spans
+ */
+static size_t CountSpans(const char* name) {
+  size_t count = 0;
+  for (const TraceRecord& record : Tracer::Collect()) {
+    if (std::strcmp(record.name_, name) == 0) {
+      count++;
+    }
+  }
+
+  return count;
+}
+
+TEST_CASE("Spans are only recorded while tracing is on", "[trace]") {
+  Tracer::SetEnabled(false);
+  {
+    TraceSpan span("test disabled span");
+  }
+  REQUIRE(CountSpans("test disabled span") == 0);
+
+  Tracer::SetEnabled(true);
+  {
+    TraceSpan outer("test outer span");
+    TraceSpan inner("test inner span");
+  }
+  Tracer::SetEnabled(false);
+
+  REQUIRE(CountSpans("test outer span") == 1);
+  REQUIRE(CountSpans("test inner span") == 1);
+}
+
+TEST_CASE("Every thread keeps its newest spans", "[trace]") {
+  Tracer::SetEnabled(true);
+  std::thread worker([] {
+    for (size_t span = 0; span < Tracer::kBufferCapacity + 100; span++) {
+      TraceSpan trace_span("test worker span");
+    }
+  });
+  worker.join();
+  Tracer::SetEnabled(false);
+
+  size_t count = CountSpans("test worker span");
+  REQUIRE(count <= Tracer::kBufferCapacity);
+  // at most the slot that might have been in use is dropped
+  REQUIRE(count >= Tracer::kBufferCapacity - 1);
+}
+
+TEST_CASE("Spans are written as Chrome trace events", "[trace]") {
+  Tracer::SetEnabled(true);
+  Tracer::SetThreadName("test thread");
+  {
+    TraceSpan span("test written span");
+  }
+  Tracer::SetEnabled(false);
+
+  const char path[] = "test_trace.json";
+  REQUIRE(Tracer::WriteChromeTrace(path));
+  std::ifstream file(path);
+  std::stringstream contents;
+  contents << file.rdbuf();
+  file.close();
+  std::remove(path);
+
+  std::string json = contents.str();
+  REQUIRE(json.find("{\"traceEvents\":[") == 0);
+  REQUIRE(json.find("\"name\":\"test written span\",\"ph\":\"X\"")
+      != std::string::npos);
+  REQUIRE(json.find("\"args\":{\"name\":\"test thread\"}")
+      != std::string::npos);
+}
+
+} // namespace tetris
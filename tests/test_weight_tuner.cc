@@ -0,0 +1,80 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#include <catch2/catch.hpp>
+
+#include <cstdio>
+#include <string>
+
+#include "bot/weight_tuner.h"
+#include "server/work_stealing_pool.h"
+
+namespace tetris {
+
+/**
+ * Makes small tuning runs that finish quickly
+ * @return the options
+ */
+static WeightTuner::Options MakeTestOptions() {
+  return WeightTuner::Options{6, 2, 2, 100,
+      {World::kClassic, World::kReloaded}, WeightTuner::kGridBackend, 3,
+      0.3};
+}
+
+TEST_CASE("Grid games are played the same way every time", "[tuner]") {
+  HeuristicBot bot;
+  WeightTuner::GameResult first = WeightTuner::PlayGame(bot, World::kClassic,
+      5, 200, WeightTuner::kGridBackend);
+  WeightTuner::GameResult second = WeightTuner::PlayGame(bot,
+      World::kClassic, 5, 200, WeightTuner::kGridBackend);
+  REQUIRE(first.num_pieces_ == 200);
+  REQUIRE(first.num_lines_ > 0);
+  REQUIRE(first.num_pieces_ == second.num_pieces_);
+  REQUIRE(first.num_lines_ == second.num_lines_);
+}
+
+TEST_CASE("A generation keeps the weights at unit length", "[tuner]") {
+  WorkStealingPool pool(2);
+  WeightTuner tuner(MakeTestOptions(), &pool);
+  WeightTuner::Report report = tuner.RunGeneration();
+  REQUIRE(report.generation_ == 0);
+  REQUIRE(report.num_games_ == 24);
+  REQUIRE(report.best_fitness_ >= report.mean_fitness_);
+  REQUIRE(tuner.GetGeneration() == 1);
+
+  double length = 0.0;
+  for (double weight : tuner.GetMean()) {
+    length += weight * weight;
+  }
+
+  REQUIRE(length == Approx(1.0));
+}
+
+TEST_CASE("A resumed search continues where it left off", "[tuner]") {
+  const std::string kPath = "test_weight_tuner.checkpoint";
+  WorkStealingPool pool(2);
+  WeightTuner tuner(MakeTestOptions(), &pool);
+  tuner.RunGeneration();
+  std::string error;
+  REQUIRE(tuner.SaveCheckpoint(kPath, &error));
+
+  WeightTuner resumed(MakeTestOptions(), &pool);
+  REQUIRE(resumed.LoadCheckpoint(kPath, &error));
+  REQUIRE(resumed.GetGeneration() == 1);
+  REQUIRE(resumed.GetMean() == tuner.GetMean());
+
+  WeightTuner::Report expected = tuner.RunGeneration();
+  WeightTuner::Report report = resumed.RunGeneration();
+  REQUIRE(report.best_weights_ == expected.best_weights_);
+  REQUIRE(report.best_fitness_ == Approx(expected.best_fitness_));
+  REQUIRE(resumed.GetStep() == Approx(tuner.GetStep()));
+
+  SECTION("Other files aren't taken for checkpoints") {
+    WeightTuner fresh(MakeTestOptions(), &pool);
+    REQUIRE_FALSE(fresh.LoadCheckpoint("missing.checkpoint", &error));
+    REQUIRE(fresh.GetGeneration() == 0);
+  }
+
+  std::remove(kPath.c_str());
+}
+
+} // namespace tetris
@@ -5,6 +5,10 @@
 #include <cinder/Rand.h>
 #include <catch2/catch.hpp>
 
+#include <algorithm>
+#include <cmath>
+
+#include "physics/game_mode.h"
 #include "physics/world.h"
 
 namespace tetris {
@@ -75,13 +79,13 @@ TEST_CASE("Test Floor Tile Array",
   SECTION("Floor size in classic mode") {
     world.SetCurrentGameState(World::kClassic);
     // Floor should be default 24 size at start
-    REQUIRE(world.GetFloorTileArray().size() == 24);
+    REQUIRE(world.GetBoard().GetNumRows() == 24);
   }
 
   SECTION("Floor size in Reloaded mode") {
     world.SetCurrentGameState(World::kReloaded);
     // Floor should be default 24 size at start
-    REQUIRE(world.GetFloorTileArray().size() == 48);
+    REQUIRE(world.GetBoard().GetNumRows() == 48);
   }
 }
 
@@ -89,25 +93,69 @@ TEST_CASE("Moving commands", "[world-constructor][world][move]") {
   World world;
   world.SetCurrentGameState(World::kClassic);
   world.SpawnNewRandomBlock();
+  b2Vec2 position = world.GetMovingBlock()->GetBody()->GetPosition();
 
   SECTION("Moving left") {
-    world.Move(Block::kMoveLeft);
-    REQUIRE(world.GetCurrentMoveStatus() == World::kValidateLegalMove);
+    REQUIRE(world.Move(Block::kMoveLeft));
+    REQUIRE(world.GetMovingBlock()->GetBody()->GetPosition().x
+        == Approx(position.x - 1.0f));
+    REQUIRE(world.GetCurrentMoveStatus() == World::kMoveOk);
   }
 
   SECTION("Moving Right") {
-    world.Move(Block::kMoveRight);
-    REQUIRE(world.GetCurrentMoveStatus() == World::kValidateLegalMove);
+    REQUIRE(world.Move(Block::kMoveRight));
+    REQUIRE(world.GetMovingBlock()->GetBody()->GetPosition().x
+        == Approx(position.x + 1.0f));
+    REQUIRE(world.GetCurrentMoveStatus() == World::kMoveOk);
   }
 
   SECTION("Moving Down") {
-    world.Move(Block::kMoveDown);
-    REQUIRE(world.GetCurrentMoveStatus() == World::kValidateLegalMove);
+    REQUIRE(world.Move(Block::kMoveDown));
+    REQUIRE(world.GetCurrentMoveStatus() == World::kMoveOk);
   }
 
   SECTION("Rotate Block") {
-    world.Move(Block::kRotate);
-    REQUIRE(world.GetCurrentMoveStatus() == World::kValidateLegalMove);
+    REQUIRE(world.Move(Block::kRotate));
+    REQUIRE(world.GetMovingBlock()->GetBody()->GetAngle()
+        == Approx(-M_PI / 2));
+    REQUIRE(world.GetCurrentMoveStatus() == World::kMoveOk);
+  }
+
+  SECTION("Moving into the wall is refused at once") {
+    size_t num_moves = 0;
+    while (world.Move(Block::kMoveLeft)) {
+      num_moves++;
+      REQUIRE(num_moves <= world.GetTotalNumCol());
+    }
+
+    b2Vec2 wall_position = world.GetMovingBlock()->GetBody()->GetPosition();
+    REQUIRE_FALSE(world.Move(Block::kMoveLeft));
+    REQUIRE(world.GetMovingBlock()->GetBody()->GetPosition().x
+        == Approx(wall_position.x));
+    REQUIRE(world.GetMovingBlock()->GetBlockBox(&world).lowerBound.x
+        >= 0.0f);
+  }
+
+  SECTION("Moving into a floor tile is refused at once") {
+    // drop the block so its tiles are on the board, then wall it in
+    world.Move(Block::kHardDrop);
+    const Block* block = world.GetMovingBlock();
+    b2Transform transform = block->GetBody()->GetTransform();
+    block->GetBody()->SetTransform(
+        b2Vec2(transform.p.x, transform.p.y - 12.0f), transform.q.GetAngle());
+    for (size_t row = 0; row < world.GetBoard().GetNumRows(); row++) {
+      world.GetBoard().FillTile(row, 0, cinder::Color(1, 1, 1));
+      world.GetBoard().FillTile(row, world.GetTotalNumCol() - 1,
+          cinder::Color(1, 1, 1));
+    }
+
+    size_t num_moves = 0;
+    while (world.Move(Block::kMoveLeft)) {
+      num_moves++;
+      REQUIRE(num_moves <= world.GetTotalNumCol());
+    }
+
+    REQUIRE(block->GetBlockBox(&world).lowerBound.x >= 1.0f);
   }
 }
 
@@ -126,4 +174,442 @@ TEST_CASE("World setters and getters",
   }
 }
 
+TEST_CASE("Hard drop locks the block at once", "[world][classic]") {
+  World world(false);
+  world.SetSeed(7);
+  world.SetCurrentGameState(World::kClassic);
+  world.Step();
+  const Block* dropped_block = world.GetMovingBlock();
+  REQUIRE(world.GetDropDistance() > 0);
+
+  world.Move(Block::kHardDrop);
+  const Board& board = world.GetBoard();
+  size_t num_filled = 0;
+  for (size_t row = 0; row < board.GetNumRows(); row++) {
+    for (size_t col = 0; col < board.GetNumCols(); col++) {
+      num_filled += board.IsFilled(row, col) ? 1 : 0;
+    }
+  }
+
+  // the dropped block rests on the bottom and a new one has spawned
+  REQUIRE(num_filled == 4);
+  REQUIRE(!board.IsRowEmpty(0));
+  REQUIRE(world.GetMovingBlock() != dropped_block);
+  REQUIRE(world.GetCurrentGameState() == World::kClassic);
+
+  // the next block lands on top of the first
+  size_t max_height = 0;
+  for (size_t col = 0; col < board.GetNumCols(); col++) {
+    max_height = std::max(max_height, board.GetColumnHeight(col));
+  }
+
+  world.Move(Block::kHardDrop);
+  size_t new_max_height = 0;
+  for (size_t col = 0; col < board.GetNumCols(); col++) {
+    new_max_height = std::max(new_max_height, board.GetColumnHeight(col));
+  }
+
+  REQUIRE(new_max_height >= max_height);
+  REQUIRE(new_max_height <= 8);
+}
+
+TEST_CASE("Topping out leaves no stale floor fixtures", "[world][classic]") {
+  World world(false);
+  world.SetSeed(7);
+  world.SetCurrentGameState(World::kClassic);
+  world.Step();
+  for (size_t drop = 0; drop < 200
+       && world.GetCurrentGameState() != World::kEndScreen; drop++) {
+    world.Move(Block::kHardDrop);
+  }
+
+  // the floor body was rebuilt before the game ended, taking its fixtures
+  REQUIRE(world.GetCurrentGameState() == World::kEndScreen);
+  const Board& board = world.GetBoard();
+  for (size_t row = 0; row < board.GetNumRows(); row++) {
+    for (size_t col = 0; col < board.GetNumCols(); col++) {
+      REQUIRE(board.GetFixture(row, col) == nullptr);
+    }
+  }
+}
+
+/**
+ * Checks that every locked block rests on the floor or on another tile
+ */
+class LandingChecker : public WorldListener {
+ private:
+  size_t num_locked_ = 0;
+  size_t num_misplaced_ = 0;
+
+ public:
+  void OnBlockLocked(const World& world, const Block& /* block */,
+      const std::vector<TilePosition>& tiles) override {
+    num_locked_++;
+    // a bomb leaves no tiles, it blew up where it landed
+    bool is_resting = tiles.empty();
+    for (const TilePosition& tile : tiles) {
+      if (tile.row_ == 0) {
+        is_resting = true;
+        break;
+      }
+
+      bool is_below_own_tile = std::any_of(tiles.begin(), tiles.end(),
+          [&tile](const TilePosition& other) {
+            return other.col_ == tile.col_ && other.row_ + 1 == tile.row_;
+          });
+      if (!is_below_own_tile
+          && world.GetBoard().IsFilled(tile.row_ - 1, tile.col_)) {
+        is_resting = true;
+        break;
+      }
+    }
+
+    if (!is_resting) {
+      num_misplaced_++;
+    }
+  }
+
+  size_t GetNumLocked() const {
+    return num_locked_;
+  }
+
+  size_t GetNumMisplaced() const {
+    return num_misplaced_;
+  }
+};
+
+TEST_CASE("Gravity grows with the level", "[world][gravity]") {
+  REQUIRE(World::GetGravityMultiplier(0) == Approx(1.0));
+  REQUIRE(World::GetGravityMultiplier(World::kMaxLevel)
+      == Approx(World::kMaxGravity));
+  for (size_t level = 1; level <= World::kMaxLevel; level++) {
+    REQUIRE(World::GetGravityMultiplier(level)
+        > World::GetGravityMultiplier(level - 1));
+  }
+
+  World first_level_world(false);
+  first_level_world.SetCurrentGameState(World::kClassic);
+  World world(false);
+  world.SetLevel(World::kMaxLevel + 5);
+  REQUIRE(world.GetLevel() == World::kMaxLevel);
+  world.SetCurrentGameState(World::kReloaded);
+  // reloaded tiles are half size, so blocks cover twice as many
+  REQUIRE(world.GetExpectedBlockSpeed() == Approx(2.0 * World::kMaxGravity
+      * first_level_world.GetExpectedBlockSpeed()));
+}
+
+TEST_CASE("Blocks never pass through the floor at any level",
+    "[world][gravity]") {
+  // a disjointed block locks a tile at a time as its debris settles
+  const size_t num_locks = 3;
+  struct LandingMode {
+    World::GameState game_state_;
+    bool is_tile_disconnected_;
+    bool is_bomb_;
+  };
+
+  const LandingMode kModes[] = {{World::kClassic, false, false},
+                                {World::kReloaded, false, false},
+                                {World::kReloaded, true, false},
+                                {World::kClassic, false, true}};
+  for (const LandingMode& mode : kModes) {
+    for (size_t level = 0; level <= World::kMaxLevel; level++) {
+      World world(false);
+      world.SetSeed(5);
+      world.SetLevel(level);
+      world.SetIsTileDisconnectedMode(mode.is_tile_disconnected_);
+      world.SetIsBombMode(mode.is_bomb_);
+      world.SetCurrentGameState(mode.game_state_);
+      LandingChecker checker;
+      world.AddListener(&checker);
+
+      for (size_t tick = 0; tick < 2000 && checker.GetNumLocked() < num_locks
+           && world.GetCurrentGameState() != World::kEndScreen; tick++) {
+        world.Step();
+      }
+
+      INFO("game state " << mode.game_state_ << " disjointed "
+          << mode.is_tile_disconnected_ << " bomb " << mode.is_bomb_
+          << " level " << level);
+      REQUIRE(checker.GetNumLocked() >= num_locks);
+      REQUIRE(checker.GetNumMisplaced() == 0);
+      REQUIRE(world.GetCurrentGameState() == mode.game_state_);
+      // debris still falling hasn't gone through the floor either
+      for (const World::Debris& debris : world.GetDebris()) {
+        REQUIRE(debris.body_->GetPosition().y > -0.5f);
+      }
+
+      world.RemoveListener(&checker);
+    }
+  }
+}
+
+TEST_CASE("Debris settles into the floor", "[world][debris]") {
+  World world(false);
+  world.SetSeed(3);
+  world.SetIsTileDisconnectedMode(true);
+  world.SetCurrentGameState(World::kReloaded);
+
+  // a full row of loose tiles resting just above the floor
+  for (size_t col = 0; col < world.GetTotalNumCol(); col++) {
+    world.AddDebris(kReloadedBlockTemplates[0],
+        b2Vec2(static_cast<float>(col), 0.5f), b2Vec2(0.0f, 0.0f));
+  }
+
+  // one more in the middle of the board, left alone above an empty column
+  world.AddDebris(kReloadedBlockTemplates[1], b2Vec2(3.0f, 10.0f),
+      b2Vec2(0.0f, 0.0f));
+  REQUIRE(world.GetDebris().size() == world.GetTotalNumCol() + 1);
+
+  for (size_t tick = 0; tick < 200 && !world.GetDebris().empty(); tick++) {
+    world.Step();
+  }
+
+  // the full row cleared, and the single tile ended up on the bottom row
+  REQUIRE(world.GetDebris().empty());
+  REQUIRE(world.GetScore() == 1);
+  REQUIRE(world.GetBoard().IsFilled(0, 3));
+  REQUIRE(world.GetBoard().GetColumnHeight(3) == 1);
+  REQUIRE(world.GetBoard().GetFixture(0, 3) != nullptr);
+}
+
+TEST_CASE("Hard drop stops on debris in disconnected mode",
+    "[world][debris]") {
+  World world(false);
+  world.SetSeed(3);
+  world.SetIsTileDisconnectedMode(true);
+  world.SetCurrentGameState(World::kReloaded);
+  world.Step();
+  size_t num_tiles = world.GetMovingBlock()->GetTemplate().num_tiles_;
+
+  // a row of loose tiles still in the air under the block
+  size_t num_cols = world.GetTotalNumCol();
+  for (size_t col = 0; col < num_cols; col++) {
+    world.AddDebris(kReloadedBlockTemplates[0],
+        b2Vec2(static_cast<float>(col), 10.0f), b2Vec2(0.0f, 0.0f));
+  }
+
+  // the ghost stops on the row as well
+  float lowest_bottom = static_cast<float>(world.GetTotalNumRow());
+  for (const b2Fixture* fixture =
+           world.GetMovingBlock()->GetBody()->GetFixtureList();
+       fixture != nullptr; fixture = fixture->GetNext()) {
+    lowest_bottom =
+        std::min(lowest_bottom, Block::GetTileCenter(fixture).y - 0.5f);
+  }
+
+  REQUIRE(lowest_bottom - world.GetDropDistance() > 10.5f);
+
+  world.Move(Block::kHardDrop);
+
+  // the block broke apart on top of the row instead of locking on the floor
+  const std::vector<World::Debris>& debris = world.GetDebris();
+  REQUIRE(debris.size() == num_cols + num_tiles);
+  for (size_t index = num_cols; index < debris.size(); index++) {
+    REQUIRE(debris[index].body_->GetPosition().y > 10.5f);
+  }
+
+  for (size_t col = 0; col < num_cols; col++) {
+    REQUIRE(world.GetBoard().GetColumnHeight(col) == 0);
+  }
+}
+
+TEST_CASE("Preview shows the blocks that spawn next", "[world][preview]") {
+  World world(false);
+  world.SetSeed(21);
+  world.SetCurrentGameState(World::kClassic);
+  REQUIRE(world.GetNumPreviewBlocks() == 0);
+  world.Step();
+  REQUIRE(world.GetNumPreviewBlocks() == World::kNumPreviewBlocks);
+
+  // making blocks early keeps the order the seed gives
+  World other_world(false);
+  other_world.SetCurrentGameState(World::kClassic);
+  BlockGenerator generator(false, 21);
+  REQUIRE(world.GetMovingBlock()->GetTemplateId()
+      == generator.CreateRandomBlock(&other_world)->GetTemplateId());
+
+  for (size_t lock = 0; lock < 4; lock++) {
+    size_t next_id = world.GetPreviewBlock(0).GetTemplateId();
+    size_t after_next_id = world.GetPreviewBlock(1).GetTemplateId();
+    REQUIRE_FALSE(world.GetPreviewBlock(0).GetBody()->IsActive());
+    REQUIRE(next_id
+        == generator.CreateRandomBlock(&other_world)->GetTemplateId());
+
+    world.Move(Block::kHardDrop);
+    REQUIRE(world.GetMovingBlock()->GetTemplateId() == next_id);
+    REQUIRE(world.GetMovingBlock()->GetBody()->IsActive());
+    REQUIRE(world.GetPreviewBlock(0).GetTemplateId() == after_next_id);
+    REQUIRE(world.GetNumPreviewBlocks() == World::kNumPreviewBlocks);
+    world.Step();
+  }
+}
+
+TEST_CASE("Spawning after a lock makes no bodies", "[world][preview]") {
+  World world(false);
+  world.SetSeed(2);
+  world.SetCurrentGameState(World::kClassic);
+  world.Step();
+  world.Step();
+  int num_bodies = world.GetB2World()->GetBodyCount();
+
+  // the locked block's body goes and the next one is switched on
+  world.Move(Block::kHardDrop);
+  REQUIRE(world.GetB2World()->GetBodyCount() == num_bodies - 1);
+
+  // the spare is made on the next tick
+  world.Step();
+  REQUIRE(world.GetB2World()->GetBodyCount() == num_bodies);
+}
+
+TEST_CASE("Hold puts the block aside once per block", "[world][hold]") {
+  World world(false);
+  world.SetSeed(8);
+  world.SetCurrentGameState(World::kClassic);
+  world.Step();
+  size_t first_id = world.GetMovingBlock()->GetTemplateId();
+  size_t next_id = world.GetPreviewBlock(0).GetTemplateId();
+  world.Move(Block::kRotate);
+
+  REQUIRE(world.Move(Block::kHold));
+  REQUIRE(world.GetHeldBlock()->GetTemplateId() == first_id);
+  REQUIRE_FALSE(world.GetHeldBlock()->GetBody()->IsActive());
+  REQUIRE(world.GetMovingBlock()->GetTemplateId() == next_id);
+  REQUIRE(world.IsHoldUsed());
+  REQUIRE_FALSE(world.Move(Block::kHold));
+
+  SECTION("Holding after a lock swaps the held block back in") {
+    world.Move(Block::kHardDrop);
+    REQUIRE_FALSE(world.IsHoldUsed());
+    size_t spawned_id = world.GetMovingBlock()->GetTemplateId();
+
+    REQUIRE(world.Move(Block::kHold));
+    REQUIRE(world.GetHeldBlock()->GetTemplateId() == spawned_id);
+    const Block* block = world.GetMovingBlock();
+    REQUIRE(block->GetTemplateId() == first_id);
+    REQUIRE(block->GetTimesRotated() == 0);
+    REQUIRE(block->GetBody()->GetAngle() == Approx(0.0f).margin(1e-5));
+    REQUIRE(block->GetBody()->GetPosition().x
+        == Approx(world.GetSpawnPosition().x));
+    REQUIRE(block->GetBody()->GetPosition().y
+        == Approx(world.GetSpawnPosition().y));
+    REQUIRE(block->GetBody()->IsActive());
+  }
+}
+
+/**
+ * Notes where bombs exploded
+ */
+class BombWatcher : public WorldListener {
+ private:
+  std::vector<TilePosition> centers_;
+
+ public:
+  void OnBombExploded(const World& /* world */,
+      const TilePosition& center) override {
+    centers_.push_back(center);
+  }
+
+  const std::vector<TilePosition>& GetCenters() const {
+    return centers_;
+  }
+};
+
+/**
+ * Finds a seed whose first block in bomb mode is the bomb
+ * @return the seed
+ */
+static uint32_t FindBombSeed() {
+  for (uint32_t seed = 1;; seed++) {
+    World world(false);
+    world.SetSeed(seed);
+    world.SetIsBombMode(true);
+    world.SetCurrentGameState(World::kClassic);
+    world.Step();
+    if (world.GetMovingBlock()->IsBomb()) {
+      return seed;
+    }
+  }
+}
+
+TEST_CASE("A locked bomb clears the 3 by 3 area around it",
+    "[world][bomb]") {
+  World world(false);
+  world.SetSeed(FindBombSeed());
+  world.SetIsBombMode(true);
+  world.SetCurrentGameState(World::kClassic);
+  world.Step();
+  REQUIRE(world.GetMovingBlock()->IsBomb());
+
+  world.AddGarbageRows(3);
+  const Board& board = world.GetBoard();
+  size_t num_filled = 3 * (board.GetNumCols() - 1);
+  BombWatcher watcher;
+  world.AddListener(&watcher);
+  world.Move(Block::kHardDrop);
+  world.RemoveListener(&watcher);
+
+  REQUIRE(watcher.GetCenters().size() == 1);
+  const TilePosition& center = watcher.GetCenters()[0];
+  size_t num_left = 0;
+  for (size_t row = 0; row < board.GetNumRows(); row++) {
+    for (size_t col = 0; col < board.GetNumCols(); col++) {
+      bool is_near_center = row + 1 >= center.row_ && row <= center.row_ + 1
+          && col + 1 >= center.col_ && col <= center.col_ + 1;
+      if (is_near_center) {
+        REQUIRE_FALSE(board.IsFilled(row, col));
+      }
+
+      num_left += board.IsFilled(row, col) ? 1 : 0;
+    }
+  }
+
+  // the bomb itself is never added to the floor
+  REQUIRE(num_left < num_filled);
+}
+
+TEST_CASE("Stepping a mode directly matches the runtime dispatch",
+    "[world][game-mode]") {
+  World dispatched_world(false);
+  World policy_world(false);
+  dispatched_world.SetSeed(99);
+  policy_world.SetSeed(99);
+  dispatched_world.SetIsBombMode(true);
+  policy_world.SetIsBombMode(true);
+  dispatched_world.SetCurrentGameState(World::kClassic);
+  policy_world.SetCurrentGameState(World::kClassic);
+
+  for (size_t tick = 0; tick < 600; tick++) {
+    dispatched_world.Step();
+    policy_world.StepMode<BombMode>();
+  }
+
+  REQUIRE(policy_world.GetTickCount() == dispatched_world.GetTickCount());
+  REQUIRE(policy_world.GetScore() == dispatched_world.GetScore());
+  REQUIRE(policy_world.GetMovingBlock()->GetTemplateId()
+      == dispatched_world.GetMovingBlock()->GetTemplateId());
+}
+
+TEST_CASE("Garbage rows", "[world][garbage]") {
+  World world(false);
+  world.SetCurrentGameState(World::kClassic);
+  world.AddGarbageRows(2);
+
+  // both rows share one open column
+  for (size_t row = 0; row < 2; row++) {
+    size_t filled_tiles = 0;
+    for (size_t col = 0; col < world.GetBoard().GetNumCols(); col++) {
+      if (world.GetBoard().IsFilled(row, col)) {
+        REQUIRE(world.GetBoard().GetFixture(row, col) != nullptr);
+        filled_tiles++;
+      }
+    }
+
+    REQUIRE(filled_tiles == world.GetTotalNumCol() - 1);
+  }
+
+  REQUIRE(world.GetBoard().GetNumRows() == 24);
+  REQUIRE(world.TakeClearedRowCount() == 0);
+}
+
 } // namespace tetris
@@ -0,0 +1,97 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+#include "server/match_server.h"
+#include "telemetry/trace.h"
+
+using tetris::MatchServer;
+using tetris::Tracer;
+using tetris::World;
+
+namespace {
+
+const size_t kDefaultNumWorlds = 100;
+const size_t kDefaultNumTicks = 3600;
+const double kDefaultTickRate = 60.0;
+
+void PrintUsage() {
+  printf("usage: battle_royale_server [--worlds N] [--threads N] "
+         "[--ticks N] [--rate HZ] [--mode classic|reloaded] "
+         "[--spectate-dir DIR] [--trace TRACE_PATH]\n");
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  size_t num_worlds = kDefaultNumWorlds;
+  size_t num_threads = std::thread::hardware_concurrency();
+  size_t num_ticks = kDefaultNumTicks;
+  double tick_rate = kDefaultTickRate;
+  World::GameState game_state = World::kClassic;
+  std::string spectate_directory;
+  std::string trace_path;
+
+  for (int index = 1; index + 1 < argc; index += 2) {
+    std::string flag = argv[index];
+    std::string value = argv[index + 1];
+    if (flag == "--worlds") {
+      num_worlds = std::stoul(value);
+    } else if (flag == "--threads") {
+      num_threads = std::stoul(value);
+    } else if (flag == "--ticks") {
+      num_ticks = std::stoul(value);
+    } else if (flag == "--rate") {
+      tick_rate = std::stod(value);
+    } else if (flag == "--spectate-dir") {
+      spectate_directory = value;
+    } else if (flag == "--trace") {
+      trace_path = value;
+    } else if (flag == "--mode" && value == "reloaded") {
+      game_state = World::kReloaded;
+    } else if (flag != "--mode" || value != "classic") {
+      PrintUsage();
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (argc % 2 == 0) {
+    PrintUsage();
+    return EXIT_FAILURE;
+  }
+
+  // turned on before the server starts its workers, so they are named
+  if (!trace_path.empty()) {
+    Tracer::SetEnabled(true);
+    Tracer::SetThreadName("main");
+  }
+
+  MatchServer server(num_worlds, num_threads, game_state);
+  if (!spectate_directory.empty()
+      && !server.EnableSpectators(spectate_directory)) {
+    printf("could not create spectator sockets in %s\n",
+        spectate_directory.c_str());
+    return EXIT_FAILURE;
+  }
+
+  server.Run(num_ticks, tick_rate);
+  if (!trace_path.empty() && !Tracer::WriteChromeTrace(trace_path)) {
+    printf("could not write trace to %s\n", trace_path.c_str());
+  }
+
+  MatchServer::TickStatistics statistics = server.GetTickStatistics();
+  printf("worlds: %zu on %zu threads at %.1f Hz\n",
+      server.GetNumWorlds(), num_threads, tick_rate);
+  printf("ticks: %zu, missed deadlines: %zu\n",
+      statistics.num_ticks_, statistics.num_missed_deadlines_);
+  printf("tick time (us): mean %.1f p50 %.1f p90 %.1f p99 %.1f max %.1f\n",
+      statistics.mean_, statistics.p50_, statistics.p90_, statistics.p99_,
+      statistics.max_);
+  printf("worlds alive: %zu\n", server.GetNumAlive());
+  printf("mean world memory: %zu bytes\n",
+      server.GetMeanWorldMemoryFootprint());
+  return EXIT_SUCCESS;
+}
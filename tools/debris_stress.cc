@@ -0,0 +1,128 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "physics/block_template.h"
+#include "physics/world.h"
+
+using tetris::BlockTemplate;
+using tetris::World;
+
+namespace {
+
+const size_t kDefaultMinTiles = 250;
+const size_t kDefaultMaxTiles = 4000;
+const size_t kDefaultNumTicks = 600;
+// a 60 Hz game has this long for a step
+const double kStepBudgetMs = 1000.0 / 60.0;
+
+void PrintUsage() {
+  printf("usage: debris_stress [--min-tiles N] [--max-tiles N] "
+         "[--ticks N]\n");
+}
+
+/**
+ * Gets the value below which the given fraction of samples fall
+ * @param samples samples, reordered by this call
+ * @param fraction fraction between 0 and 1
+ * @return percentile value
+ */
+double GetPercentile(std::vector<double>& samples, double fraction) {
+  size_t index = static_cast<size_t>(fraction * (samples.size() - 1));
+  std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+  return samples[index];
+}
+
+/**
+ * Rains tiles onto a disconnected mode board and times every step
+ * @param num_tiles number of tiles dropped at the start
+ * @param num_ticks most steps to run
+ */
+void RunStress(size_t num_tiles, size_t num_ticks) {
+  World world(false);
+  world.SetSeed(static_cast<uint32_t>(num_tiles));
+  world.SetIsTileDisconnectedMode(true);
+  world.SetCurrentGameState(World::kReloaded);
+
+  // one tile per column in each layer, stacked above the board, so every
+  // tile is live at the start and full layers clear as rows
+  size_t num_cols = world.GetTotalNumCol();
+  size_t num_rows = world.GetTotalNumRow();
+  for (size_t tile = 0; tile < num_tiles; tile++) {
+    const BlockTemplate& block_template = tetris::kReloadedBlockTemplates[
+        tile % tetris::kNumReloadedBlockTemplates];
+    b2Vec2 position(static_cast<float>(tile % num_cols),
+        static_cast<float>(num_rows + tile / num_cols));
+    world.AddDebris(block_template, position, b2Vec2(0.0f, 0.0f));
+  }
+
+  std::vector<double> step_times;
+  size_t max_debris = 0;
+  for (size_t tick = 0; tick < num_ticks
+       && world.GetCurrentGameState() != World::kEndScreen; tick++) {
+    max_debris = std::max(max_debris, world.GetDebris().size());
+    auto start = std::chrono::steady_clock::now();
+    world.Step();
+    std::chrono::duration<double, std::milli> elapsed =
+        std::chrono::steady_clock::now() - start;
+    step_times.push_back(elapsed.count());
+  }
+
+  size_t num_over_budget = std::count_if(step_times.begin(),
+      step_times.end(), [](double step_time) {
+        return step_time > kStepBudgetMs;
+      });
+  double mean = 0.0;
+  for (double step_time : step_times) {
+    mean += step_time / step_times.size();
+  }
+
+  double p99 = GetPercentile(step_times, 0.99);
+  double max = *std::max_element(step_times.begin(), step_times.end());
+  printf("%7zu %7zu %7zu %9zu %9.3f %9.3f %9.3f %6zu %s\n",
+      num_tiles, step_times.size(), max_debris, world.GetDebris().size(),
+      mean, p99, max, num_over_budget,
+      world.GetCurrentGameState() == World::kEndScreen ? "topped out" : "");
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  size_t min_tiles = kDefaultMinTiles;
+  size_t max_tiles = kDefaultMaxTiles;
+  size_t num_ticks = kDefaultNumTicks;
+
+  for (int index = 1; index + 1 < argc; index += 2) {
+    std::string flag = argv[index];
+    std::string value = argv[index + 1];
+    if (flag == "--min-tiles") {
+      min_tiles = std::stoul(value);
+    } else if (flag == "--max-tiles") {
+      max_tiles = std::stoul(value);
+    } else if (flag == "--ticks") {
+      num_ticks = std::stoul(value);
+    } else {
+      PrintUsage();
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (argc % 2 == 0 || min_tiles == 0 || num_ticks == 0) {
+    PrintUsage();
+    return EXIT_FAILURE;
+  }
+
+  printf("step budget %.2f ms\n", kStepBudgetMs);
+  printf("  tiles   ticks peak live end live   mean ms    p99 ms    max ms "
+         "over\n");
+  for (size_t num_tiles = min_tiles; num_tiles <= max_tiles; num_tiles *= 2) {
+    RunStress(num_tiles, num_ticks);
+  }
+
+  return EXIT_SUCCESS;
+}
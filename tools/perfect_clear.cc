@@ -0,0 +1,182 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "physics/block_generator.h"
+#include "physics/perfect_clear_solver.h"
+#include "physics/piece_set.h"
+#include "physics/world.h"
+#include "server/work_stealing_pool.h"
+
+using tetris::Block;
+using tetris::BlockGenerator;
+using tetris::BlockTemplate;
+using tetris::PerfectClearSolver;
+using tetris::PieceSet;
+using tetris::WorkStealingPool;
+using tetris::World;
+
+namespace {
+
+const size_t kDefaultNumPieces = 10;
+
+void PrintUsage() {
+  printf("usage: perfect_clear [--seed N] [--pieces N] [--threads N] "
+         "[--mode classic|reloaded|bomb] [--piece-set PIECES_PATH] "
+         "[--rows ROWS] [--games N]\n");
+}
+
+/**
+ * Reads rows written as # for a filled tile and . for an empty one
+ * @param text rows separated by /, the bottom row first
+ * @param rows set to the filled tiles of each row
+ * @return false if a row has another character or is too wide
+ */
+bool ParseRows(const std::string& text, std::vector<uint32_t>* rows) {
+  rows->assign(1, 0);
+  size_t col = 0;
+  for (char character : text) {
+    if (character == '/') {
+      rows->push_back(0);
+      col = 0;
+    } else if ((character != '#' && character != '.') || col >= 32) {
+      return false;
+    } else {
+      rows->back() |= character == '#' ? 1u << col : 0u;
+      col++;
+    }
+  }
+
+  return true;
+}
+
+/**
+ * Gets the blocks a seed spawns, in the order the game spawns them
+ * @param world a world in the mode to play
+ * @param seed the seed
+ * @param piece_set blocks to spawn instead of the mode's, or nullptr
+ * @param num_pieces number of blocks
+ * @return templates of the blocks
+ */
+std::vector<const BlockTemplate*> GetSequence(World* world, uint32_t seed,
+    const PieceSet* piece_set, size_t num_pieces) {
+  BlockGenerator generator(world->GetIsBombMode(), seed);
+  generator.SetPieceSet(piece_set);
+  std::vector<const BlockTemplate*> pieces;
+  for (size_t piece = 0; piece < num_pieces; piece++) {
+    std::unique_ptr<Block> block = generator.CreateRandomBlock(world, false);
+    pieces.push_back(&block->GetTemplate());
+    world->GetB2World()->DestroyBody(block->GetBody());
+  }
+
+  return pieces;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  uint32_t seed = 1;
+  size_t num_pieces = kDefaultNumPieces;
+  size_t num_threads = std::thread::hardware_concurrency();
+  size_t num_games = 1;
+  std::string mode = "classic";
+  std::string piece_set_path;
+  std::vector<uint32_t> rows;
+
+  for (int index = 1; index + 1 < argc; index += 2) {
+    std::string flag = argv[index];
+    std::string value = argv[index + 1];
+    if (flag == "--seed") {
+      seed = static_cast<uint32_t>(std::stoul(value));
+    } else if (flag == "--pieces") {
+      num_pieces = std::stoul(value);
+    } else if (flag == "--threads") {
+      num_threads = std::stoul(value);
+    } else if (flag == "--mode") {
+      mode = value;
+    } else if (flag == "--piece-set") {
+      piece_set_path = value;
+    } else if (flag == "--games") {
+      num_games = std::stoul(value);
+    } else if (flag == "--rows" && ParseRows(value, &rows)) {
+      continue;
+    } else {
+      PrintUsage();
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (argc % 2 == 0 || num_games == 0
+      || (mode != "classic" && mode != "reloaded" && mode != "bomb")) {
+    PrintUsage();
+    return EXIT_FAILURE;
+  }
+
+  PieceSet piece_set;
+  std::string error;
+  if (!piece_set_path.empty() && !piece_set.Load(piece_set_path, &error)) {
+    printf("could not load %s, %s\n", piece_set_path.c_str(), error.c_str());
+    return EXIT_FAILURE;
+  }
+
+  World world(false);
+  world.SetIsBombMode(mode == "bomb");
+  world.SetCurrentGameState(
+      mode == "reloaded" ? World::kReloaded : World::kClassic);
+  size_t num_cols = world.GetTotalNumCol();
+  WorkStealingPool pool(num_threads);
+  PerfectClearSolver solver(num_cols, &pool);
+
+  std::vector<double> solve_times;
+  size_t num_found = 0;
+  for (size_t game = 0; game < num_games; game++) {
+    uint32_t game_seed = seed + static_cast<uint32_t>(game);
+    std::vector<const BlockTemplate*> pieces = GetSequence(&world, game_seed,
+        piece_set_path.empty() ? nullptr : &piece_set, num_pieces);
+
+    auto start = std::chrono::steady_clock::now();
+    PerfectClearSolver::Result result =
+        solver.Solve(rows, pieces, num_pieces);
+    std::chrono::duration<double, std::milli> elapsed =
+        std::chrono::steady_clock::now() - start;
+    solve_times.push_back(elapsed.count());
+    num_found += result.is_found_ ? 1 : 0;
+
+    if (num_games > 1) {
+      continue;
+    }
+
+    if (!result.is_found_) {
+      printf("seed %u: no perfect clear within %zu blocks, %zu positions "
+             "in %.1f ms\n", game_seed, num_pieces, result.num_nodes_,
+             elapsed.count());
+      return EXIT_FAILURE;
+    }
+
+    printf("seed %u: clears %zu rows with %zu blocks, %zu positions "
+           "in %.1f ms\n", game_seed, result.height_,
+           result.placements_.size(), result.num_nodes_, elapsed.count());
+    for (const PerfectClearSolver::Placement& placement :
+         result.placements_) {
+      printf("  block %zu, template %d, rotation %zu, at column %d row %d\n",
+          placement.piece_, pieces[placement.piece_]->template_id_,
+          placement.rotation_, placement.col_, placement.row_);
+    }
+  }
+
+  if (num_games > 1) {
+    std::sort(solve_times.begin(), solve_times.end());
+    printf("%zu of %zu seeds clear within %zu blocks, solve time median "
+           "%.1f ms, max %.1f ms\n", num_found, num_games, num_pieces,
+           solve_times[solve_times.size() / 2], solve_times.back());
+  }
+
+  return EXIT_SUCCESS;
+}
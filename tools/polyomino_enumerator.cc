@@ -0,0 +1,162 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "physics/block_template.h"
+#include "physics/piece_set.h"
+#include "physics/polyomino.h"
+#include "server/work_stealing_pool.h"
+
+using tetris::BlockTemplate;
+using tetris::PieceSet;
+using tetris::Polyomino;
+using tetris::PolyominoEnumerator;
+using tetris::WorkStealingPool;
+
+namespace {
+
+const size_t kDefaultMaxCells = 8;
+
+void PrintUsage() {
+  printf("usage: polyomino_enumerator [--max-cells N] [--threads N] "
+         "[--box N] [--lie-flat 0|1] [--out PIECES_PATH] [--min-cells N] "
+         "[--limit N]\n");
+}
+
+/**
+ * Checks a shape against the gameplay filters
+ * @param polyomino the shape
+ * @param box_size side of the box it must fit in
+ * @param must_lie_flat true if it must be able to lie flat
+ * @return true if the shape passes
+ */
+bool IsPlayable(const Polyomino& polyomino, int box_size,
+    bool must_lie_flat) {
+  return polyomino.FitsBox(box_size)
+      && (!must_lie_flat || polyomino.CanLieFlat());
+}
+
+/**
+ * Picks shapes spread evenly through a list, so every size is kept when
+ * there are more shapes than a piece set holds
+ * @param shapes the shapes, in order
+ * @param limit most shapes to keep
+ * @return the shapes kept
+ */
+std::vector<Polyomino> Spread(const std::vector<Polyomino>& shapes,
+    size_t limit) {
+  if (shapes.size() <= limit) {
+    return shapes;
+  }
+
+  std::vector<Polyomino> kept;
+  for (size_t pick = 0; pick < limit; pick++) {
+    kept.push_back(shapes[pick * shapes.size() / limit]);
+  }
+
+  return kept;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  size_t max_cells = kDefaultMaxCells;
+  size_t min_cells = 1;
+  size_t num_threads = std::thread::hardware_concurrency();
+  int box_size = BlockTemplate::kBoxSize;
+  bool must_lie_flat = false;
+  size_t limit = PieceSet::kMaxPieces;
+  std::string out_path;
+
+  for (int index = 1; index + 1 < argc; index += 2) {
+    std::string flag = argv[index];
+    std::string value = argv[index + 1];
+    if (flag == "--max-cells") {
+      max_cells = std::stoul(value);
+    } else if (flag == "--min-cells") {
+      min_cells = std::stoul(value);
+    } else if (flag == "--threads") {
+      num_threads = std::stoul(value);
+    } else if (flag == "--box") {
+      box_size = std::stoi(value);
+    } else if (flag == "--lie-flat") {
+      must_lie_flat = value == "1";
+    } else if (flag == "--out") {
+      out_path = value;
+    } else if (flag == "--limit") {
+      limit = std::stoul(value);
+    } else {
+      PrintUsage();
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (argc % 2 == 0 || max_cells == 0 || max_cells > Polyomino::kMaxCells
+      || limit == 0 || limit > PieceSet::kMaxPieces) {
+    PrintUsage();
+    return EXIT_FAILURE;
+  }
+
+  WorkStealingPool pool(num_threads);
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::vector<Polyomino>> sizes =
+      PolyominoEnumerator::Enumerate(max_cells, &pool);
+  std::chrono::duration<double, std::milli> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  printf("%5s %12s %12s\n", "cells", "free", "playable");
+  std::vector<Polyomino> playable;
+  for (size_t size = 0; size < sizes.size(); size++) {
+    size_t num_cells = size + 1;
+    size_t num_playable = 0;
+    for (const Polyomino& polyomino : sizes[size]) {
+      if (!IsPlayable(polyomino, box_size, must_lie_flat)) {
+        continue;
+      }
+
+      num_playable++;
+      // a piece set holds blocks that fit the box blocks turn in
+      if (num_cells >= min_cells && num_cells <= BlockTemplate::kMaxTiles
+          && polyomino.FitsBox(BlockTemplate::kBoxSize)) {
+        playable.push_back(polyomino);
+      }
+    }
+
+    printf("%5zu %12zu %12zu\n", num_cells, sizes[size].size(), num_playable);
+  }
+
+  printf("enumerated in %.1f ms on %zu threads\n", elapsed.count(),
+      pool.GetNumThreads());
+  if (out_path.empty()) {
+    return EXIT_SUCCESS;
+  }
+
+  // written text is compiled here first, so a bad set is never saved
+  std::vector<Polyomino> pieces = Spread(playable, limit);
+  std::string text = PolyominoEnumerator::WritePieceSet(pieces);
+  std::vector<BlockTemplate> templates;
+  std::vector<uint32_t> weights;
+  std::string error;
+  if (!PieceSet::Compile(text, &templates, &weights, &error)) {
+    printf("could not make a piece set, %s\n", error.c_str());
+    return EXIT_FAILURE;
+  }
+
+  std::ofstream file(out_path);
+  file << text;
+  if (!file) {
+    printf("could not write %s\n", out_path.c_str());
+    return EXIT_FAILURE;
+  }
+
+  printf("wrote %zu of %zu playable pieces to %s\n", pieces.size(),
+      playable.size(), out_path.c_str());
+  return EXIT_SUCCESS;
+}
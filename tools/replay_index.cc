@@ -0,0 +1,196 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "persistence/replay.h"
+#include "persistence/replay_index.h"
+#include "physics/world.h"
+#include "server/work_stealing_pool.h"
+
+using tetris::Replay;
+using tetris::ReplayIndex;
+using tetris::WorkStealingPool;
+using tetris::World;
+
+namespace {
+
+const size_t kDefaultMaxTicks = 200000;
+
+void PrintUsage() {
+  printf("usage: replay_index --index FILE [--build REPLAY_FILE] "
+         "[--interval N] [--ticks N] [--seek TICK] [--verify THREADS] "
+         "[--first-score N] [--first-level N]\n");
+}
+
+/**
+ * Reads a whole file
+ * @param path the file
+ * @param bytes where to put its contents
+ * @return false if the file could not be read
+ */
+bool ReadFile(const std::string& path, std::vector<uint8_t>* bytes) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    return false;
+  }
+
+  bytes->assign(std::istreambuf_iterator<char>(file),
+      std::istreambuf_iterator<char>());
+  return true;
+}
+
+/**
+ * Replays every interval of an index and compares it with the recorded
+ * hashes
+ * @param index the index
+ * @param num_threads threads checking intervals at once
+ * @return first tick that doesn't match, or ReplayIndex::kNoTick
+ */
+size_t Verify(const ReplayIndex& index, size_t num_threads) {
+  std::vector<size_t> desyncs(index.GetNumKeyframes(), ReplayIndex::kNoTick);
+  WorkStealingPool pool(num_threads);
+  pool.ParallelFor(desyncs.size(), [&index, &desyncs](size_t keyframe) {
+    desyncs[keyframe] = index.FindDesync(keyframe);
+  });
+
+  // kNoTick is the largest size_t, so the earliest desync wins
+  return desyncs.empty() ? ReplayIndex::kNoTick
+                         : *std::min_element(desyncs.begin(), desyncs.end());
+}
+
+/**
+ * Prints the result of a search
+ * @param what what was searched for
+ * @param tick the tick found, or ReplayIndex::kNoTick
+ */
+void PrintTick(const std::string& what, size_t tick) {
+  if (tick == ReplayIndex::kNoTick) {
+    printf("%s: never\n", what.c_str());
+  } else {
+    printf("%s: tick %zu\n", what.c_str(), tick);
+  }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::string index_path;
+  std::string replay_path;
+  size_t keyframe_interval = ReplayIndex::kDefaultKeyframeInterval;
+  size_t max_ticks = kDefaultMaxTicks;
+  size_t seek_tick = ReplayIndex::kNoTick;
+  size_t num_verify_threads = 0;
+  size_t first_score = 0;
+  size_t first_level = 0;
+
+  for (int index = 1; index + 1 < argc; index += 2) {
+    std::string flag = argv[index];
+    std::string value = argv[index + 1];
+    if (flag == "--index") {
+      index_path = value;
+    } else if (flag == "--build") {
+      replay_path = value;
+    } else if (flag == "--interval") {
+      keyframe_interval = std::stoul(value);
+    } else if (flag == "--ticks") {
+      max_ticks = std::stoul(value);
+    } else if (flag == "--seek") {
+      seek_tick = std::stoul(value);
+    } else if (flag == "--verify") {
+      num_verify_threads = std::stoul(value);
+    } else if (flag == "--first-score") {
+      first_score = std::stoul(value);
+    } else if (flag == "--first-level") {
+      first_level = std::stoul(value);
+    } else {
+      PrintUsage();
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (argc % 2 == 0 || index_path.empty() || keyframe_interval == 0) {
+    PrintUsage();
+    return EXIT_FAILURE;
+  }
+
+  if (!replay_path.empty()) {
+    std::vector<uint8_t> blob;
+    Replay replay;
+    if (!ReadFile(replay_path, &blob) || !replay.Deserialize(blob)) {
+      printf("%s is not a replay\n", replay_path.c_str());
+      return EXIT_FAILURE;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    if (!ReplayIndex::Build(replay, keyframe_interval, max_ticks,
+        index_path)) {
+      printf("could not write %s\n", index_path.c_str());
+      return EXIT_FAILURE;
+    }
+
+    std::chrono::duration<double, std::milli> elapsed =
+        std::chrono::steady_clock::now() - start;
+    printf("built %s in %.1f ms\n", index_path.c_str(), elapsed.count());
+  }
+
+  ReplayIndex index;
+  if (!index.Open(index_path)) {
+    printf("%s is not a replay index\n", index_path.c_str());
+    return EXIT_FAILURE;
+  }
+
+  printf("%s game with seed %u, %zu ticks, %zu keyframes every %zu ticks\n",
+      index.GetReplay().GetModeName().c_str(), index.GetReplay().GetSeed(),
+      index.GetNumTicks(), index.GetNumKeyframes(),
+      index.GetKeyframeInterval());
+
+  bool is_ok = true;
+  if (seek_tick != ReplayIndex::kNoTick) {
+    World world(false);
+    auto start = std::chrono::steady_clock::now();
+    bool is_reached = index.SeekTo(&world, seek_tick);
+    std::chrono::duration<double, std::milli> elapsed =
+        std::chrono::steady_clock::now() - start;
+    printf("seek to tick %zu took %.2f ms, score %zu, hash %016llx %s\n",
+        world.GetTickCount(), elapsed.count(), world.GetScore(),
+        static_cast<unsigned long long>(world.GetStateHash()),
+        is_reached && world.GetStateHash()
+            == index.GetTickHash(world.GetTickCount())
+            ? "matches" : "does not match");
+    is_ok = is_ok && is_reached;
+  }
+
+  if (num_verify_threads > 0) {
+    auto start = std::chrono::steady_clock::now();
+    size_t desync = Verify(index, num_verify_threads);
+    std::chrono::duration<double, std::milli> elapsed =
+        std::chrono::steady_clock::now() - start;
+    PrintTick("first desync", desync);
+    printf("verified in %.1f ms\n", elapsed.count());
+    is_ok = is_ok && desync == ReplayIndex::kNoTick;
+  }
+
+  // score and level never go down, so they can be bisected
+  if (first_score > 0) {
+    PrintTick("score " + std::to_string(first_score),
+        index.Bisect([first_score](const World& world) {
+          return world.GetScore() >= first_score;
+        }));
+  }
+
+  if (first_level > 0) {
+    PrintTick("level " + std::to_string(first_level),
+        index.Bisect([first_level](const World& world) {
+          return world.GetLevel() >= first_level;
+        }));
+  }
+
+  return is_ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
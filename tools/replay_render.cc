@@ -0,0 +1,239 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "persistence/replay.h"
+#include "physics/world.h"
+#include "physics/world_listener.h"
+#include "render/board_renderer.h"
+
+using tetris::Block;
+using tetris::BoardRenderer;
+using tetris::Replay;
+using tetris::World;
+using tetris::WorldListener;
+
+namespace {
+
+const size_t kDefaultMaxTicks = 20000;
+
+void PrintUsage() {
+  printf("usage: replay_render [--replay FILE | --seed N "
+         "--mode classic|reloaded|bomb|blitz] [--ticks N] [--out-dir DIR] "
+         "[--every N] [--format png|ppm] [--tile-size N]\n");
+}
+
+/**
+ * Renders the board after every step and writes some of the frames
+ */
+class FrameWriter : public WorldListener {
+ private:
+  BoardRenderer renderer_;
+  std::string out_dir_;
+  size_t frame_interval_;
+  bool is_png_;
+  size_t num_frames_ = 0;
+  size_t num_written_ = 0;
+  bool has_write_failed_ = false;
+  // time spent rendering only, not stepping or writing files
+  double render_ms_ = 0.0;
+
+ public:
+  /**
+   * Creates a writer
+   * @param tile_size pixels per tile
+   * @param out_dir directory for frames, empty to render without writing
+   * @param frame_interval write every this many frames
+   * @param is_png true for PNG, false for PPM
+   */
+  FrameWriter(int tile_size, const std::string& out_dir,
+      size_t frame_interval, bool is_png)
+      : renderer_(tile_size), out_dir_(out_dir),
+        frame_interval_(frame_interval), is_png_(is_png) {}
+
+  void OnStepFinished(const World& world) override {
+    auto start = std::chrono::steady_clock::now();
+    renderer_.Render(world);
+    std::chrono::duration<double, std::milli> elapsed =
+        std::chrono::steady_clock::now() - start;
+    render_ms_ += elapsed.count();
+
+    if (!out_dir_.empty() && num_frames_ % frame_interval_ == 0) {
+      char name[32];
+      snprintf(name, sizeof(name), "/frame_%06zu.%s", world.GetTickCount(),
+          is_png_ ? "png" : "ppm");
+      std::string path = out_dir_ + name;
+      bool is_written = is_png_
+          ? renderer_.GetFramebuffer().WritePng(path)
+          : renderer_.GetFramebuffer().WritePpm(path);
+      if (is_written) {
+        num_written_++;
+      } else if (!has_write_failed_) {
+        has_write_failed_ = true;
+        printf("could not write %s\n", path.c_str());
+      }
+    }
+
+    num_frames_++;
+  }
+
+  size_t GetNumFrames() const {
+    return num_frames_;
+  }
+
+  size_t GetNumWritten() const {
+    return num_written_;
+  }
+
+  bool HasWriteFailed() const {
+    return has_write_failed_;
+  }
+
+  double GetRenderMs() const {
+    return render_ms_;
+  }
+};
+
+/**
+ * Reads a whole file
+ * @param path the file
+ * @param bytes where to put its contents
+ * @return false if the file could not be read
+ */
+bool ReadFile(const std::string& path, std::vector<uint8_t>* bytes) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    return false;
+  }
+
+  bytes->assign(std::istreambuf_iterator<char>(file),
+      std::istreambuf_iterator<char>());
+  return true;
+}
+
+/**
+ * Plays a game with random moves, for rendering without a saved replay
+ * @param world a world that has not started a game yet
+ * @param seed seeds the world and the moves
+ * @param mode classic, reloaded, bomb or blitz
+ * @param max_ticks steps to take at most
+ * @return false if the mode is unknown
+ */
+bool PlayRandomGame(World* world, uint32_t seed, const std::string& mode,
+    size_t max_ticks) {
+  if (mode != "classic" && mode != "reloaded" && mode != "bomb"
+      && mode != "blitz") {
+    return false;
+  }
+
+  world->SetSeed(seed);
+  world->SetIsBombMode(mode == "bomb");
+  world->SetIsTileDisconnectedMode(mode == "blitz");
+  world->SetCurrentGameState(
+      mode == "classic" ? World::kClassic : World::kReloaded);
+
+  const Block::Move moves[] = {Block::kMoveLeft, Block::kMoveRight,
+                               Block::kRotate, Block::kHardDrop};
+  std::mt19937 random(seed);
+  while (world->GetCurrentGameState() != World::kEndScreen
+         && world->GetTickCount() < max_ticks) {
+    // roughly one move every eight ticks, like an unhurried player
+    if (random() % 8 == 0) {
+      world->Move(moves[random() % 4]);
+    }
+
+    world->Step();
+  }
+
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::string replay_path;
+  uint32_t seed = 0;
+  std::string mode = "classic";
+  size_t max_ticks = kDefaultMaxTicks;
+  std::string out_dir;
+  size_t frame_interval = 1;
+  std::string format = "png";
+  int tile_size = BoardRenderer::kDefaultTileSize;
+
+  for (int index = 1; index + 1 < argc; index += 2) {
+    std::string flag = argv[index];
+    std::string value = argv[index + 1];
+    if (flag == "--replay") {
+      replay_path = value;
+    } else if (flag == "--seed") {
+      seed = static_cast<uint32_t>(std::stoul(value));
+    } else if (flag == "--mode") {
+      mode = value;
+    } else if (flag == "--ticks") {
+      max_ticks = std::stoul(value);
+    } else if (flag == "--out-dir") {
+      out_dir = value;
+    } else if (flag == "--every") {
+      frame_interval = std::stoul(value);
+    } else if (flag == "--format") {
+      format = value;
+    } else if (flag == "--tile-size") {
+      tile_size = std::stoi(value);
+    } else {
+      PrintUsage();
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (argc % 2 == 0 || frame_interval == 0 || tile_size <= 0
+      || (format != "png" && format != "ppm")) {
+    PrintUsage();
+    return EXIT_FAILURE;
+  }
+
+  World world(false);
+  FrameWriter frame_writer(tile_size, out_dir, frame_interval,
+      format == "png");
+  world.AddListener(&frame_writer);
+
+  auto start = std::chrono::steady_clock::now();
+  if (!replay_path.empty()) {
+    std::vector<uint8_t> blob;
+    Replay replay;
+    if (!ReadFile(replay_path, &blob) || !replay.Deserialize(blob)) {
+      printf("%s is not a replay\n", replay_path.c_str());
+      return EXIT_FAILURE;
+    }
+
+    printf("replaying a %s game with seed %u\n",
+        replay.GetModeName().c_str(), replay.GetSeed());
+    replay.Play(&world, max_ticks);
+  } else if (!PlayRandomGame(&world, seed, mode, max_ticks)) {
+    PrintUsage();
+    return EXIT_FAILURE;
+  }
+
+  std::chrono::duration<double, std::milli> elapsed =
+      std::chrono::steady_clock::now() - start;
+  world.RemoveListener(&frame_writer);
+
+  size_t num_frames = frame_writer.GetNumFrames();
+  double render_ms = frame_writer.GetRenderMs();
+  printf("%zu frames, %zu written, score %zu\n", num_frames,
+      frame_writer.GetNumWritten(), world.GetScore());
+  if (num_frames > 0 && render_ms > 0.0) {
+    printf("render %.3f ms per frame, %.0f frames per second\n",
+        render_ms / num_frames, num_frames * 1000.0 / render_ms);
+  }
+
+  printf("total %.1f ms including physics and file writes\n",
+      elapsed.count());
+  return frame_writer.HasWriteFailed() ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,204 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#if defined(__APPLE__)
+#include <mach/mach.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "physics/world_listener.h"
+#include "telemetry/allocation_tracker.h"
+#include "tetris_engine.h"
+
+using tetris::AllocationTracker;
+using tetris::Block;
+using tetris::TetrisEngine;
+using tetris::World;
+using tetris::WorldListener;
+
+namespace {
+
+const size_t kDefaultNumLocks = 1000000;
+const size_t kDefaultSampleInterval = 50000;
+const size_t kDefaultMaxRssGrowthKb = 2048;
+const size_t kDefaultMaxAllocationGrowth = 16;
+
+/**
+ * Counts the blocks locked into the floor
+ */
+class LockCounter : public WorldListener {
+ private:
+  size_t num_locks_ = 0;
+
+ public:
+  void OnBlockLocked(const World& /* world */, const Block& /* block */,
+      const std::vector<tetris::TilePosition>& /* tiles */) override {
+    num_locks_++;
+  }
+
+  size_t GetNumLocks() const {
+    return num_locks_;
+  }
+};
+
+void PrintUsage() {
+  printf("usage: soak_test [--locks N] [--sample-every N] "
+         "[--max-rss-growth-kb N] [--max-allocation-growth N]\n");
+}
+
+/**
+ * Gets the memory the process has in RAM right now
+ * @return resident size in bytes, 0 if it can't be read
+ */
+size_t GetResidentBytes() {
+#if defined(__APPLE__)
+  mach_task_basic_info info;
+  mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+  if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO,
+      reinterpret_cast<task_info_t>(&info), &count) != KERN_SUCCESS) {
+    return 0;
+  }
+
+  return info.resident_size;
+#else
+  FILE* statm = fopen("/proc/self/statm", "r");
+  if (statm == nullptr) {
+    return 0;
+  }
+
+  unsigned long num_pages = 0;
+  unsigned long num_resident_pages = 0;
+  int num_read = fscanf(statm, "%lu %lu", &num_pages, &num_resident_pages);
+  fclose(statm);
+  if (num_read != 2) {
+    return 0;
+  }
+
+  return num_resident_pages * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+/**
+ * Plays one game with random moves and a hard drop after every step
+ * @param game_index picks the mode and seeds the game
+ * @param max_locks stop after this many locks
+ * @return number of blocks locked
+ */
+size_t PlayGame(size_t game_index, size_t max_locks) {
+  const Block::Move moves[] = {Block::kMoveLeft, Block::kMoveRight,
+                               Block::kRotate};
+  TetrisEngine engine(false);
+  LockCounter lock_counter;
+  World& world = engine.GetWorld();
+  world.AddListener(&lock_counter);
+  world.SetSeed(static_cast<uint32_t>(game_index));
+  world.SetIsBombMode(game_index % 3 == 2);
+  engine.SetCurrentGameState(
+      game_index % 3 == 1 ? World::kReloaded : World::kClassic);
+
+  std::mt19937 random(static_cast<uint32_t>(game_index));
+  while (world.GetCurrentGameState() != World::kEndScreen
+         && lock_counter.GetNumLocks() < max_locks) {
+    world.Step();
+    for (size_t num_moves = random() % 4; num_moves > 0; num_moves--) {
+      engine.Move(moves[random() % 3]);
+    }
+
+    engine.Move(Block::kHardDrop);
+  }
+
+  world.RemoveListener(&lock_counter);
+  return lock_counter.GetNumLocks();
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  size_t num_locks = kDefaultNumLocks;
+  size_t sample_interval = kDefaultSampleInterval;
+  size_t max_rss_growth_kb = kDefaultMaxRssGrowthKb;
+  size_t max_allocation_growth = kDefaultMaxAllocationGrowth;
+
+  for (int index = 1; index + 1 < argc; index += 2) {
+    std::string flag = argv[index];
+    std::string value = argv[index + 1];
+    if (flag == "--locks") {
+      num_locks = std::stoul(value);
+    } else if (flag == "--sample-every") {
+      sample_interval = std::stoul(value);
+    } else if (flag == "--max-rss-growth-kb") {
+      max_rss_growth_kb = std::stoul(value);
+    } else if (flag == "--max-allocation-growth") {
+      max_allocation_growth = std::stoul(value);
+    } else {
+      PrintUsage();
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (argc % 2 == 0 || sample_interval == 0) {
+    PrintUsage();
+    return EXIT_FAILURE;
+  }
+
+  // the first sample is taken once caches and allocator pools have warmed
+  // up, and every later one is compared against it
+  bool has_baseline = false;
+  size_t baseline_rss = 0;
+  size_t baseline_allocations = 0;
+  size_t next_sample = sample_interval;
+  size_t num_locked = 0;
+  size_t num_games = 0;
+
+  if (!AllocationTracker::IsTracked()) {
+    printf("allocations are not counted in this build, only memory is "
+           "checked\n");
+  }
+
+  printf("     locks    games   rss (KiB)  live allocations\n");
+  while (num_locked < num_locks) {
+    num_locked += PlayGame(num_games, num_locks - num_locked);
+    num_games++;
+    if (num_locked < next_sample && num_locked < num_locks) {
+      continue;
+    }
+
+    // samples are taken between games, when no engine is alive
+    next_sample += sample_interval;
+    size_t rss = GetResidentBytes();
+    // every allocation in the process is counted, so a leak shows up as a
+    // growing count between games even when the allocator reuses the memory
+    size_t allocations = static_cast<size_t>(
+        AllocationTracker::GetTotalCounts().GetNumLive());
+    printf("%10zu %8zu %11zu %17zu\n", num_locked, num_games, rss / 1024,
+        allocations);
+
+    if (!has_baseline) {
+      has_baseline = true;
+      baseline_rss = rss;
+      baseline_allocations = allocations;
+      continue;
+    }
+
+    if (rss > baseline_rss + max_rss_growth_kb * 1024) {
+      printf("resident memory grew by %zu KiB\n", (rss - baseline_rss) / 1024);
+      return EXIT_FAILURE;
+    }
+
+    if (allocations > baseline_allocations + max_allocation_growth) {
+      printf("live allocations grew by %zu\n",
+          allocations - baseline_allocations);
+      return EXIT_FAILURE;
+    }
+  }
+
+  printf("memory stayed flat over %zu locks in %zu games\n", num_locked,
+      num_games);
+  return EXIT_SUCCESS;
+}
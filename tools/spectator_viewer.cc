@@ -0,0 +1,138 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "stream/spectator_stream.h"
+
+using tetris::BoardMirror;
+using tetris::SpectatorFrameReader;
+
+namespace {
+
+// Redraws at most this often, frames in between are still applied
+const std::chrono::milliseconds kRedrawPeriod(33);
+
+/**
+ * Connects to a game's spectator socket
+ * @param socket_path path of the Unix domain socket
+ * @return connected socket, or -1 on failure
+ */
+int Connect(const std::string& socket_path) {
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    return -1;
+  }
+
+  sockaddr_un address = {};
+  address.sun_family = AF_UNIX;
+  std::strncpy(address.sun_path, socket_path.c_str(),
+      sizeof(address.sun_path) - 1);
+  if (connect(fd, reinterpret_cast<sockaddr*>(&address),
+      sizeof(address)) != 0) {
+    close(fd);
+    return -1;
+  }
+
+  return fd;
+}
+
+/**
+ * Draws the mirrored board with ANSI colors, top row first
+ * @param mirror the mirrored board
+ */
+void Render(const BoardMirror& mirror) {
+  std::string screen = "\x1b[H";
+  std::vector<bool> is_piece(mirror.GetNumRows() * mirror.GetNumCols());
+  for (const std::pair<int, int>& position : mirror.GetPieceTilePositions()) {
+    if (position.first >= 0 && position.second >= 0
+        && static_cast<size_t>(position.first) < mirror.GetNumRows()
+        && static_cast<size_t>(position.second) < mirror.GetNumCols()) {
+      is_piece[position.first * mirror.GetNumCols() + position.second] = true;
+    }
+  }
+
+  char color_code[32];
+  for (size_t row = mirror.GetNumRows(); row-- > 0;) {
+    screen += "|";
+    for (size_t col = 0; col < mirror.GetNumCols(); col++) {
+      const BoardMirror::Tile& tile =
+          is_piece[row * mirror.GetNumCols() + col] ? mirror.GetPieceColor()
+                                                    : mirror.GetTile(row, col);
+      if (!tile.is_filled_) {
+        screen += "  ";
+        continue;
+      }
+
+      snprintf(color_code, sizeof(color_code), "\x1b[48;2;%d;%d;%dm  \x1b[0m",
+          tile.r_, tile.g_, tile.b_);
+      screen += color_code;
+    }
+
+    screen += "|\n";
+  }
+
+  screen += "tick " + std::to_string(mirror.GetTick())
+      + "  score " + std::to_string(mirror.GetScore()) + "\x1b[K\n";
+  fwrite(screen.data(), 1, screen.size(), stdout);
+  fflush(stdout);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc != 2) {
+    printf("usage: spectator_viewer SOCKET_PATH\n");
+    return EXIT_FAILURE;
+  }
+
+  int fd = Connect(argv[1]);
+  if (fd < 0) {
+    printf("could not connect to %s\n", argv[1]);
+    return EXIT_FAILURE;
+  }
+
+  SpectatorFrameReader reader;
+  BoardMirror mirror;
+  std::vector<uint8_t> frame;
+  uint8_t buffer[1 << 16];
+  auto last_redraw = std::chrono::steady_clock::now();
+  bool is_redraw_needed = false;
+  // clear the screen once, later redraws only move the cursor home
+  printf("\x1b[2J");
+
+  while (true) {
+    pollfd poll_fd = {fd, POLLIN, 0};
+    if (poll(&poll_fd, 1, static_cast<int>(kRedrawPeriod.count())) > 0) {
+      ssize_t size = read(fd, buffer, sizeof(buffer));
+      if (size <= 0) {
+        break;
+      }
+
+      reader.Append(buffer, static_cast<size_t>(size));
+      while (reader.NextFrame(&frame)) {
+        is_redraw_needed |= mirror.ApplyFrame(frame.data(), frame.size());
+      }
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    if (is_redraw_needed && mirror.HasKeyframe()
+        && now - last_redraw >= kRedrawPeriod) {
+      Render(mirror);
+      last_redraw = now;
+      is_redraw_needed = false;
+    }
+  }
+
+  close(fd);
+  printf("stream ended\n");
+  return EXIT_SUCCESS;
+}
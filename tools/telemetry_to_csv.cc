@@ -0,0 +1,31 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+
+#include "telemetry/event_log.h"
+
+using tetris::EventLogReader;
+using tetris::TelemetryEvent;
+
+int main(int argc, char** argv) {
+  if (argc != 2) {
+    printf("usage: telemetry_to_csv LOG_PATH\n");
+    return EXIT_FAILURE;
+  }
+
+  EventLogReader reader;
+  if (!reader.Open(argv[1])) {
+    printf("%s is not a telemetry log\n", argv[1]);
+    return EXIT_FAILURE;
+  }
+
+  tetris::WriteEventCsvHeader(std::cout);
+  TelemetryEvent event;
+  while (reader.Next(&event)) {
+    tetris::WriteEventCsvRow(std::cout, event);
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,482 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#include <termios.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "persistence/replay.h"
+#include "physics/block_template.h"
+#include "physics/world_listener.h"
+#include "render/terminal_canvas.h"
+#include "tetris_engine.h"
+
+using tetris::Block;
+using tetris::Board;
+using tetris::Replay;
+using tetris::TerminalCanvas;
+using tetris::TetrisEngine;
+using tetris::World;
+using tetris::WorldListener;
+
+namespace {
+
+const std::chrono::microseconds kTickDuration(1000000 / 60);
+// every tile is two cells wide, so tiles look square in most fonts
+const int kCellsPerTile = 2;
+const int kSidebarWidth = 24;
+const size_t kMaxReplayTicks = 1000000;
+// resets colors, clears the screen and shows the cursor again
+const char* const kRestoreScreen = "\x1b[0m\x1b[2J\x1b[H\x1b[?25h";
+
+// set from the signal handler to leave the game loop
+volatile sig_atomic_t is_quit_requested = 0;
+
+void HandleQuitSignal(int) {
+  is_quit_requested = 1;
+}
+
+void PrintUsage() {
+  printf("usage: terminal_tetris [--replay FILE]\n");
+}
+
+/**
+ * Puts the terminal in raw mode and restores it when destroyed
+ */
+class RawTerminal {
+ private:
+  termios original_;
+  bool is_raw_;
+
+ public:
+  RawTerminal() : is_raw_(false) {
+    if (tcgetattr(STDIN_FILENO, &original_) != 0) {
+      return;
+    }
+
+    // keys arrive one at a time without echo, and reads never wait; ISIG
+    // is kept so Ctrl-C still quits
+    termios raw = original_;
+    raw.c_lflag &= static_cast<tcflag_t>(~(ICANON | ECHO));
+    raw.c_iflag &= static_cast<tcflag_t>(~(IXON | ICRNL));
+    raw.c_cc[VMIN] = 0;
+    raw.c_cc[VTIME] = 0;
+    is_raw_ = tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw) == 0;
+  }
+
+  ~RawTerminal() {
+    Restore();
+  }
+
+  /**
+   * Puts the terminal back the way it was, before exiting
+   */
+  void Restore() {
+    if (is_raw_) {
+      tcsetattr(STDIN_FILENO, TCSAFLUSH, &original_);
+      is_raw_ = false;
+    }
+  }
+
+  RawTerminal(const RawTerminal&) = delete;
+  RawTerminal& operator=(const RawTerminal&) = delete;
+
+  bool IsRaw() const {
+    return is_raw_;
+  }
+};
+
+/**
+ * Writes all of the given bytes to the terminal
+ * @param bytes the bytes
+ */
+void WriteToTerminal(const std::string& bytes) {
+  size_t offset = 0;
+  while (offset < bytes.size()) {
+    ssize_t num_written = write(STDOUT_FILENO, bytes.data() + offset,
+        bytes.size() - offset);
+    if (num_written <= 0) {
+      return;
+    }
+
+    offset += static_cast<size_t>(num_written);
+  }
+}
+
+/**
+ * Reads the keys pressed since the last call, without waiting
+ * @return the bytes the terminal sent
+ */
+std::string ReadKeys() {
+  std::string keys;
+  char buffer[64];
+  ssize_t num_read;
+  while ((num_read = read(STDIN_FILENO, buffer, sizeof(buffer))) > 0) {
+    keys.append(buffer, static_cast<size_t>(num_read));
+  }
+
+  return keys;
+}
+
+/**
+ * Converts a game color to the terminal palette
+ * @param color the color
+ * @return palette index
+ */
+uint16_t ToTerminalColor(const cinder::Color& color) {
+  return TerminalCanvas::GetColorIndex(color.r, color.g, color.b);
+}
+
+/**
+ * Fills the cells of the tile at a board position
+ * @param canvas where to draw
+ * @param world the world, for its size
+ * @param x tile column
+ * @param y tile row, from the bottom
+ * @param glyphs the two characters of the tile
+ * @param foreground palette index
+ * @param background palette index
+ */
+void DrawTile(TerminalCanvas* canvas, const World& world, int x, int y,
+    const char* glyphs, uint16_t foreground, uint16_t background) {
+  if (x < 0 || x >= static_cast<int>(world.GetTotalNumCol()) || y < 0
+      || y >= static_cast<int>(world.GetTotalNumRow())) {
+    return;
+  }
+
+  // one cell of border around the board
+  int col = 1 + x * kCellsPerTile;
+  int row = 1 + static_cast<int>(world.GetTotalNumRow()) - 1 - y;
+  for (int cell = 0; cell < kCellsPerTile; cell++) {
+    canvas->SetCell(col + cell, row, glyphs[cell], foreground, background);
+  }
+}
+
+/**
+ * Draws a box given in world units as the tile its center is in
+ * @param canvas where to draw
+ * @param world the world
+ * @param box the box
+ * @param y_offset added to the box's y, in tiles
+ * @param glyphs the two characters of the tile
+ * @param foreground palette index
+ * @param background palette index
+ */
+void DrawWorldBox(TerminalCanvas* canvas, const World& world,
+    const b2AABB& box, float y_offset, const char* glyphs,
+    uint16_t foreground, uint16_t background) {
+  b2Vec2 center = box.GetCenter();
+  DrawTile(canvas, world, static_cast<int>(std::floor(center.x)),
+      static_cast<int>(std::floor(center.y + y_offset)), glyphs, foreground,
+      background);
+}
+
+/**
+ * Draws the board, the pieces and the sidebar
+ * @param canvas where to draw, sized by this call
+ * @param world the world
+ */
+void DrawWorld(TerminalCanvas* canvas, const World& world) {
+  int board_width = static_cast<int>(world.GetTotalNumCol()) * kCellsPerTile;
+  int board_height = static_cast<int>(world.GetTotalNumRow());
+  if (canvas->GetWidth() != board_width + 2 + kSidebarWidth
+      || canvas->GetHeight() != board_height + 2) {
+    canvas->Resize(board_width + 2 + kSidebarWidth, board_height + 2);
+  }
+
+  canvas->Clear();
+  const uint16_t kBorderColor = TerminalCanvas::GetColorIndex(0.5f, 0.5f,
+      0.5f);
+  for (int col = 0; col < board_width + 2; col++) {
+    canvas->SetCell(col, 0, '-', kBorderColor, TerminalCanvas::kDefaultColor);
+    canvas->SetCell(col, board_height + 1, '-', kBorderColor,
+        TerminalCanvas::kDefaultColor);
+  }
+
+  for (int row = 1; row <= board_height; row++) {
+    canvas->SetCell(0, row, '|', kBorderColor, TerminalCanvas::kDefaultColor);
+    canvas->SetCell(board_width + 1, row, '|', kBorderColor,
+        TerminalCanvas::kDefaultColor);
+  }
+
+  const Board& board = world.GetBoard();
+  for (size_t row = 0; row < board.GetNumRows(); row++) {
+    for (size_t col = 0; col < board.GetNumCols(); col++) {
+      if (board.IsExploded(row, col)) {
+        DrawTile(canvas, world, static_cast<int>(col), static_cast<int>(row),
+            "**", TerminalCanvas::GetColorIndex(1.0f, 1.0f, 1.0f),
+            TerminalCanvas::kDefaultColor);
+      } else if (board.IsFilled(row, col)) {
+        uint16_t color = ToTerminalColor(board.GetTileColor(row, col));
+        DrawTile(canvas, world, static_cast<int>(col), static_cast<int>(row),
+            "  ", color, color);
+      }
+    }
+  }
+
+  for (const World::Debris& debris : world.GetDebris()) {
+    uint16_t color = TerminalCanvas::GetColorIndex(
+        debris.block_template_->red_, debris.block_template_->green_,
+        debris.block_template_->blue_);
+    DrawWorldBox(canvas, world, debris.body_->GetFixtureList()->GetAABB(0),
+        0.0f, "  ", color, color);
+  }
+
+  const Block* block = world.GetMovingBlock();
+  if (block != nullptr) {
+    uint16_t color = block->IsBomb()
+        ? TerminalCanvas::GetColorIndex(0.6f, 0.6f, 0.6f)
+        : ToTerminalColor(block->GetColor());
+    float drop_distance = world.GetDropDistance();
+    // the landing outline first, so the block covers it where they meet
+    for (const b2AABB& tile : block->GetBoundingBoxList()) {
+      DrawWorldBox(canvas, world, tile, -drop_distance, "[]", color,
+          TerminalCanvas::kDefaultColor);
+    }
+
+    for (const b2AABB& tile : block->GetBoundingBoxList()) {
+      DrawWorldBox(canvas, world, tile, 0.0f, "  ", color, color);
+    }
+  }
+
+  int sidebar = board_width + 4;
+  canvas->DrawText(sidebar, 1, "score " + std::to_string(world.GetScore()));
+  canvas->DrawText(sidebar, 2, "level " + std::to_string(world.GetLevel()));
+  canvas->DrawText(sidebar, 4, "left/right  move");
+  canvas->DrawText(sidebar, 5, "down        drop");
+  canvas->DrawText(sidebar, 6, "z/up        rotate");
+  canvas->DrawText(sidebar, 7, "space       hard drop");
+  canvas->DrawText(sidebar, 8, "q           quit");
+}
+
+/**
+ * Draws the mode menu
+ * @param canvas where to draw
+ */
+void DrawStartScreen(TerminalCanvas* canvas) {
+  if (canvas->GetWidth() == 0) {
+    canvas->Resize(40, 8);
+  }
+
+  canvas->Clear();
+  canvas->DrawText(2, 1, "TETRIS RELOADED");
+  canvas->DrawText(2, 3, "1  classic");
+  canvas->DrawText(2, 4, "2  reloaded");
+  canvas->DrawText(2, 5, "3  blitz");
+  canvas->DrawText(2, 6, "4  bomb");
+  canvas->DrawText(2, 7, "q  quit");
+}
+
+/**
+ * Turns the bytes a terminal sends for a key into a move
+ * @param keys pressed keys; the ones used are removed from the front
+ * @param move set to the move of the key
+ * @return false if the first key is not a move
+ */
+bool ParseMove(std::string* keys, Block::Move* move) {
+  // arrows arrive as ESC [ A to D, or ESC O A to D in application mode
+  if (keys->size() >= 3 && (*keys)[0] == '\x1b'
+      && ((*keys)[1] == '[' || (*keys)[1] == 'O')) {
+    char arrow = (*keys)[2];
+    keys->erase(0, 3);
+    switch (arrow) {
+      case 'A':
+        *move = Block::kRotate;
+        return true;
+      case 'B':
+        *move = Block::kMoveDown;
+        return true;
+      case 'C':
+        *move = Block::kMoveRight;
+        return true;
+      case 'D':
+        *move = Block::kMoveLeft;
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  char key = (*keys)[0];
+  keys->erase(0, 1);
+  switch (key) {
+    case 'z':
+    case 'x':
+      *move = Block::kRotate;
+      return true;
+    case ' ':
+      *move = Block::kHardDrop;
+      return true;
+    case 'c':
+      *move = Block::kHold;
+      return true;
+    default:
+      return false;
+  }
+}
+
+/**
+ * Redraws the world after every step and paces the steps to 60 Hz, for
+ * watching a replay
+ */
+class ReplayWatcher : public WorldListener {
+ private:
+  TerminalCanvas* canvas_;
+  std::chrono::steady_clock::time_point next_tick_;
+  bool is_quit_ = false;
+
+ public:
+  /**
+   * Creates a watcher
+   * @param canvas where to draw
+   */
+  explicit ReplayWatcher(TerminalCanvas* canvas)
+      : canvas_(canvas), next_tick_(std::chrono::steady_clock::now()) {}
+
+  void OnStepFinished(const World& world) override {
+    DrawWorld(canvas_, world);
+    WriteToTerminal(canvas_->Flush());
+    if (ReadKeys().find('q') != std::string::npos || is_quit_requested) {
+      // the replay stops at the end of this step, see IsQuit
+      is_quit_ = true;
+      return;
+    }
+
+    next_tick_ += kTickDuration;
+    std::this_thread::sleep_until(next_tick_);
+  }
+
+  /**
+   * Checks if the viewer asked to quit part way through
+   * @return true once q or a quit signal was seen
+   */
+  bool IsQuit() const {
+    return is_quit_;
+  }
+};
+
+/**
+ * Reads a whole file
+ * @param path the file
+ * @param bytes where to put its contents
+ * @return false if the file could not be read
+ */
+bool ReadFile(const std::string& path, std::vector<uint8_t>* bytes) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    return false;
+  }
+
+  bytes->assign(std::istreambuf_iterator<char>(file),
+      std::istreambuf_iterator<char>());
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::string replay_path;
+  if (argc == 3 && std::string(argv[1]) == "--replay") {
+    replay_path = argv[2];
+  } else if (argc != 1) {
+    PrintUsage();
+    return EXIT_FAILURE;
+  }
+
+  Replay replay;
+  if (!replay_path.empty()) {
+    std::vector<uint8_t> blob;
+    if (!ReadFile(replay_path, &blob) || !replay.Deserialize(blob)) {
+      printf("%s is not a replay\n", replay_path.c_str());
+      return EXIT_FAILURE;
+    }
+  }
+
+  RawTerminal raw_terminal;
+  if (!raw_terminal.IsRaw()) {
+    printf("standard input is not a terminal\n");
+    return EXIT_FAILURE;
+  }
+
+  signal(SIGINT, HandleQuitSignal);
+  signal(SIGTERM, HandleQuitSignal);
+  // hide the cursor while playing
+  WriteToTerminal("\x1b[?25l");
+
+  TetrisEngine engine(false);
+  World& world = engine.GetWorld();
+  TerminalCanvas canvas;
+  if (!replay_path.empty()) {
+    ReplayWatcher watcher(&canvas);
+    world.AddListener(&watcher);
+    replay.Play(&world, kMaxReplayTicks, [&watcher](const World&) {
+      return watcher.IsQuit();
+    });
+    world.RemoveListener(&watcher);
+  } else {
+    auto next_tick = std::chrono::steady_clock::now();
+    while (!is_quit_requested
+           && engine.GetCurrentGameState() != World::kEndScreen) {
+      std::string keys = ReadKeys();
+      if (engine.GetCurrentGameState() == World::kChooseMode) {
+        for (char key : keys) {
+          if (key == '1') {
+            engine.SetCurrentGameState(World::kClassic);
+          } else if (key == '2') {
+            engine.SetCurrentGameState(World::kReloaded);
+          } else if (key == '3') {
+            world.SetIsTileDisconnectedMode(true);
+            engine.SetCurrentGameState(World::kReloaded);
+          } else if (key == '4') {
+            world.SetIsBombMode(true);
+            engine.SetCurrentGameState(World::kClassic);
+          } else if (key == 'q') {
+            is_quit_requested = 1;
+          }
+
+          if (engine.GetCurrentGameState() != World::kChooseMode) {
+            break;
+          }
+        }
+      } else {
+        while (!keys.empty()) {
+          if (keys[0] == 'q') {
+            is_quit_requested = 1;
+            break;
+          }
+
+          Block::Move move;
+          if (ParseMove(&keys, &move)) {
+            engine.Move(move);
+          }
+        }
+
+        world.Step();
+      }
+
+      if (engine.GetCurrentGameState() == World::kChooseMode) {
+        DrawStartScreen(&canvas);
+      } else {
+        DrawWorld(&canvas, world);
+      }
+
+      WriteToTerminal(canvas.Flush());
+      next_tick += kTickDuration;
+      std::this_thread::sleep_until(next_tick);
+    }
+  }
+
+  // leave the screen as the shell had it
+  WriteToTerminal(kRestoreScreen);
+  printf("score %zu\n", world.GetScore());
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,141 @@
+// Copyright (c) 2020 [Henrik Tseng]. All rights reserved.
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <thread>
+
+#include "bot/heuristic_bot.h"
+#include "bot/weight_tuner.h"
+#include "server/work_stealing_pool.h"
+
+using tetris::HeuristicBot;
+using tetris::WeightTuner;
+using tetris::WorkStealingPool;
+using tetris::World;
+
+namespace {
+
+const size_t kDefaultNumGenerations = 20;
+const size_t kDefaultPopulation = 24;
+const size_t kDefaultNumParents = 6;
+const size_t kDefaultGamesPerMode = 8;
+const size_t kDefaultMaxPieces = 500;
+const double kDefaultStep = 0.3;
+
+void PrintUsage() {
+  printf("usage: weight_tuner [--generations N] [--population N] "
+         "[--parents N] [--games N] [--pieces N] "
+         "[--modes classic|reloaded|both] [--backend grid|world] "
+         "[--threads N] [--seed N] [--step X] [--checkpoint FILE]\n");
+}
+
+void PrintWeights(const char* label, const HeuristicBot::Weights& weights) {
+  printf("%s:", label);
+  for (size_t feature = 0; feature < weights.size(); feature++) {
+    printf(" %s %.4f", HeuristicBot::GetFeatureName(
+        static_cast<HeuristicBot::Feature>(feature)), weights[feature]);
+  }
+
+  printf("\n");
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  size_t num_generations = kDefaultNumGenerations;
+  size_t num_threads = std::thread::hardware_concurrency();
+  std::string modes = "both";
+  std::string backend = "grid";
+  std::string checkpoint_path;
+  WeightTuner::Options options = {kDefaultPopulation, kDefaultNumParents,
+      kDefaultGamesPerMode, kDefaultMaxPieces, {},
+      WeightTuner::kGridBackend, 1, kDefaultStep};
+
+  for (int index = 1; index + 1 < argc; index += 2) {
+    std::string flag = argv[index];
+    std::string value = argv[index + 1];
+    if (flag == "--generations") {
+      num_generations = std::stoul(value);
+    } else if (flag == "--population") {
+      options.population_ = std::stoul(value);
+    } else if (flag == "--parents") {
+      options.num_parents_ = std::stoul(value);
+    } else if (flag == "--games") {
+      options.games_per_mode_ = std::stoul(value);
+    } else if (flag == "--pieces") {
+      options.max_pieces_ = std::stoul(value);
+    } else if (flag == "--modes") {
+      modes = value;
+    } else if (flag == "--backend") {
+      backend = value;
+    } else if (flag == "--threads") {
+      num_threads = std::stoul(value);
+    } else if (flag == "--seed") {
+      options.seed_ = static_cast<uint32_t>(std::stoul(value));
+    } else if (flag == "--step") {
+      options.initial_step_ = std::stod(value);
+    } else if (flag == "--checkpoint") {
+      checkpoint_path = value;
+    } else {
+      PrintUsage();
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (modes == "classic" || modes == "both") {
+    options.modes_.push_back(World::kClassic);
+  }
+
+  if (modes == "reloaded" || modes == "both") {
+    options.modes_.push_back(World::kReloaded);
+  }
+
+  if (argc % 2 == 0 || options.modes_.empty()
+      || options.games_per_mode_ == 0
+      || (backend != "grid" && backend != "world")) {
+    PrintUsage();
+    return EXIT_FAILURE;
+  }
+
+  options.backend_ = backend == "world" ? WeightTuner::kWorldBackend
+                                        : WeightTuner::kGridBackend;
+  WorkStealingPool pool(num_threads);
+  WeightTuner tuner(options, &pool);
+  std::string error;
+
+  // an existing checkpoint continues the search it was written by
+  if (!checkpoint_path.empty() && std::ifstream(checkpoint_path)) {
+    if (!tuner.LoadCheckpoint(checkpoint_path, &error)) {
+      printf("could not resume from %s, %s\n", checkpoint_path.c_str(),
+          error.c_str());
+      return EXIT_FAILURE;
+    }
+
+    printf("resuming at generation %zu\n", tuner.GetGeneration());
+  }
+
+  while (tuner.GetGeneration() < num_generations) {
+    WeightTuner::Report report = tuner.RunGeneration();
+    printf("generation %zu: best %.1f rows, mean %.1f rows, step %.3f, "
+           "%.0f games/s, %.0f blocks/s, %.0f%% of %zu threads busy\n",
+        report.generation_, report.best_fitness_, report.mean_fitness_,
+        report.step_, static_cast<double>(report.num_games_) / report.seconds_,
+        static_cast<double>(report.num_pieces_) / report.seconds_,
+        report.utilization_ * 100.0,
+        pool.GetNumThreads() + 1);
+
+    if (!checkpoint_path.empty()
+        && !tuner.SaveCheckpoint(checkpoint_path, &error)) {
+      printf("could not save %s, %s\n", checkpoint_path.c_str(),
+          error.c_str());
+      return EXIT_FAILURE;
+    }
+  }
+
+  PrintWeights("mean weights", tuner.GetMean());
+  printf("best sample, %.1f rows a game\n", tuner.GetBestFitness());
+  PrintWeights("best weights", tuner.GetBestWeights());
+  return EXIT_SUCCESS;
+}